@@ -169,6 +169,7 @@ testScripts = [
     # 'rpcnamedargs.py',
     'listsinceblock.py',
     'p2p-leaktests.py',
+    'p2p-socketevents.py',
     'notifications.py',
 
     # Privora-specific tests
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 The Privora Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test that nodes using different -socketevents backends relay transactions and
+# blocks larger than one receive buffer (64 KB) to each other without stalling.
+#
+
+from test_framework.test_framework import PrivoraTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+    connect_nodes_bi,
+    start_nodes,
+    sync_blocks,
+    sync_mempools,
+)
+import time
+
+class SocketEventsTest(PrivoraTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 3
+        self.setup_clean_chain = False
+
+    def setup_network(self):
+        # node0 uses the platform default, epoll where available
+        extra_args = [[], ["-socketevents=select"], ["-socketevents=poll"]]
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, extra_args)
+        connect_nodes_bi(self.nodes, 0, 1)
+        connect_nodes_bi(self.nodes, 1, 2)
+        connect_nodes_bi(self.nodes, 0, 2)
+        self.is_network_split = False
+        self.sync_all()
+
+    def run_test(self):
+        assert_equal(self.nodes[1].getnetworkinfo()["socketevents"], "select")
+        assert_equal(self.nodes[2].getnetworkinfo()["socketevents"], "poll")
+        print("node0 uses %s" % self.nodes[0].getnetworkinfo()["socketevents"])
+
+        # Every node sends one large transaction, so each backend both reads and writes
+        # messages that take several reads to drain
+        for node in self.nodes:
+            outputs = {}
+            for i in range(2000):
+                outputs[self.nodes[i % self.num_nodes].getnewaddress()] = 0.01
+            txid = node.sendmany("", outputs)
+            assert_greater_than(len(node.gettransaction(txid)["hex"]) // 2, 0x10000)
+
+        start = time.time()
+        sync_mempools(self.nodes, timeout=30)
+        for node in self.nodes:
+            assert_equal(len(node.getrawmempool()), self.num_nodes)
+
+        # the first block carries all three transactions, each node announces one block
+        for node in self.nodes:
+            node.generate(1)
+            sync_blocks(self.nodes, timeout=30)
+        for node in self.nodes:
+            assert_equal(len(node.getrawmempool()), 0)
+        print("Relayed in %.1f seconds" % (time.time() - start))
+
+if __name__ == '__main__':
+    SocketEventsTest().main()
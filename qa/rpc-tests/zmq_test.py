@@ -9,9 +9,16 @@
 
 from test_framework.test_framework import PrivoraTestFramework
 from test_framework.util import *
+from test_framework.mininode import deser_compact_size, deser_string
+from io import BytesIO
 import zmq
 import struct
 
+# event byte of the privacy topics
+EVENT_MEMPOOL = 0
+EVENT_CONNECTED = 1
+EVENT_DISCONNECTED = 2
+
 class ZMQTest (PrivoraTestFramework):
 
     def __init__(self):
@@ -19,6 +26,8 @@ class ZMQTest (PrivoraTestFramework):
         self.num_nodes = 4
 
     port = 28332
+    privacyPort = 28333
+    privacyTopics = [b"sparkmint", b"sparkspend", b"sparkname", b"lelantusspend"]
 
     def setup_nodes(self):
         self.zmqContext = zmq.Context()
@@ -26,8 +35,17 @@ class ZMQTest (PrivoraTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % self.port)
+        # the privacy topics share one publisher socket on their own port, so they don't
+        # interleave with the hashblock/hashtx sequence checks above
+        self.zmqPrivacySocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqPrivacySocket.setsockopt(zmq.RCVTIMEO, 60000)
+        for topic in self.privacyTopics:
+            self.zmqPrivacySocket.setsockopt(zmq.SUBSCRIBE, topic)
+        self.zmqPrivacySocket.connect("tcp://127.0.0.1:%i" % self.privacyPort)
+        privacyAddress = 'tcp://127.0.0.1:' + str(self.privacyPort)
         return start_nodes(self.num_nodes, self.options.tmpdir, extra_args=[
-            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)],
+            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)] +
+            ['-zmqpub%s=%s' % (topic.decode(), privacyAddress) for topic in self.privacyTopics],
             [],
             [],
             []
@@ -92,6 +110,72 @@ class ZMQTest (PrivoraTestFramework):
 
         assert_equal(hashRPC, hashZMQ) #blockhash from generate must be equal to the hash received over zmq
 
+        self.run_privacy_test()
+
+    # Privacy topics carry: uint8 event | int32 height | uint256 txid | compact size count | items
+    def recv_privacy_event(self, topic, txid, event):
+        # skip notifications of other transactions and events, a spend also publishes the
+        # mint of its change and a reorg puts transactions back into the mempool
+        while True:
+            msg = self.zmqPrivacySocket.recv_multipart()
+            assert(msg[0] in self.privacyTopics)
+            assert(msg[0] != b"lelantusspend") # no Lelantus transactions are made here
+            f = BytesIO(msg[1])
+            msgEvent = struct.unpack('<B', f.read(1))[0]
+            height = struct.unpack('<i', f.read(4))[0]
+            msgTxid = bytes_to_hex_str(f.read(32)[::-1])
+            count = deser_compact_size(f)
+            if msg[0] == topic and msgTxid == txid and msgEvent == event:
+                assert_greater_than(count, 0)
+                if event == EVENT_MEMPOOL:
+                    assert_equal(height, -1)
+                return height, count, f
+
+    def run_privacy_test(self):
+        node = self.nodes[0]
+        # Spark is active from block 100 and the cached chain is longer
+        assert_greater_than(node.getblockcount(), 105)
+        sparkAddress = node.getsparkdefaultaddress()[0]
+
+        print("spark mint...")
+        mintTxid = node.mintspark({sparkAddress: {"amount": 10, "memo": ""}})[0]
+        self.recv_privacy_event(b"sparkmint", mintTxid, EVENT_MEMPOOL)
+        blockHash = node.generate(1)[0]
+        height, count, _ = self.recv_privacy_event(b"sparkmint", mintTxid, EVENT_CONNECTED)
+        assert_equal(height, node.getblockcount())
+        assert_equal(count, 1)
+
+        # the mint rolls back with its block and comes back with the next one
+        node.invalidateblock(blockHash)
+        disconnectedHeight, _, _ = self.recv_privacy_event(b"sparkmint", mintTxid, EVENT_DISCONNECTED)
+        assert_equal(disconnectedHeight, height)
+        node.reconsiderblock(blockHash)
+        self.recv_privacy_event(b"sparkmint", mintTxid, EVENT_CONNECTED)
+        node.generate(1)
+        self.sync_all()
+
+        print("spark spend...")
+        spendTxid = node.spendspark({node.getnewaddress(): {"amount": 1, "subtractFee": False}}, {})
+        _, count, _ = self.recv_privacy_event(b"sparkspend", spendTxid, EVENT_MEMPOOL)
+        assert_equal(count, 1) # one linking tag per spent coin
+        node.generate(1)
+        height, _, _ = self.recv_privacy_event(b"sparkspend", spendTxid, EVENT_CONNECTED)
+        assert_equal(height, node.getblockcount())
+        # let the change of the spend confirm before it pays the name fee
+        node.generate(1)
+        self.sync_all()
+
+        print("spark name...")
+        nameTxid = node.registersparkname("zmqtestname", sparkAddress, 1)
+        _, count, f = self.recv_privacy_event(b"sparkname", nameTxid, EVENT_MEMPOOL)
+        assert_equal(count, 1)
+        f.read(2 + 32) # version, inputs hash
+        assert_equal(deser_string(f), b"zmqtestname")
+        assert_equal(deser_string(f).decode(), sparkAddress)
+        node.generate(1)
+        self.recv_privacy_event(b"sparkname", nameTxid, EVENT_CONNECTED)
+        self.sync_all()
+
 
 if __name__ == '__main__':
     ZMQTest ().main ()
@@ -7,6 +7,7 @@
 #include "lelantus.h"
 #include "ui_interface.h"
 #include "spark/state.h"
+#include "perfstats.h"
 
 std::unique_ptr<BatchProofContainer> BatchProofContainer::instance;
 
@@ -164,6 +165,7 @@ void BatchProofContainer::erase(std::vector<LelantusSigmaProofData>* vProofs, co
 }
 
 void BatchProofContainer::batch_sigma() {
+    CPerfTimer perfTimer(PerfStat::BATCH_VERIFY_SIGMA);
     if (!sigmaProofs.empty()){
         LogPrintf("Sigma batch verification started.\n");
         uiInterface.UpdateProgressBarLabel("Batch verifying Sigma...");
@@ -241,6 +243,7 @@ void BatchProofContainer::batch_sigma() {
 }
 
 void BatchProofContainer::batch_lelantus() {
+    CPerfTimer perfTimer(PerfStat::BATCH_VERIFY_LELANTUS);
     if (!lelantusSigmaProofs.empty()){
         LogPrintf("Lelantus batch verification started.\n");
         uiInterface.UpdateProgressBarLabel("Batch verifying Lelantus...");
@@ -344,6 +347,7 @@ void BatchProofContainer::batch_lelantus() {
 }
 
 void BatchProofContainer::batch_rangeProofs() {
+    CPerfTimer perfTimer(PerfStat::BATCH_VERIFY_RANGEPROOFS);
     if (!rangeProofs.empty()){
         LogPrintf("RangeProof batch verification started.\n");
         uiInterface.UpdateProgressBarLabel("Batch verifying Range Proofs...");
@@ -405,6 +409,7 @@ void BatchProofContainer::remove(const spark::SpendTransaction& tx) {
 }
 
 void BatchProofContainer::batch_spark() {
+    CPerfTimer perfTimer(PerfStat::BATCH_VERIFY_SPARK);
     if (!sparkTransactions.empty()){
         LogPrintf("Spark batch verification started.\n");
         uiInterface.UpdateProgressBarLabel("Batch verifying Spark Proofs...");
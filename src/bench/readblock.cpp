@@ -0,0 +1,103 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "pow.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/filesystem.hpp>
+
+// Compares serving a stored block the way getdata used to (decode it, check the
+// ProgPoW hash, encode it again) with sending the raw bytes from the block file.
+static const int NUM_TXS = 1000;
+
+struct StoredBlock
+{
+    boost::filesystem::path pathTemp;
+    CBlock block;
+    uint256 hash;
+    CBlockIndex index;
+
+    StoredBlock()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        ClearDatadirCache();
+        pathTemp = boost::filesystem::temp_directory_path() / strprintf("bench_privora_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+        boost::filesystem::create_directories(pathTemp);
+        ForceSetArg("-datadir", pathTemp.string());
+
+        const Consensus::Params& consensus = Params().GetConsensus();
+        for (int i = 0; i < NUM_TXS; i++) {
+            CMutableTransaction tx;
+            tx.vin.resize(2);
+            tx.vout.resize(2);
+            for (CTxIn& txin : tx.vin) {
+                txin.prevout = COutPoint(GetRandHash(), i);
+                txin.scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+            }
+            for (CTxOut& txout : tx.vout) {
+                txout.nValue = i;
+                txout.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 3) << OP_EQUALVERIFY << OP_CHECKSIG;
+            }
+            block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+        }
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+        block.nTime = GetTime();
+        block.nBits = UintToArith256(consensus.powLimit).GetCompact();
+        block.nHeight = 1;
+        block.mix_hash = GetRandHash();
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, consensus))
+            block.nNonce64++;
+        hash = block.GetHash();
+
+        CDiskBlockPos pos(0, 0);
+        if (!WriteBlockToDisk(block, pos, Params().MessageStart()))
+            throw std::runtime_error("cannot write block");
+
+        index = CBlockIndex(block);
+        index.phashBlock = &hash;
+        index.nHeight = block.nHeight;
+        index.nFile = pos.nFile;
+        index.nDataPos = pos.nPos;
+        index.nStatus = BLOCK_HAVE_DATA;
+    }
+
+    ~StoredBlock()
+    {
+        ClearDatadirCache();
+        boost::filesystem::remove_all(pathTemp);
+    }
+};
+
+static void ReadBlockDecodeEncode(benchmark::State& state)
+{
+    StoredBlock stored;
+    while (state.KeepRunning()) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, &stored.index, Params().GetConsensus()))
+            throw std::runtime_error("cannot read block");
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << block;
+    }
+}
+
+static void ReadBlockRaw(benchmark::State& state)
+{
+    StoredBlock stored;
+    while (state.KeepRunning()) {
+        std::vector<unsigned char> block;
+        if (!ReadRawBlockFromDisk(block, &stored.index, Params().MessageStart()))
+            throw std::runtime_error("cannot read block");
+    }
+}
+
+BENCHMARK(ReadBlockDecodeEncode);
+BENCHMARK(ReadBlockRaw);
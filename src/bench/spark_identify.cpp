@@ -0,0 +1,79 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "libspark/aead.h"
+#include "libspark/coin.h"
+
+/* Number of coins scanned per iteration */
+static const size_t COIN_COUNT = 16;
+
+static std::vector<spark::Coin> MakeCoins(const spark::Params* params, const spark::Address& address)
+{
+    std::vector<spark::Coin> coins;
+    for (size_t i = 0; i < COIN_COUNT; i++) {
+        Scalar k;
+        k.randomize();
+        std::vector<unsigned char> serial_context(32, (unsigned char)i);
+        coins.emplace_back(params, i % 2 ? spark::COIN_TYPE_MINT : spark::COIN_TYPE_SPEND, k, address, 1000 + i, "bench", serial_context);
+    }
+    return coins;
+}
+
+// A wallet scanning coins it owns
+static void SparkIdentifyOwned(benchmark::State& state)
+{
+    const spark::Params* params = spark::Params::get_default();
+    spark::SpendKey spend_key(params);
+    spark::FullViewKey full_view_key(spend_key);
+    spark::IncomingViewKey incoming_view_key(full_view_key);
+    std::vector<spark::Coin> coins = MakeCoins(params, spark::Address(incoming_view_key, 1));
+
+    while (state.KeepRunning()) {
+        for (spark::Coin& coin : coins)
+            coin.identify(incoming_view_key);
+    }
+}
+
+// A wallet scanning coins of others, which fail at the key commitment
+static void SparkIdentifyForeign(benchmark::State& state)
+{
+    const spark::Params* params = spark::Params::get_default();
+    spark::SpendKey spend_key(params);
+    spark::FullViewKey full_view_key(spend_key);
+    spark::IncomingViewKey incoming_view_key(full_view_key);
+    spark::SpendKey other_spend_key(params);
+    spark::FullViewKey other_full_view_key(other_spend_key);
+    spark::IncomingViewKey other_incoming_view_key(other_full_view_key);
+    std::vector<spark::Coin> coins = MakeCoins(params, spark::Address(other_incoming_view_key, 1));
+
+    while (state.KeepRunning()) {
+        for (spark::Coin& coin : coins) {
+            try {
+                coin.identify(incoming_view_key);
+            } catch (const std::exception&) {
+            }
+        }
+    }
+}
+
+// The symmetric part of identification alone
+static void SparkAEADDecrypt(benchmark::State& state)
+{
+    GroupElement prekey;
+    prekey.randomize();
+    CDataStream plaintext(SER_NETWORK, PROTOCOL_VERSION);
+    plaintext << std::vector<unsigned char>(128, 0x5a);
+    spark::AEADEncryptedData data = spark::AEAD::encrypt(prekey, "Spend coin data", plaintext);
+    std::vector<unsigned char> decrypted(data.ciphertext.size());
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < COIN_COUNT; i++)
+            spark::AEAD::decrypt_and_verify(prekey, "Spend coin data", data, decrypted.data());
+    }
+}
+
+BENCHMARK(SparkIdentifyOwned);
+BENCHMARK(SparkIdentifyForeign);
+BENCHMARK(SparkAEADDecrypt);
@@ -56,6 +56,7 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     assert(header.IsNull() && txn_available.empty());
     header = cmpctblock.header;
     txn_available.resize(cmpctblock.BlockTxCount());
+    txn_from_mempool.assign(txn_available.size(), false);
 
     int32_t lastprefilledindex = -1;
     for (size_t i = 0; i < cmpctblock.prefilledtxn.size(); i++) {
@@ -114,6 +115,7 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
             if (!have_txn[idit->second]) {
                 txn_available[idit->second] = vTxHashes[i].second->GetSharedTx();
                 have_txn[idit->second]  = true;
+                txn_from_mempool[idit->second] = true;
                 mempool_count++;
             } else {
                 // If we find two mempool txn that match the short id, just request it.
@@ -121,6 +123,7 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
                 // but eating a round-trip due to FillBlock failure would be annoying
                 if (txn_available[idit->second]) {
                     txn_available[idit->second].reset();
+                    txn_from_mempool[idit->second] = false;
                     mempool_count--;
                 }
             }
@@ -152,6 +155,7 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
                 if (txn_available[idit->second] &&
                         txn_available[idit->second]->GetWitnessHash() != extra_txn[i].second->GetWitnessHash()) {
                     txn_available[idit->second].reset();
+                    txn_from_mempool[idit->second] = false;
                     mempool_count--;
                     extra_count--;
                 }
@@ -175,20 +179,28 @@ bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const {
     return txn_available[index] ? true : false;
 }
 
+bool PartiallyDownloadedBlock::IsTxFromMempool(size_t index) const {
+    assert(index < txn_from_mempool.size());
+    return txn_from_mempool[index];
+}
+
 ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing) {
     assert(!header.IsNull());
     uint256 hash = header.GetHash();
     block = header;
     block.vtx.resize(txn_available.size());
 
-    size_t tx_missing_offset = 0;
+    size_t tx_missing_offset = 0, privacy_mempool_count = 0;
     for (size_t i = 0; i < txn_available.size(); i++) {
         if (!txn_available[i]) {
             if (vtx_missing.size() <= tx_missing_offset)
                 return READ_STATUS_INVALID;
             block.vtx[i] = vtx_missing[tx_missing_offset++];
-        } else
+        } else {
             block.vtx[i] = std::move(txn_available[i]);
+            if (txn_from_mempool[i] && (block.vtx[i]->IsLelantusJoinSplit() || block.vtx[i]->IsSparkSpend()))
+                privacy_mempool_count++;
+        }
     }
 
     // Make sure we can't call FillBlock again.
@@ -210,6 +222,7 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
     }
 
     LogPrint("cmpctblock", "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size());
+    LogPrint("cmpctblock", "Reconstructed block %s has %lu Lelantus/Spark spends from mempool with already verified proofs\n", hash.ToString(), privacy_mempool_count);
     if (vtx_missing.size() < 5) {
         for (const auto& tx : vtx_missing)
             LogPrint("cmpctblock", "Reconstructed block %s required tx %s\n", hash.ToString(), tx->GetHash().ToString());
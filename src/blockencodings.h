@@ -194,6 +194,9 @@ public:
 class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
+    // Transactions taken from our mempool (not the extra pool); their Lelantus and Spark
+    // proofs were verified on mempool acceptance and are in the verified proof cache
+    std::vector<bool> txn_from_mempool;
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
     CTxMemPool* pool;
 public:
@@ -203,6 +206,8 @@ public:
     // extra_txn is a list of extra transactions to look at, in <witness hash, reference> form
     ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
     bool IsTxAvailable(size_t index) const;
+    // Whether the transaction at index came from our mempool, still valid after FillBlock
+    bool IsTxFromMempool(size_t index) const;
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
 };
 
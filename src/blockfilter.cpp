@@ -0,0 +1,353 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "coins.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "lelantus.h"
+#include "primitives/block.h"
+#include "primitives/mint_spend.h"
+#include "script/script.h"
+#include "spark/primitives.h"
+#include "spark/state.h"
+#include "streams.h"
+#include "undo.h"
+
+#include <algorithm>
+
+static const std::string basicFilterName = "basic";
+static const std::string emptyFilterName;
+
+/** Writes bits most significant first into an underlying byte stream */
+template <typename OStream>
+class BitStreamWriter
+{
+private:
+    OStream& ostream;
+    uint8_t buffer;
+    int offset; // number of bits already used in buffer
+
+public:
+    explicit BitStreamWriter(OStream& ostreamIn) : ostream(ostreamIn), buffer(0), offset(0) {}
+
+    ~BitStreamWriter()
+    {
+        Flush();
+    }
+
+    /** Write the nbits least significant bits of data */
+    void Write(uint64_t data, int nbits)
+    {
+        while (nbits > 0) {
+            int bits = std::min(8 - offset, nbits);
+            buffer |= uint8_t((data << (64 - nbits)) >> (64 - 8 + offset));
+            offset += bits;
+            nbits -= bits;
+            if (offset == 8)
+                Flush();
+        }
+    }
+
+    /** Pad the last partial byte with zeroes and write it out */
+    void Flush()
+    {
+        if (offset == 0)
+            return;
+        ostream << buffer;
+        buffer = 0;
+        offset = 0;
+    }
+};
+
+template <typename IStream>
+class BitStreamReader
+{
+private:
+    IStream& istream;
+    uint8_t buffer;
+    int offset; // number of bits of buffer already consumed
+
+public:
+    explicit BitStreamReader(IStream& istreamIn) : istream(istreamIn), buffer(0), offset(8) {}
+
+    /** Read nbits bits, most significant first */
+    uint64_t Read(int nbits)
+    {
+        uint64_t data = 0;
+        while (nbits > 0) {
+            if (offset == 8) {
+                istream >> buffer;
+                offset = 0;
+            }
+            int bits = std::min(8 - offset, nbits);
+            data <<= bits;
+            data |= uint8_t(buffer << offset) >> (8 - bits);
+            offset += bits;
+            nbits -= bits;
+        }
+        return data;
+    }
+};
+
+template <typename OStream>
+static void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t P, uint64_t x)
+{
+    // quotient in unary (q ones followed by a zero), remainder in P bits
+    uint64_t q = x >> P;
+    while (q > 0) {
+        int nbits = q <= 64 ? (int)q : 64;
+        bitwriter.Write(~0ULL, nbits);
+        q -= nbits;
+    }
+    bitwriter.Write(0, 1);
+    bitwriter.Write(x, P);
+}
+
+template <typename IStream>
+static uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t P)
+{
+    uint64_t q = 0;
+    while (bitreader.Read(1) == 1)
+        ++q;
+    uint64_t r = bitreader.Read(P);
+    return (q << P) + r;
+}
+
+/** Map x uniformly into [0, n), faster than and as fair as x % n for a uniform 64-bit x */
+static uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)x * (unsigned __int128)n) >> 64);
+#else
+    // high 64 bits of the 128-bit product
+    uint64_t xHi = x >> 32, xLo = x & 0xFFFFFFFF;
+    uint64_t nHi = n >> 32, nLo = n & 0xFFFFFFFF;
+    uint64_t acHi = xHi * nHi, adHi = xHi * nLo, bcHi = xLo * nHi, bdLo = xLo * nLo;
+    uint64_t mid = (adHi & 0xFFFFFFFF) + (bcHi & 0xFFFFFFFF) + (bdLo >> 32);
+    return acHi + (adHi >> 32) + (bcHi >> 32) + (mid >> 32);
+#endif
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = CSipHasher(params.siphash_k0, params.siphash_k1)
+        .Write(element.data(), element.size())
+        .Finalize();
+    return MapIntoRange(hash, F);
+}
+
+std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> hashedElements;
+    hashedElements.reserve(elements.size());
+    for (const Element& element : elements)
+        hashedElements.push_back(HashToRange(element));
+    std::sort(hashedElements.begin(), hashedElements.end());
+    return hashedElements;
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn)
+    : params(paramsIn), N(0), F(0), encoded(1, 0)
+{}
+
+GCSFilter::GCSFilter(const Params& paramsIn, std::vector<unsigned char> encodedFilter)
+    : params(paramsIn), encoded(std::move(encodedFilter))
+{
+    CDataStream stream(encoded, SER_NETWORK, PROTOCOL_VERSION);
+
+    uint64_t n = ReadCompactSize(stream);
+    N = static_cast<uint32_t>(n);
+    if (n != N)
+        throw std::ios_base::failure("N must be < 2^32");
+    F = static_cast<uint64_t>(N) * static_cast<uint64_t>(params.M);
+
+    // Decode the whole filter once so a malformed encoding is rejected up front
+    BitStreamReader<CDataStream> bitreader(stream);
+    for (uint64_t i = 0; i < N; ++i)
+        GolombRiceDecode(bitreader, params.P);
+    if (!stream.empty())
+        throw std::ios_base::failure("encoded filter contains excess data");
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const ElementSet& elements)
+    : params(paramsIn)
+{
+    size_t n = elements.size();
+    N = static_cast<uint32_t>(n);
+    if (n != N)
+        throw std::invalid_argument("N must be < 2^32");
+    F = static_cast<uint64_t>(N) * static_cast<uint64_t>(params.M);
+
+    CVectorWriter stream(SER_NETWORK, PROTOCOL_VERSION, encoded, 0);
+    WriteCompactSize(stream, N);
+
+    if (elements.empty())
+        return;
+
+    BitStreamWriter<CVectorWriter> bitwriter(stream);
+    uint64_t lastValue = 0;
+    for (uint64_t value : BuildHashedSet(elements)) {
+        GolombRiceEncode(bitwriter, params.P, value - lastValue);
+        lastValue = value;
+    }
+    bitwriter.Flush();
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* sortedHashes, size_t size) const
+{
+    CDataStream stream(encoded, SER_NETWORK, PROTOCOL_VERSION);
+
+    // skip N, it was validated by the constructor
+    ReadCompactSize(stream);
+
+    BitStreamReader<CDataStream> bitreader(stream);
+
+    uint64_t value = 0;
+    size_t hashesIndex = 0;
+    for (uint32_t i = 0; i < N; ++i) {
+        value += GolombRiceDecode(bitreader, params.P);
+
+        while (true) {
+            if (hashesIndex == size)
+                return false;
+            if (sortedHashes[hashesIndex] == value)
+                return true;
+            if (sortedHashes[hashesIndex] > value)
+                break;
+            hashesIndex++;
+        }
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    uint64_t query = HashToRange(element);
+    return MatchInternal(&query, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    const std::vector<uint64_t> queries = BuildHashedSet(elements);
+    return MatchInternal(queries.data(), queries.size());
+}
+
+const std::string& BlockFilterTypeName(BlockFilterType filterType)
+{
+    switch (filterType) {
+    case BlockFilterType::BASIC:
+        return basicFilterName;
+    default:
+        return emptyFilterName;
+    }
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType)
+{
+    if (name == basicFilterName) {
+        filterType = BlockFilterType::BASIC;
+        return true;
+    }
+    return false;
+}
+
+static void AddHashElement(GCSFilter::ElementSet& elements, const uint256& hash)
+{
+    elements.emplace(hash.begin(), hash.end());
+}
+
+static void AddStringElement(GCSFilter::ElementSet& elements, const std::string& str)
+{
+    elements.emplace(str.begin(), str.end());
+}
+
+static GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CTransactionRef& tx : block.vtx) {
+        for (const CTxOut& txout : tx->vout) {
+            const CScript& script = txout.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            // committed to by the Spark coin hash below, which matches coins the wallet already knows
+            if (script.IsSparkMint() || script.IsSparkSMint())
+                continue;
+            elements.emplace(script.begin(), script.end());
+        }
+    }
+
+    for (const CTxUndo& txUndo : blockUndo.vtxundo) {
+        for (const Coin& prevout : txUndo.vprevout) {
+            const CScript& script = prevout.out.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.emplace(script.begin(), script.end());
+        }
+    }
+
+    if (block.sparkTxInfo) {
+        for (const spark::Coin& coin : block.sparkTxInfo->mints)
+            AddHashElement(elements, primitives::GetSparkCoinHash(coin));
+        for (const auto& lTag : block.sparkTxInfo->spentLTags)
+            AddHashElement(elements, primitives::GetLTagHash(lTag.first));
+        for (const auto& sparkName : block.sparkTxInfo->sparkNames) {
+            AddStringElement(elements, sparkName.first);
+            AddStringElement(elements, sparkName.second.sparkAddress);
+        }
+    }
+
+    if (block.lelantusTxInfo) {
+        for (const auto& serial : block.lelantusTxInfo->spentSerials)
+            AddHashElement(elements, primitives::GetSerialHash(serial.first));
+    }
+
+    return elements;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn, std::vector<unsigned char> encodedFilter)
+    : filterType(filterTypeIn), blockHash(blockHashIn)
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(params, std::move(encodedFilter));
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo)
+    : filterType(filterTypeIn), blockHash(block.GetHash())
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(params, BasicFilterElements(block, blockUndo));
+}
+
+bool BlockFilter::BuildParams(GCSFilter::Params& params) const
+{
+    switch (filterType) {
+    case BlockFilterType::BASIC:
+        params.siphash_k0 = ReadLE64(blockHash.begin());
+        params.siphash_k1 = ReadLE64(blockHash.begin() + 8);
+        params.P = BASIC_FILTER_P;
+        params.M = BASIC_FILTER_M;
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& data = GetEncodedFilter();
+    return Hash(data.begin(), data.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 filterHash = GetHash();
+    return Hash(filterHash.begin(), filterHash.end(), prevHeader.begin(), prevHeader.end());
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_BLOCKFILTER_H
+#define PRIVORA_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * Golomb-coded set filter as specified in BIP 158. The set is probabilistic: Match()
+ * never returns false for an element that was added and returns true for any other
+ * element with probability 1/M.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params
+    {
+        uint64_t siphash_k0;
+        uint64_t siphash_k1;
+        uint8_t P;  //!< Golomb-Rice coding parameter
+        uint32_t M; //!< Inverse false positive rate
+
+        Params(uint64_t k0 = 0, uint64_t k1 = 0, uint8_t P = 0, uint32_t M = 1)
+            : siphash_k0(k0), siphash_k1(k1), P(P), M(M) {}
+    };
+
+private:
+    Params params;
+    uint32_t N; //!< Number of elements in the filter
+    uint64_t F; //!< Range of element hashes, F = N * M
+    std::vector<unsigned char> encoded;
+
+    /** Hash an element to an integer in [0, F) */
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+    /** Check if the filter contains any of the sorted hashed values */
+    bool MatchInternal(const uint64_t* sortedHashes, size_t size) const;
+
+public:
+    /** Construct an empty filter */
+    explicit GCSFilter(const Params& params = Params());
+
+    /** Reconstruct a filter from its encoding, throws std::ios_base::failure if it is malformed */
+    GCSFilter(const Params& params, std::vector<unsigned char> encodedFilter);
+
+    /** Build a filter over the given elements */
+    GCSFilter(const Params& params, const ElementSet& elements);
+
+    uint32_t GetN() const { return N; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return encoded; }
+
+    bool Match(const Element& element) const;
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+enum class BlockFilterType : uint8_t
+{
+    BASIC = 0,
+    INVALID = 255,
+};
+
+/** Get the human-readable name for a filter type, empty for unknown types */
+const std::string& BlockFilterTypeName(BlockFilterType filterType);
+
+/** Find a filter type by its human-readable name */
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType);
+
+/**
+ * Compact filter of a block. On top of the BIP 158 basic filter contents (output scripts
+ * and the scripts of the spent outputs) the basic filter of this chain also commits to the
+ * privacy data of the block: hashes of the Spark coins minted and of the linking tags
+ * spent, the Spark names registered with their addresses and the hashes of the Lelantus
+ * serials spent. A light wallet matches the linking tags and serials of its own coins to
+ * find the blocks spending them, and the hashes of coins it already knows (its pending
+ * mints, change and outgoing payments) to find the blocks confirming them. Incoming Spark
+ * coins cannot be matched, recipients only recognize those by trial decryption.
+ */
+class BlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 blockHash;
+    GCSFilter filter;
+
+    bool BuildParams(GCSFilter::Params& params) const;
+
+public:
+    BlockFilter() : filterType(BlockFilterType::INVALID) {}
+
+    /** Reconstruct a filter from its encoding, throws std::ios_base::failure if it is malformed */
+    BlockFilter(BlockFilterType filterType, const uint256& blockHash, std::vector<unsigned char> encodedFilter);
+
+    /**
+     * Build the filter of a connected block. The privacy elements are taken from the
+     * block's CSparkTxInfo/CLelantusTxInfo, which ConnectBlock fills in.
+     */
+    BlockFilter(BlockFilterType filterType, const CBlock& block, const CBlockUndo& blockUndo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return blockHash; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** Double SHA256 of the encoded filter */
+    uint256 GetHash() const;
+
+    /** Filter header committing to this filter and the header of the previous block's filter */
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << (uint8_t)filterType << blockHash << filter.GetEncoded();
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        std::vector<unsigned char> encodedFilter;
+        uint8_t type;
+        s >> type >> blockHash >> encodedFilter;
+        filterType = BlockFilterType(type);
+
+        GCSFilter::Params params;
+        if (!BuildParams(params))
+            throw std::ios_base::failure("unknown filter type");
+        filter = GCSFilter(params, std::move(encodedFilter));
+    }
+};
+
+#endif // PRIVORA_BLOCKFILTER_H
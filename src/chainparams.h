@@ -30,6 +30,16 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/**
+ * Published state snapshots (see dumpstatesnapshot) by height: the block hash and the
+ * snapshot content hash. A snapshot at a pinned height is only loaded if both match.
+ */
+typedef std::map<int, std::pair<uint256, uint256> > MapStateSnapshots;
+
+struct CStateSnapshotData {
+    MapStateSnapshots mapSnapshots;
+};
+
 struct ChainTxData {
     int64_t nTime;
     int64_t nTxCount;
@@ -79,6 +89,7 @@ public:
     const std::vector<unsigned char>& Base58Prefix(Base58Type type) const { return base58Prefixes[type]; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
+    const CStateSnapshotData& StateSnapshots() const { return stateSnapshotData; }
     /** znode code from Dash*/
     int64_t MaxTipAge() const { return nMaxTipAge; }
     int PoolMaxTransactions() const { return nPoolMaxTransactions; }
@@ -105,6 +116,7 @@ protected:
     bool fMineBlocksOnDemand;
     bool fAllowMultiplePorts;
     CCheckpointData checkpointData;
+    CStateSnapshotData stateSnapshotData;
 	
     /** znode params*/
     long nMaxTipAge;
@@ -42,6 +42,12 @@ CSpendCoinInfo CSpendCoinInfo::make(CoinDenomination denomination,  int coinGrou
     return coinInfo;
 }
 
+frozen_mint_container::Key MakeFrozenMintKey(const GroupElement& value, CoinDenomination denomination) {
+    frozen_mint_container::Key key;
+    value.serialize(key.data());
+    key.back() = (unsigned char)denomination;
+    return key;
+}
 
 } // namespace sigma
 
@@ -5,7 +5,84 @@
 #include "sigma/coin.h"
 #include "liblelantus/coin.h"
 
+#include "immer/map.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <unordered_map>
+#include <vector>
+
+/**
+ * Coins or serials of an anonymity set that can no longer change, kept as one sorted contiguous
+ * array of (serialized key, value) pairs. A lookup is a binary search over the serialized bytes.
+ * Compared to the hash maps of the live state this saves the per-node allocations and the
+ * unpacked group elements and scalars, which are most of their memory.
+ */
+template <size_t KeySize, typename Value>
+class CFrozenCoinSet
+{
+public:
+    typedef std::array<unsigned char, KeySize> Key;
+    typedef std::pair<Key, Value> Entry;
+    typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+    /** Hash of a key, whose leading bytes are a coordinate, scalar or hash and spread evenly already */
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept
+        {
+            std::size_t result;
+            std::memcpy(&result, key.data(), sizeof(result));
+            return result;
+        }
+    };
+
+    /** Serialized form of a GroupElement, Scalar or anything else with serialize(unsigned char*) */
+    template <typename T>
+    static Key MakeKey(const T& t)
+    {
+        Key key;
+        t.serialize(key.data());
+        return key;
+    }
+
+    /** Replace the contents, the entries may come in any order but keys must be unique */
+    void Build(std::vector<Entry> entriesIn)
+    {
+        entries = std::move(entriesIn);
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& a, const Entry& b) { return a.first < b.first; });
+        entries.shrink_to_fit();
+    }
+
+    const Value* Find(const Key& key) const
+    {
+        auto it = std::lower_bound(entries.begin(), entries.end(), key,
+                                   [](const Entry& e, const Key& k) { return e.first < k; });
+        return it != entries.end() && it->first == key ? &it->second : nullptr;
+    }
+
+    template <typename T>
+    const Value* Find(const T& t) const { return Find(MakeKey(t)); }
+
+    void clear() { std::vector<Entry>().swap(entries); }
+
+    bool empty() const { return entries.empty(); }
+    size_t size() const { return entries.size(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+private:
+    std::vector<Entry> entries;
+};
+
+/** Key of a frozen set indexed by a 256-bit hash */
+inline std::array<unsigned char, 32> MakeHashKey(const uint256& hash)
+{
+    std::array<unsigned char, 32> key;
+    std::copy(hash.begin(), hash.end(), key.begin());
+    return key;
+}
 
 namespace sigma {
 
@@ -54,6 +131,13 @@ struct CSpendCoinInfo {
 
 using mint_info_container = std::unordered_map<sigma::PublicCoin, CMintedCoinInfo, sigma::CPublicCoinHash>;
 using spend_info_container = std::unordered_map<Scalar, CSpendCoinInfo, sigma::CScalarHash>;
+//! Keyed by the serialized coin value followed by the denomination
+using frozen_mint_container = CFrozenCoinSet<GroupElement::serialize_size + 1, CMintedCoinInfo>;
+using frozen_spend_container = CFrozenCoinSet<Scalar::memoryRequired(), CSpendCoinInfo>;
+//! Hash of the coin value (GetPubCoinValueHash) to the key of the frozen mint
+using frozen_mint_hash_container = CFrozenCoinSet<32, frozen_mint_container::Key>;
+
+frozen_mint_container::Key MakeFrozenMintKey(const GroupElement& value, CoinDenomination denomination);
 
 } // namespace sigma
 
@@ -91,6 +175,26 @@ struct CMintedCoinInfo {
 };
 
 using mint_info_container = std::unordered_map<lelantus::PublicCoin, CMintedCoinInfo, lelantus::CPublicCoinHash>;
+using frozen_mint_container = CFrozenCoinSet<GroupElement::serialize_size, CMintedCoinInfo>;
+using frozen_spend_container = CFrozenCoinSet<Scalar::memoryRequired(), int>;
+//! Mint tag to the serialized coin value
+using frozen_tag_container = CFrozenCoinSet<32, std::array<unsigned char, GroupElement::serialize_size>>;
+//! Hash of the coin value (GetPubCoinValueHash) to the serialized coin value
+using frozen_mint_hash_container = CFrozenCoinSet<32, frozen_mint_container::Key>;
+
+//! The frozen sets of a closed Lelantus state, shared between the state and its snapshots
+struct CFrozenSets {
+    frozen_mint_container mints;
+    frozen_spend_container spends;
+    frozen_tag_container tags;
+    frozen_mint_hash_container mintHashes;
+};
+
+//! Persistent maps keyed like the frozen sets, for the part of the Lelantus state that can still change.
+//! Copies share their nodes, so a copy costs the same whatever the size.
+using live_mint_map = immer::map<frozen_mint_container::Key, CMintedCoinInfo, frozen_mint_container::KeyHash>;
+using live_spend_map = immer::map<frozen_spend_container::Key, int, frozen_spend_container::KeyHash>;
+using live_tag_map = immer::map<frozen_tag_container::Key, frozen_mint_container::Key, frozen_tag_container::KeyHash>;
 
 } // namespace lelantus
 
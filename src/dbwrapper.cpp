@@ -7,6 +7,12 @@
 #include "util.h"
 #include "random.h"
 
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <sstream>
+
 #include <boost/filesystem.hpp>
 
 #include <leveldb/cache.h>
@@ -15,14 +21,83 @@
 #include <memenv.h>
 #include <stdint.h>
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+namespace {
+
+//! Table file reads made by the current thread, tells whether a Get was served from memory
+thread_local uint64_t nThreadFileReads = 0;
+
+/**
+ * Table file that counts the reads LevelDB has to copy out of it, i.e. block cache misses.
+ * Reads of memory mapped tables hand out a pointer into the mapping and are not counted,
+ * LevelDB does not put their blocks in the block cache either.
+ */
+class CCountingRandomAccessFile : public leveldb::RandomAccessFile
+{
+private:
+    std::unique_ptr<leveldb::RandomAccessFile> file;
+    CDBWrapper::Counters& counters;
+
+public:
+    CCountingRandomAccessFile(leveldb::RandomAccessFile* fileIn, CDBWrapper::Counters& countersIn) : file(fileIn), counters(countersIn) {}
+
+    leveldb::Status Read(uint64_t offset, size_t n, leveldb::Slice* result, char* scratch) const override
+    {
+        leveldb::Status status = file->Read(offset, n, result, scratch);
+        if (result->data() != scratch)
+            return status;
+        nThreadFileReads++;
+        counters.nFileReads++;
+        counters.nFileBytesRead += result->size();
+        return status;
+    }
+
+    std::string GetName() const override { return file->GetName(); }
+};
+
+class CStatsEnv : public leveldb::EnvWrapper
+{
+private:
+    CDBWrapper::Counters& counters;
+
+public:
+    CStatsEnv(leveldb::Env* target, CDBWrapper::Counters& countersIn) : leveldb::EnvWrapper(target), counters(countersIn) {}
+
+    leveldb::Status NewRandomAccessFile(const std::string& fname, leveldb::RandomAccessFile** result) override
+    {
+        leveldb::Status status = target()->NewRandomAccessFile(fname, result);
+        if (status.ok())
+            *result = new CCountingRandomAccessFile(*result, counters);
+        return status;
+    }
+};
+
+std::mutex csOpenDatabases;
+std::set<const CDBWrapper*> setOpenDatabases;
+
+}
+
+CDBWrapperOptions GetDBWrapperOptions(const std::string& strName, size_t nCacheSize)
+{
+    CDBWrapperOptions options;
+    options.strName = strName;
+    options.nCacheSize = nCacheSize;
+    if (IsArgSet("-" + strName + "dbcache"))
+        options.nCacheSize = std::max<int64_t>(GetArg("-" + strName + "dbcache", 0), 1) << 20;
+    options.nWriteBufferSize = std::max<int64_t>(GetArg("-" + strName + "dbwritebuffer", 0), 0) << 20;
+    options.nMaxOpenFiles = std::max<int64_t>(GetArg("-" + strName + "dbmaxopenfiles", DEFAULT_DB_MAX_OPEN_FILES), 16);
+    options.nBloomBits = std::min<int64_t>(std::max<int64_t>(GetArg("-" + strName + "dbbloombits", DEFAULT_DB_BLOOM_BITS), 1), 32);
+    return options;
+}
+
+static leveldb::Options GetOptions(const CDBWrapperOptions& dbOptions)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.block_cache = leveldb::NewLRUCache(dbOptions.nCacheSize / 2);
+    // up to two write buffers may be held in memory simultaneously
+    options.write_buffer_size = dbOptions.nWriteBufferSize ? dbOptions.nWriteBufferSize : dbOptions.nCacheSize / 4;
+    options.filter_policy = leveldb::NewBloomFilterPolicy(dbOptions.nBloomBits);
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.max_open_files = dbOptions.nMaxOpenFiles;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -32,18 +107,26 @@ static leveldb::Options GetOptions(size_t nCacheSize)
 }
 
 CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+    : CDBWrapper(path, CDBWrapperOptions(nCacheSize), fMemory, fWipe, obfuscate)
+{
+}
+
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, const CDBWrapperOptions& dbOptionsIn, bool fMemory, bool fWipe, bool obfuscate)
+    : dbOptions(dbOptionsIn)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(dbOptions);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
-        options.env = penv;
-    } else {
+    }
+    pstatsenv = new CStatsEnv(penv ? penv : leveldb::Env::Default(), counters);
+    options.env = pstatsenv;
+    if (!fMemory) {
         if (fWipe) {
             LogPrintf("Wiping LevelDB in %s\n", path.string());
             leveldb::Status result = leveldb::DestroyDB(path.string(), options);
@@ -52,6 +135,11 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
         TryCreateDirectory(path);
         LogPrintf("Opening LevelDB in %s\n", path.string());
     }
+    if (!dbOptions.strName.empty()) {
+        LogPrintf("Using %.1fMiB cache, %.1fMiB write buffer and up to %d open files for %s database\n",
+                  dbOptions.nCacheSize * (1.0 / 1024 / 1024), options.write_buffer_size * (1.0 / 1024 / 1024),
+                  dbOptions.nMaxOpenFiles, dbOptions.strName);
+    }
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
     LogPrintf("Opened LevelDB successfully\n");
@@ -74,23 +162,162 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    if (!dbOptions.strName.empty()) {
+        std::lock_guard<std::mutex> lock(csOpenDatabases);
+        setOpenDatabases.insert(this);
+    }
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        std::lock_guard<std::mutex> lock(csOpenDatabases);
+        setOpenDatabases.erase(this);
+    }
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
     options.filter_policy = NULL;
     delete options.block_cache;
     options.block_cache = NULL;
+    delete pstatsenv;
+    pstatsenv = NULL;
     delete penv;
     options.env = NULL;
 }
 
+bool CDBWrapper::ReadRaw(const leveldb::Slice& slKey, std::string& strValue) const
+{
+    uint64_t nFileReadsBefore = nThreadFileReads;
+    CPerfTimer perfTimer(PerfStat::DB_READ);
+    leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+    perfTimer.Stop();
+
+    counters.nReads++;
+    if (nThreadFileReads == nFileReadsBefore)
+        counters.nCacheHits++;
+
+    if (!status.ok()) {
+        if (status.IsNotFound())
+            return false;
+        LogPrintf("LevelDB read failure: %s\n", status.ToString());
+        dbwrapper_private::HandleError(status);
+    }
+    counters.nBytesRead += strValue.size();
+    return true;
+}
+
+//! How many entries ReadManyRaw steps over with Next() before seeking to a key instead
+static const int READMANY_MAX_NEXT_STEPS = 16;
+
+void CDBWrapper::ReadManyRaw(const std::vector<CDataStream>& ssKeys, std::vector<std::string>& strValues, std::vector<bool>& found) const
+{
+    strValues.assign(ssKeys.size(), std::string());
+    found.assign(ssKeys.size(), false);
+    if (ssKeys.empty())
+        return;
+
+    std::vector<leveldb::Slice> slKeys;
+    slKeys.reserve(ssKeys.size());
+    for (const CDataStream& ssKey : ssKeys)
+        slKeys.emplace_back(ssKey.data(), ssKey.size());
+
+    // visit the keys in the database's (bytewise) order
+    std::vector<size_t> order(ssKeys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&slKeys](size_t a, size_t b) {
+        return slKeys[a].compare(slKeys[b]) < 0;
+    });
+
+    CPerfTimer perfTimer(PerfStat::DB_READ);
+    std::unique_ptr<leveldb::Iterator> it(pdb->NewIterator(readoptions));
+    bool fSeeked = false;
+    for (size_t i : order) {
+        const leveldb::Slice& slKey = slKeys[i];
+        // Walk forward over the entries between the previous key and this one, they are
+        // usually neighbours; only seek again when the gap turns out to be large. A key
+        // we missed may have left the iterator at or past this one already.
+        int nSteps = 0;
+        while (fSeeked && it->Valid() && it->key().compare(slKey) < 0 && nSteps++ < READMANY_MAX_NEXT_STEPS)
+            it->Next();
+        if (!fSeeked || !it->Valid() || it->key().compare(slKey) < 0) {
+            it->Seek(slKey);
+            fSeeked = true;
+        }
+        if (!it->Valid())
+            break;
+        if (it->key() == slKey) {
+            strValues[i].assign(it->value().data(), it->value().size());
+            found[i] = true;
+            counters.nBytesRead += strValues[i].size();
+        }
+    }
+    leveldb::Status status = it->status();
+    perfTimer.Stop();
+
+    counters.nMultiReads++;
+    counters.nMultiReadKeys += ssKeys.size();
+    if (!status.ok()) {
+        LogPrintf("LevelDB read failure: %s\n", status.ToString());
+        dbwrapper_private::HandleError(status);
+    }
+}
+
+CDBWrapperStats CDBWrapper::GetStats() const
+{
+    CDBWrapperStats stats;
+    stats.options = dbOptions;
+    stats.nReads = counters.nReads;
+    stats.nCacheHits = counters.nCacheHits;
+    stats.nMultiReads = counters.nMultiReads;
+    stats.nMultiReadKeys = counters.nMultiReadKeys;
+    stats.nBytesRead = counters.nBytesRead;
+    stats.nFileReads = counters.nFileReads;
+    stats.nFileBytesRead = counters.nFileBytesRead;
+
+    // "leveldb.stats" is a table with one line per level:
+    // level, files, size (MB), compaction time (s), compaction read (MB), compaction write (MB)
+    std::string strStats;
+    if (pdb->GetProperty("leveldb.stats", &strStats)) {
+        std::istringstream lines(strStats);
+        std::string line;
+        while (std::getline(lines, line)) {
+            int nLevel, nFiles;
+            double sizeMB, seconds, readMB, writtenMB;
+            if (sscanf(line.c_str(), "%d %d %lf %lf %lf %lf", &nLevel, &nFiles, &sizeMB, &seconds, &readMB, &writtenMB) != 6)
+                continue;
+            stats.nSizeOnDisk += sizeMB * 1048576;
+            stats.nCompactionSeconds += seconds;
+            stats.nCompactionBytesRead += readMB * 1048576;
+            stats.nCompactionBytesWritten += writtenMB * 1048576;
+        }
+    }
+
+    std::string strMemoryUsage;
+    if (pdb->GetProperty("leveldb.approximate-memory-usage", &strMemoryUsage))
+        stats.nMemoryUsage = atoi64(strMemoryUsage);
+
+    return stats;
+}
+
+std::vector<CDBWrapperStats> GetDBWrapperStats()
+{
+    std::vector<CDBWrapperStats> result;
+    std::lock_guard<std::mutex> lock(csOpenDatabases);
+    for (const CDBWrapper* db : setOpenDatabases)
+        result.push_back(db->GetStats());
+    std::sort(result.begin(), result.end(), [](const CDBWrapperStats& a, const CDBWrapperStats& b) {
+        return a.options.strName < b.options.strName;
+    });
+    return result;
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
+    CPerfTimer perfTimer(PerfStat::DB_WRITE);
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
+    perfTimer.Stop();
     dbwrapper_private::HandleError(status);
     return true;
 }
@@ -6,12 +6,15 @@
 #define PRIVORA_DBWRAPPER_H
 
 #include "clientversion.h"
+#include "perfstats.h"
 #include "serialize.h"
 #include "streams.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "version.h"
 
+#include <atomic>
+
 #include <boost/filesystem/path.hpp>
 
 #include <leveldb/db.h>
@@ -20,6 +23,11 @@
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
+//! Default LevelDB open file limit of a database
+static const int DEFAULT_DB_MAX_OPEN_FILES = 64;
+//! Default bloom filter bits per key of a database
+static const int DEFAULT_DB_BLOOM_BITS = 10;
+
 class dbwrapper_error : public std::runtime_error
 {
 public:
@@ -44,6 +52,58 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 };
 
+/**
+ * LevelDB settings of a database. Named databases (blocktree, chainstate, evo, llmq) can
+ * have each setting overridden with -<name>dbcache, -<name>dbwritebuffer,
+ * -<name>dbmaxopenfiles and -<name>dbbloombits, and report their counters to
+ * getdbstats. Compression is not configurable: the bundled LevelDB is built without
+ * Snappy and stores blocks as is.
+ */
+struct CDBWrapperOptions
+{
+    std::string strName;
+    size_t nCacheSize{0};
+    //! 0 to use a quarter of the cache size
+    size_t nWriteBufferSize{0};
+    int nMaxOpenFiles{DEFAULT_DB_MAX_OPEN_FILES};
+    int nBloomBits{DEFAULT_DB_BLOOM_BITS};
+
+    CDBWrapperOptions() {}
+    explicit CDBWrapperOptions(size_t nCacheSizeIn) : nCacheSize(nCacheSizeIn) {}
+};
+
+/** Options of the database called strName, nCacheSize unless -<strName>dbcache is set */
+CDBWrapperOptions GetDBWrapperOptions(const std::string& strName, size_t nCacheSize);
+
+/** Counters of a named database, see getdbstats */
+struct CDBWrapperStats
+{
+    CDBWrapperOptions options;
+
+    //! single key reads and how many of them were served from memory: the memtables, the
+    //! block cache or memory mapped tables
+    uint64_t nReads{0};
+    uint64_t nCacheHits{0};
+    //! ReadMany calls and the keys they looked up
+    uint64_t nMultiReads{0};
+    uint64_t nMultiReadKeys{0};
+    //! bytes of the values returned to callers
+    uint64_t nBytesRead{0};
+    //! reads copied from table files (block cache misses) and their bytes, compactions included
+    uint64_t nFileReads{0};
+    uint64_t nFileBytesRead{0};
+
+    double nCompactionSeconds{0};
+    uint64_t nCompactionBytesRead{0};
+    uint64_t nCompactionBytesWritten{0};
+    uint64_t nSizeOnDisk{0};
+    //! block cache plus memtables
+    uint64_t nMemoryUsage{0};
+};
+
+/** Counters of all open named databases */
+std::vector<CDBWrapperStats> GetDBWrapperStats();
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -203,10 +263,31 @@ public:
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+public:
+    //! counters behind CDBWrapperStats, updated without locks
+    struct Counters
+    {
+        std::atomic<uint64_t> nReads{0};
+        std::atomic<uint64_t> nCacheHits{0};
+        std::atomic<uint64_t> nMultiReads{0};
+        std::atomic<uint64_t> nMultiReadKeys{0};
+        std::atomic<uint64_t> nBytesRead{0};
+        std::atomic<uint64_t> nFileReads{0};
+        std::atomic<uint64_t> nFileBytesRead{0};
+    };
+
 private:
     //! custom environment this database is using (may be NULL in case of default environment)
     leveldb::Env* penv;
 
+    //! environment counting table file reads, wraps penv or the default environment
+    leveldb::Env* pstatsenv;
+
+    //! settings the database was opened with
+    CDBWrapperOptions dbOptions;
+
+    mutable Counters counters;
+
     //! database options used
     leveldb::Options options;
 
@@ -236,6 +317,12 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    //! Get the raw value of a key, false if it does not exist
+    bool ReadRaw(const leveldb::Slice& slKey, std::string& strValue) const;
+
+    //! Get the raw values of many keys with one iterator
+    void ReadManyRaw(const std::vector<CDataStream>& ssKeys, std::vector<std::string>& strValues, std::vector<bool>& found) const;
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
@@ -246,6 +333,8 @@ public:
      *                        with a zero'd byte array.
      */
     CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    /** @param[in] dbOptions  Cache size and LevelDB settings, see GetDBWrapperOptions */
+    CDBWrapper(const boost::filesystem::path& path, const CDBWrapperOptions& dbOptions, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
     ~CDBWrapper();
 
     template <typename K>
@@ -262,13 +351,8 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
+        if (!ReadRaw(slKey, strValue))
+            return false;
         CDataStream ssValueTmp(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
         ssValueTmp.Xor(obfuscate_key);
         ssValue = std::move(ssValueTmp);
@@ -284,13 +368,8 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
+        if (!ReadRaw(slKey, strValue))
+            return false;
         try {
             CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
             ssValue.Xor(obfuscate_key);
@@ -318,14 +397,47 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
+        return ReadRaw(slKey, strValue);
+    }
+
+    /**
+     * Read the values of many keys. The keys are looked up in sorted order with a single
+     * iterator that steps forward with Next() from one key to the following one, and only
+     * seeks when they are far apart, so neighbouring keys are served from the table blocks
+     * already loaded instead of each going through the table cache and block cache again.
+     * found[i] tells whether keys[i] exists, in which case values[i] holds its value.
+     * Returns the number of keys found.
+     */
+    template <typename K, typename V>
+    size_t ReadMany(const std::vector<K>& keys, std::vector<V>& values, std::vector<bool>& found) const
+    {
+        std::vector<CDataStream> ssKeys;
+        ssKeys.reserve(keys.size());
+        for (const K& key : keys) {
+            ssKeys.emplace_back(SER_DISK, CLIENT_VERSION);
+            ssKeys.back().reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+            ssKeys.back() << key;
+        }
+
+        std::vector<std::string> strValues;
+        ReadManyRaw(ssKeys, strValues, found);
+
+        size_t nFound = 0;
+        values.clear();
+        values.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (!found[i])
+                continue;
+            try {
+                CDataStream ssValue(strValues[i].data(), strValues[i].data() + strValues[i].size(), SER_DISK, CLIENT_VERSION);
+                ssValue.Xor(obfuscate_key);
+                ssValue >> values[i];
+                nFound++;
+            } catch (const std::exception&) {
+                found[i] = false;
+            }
         }
-        return true;
+        return nFound;
     }
 
     template <typename K>
@@ -396,7 +508,11 @@ public:
     {
         pdb->CompactRange(nullptr, nullptr);
     }
-    
+
+    const CDBWrapperOptions& GetDBOptions() const { return dbOptions; }
+
+    /** Read counters plus LevelDB's compaction and memory figures */
+    CDBWrapperStats GetStats() const;
 };
 
 template<typename CDBTransaction>
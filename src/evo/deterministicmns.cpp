@@ -20,6 +20,19 @@
 
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
 static const std::string DB_LIST_DIFF = "dmn_D";
+// diffs and snapshots keyed by inversed height, so that walking back from a block is a single forward scan
+static const std::string DB_LIST_BY_INVERSED_HEIGHT = "dmn_H";
+
+// a snapshot sorts before the diff of the same block
+static const uint8_t LIST_RECORD_SNAPSHOT = 0;
+static const uint8_t LIST_RECORD_DIFF = 1;
+
+typedef std::tuple<std::string, uint32_t, uint256, uint8_t> ListByHeightKey;
+
+static ListByHeightKey BuildListByHeightKey(int nHeight, const uint256& blockHash, uint8_t recordType)
+{
+    return std::make_tuple(DB_LIST_BY_INVERSED_HEIGHT, htobe32(std::numeric_limits<uint32_t>::max() - nHeight), blockHash, recordType);
+}
 
 CDeterministicMNManager* deterministicMNManager;
 
@@ -538,12 +551,29 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
         oldList = GetListForBlock(pindex->pprev);
         diff = oldList.BuildDiff(newList);
 
-        evoDb.Write(std::make_pair(DB_LIST_DIFF, newList.GetBlockHash()), diff);
-        if ((nHeight % SNAPSHOT_LIST_PERIOD) == 0 || oldList.GetHeight() == -1) {
-            evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT, newList.GetBlockHash()), newList);
-            LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d\n",
-                __func__, nHeight, newList.GetAllMNsCount());
+        evoDb.Write(BuildListByHeightKey(nHeight, newList.GetBlockHash(), LIST_RECORD_DIFF), diff);
+
+        // Besides the daily snapshot, write one as soon as replaying the diffs since the last
+        // snapshot would read more than the snapshot itself, so periods of heavy churn don't
+        // make old lists expensive to rebuild
+        if (!fSnapshotIntervalKnown) {
+            InitSnapshotInterval(pindex->pprev);
+        }
+        nDiffsSizeSinceSnapshot += ::GetSerializeSize(diff, SER_DISK, CLIENT_VERSION);
+        bool fSnapshot = (nHeight % SNAPSHOT_LIST_PERIOD) == 0 || oldList.GetHeight() == -1;
+        if (!fSnapshot && nLastSnapshotSize != 0 && nHeight - nLastSnapshotHeight >= MIN_SNAPSHOT_LIST_PERIOD) {
+            fSnapshot = nDiffsSizeSinceSnapshot >= nLastSnapshotSize;
         }
+        if (fSnapshot) {
+            evoDb.Write(BuildListByHeightKey(nHeight, newList.GetBlockHash(), LIST_RECORD_SNAPSHOT), newList);
+            nLastSnapshotHeight = nHeight;
+            nLastSnapshotSize = ::GetSerializeSize(newList, SER_DISK, CLIENT_VERSION);
+            nDiffsSizeSinceSnapshot = 0;
+            LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d, size=%d\n",
+                __func__, nHeight, newList.GetAllMNsCount(), nLastSnapshotSize);
+        }
+
+        mnListsCache.insert(newList.GetBlockHash(), newList);
     }
 
     // Don't hold cs while calling signals
@@ -556,9 +586,6 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
         LogPrintf("CDeterministicMNManager::%s -- DIP3 is enforced now. nHeight=%d\n", __func__, nHeight);
     }
 
-    LOCK(cs);
-    CleanupCache(nHeight);
-
     return true;
 }
 
@@ -572,7 +599,7 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
     CDeterministicMNListDiff diff;
     {
         LOCK(cs);
-        evoDb.Read(std::make_pair(DB_LIST_DIFF, blockHash), diff);
+        ReadDiff(pindex, diff);
 
         if (diff.HasChanges()) {
             // need to call this before erasing
@@ -580,10 +607,15 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
             prevList = GetListForBlock(pindex->pprev);
         }
 
+        evoDb.Erase(BuildListByHeightKey(nHeight, blockHash, LIST_RECORD_DIFF));
+        evoDb.Erase(BuildListByHeightKey(nHeight, blockHash, LIST_RECORD_SNAPSHOT));
         evoDb.Erase(std::make_pair(DB_LIST_DIFF, blockHash));
         evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT, blockHash));
 
         mnListsCache.erase(blockHash);
+
+        // the undone block may have been counted or have had the last snapshot
+        fSnapshotIntervalKnown = false;
     }
 
     if (diff.HasChanges()) {
@@ -903,40 +935,144 @@ void CDeterministicMNManager::DecreasePoSePenalties(CDeterministicMNList& mnList
     }
 }
 
+bool CDeterministicMNManager::ReadDiff(const CBlockIndex* pindex, CDeterministicMNListDiff& diff)
+{
+    // diffs written before the height index existed are only stored by block hash
+    return evoDb.Read(BuildListByHeightKey(pindex->nHeight, pindex->GetBlockHash(), LIST_RECORD_DIFF), diff) ||
+           evoDb.Read(std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash()), diff);
+}
+
+/**
+ * Rebuild the adaptive snapshot interval state for a chain ending at pindex from the stored
+ * records. Without a snapshot in the last SNAPSHOT_LIST_PERIOD blocks only the daily
+ * snapshot is written until the next one.
+ */
+void CDeterministicMNManager::InitSnapshotInterval(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs);
+
+    fSnapshotIntervalKnown = true;
+    nLastSnapshotHeight = -1;
+    nLastSnapshotSize = 0;
+    nDiffsSizeSinceSnapshot = 0;
+
+    for (int i = 0; pindex && i < SNAPSHOT_LIST_PERIOD; i++, pindex = pindex->pprev) {
+        CDeterministicMNList snapshot;
+        if (evoDb.Read(BuildListByHeightKey(pindex->nHeight, pindex->GetBlockHash(), LIST_RECORD_SNAPSHOT), snapshot) ||
+            evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
+            nLastSnapshotHeight = pindex->nHeight;
+            nLastSnapshotSize = ::GetSerializeSize(snapshot, SER_DISK, CLIENT_VERSION);
+            return;
+        }
+
+        CDeterministicMNListDiff diff;
+        if (!ReadDiff(pindex, diff)) {
+            break;
+        }
+        nDiffsSizeSinceSnapshot += ::GetSerializeSize(diff, SER_DISK, CLIENT_VERSION);
+    }
+
+    nDiffsSizeSinceSnapshot = 0;
+}
+
+/**
+ * Collect the diffs of pindex and its ancestors, newest first, with one scan over the height
+ * ordered records until a cached list or a snapshot is found and stored in baseListRet.
+ * Records of other forks at the same heights are skipped. Returns nullptr if a base list was
+ * found, otherwise the block whose records are missing from the height index, from which
+ * the caller has to continue with the legacy per block hash records.
+ */
+const CBlockIndex* CDeterministicMNManager::LoadDiffsByHeight(const CBlockIndex* pindex, CDeterministicMNList& baseListRet, DiffsVector& diffsRet)
+{
+    AssertLockHeld(cs);
+
+    auto dbIt = evoDb.GetCurTransaction().NewIteratorUniquePtr();
+    dbIt->Seek(BuildListByHeightKey(pindex->nHeight, uint256(), LIST_RECORD_SNAPSHOT));
+
+    for (; pindex; pindex = pindex->pprev) {
+        if (mnListsCache.get(pindex->GetBlockHash(), baseListRet)) {
+            return nullptr;
+        }
+
+        bool fFound = false;
+        while (!fFound && dbIt->Valid()) {
+            ListByHeightKey key;
+            if (!dbIt->GetKey(key) || std::get<0>(key) != DB_LIST_BY_INVERSED_HEIGHT) {
+                return pindex;
+            }
+            int nKeyHeight = (int)(std::numeric_limits<uint32_t>::max() - be32toh(std::get<1>(key)));
+            if (nKeyHeight < pindex->nHeight) {
+                return pindex;
+            }
+            if (nKeyHeight > pindex->nHeight || std::get<2>(key) != pindex->GetBlockHash()) {
+                // a block of another fork
+                dbIt->Next();
+                continue;
+            }
+
+            if (std::get<3>(key) == LIST_RECORD_SNAPSHOT) {
+                if (!dbIt->GetValue(baseListRet)) {
+                    return pindex;
+                }
+                mnListsCache.insert(pindex->GetBlockHash(), baseListRet);
+                return nullptr;
+            }
+
+            CDeterministicMNListDiff diff;
+            if (!dbIt->GetValue(diff)) {
+                return pindex;
+            }
+            diffsRet.emplace_back(pindex, std::move(diff));
+            dbIt->Next();
+            fFound = true;
+        }
+        if (!fFound) {
+            return pindex;
+        }
+    }
+
+    baseListRet = CDeterministicMNList();
+    return nullptr;
+}
+
 CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex* pindex)
 {
     LOCK(cs);
 
     CDeterministicMNList snapshot;
-    std::list<std::pair<const CBlockIndex*, CDeterministicMNListDiff>> listDiff;
+    if (mnListsCache.get(pindex->GetBlockHash(), snapshot)) {
+        return snapshot;
+    }
 
-    while (true) {
+    DiffsVector diffs;
+    const CBlockIndex* pindexLegacy = LoadDiffsByHeight(pindex, snapshot, diffs);
+
+    while (pindexLegacy) {
         // try using cache before reading from disk
-        auto it = mnListsCache.find(pindex->GetBlockHash());
-        if (it != mnListsCache.end()) {
-            snapshot = it->second;
+        if (mnListsCache.get(pindexLegacy->GetBlockHash(), snapshot)) {
             break;
         }
 
-        if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+        if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindexLegacy->GetBlockHash()), snapshot)) {
+            mnListsCache.insert(pindexLegacy->GetBlockHash(), snapshot);
             break;
         }
 
         CDeterministicMNListDiff diff;
-        if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash()), diff)) {
-            snapshot = CDeterministicMNList(pindex->GetBlockHash(), -1, 0);
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+        if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, pindexLegacy->GetBlockHash()), diff)) {
+            snapshot = CDeterministicMNList(pindexLegacy->GetBlockHash(), -1, 0);
+            mnListsCache.insert(pindexLegacy->GetBlockHash(), snapshot);
             break;
         }
 
-        listDiff.emplace_front(pindex, std::move(diff));
-        pindex = pindex->pprev;
+        diffs.emplace_back(pindexLegacy, std::move(diff));
+        pindexLegacy = pindexLegacy->pprev;
     }
 
-    for (const auto& p : listDiff) {
-        auto diffIndex = p.first;
-        auto& diff = p.second;
+    // apply the diffs oldest first, caching only some of the intermediate lists
+    for (auto it = diffs.rbegin(); it != diffs.rend(); ++it) {
+        auto diffIndex = it->first;
+        auto& diff = it->second;
         if (diff.HasChanges()) {
             snapshot = snapshot.ApplyDiff(diffIndex, diff);
         } else {
@@ -944,12 +1080,38 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
             snapshot.SetHeight(diffIndex->nHeight);
         }
 
-        mnListsCache.emplace(diffIndex->GetBlockHash(), snapshot);
+        if (diffIndex == pindex || (diffIndex->nHeight % LISTS_CACHE_INTERMEDIATE_PERIOD) == 0) {
+            mnListsCache.insert(diffIndex->GetBlockHash(), snapshot);
+        }
     }
 
     return snapshot;
 }
 
+void CDeterministicMNManager::ImportLists(const CBlockIndex* pindexStart, const CDeterministicMNList& startList,
+                                          const std::vector<CDeterministicMNListDiff>& diffs, const CBlockIndex* pindexEnd)
+{
+    AssertLockHeld(cs_main);
+    assert(pindexEnd->nHeight - pindexStart->nHeight == (int)diffs.size());
+
+    LOCK(cs);
+
+    evoDb.Write(BuildListByHeightKey(pindexStart->nHeight, pindexStart->GetBlockHash(), LIST_RECORD_SNAPSHOT), startList);
+    mnListsCache.insert(pindexStart->GetBlockHash(), startList);
+    fSnapshotIntervalKnown = true;
+    nLastSnapshotHeight = pindexStart->nHeight;
+    nLastSnapshotSize = ::GetSerializeSize(startList, SER_DISK, CLIENT_VERSION);
+    nDiffsSizeSinceSnapshot = 0;
+
+    for (size_t i = 0; i < diffs.size(); i++) {
+        const CBlockIndex* pindex = pindexEnd->GetAncestor(pindexStart->nHeight + 1 + i);
+        evoDb.Write(BuildListByHeightKey(pindex->nHeight, pindex->GetBlockHash(), LIST_RECORD_DIFF), diffs[i]);
+        nDiffsSizeSinceSnapshot += ::GetSerializeSize(diffs[i], SER_DISK, CLIENT_VERSION);
+    }
+
+    LogPrintf("CDeterministicMNManager::%s -- imported lists from height %d to %d\n", __func__, pindexStart->nHeight, pindexEnd->nHeight);
+}
+
 CDeterministicMNList CDeterministicMNManager::GetListAtChainTip()
 {
     LOCK(cs);
@@ -995,21 +1157,6 @@ bool CDeterministicMNManager::IsDIP3Enforced(int nHeight)
     return nHeight >= Params().GetConsensus().DIP0003EnforcementHeight;
 }
 
-void CDeterministicMNManager::CleanupCache(int nHeight)
-{
-    AssertLockHeld(cs);
-
-    std::vector<uint256> toDelete;
-    for (const auto& p : mnListsCache) {
-        if (p.second.GetHeight() + LISTS_CACHE_SIZE < nHeight) {
-            toDelete.emplace_back(p.first);
-        }
-    }
-    for (const auto& h : toDelete) {
-        mnListsCache.erase(h);
-    }
-}
-
 bool CDeterministicMNManager::UpgradeDiff(CDBBatch& batch, const CBlockIndex* pindexNext, const CDeterministicMNList& curMNList, CDeterministicMNList& newMNList)
 {
     CDataStream oldDiffData(SER_DISK, CLIENT_VERSION);
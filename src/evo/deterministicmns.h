@@ -10,8 +10,10 @@
 #include "dbwrapper.h"
 #include "evodb.h"
 #include "providertx.h"
+#include "saltedhasher.h"
 #include "simplifiedmns.h"
 #include "sync.h"
+#include "unordered_lru_cache.h"
 
 #include "immer/map.hpp"
 #include "immer/map_transient.hpp"
@@ -626,7 +628,12 @@ public:
 class CDeterministicMNManager
 {
     static const int SNAPSHOT_LIST_PERIOD = 576; // once per day
-    static const int LISTS_CACHE_SIZE = 576;
+    // snapshots written early because of heavy list churn are at least this far apart
+    static const int MIN_SNAPSHOT_LIST_PERIOD = 16;
+    // lists share their maps' structure, so bounding their number bounds the memory as well
+    static const size_t LISTS_CACHE_SIZE = 1024;
+    // of the lists rebuilt while applying diffs only those at multiples of this height are cached
+    static const int LISTS_CACHE_INTERMEDIATE_PERIOD = 32;
 
 public:
     CCriticalSection cs;
@@ -634,9 +641,16 @@ public:
 private:
     CEvoDB& evoDb;
 
-    std::map<uint256, CDeterministicMNList> mnListsCache;
+    unordered_lru_cache<uint256, CDeterministicMNList, StaticSaltedHasher> mnListsCache{LISTS_CACHE_SIZE};
     const CBlockIndex* tipIndex{nullptr};
 
+    // state of the adaptive snapshot interval, see ProcessBlock. Rebuilt from the stored
+    // records by InitSnapshotInterval when unknown, after a restart or an undone block.
+    bool fSnapshotIntervalKnown{false};
+    int nLastSnapshotHeight{-1};
+    size_t nLastSnapshotSize{0};
+    size_t nDiffsSizeSinceSnapshot{0};
+
 public:
     CDeterministicMNManager(CEvoDB& _evoDb);
 
@@ -653,6 +667,11 @@ public:
     CDeterministicMNList GetListForBlock(const CBlockIndex* pindex);
     CDeterministicMNList GetListAtChainTip();
 
+    // Store the list of pindexStart and the diffs of the blocks after it, oldest first, as if
+    // they had been processed. Used to load a state snapshot, which carries no block data.
+    void ImportLists(const CBlockIndex* pindexStart, const CDeterministicMNList& startList,
+                     const std::vector<CDeterministicMNListDiff>& diffs, const CBlockIndex* pindexEnd);
+
     // Test if given TX is a ProRegTx which also contains the collateral at index n
     bool IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n);
 
@@ -665,7 +684,11 @@ public:
     static bool IsDIP3Active(int height);
 
 private:
-    void CleanupCache(int nHeight);
+    typedef std::vector<std::pair<const CBlockIndex*, CDeterministicMNListDiff>> DiffsVector;
+
+    bool ReadDiff(const CBlockIndex* pindex, CDeterministicMNListDiff& diff);
+    void InitSnapshotInterval(const CBlockIndex* pindex);
+    const CBlockIndex* LoadDiffsByHeight(const CBlockIndex* pindex, CDeterministicMNList& baseListRet, DiffsVector& diffsRet);
 };
 
 extern CDeterministicMNManager* deterministicMNManager;
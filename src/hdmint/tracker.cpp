@@ -75,8 +75,11 @@ bool CHDMintTracker::Archive(CMintMeta& meta)
 {
     uint256 hashPubcoin = meta.GetPubCoinValueHash();
 
-    if (HasSerialHash(meta.hashSerial))
-        mapSerialHashes.at(meta.hashSerial).isArchived = true;
+    if (HasSerialHash(meta.hashSerial)) {
+        CMintMeta archived = mapSerialHashes.at(meta.hashSerial);
+        archived.isArchived = true;
+        SetMeta(archived);
+    }
 
    CWalletDB walletdb(strWalletFile);
     CHDMint dMint;
@@ -93,8 +96,11 @@ bool CHDMintTracker::Archive(CLelantusMintMeta& meta)
 {
     uint256 hashPubcoin = meta.GetPubCoinValueHash();
 
-    if (HasLelantusSerialHash(meta.hashSerial))
-        mapLelantusSerialHashes.at(meta.hashSerial).isArchived = true;
+    if (HasLelantusSerialHash(meta.hashSerial)) {
+        CLelantusMintMeta archived = mapLelantusSerialHashes.at(meta.hashSerial);
+        archived.isArchived = true;
+        SetMeta(archived);
+    }
 
     CWalletDB walletdb(strWalletFile);
     CHDMint dMint;
@@ -325,7 +331,7 @@ bool CHDMintTracker::UpdateState(const CMintMeta& meta)
             CT_UPDATED);
     }
 
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
 
     return true;
 }
@@ -374,7 +380,7 @@ bool CHDMintTracker::UpdateState(const CLelantusMintMeta& meta)
             std::string("Update (") + std::to_string((double)dMint.GetAmount() / COIN) + "mint)",
             CT_UPDATED);
 
-    mapLelantusSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
 
     return true;
 }
@@ -406,7 +412,7 @@ void CHDMintTracker::Add(CWalletDB& walletdb, const CHDMint& dMint, bool isNew,
     meta.isArchived = isArchived;
     meta.isDeterministic = true;
     meta.isSeedCorrect = true;
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
 
     pwalletMain->NotifyZerocoinChanged(
         pwalletMain,
@@ -430,7 +436,7 @@ void CHDMintTracker::AddLelantus(CWalletDB& walletdb, const CHDMint& dMint, bool
     meta.amount = dMint.GetAmount();
     meta.isArchived = isArchived;
     meta.isSeedCorrect = true;
-    mapLelantusSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
 
     pwalletMain->NotifyZerocoinChanged(
             pwalletMain,
@@ -458,7 +464,7 @@ void CHDMintTracker::Add(CWalletDB& walletdb, const CSigmaEntry& sigma, bool isN
     meta.isArchived = isArchived;
     meta.isDeterministic = false;
     meta.isSeedCorrect = true;
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
 
     if (isNew)
         walletdb.WriteSigmaEntry(sigma);
@@ -1291,5 +1297,131 @@ std::set<uint256> CHDMintTracker::GetMempoolTxids(){
  */
 void CHDMintTracker::Clear()
 {
+    LOCK(cs_balance);
     mapSerialHashes.clear();
+    sigmaBalance.Clear();
+}
+
+void CHDMintTracker::TallyMeta(const CMintMeta& meta, bool fAdd)
+{
+    if (meta.isUsed || meta.isArchived || !meta.isSeedCorrect)
+        return;
+
+    CAmount amount;
+    if (!sigma::DenominationToInteger(meta.denom, amount))
+        return;
+
+    if (fAdd)
+        sigmaBalance.Add(meta.nHeight, amount);
+    else
+        sigmaBalance.Remove(meta.nHeight, amount);
+}
+
+void CHDMintTracker::TallyMeta(const CLelantusMintMeta& meta, bool fAdd)
+{
+    if (meta.isUsed || meta.isArchived || !meta.isSeedCorrect)
+        return;
+
+    if (fAdd)
+        lelantusBalance.Add(meta.nHeight, meta.amount);
+    else
+        lelantusBalance.Remove(meta.nHeight, meta.amount);
+}
+
+/**
+ * Store a mint meta object in memory, replacing the one with the same serial hash.
+ *
+ * @param meta mint meta object
+ * @return void
+ */
+void CHDMintTracker::SetMeta(const CMintMeta& meta)
+{
+    LOCK(cs_balance);
+    auto it = mapSerialHashes.find(meta.hashSerial);
+    if (it != mapSerialHashes.end()) {
+        TallyMeta(it->second, false);
+        it->second = meta;
+    } else {
+        mapSerialHashes.emplace(meta.hashSerial, meta);
+    }
+    TallyMeta(meta, true);
+}
+
+void CHDMintTracker::SetMeta(const CLelantusMintMeta& meta)
+{
+    LOCK(cs_balance);
+    auto it = mapLelantusSerialHashes.find(meta.hashSerial);
+    if (it != mapLelantusSerialHashes.end()) {
+        TallyMeta(it->second, false);
+        it->second = meta;
+    } else {
+        mapLelantusSerialHashes.emplace(meta.hashSerial, meta);
+    }
+    TallyMeta(meta, true);
+}
+
+/**
+ * Get the balance of the unspent Sigma and Lelantus mints.
+ *
+ * A mint is confirmed once it has ZC_MINT_CONFIRMATIONS confirmations at the given chain height.
+ *
+ * @param nChainHeight chain height
+ * @param balance confirmed and unconfirmed amounts
+ * @param confirmed number of confirmed mints
+ * @param unconfirmed number of unconfirmed mints
+ * @return void
+ */
+void CHDMintTracker::GetBalance(int nChainHeight, std::pair<CAmount, CAmount>& balance, size_t& confirmed, size_t& unconfirmed) const
+{
+    LOCK(cs_balance);
+    lelantusBalance.Get(nChainHeight, ZC_MINT_CONFIRMATIONS, balance, confirmed, unconfirmed);
+    sigmaBalance.Get(nChainHeight, ZC_MINT_CONFIRMATIONS, balance, confirmed, unconfirmed);
+}
+
+void CMintBalanceTally::Add(int nHeight, CAmount nAmount)
+{
+    std::pair<CAmount, size_t>& bucket = nHeight > 0 ? mapMinedByHeight[nHeight] : unmined;
+    bucket.first += nAmount;
+    bucket.second++;
+    if (nHeight > 0) {
+        mined.first += nAmount;
+        mined.second++;
+    }
+}
+
+void CMintBalanceTally::Remove(int nHeight, CAmount nAmount)
+{
+    if (nHeight > 0) {
+        auto it = mapMinedByHeight.find(nHeight);
+        assert(it != mapMinedByHeight.end());
+        it->second.first -= nAmount;
+        if (--it->second.second == 0)
+            mapMinedByHeight.erase(it);
+        mined.first -= nAmount;
+        mined.second--;
+    } else {
+        unmined.first -= nAmount;
+        unmined.second--;
+    }
+}
+
+void CMintBalanceTally::Clear()
+{
+    unmined = mined = std::make_pair(0, 0);
+    mapMinedByHeight.clear();
+}
+
+void CMintBalanceTally::Get(int nChainHeight, int nConfirmations, std::pair<CAmount, CAmount>& balance, size_t& confirmed, size_t& unconfirmed) const
+{
+    // only the last few heights hold mined mints that are not confirmed yet
+    std::pair<CAmount, size_t> recent = unmined;
+    for (auto it = mapMinedByHeight.upper_bound(nChainHeight - nConfirmations + 1); it != mapMinedByHeight.end(); ++it) {
+        recent.first += it->second.first;
+        recent.second += it->second.second;
+    }
+
+    balance.first += mined.first + unmined.first - recent.first;
+    balance.second += recent.first;
+    confirmed += mined.second + unmined.second - recent.second;
+    unconfirmed += recent.second;
 }
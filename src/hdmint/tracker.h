@@ -7,12 +7,37 @@
 
 #include "primitives/mint_spend.h"
 #include "hdmint/mintpool.h"
+#include "sync.h"
 #include "wallet/walletdb.h"
 #include <list>
 
 class CHDMint;
 class CHDMintWallet;
 
+/**
+ * Running totals of unspent mints, kept by the height they were mined at so that the part that
+ * is confirmed at a chain height is known without going over the mints.
+ */
+class CMintBalanceTally
+{
+private:
+    //! amount and number of mints that are not mined
+    std::pair<CAmount, size_t> unmined;
+    //! amount and number of mined mints, in total and by height
+    std::pair<CAmount, size_t> mined;
+    std::map<int, std::pair<CAmount, size_t> > mapMinedByHeight;
+
+public:
+    CMintBalanceTally() : unmined(0, 0), mined(0, 0) {}
+
+    void Add(int nHeight, CAmount nAmount);
+    void Remove(int nHeight, CAmount nAmount);
+    void Clear();
+
+    /** Add the amounts and numbers of the mints with at least nConfirmations at nChainHeight and of the others */
+    void Get(int nChainHeight, int nConfirmations, std::pair<CAmount, CAmount>& balance, size_t& confirmed, size_t& unconfirmed) const;
+};
+
 class CHDMintTracker
 {
 private:
@@ -21,6 +46,14 @@ private:
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, CLelantusMintMeta> mapLelantusSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
+    //! unspent Sigma and Lelantus mints, guarded by cs_balance
+    mutable CCriticalSection cs_balance;
+    CMintBalanceTally sigmaBalance;
+    CMintBalanceTally lelantusBalance;
+    void SetMeta(const CMintMeta& meta);
+    void SetMeta(const CLelantusMintMeta& meta);
+    void TallyMeta(const CMintMeta& meta, bool fAdd);
+    void TallyMeta(const CLelantusMintMeta& meta, bool fAdd);
     bool IsMempoolSpendOurs(const std::set<uint256>& setMempool, const uint256& hashSerial);
     bool UpdateMetaStatus(const std::set<uint256>& setMempool, CMintMeta& mint, bool fSpend=false);
     bool UpdateLelantusMetaStatus(const std::set<uint256>& setMempool, CLelantusMintMeta& mint, bool fSpend=false);
@@ -67,6 +100,8 @@ public:
     bool UpdateState(const CMintMeta& meta);
     bool UpdateState(const CLelantusMintMeta& meta);
     void Clear();
+    /** Amounts and numbers of the confirmed and unconfirmed unspent Sigma and Lelantus mints */
+    void GetBalance(int nChainHeight, std::pair<CAmount, CAmount>& balance, size_t& confirmed, size_t& unconfirmed) const;
 };
 
 #endif //PRIVORA_HDMINTTRACKER_H
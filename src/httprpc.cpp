@@ -8,6 +8,7 @@
 #include "chainparams.h"
 #include "httpserver.h"
 #include "mbstring.h"
+#include "rpc/jsonstream.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -194,7 +195,33 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq);
+            // methods with large results can send them while they are written
+            CRPCReplyStream replyStream(jreq.id,
+                [req]() {
+                    req->WriteHeader("Content-Type", "application/json");
+                    req->StartReply(HTTP_OK);
+                },
+                [req](std::string&& chunk) { req->WriteReplyChunk(std::move(chunk)); },
+                fSanitizeResponse);
+            jreq.replyStream = &replyStream;
+
+            UniValue result;
+            try {
+                result = tableRPC.execute(jreq);
+            } catch (...) {
+                // the status and part of the result are out already, all that is left is to cut the reply short
+                if (replyStream.IsStarted()) {
+                    LogPrintf("%s: %s failed while sending its result\n", __func__, jreq.strMethod);
+                    req->EndReply();
+                    return false;
+                }
+                throw;
+            }
+            if (replyStream.IsStarted()) {
+                replyStream.EndResult();
+                req->EndReply();
+                return true;
+            }
 
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
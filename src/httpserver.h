@@ -55,6 +55,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -110,6 +111,17 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for a body that is sent with WriteReplyChunk as it is
+     * produced and finished with EndReply.
+     *
+     * @note Write the headers before. Chunks are handed to the main http thread in order;
+     * if the client has gone away they are dropped there.
+     */
+    void StartReply(int nStatus);
+    void WriteReplyChunk(std::string&& chunk);
+    void EndReply();
 };
 
 /** Event handler closure.
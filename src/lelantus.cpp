@@ -20,6 +20,8 @@
 #include "policy/policy.h"
 #include "coins.h"
 #include "batchproof_container.h"
+#include "perfstats.h"
+#include "privacytx.h"
 
 #include <atomic>
 #include <sstream>
@@ -365,6 +367,7 @@ bool CheckLelantusJoinSplitTransaction(
         bool fStatefulSigmaCheck,
         sigma::CSigmaTxInfo* sigmaTxInfo,
         CLelantusTxInfo* lelantusTxInfo) {
+    CPerfTimer perfTimer(PerfStat::LELANTUS_JOINSPLIT_CHECK);
     std::unordered_set<Scalar, sigma::CScalarHash> txSerials;
 
     Consensus::Params const & params = ::Params().GetConsensus();
@@ -466,6 +469,7 @@ bool CheckLelantusJoinSplitTransaction(
     }
 
     std::vector<std::vector<unsigned char>> anonymity_set_hashes;
+    std::vector<CPrivacyProofSet> proofSets;
 
     for (auto& idAndHash : joinsplit->getIdAndBlockHashes()) {
         auto& anonymity_set = anonymity_sets[idAndHash.first];
@@ -488,6 +492,7 @@ bool CheckLelantusJoinSplitTransaction(
             while (index != coinGroup.firstBlock && index->GetBlockHash() != idAndHash.second)
                 index = index->pprev;
 
+            proofSets.push_back({idAndHash.first, index->GetBlockHash(), 0, {}});
             std::pair<sigma::CoinDenomination, int> denominationAndId = std::make_pair(denomination, coinGroupId);
 
             auto lelantusParams = lelantus::Params::get_default();
@@ -520,11 +525,14 @@ bool CheckLelantusJoinSplitTransaction(
             while (index != coinGroup.firstBlock && index->GetBlockHash() != idAndHash.second)
                 index = index->pprev;
 
+            proofSets.push_back({idAndHash.first, index->GetBlockHash(), 0, {}});
             // take the hash from last block of anonymity set, it is used at challenge generation if nLelantusFixesStartBlock is passed
             if (nHeight >= params.nLelantusFixesStartBlock) {
                 std::vector<unsigned char> set_hash = GetAnonymitySetHash(index, idAndHash.first);
-                if (!set_hash.empty())
+                if (!set_hash.empty()) {
                     anonymity_set_hashes.push_back(set_hash);
+                    proofSets.back().setHash = set_hash;
+                }
             }
             // Build a vector with all the public coins with given id before
             // the block on which the spend occured.
@@ -558,6 +566,7 @@ bool CheckLelantusJoinSplitTransaction(
             }
         }
         anonymity_sets[idAndHash.first] = anonymity_set;
+        proofSets.back().nCoins = anonymity_set.size();
     }
 
     const std::vector<uint32_t>& ids = joinsplit->getCoinGroupIds();
@@ -571,11 +580,20 @@ bool CheckLelantusJoinSplitTransaction(
     bool useBatching = batchProofContainer->fCollectProofs && !isVerifyDB && !isCheckWallet && lelantusTxInfo && !lelantusTxInfo->fInfoIsComplete;
 
     Scalar challenge;
-    // if we are collecting proofs, skip verification and collect proofs
-    passVerify = joinsplit->Verify(anonymity_sets, anonymity_set_hashes, Cout, Vout, txHashForMetadata, challenge, useBatching);
+    // the proof already passed against these anonymity sets when the tx entered the mempool
+    uint256 proofCacheKey = GetPrivacyProofCacheKey(hashTx, proofSets);
+    bool fProofCached = IsPrivacyProofVerified(proofCacheKey);
+    if (fProofCached) {
+        passVerify = true;
+    } else {
+        // if we are collecting proofs, skip verification and collect proofs
+        passVerify = joinsplit->Verify(anonymity_sets, anonymity_set_hashes, Cout, Vout, txHashForMetadata, challenge, useBatching);
+        if (passVerify && !useBatching && !isVerifyDB)
+            SetPrivacyProofVerified(proofCacheKey);
+    }
 
     // add proofs into container
-    if(useBatching) {
+    if(useBatching && !fProofCached) {
         std::map<uint32_t, size_t> idAndSizes;
 
         for(auto itr : anonymity_sets)
@@ -870,6 +888,7 @@ void RemoveLelantusJoinSplitReferencingBlock(CTxMemPool& pool, CBlockIndex* bloc
 
 void DisconnectTipLelantus(CBlock& block, CBlockIndex *pindexDelete) {
     lelantusState.RemoveBlock(pindexDelete);
+    lelantusState.PublishSnapshot(pindexDelete->pprev);
 
     // Also remove from mempool lelantus joinsplits that reference given block hash.
     RemoveLelantusJoinSplitReferencingBlock(mempool, pindexDelete);
@@ -880,29 +899,19 @@ std::vector<Scalar> GetLelantusJoinSplitSerialNumbers(const CTransaction &tx, co
     if (!tx.IsLelantusJoinSplit())
         return std::vector<Scalar>();
 
-    try {
-        return ParseLelantusJoinSplit(tx)->getCoinSerialNumbers();
-    }
-    catch (const std::exception &) {
-        return std::vector<Scalar>();
-    }
+    return GetPrivacyTxData(tx)->lelantusSerials;
 }
 
 std::vector<uint32_t> GetLelantusJoinSplitIds(const CTransaction &tx, const CTxIn &txin) {
     if (!tx.IsLelantusJoinSplit())
         return std::vector<uint32_t>();
 
-    try {
-        return ParseLelantusJoinSplit(tx)->getCoinGroupIds();
-    }
-    catch (const std::exception &) {
-        return std::vector<uint32_t>();
-    }
+    return GetPrivacyTxData(tx)->lelantusGroupIds;
 }
 
 size_t GetSpendInputs(const CTransaction &tx, const CTxIn& in) {
-    return in.IsLelantusJoinSplit() ?
-        GetLelantusJoinSplitSerialNumbers(tx, in).size() : 0;
+    return in.IsLelantusJoinSplit() && tx.IsLelantusJoinSplit() ?
+        GetPrivacyTxData(tx)->lelantusSerials.size() : 0;
 }
 
 size_t GetSpendInputs(const CTransaction &tx) {
@@ -962,6 +971,7 @@ bool ConnectBlockLelantus(
                 pindexNew->lelantusSpentSerials.insert(serial);
                 lelantusState.AddSpend(serial.first, serial.second);
             }
+            lelantusState.AddSpendsToLog(pindexNew);
         }
         else {
             return true;
@@ -1024,6 +1034,11 @@ bool ConnectBlockLelantus(
     else if (!fJustCheck) {
         lelantusState.AddBlock(pindexNew);
     }
+
+    if (!fJustCheck) {
+        lelantusState.FreezeIfClosed(pindexNew->nHeight);
+        lelantusState.PublishSnapshot(pindexNew);
+    }
     return true;
 }
 
@@ -1107,7 +1122,9 @@ bool BuildLelantusStateFromIndex(CChain *chain) {
     for (CBlockIndex *blockIndex = chain->Genesis(); blockIndex; blockIndex=chain->Next(blockIndex))
     {
         lelantusState.AddBlock(blockIndex);
+        lelantusState.FreezeIfClosed(blockIndex->nHeight);
     }
+    lelantusState.PublishSnapshot(chain->Tip());
     // DEBUG
     LogPrintf(
         "Latest ID for Lelantus coin group  %d\n",
@@ -1136,13 +1153,21 @@ void CLelantusTxInfo::Complete() {
 /******************************************************************************/
 
 CLelantusState::Containers::Containers(std::atomic<bool> & surgeCondition)
-: surgeCondition(surgeCondition)
+: frozen(std::make_shared<const CFrozenSets>()), fFrozen(false), surgeCondition(surgeCondition)
 {}
 
 void CLelantusState::Containers::AddMint(lelantus::PublicCoin const & pubCoin, CMintedCoinInfo const & coinInfo, const uint256& tag) {
     mintedPubCoins.insert(std::make_pair(pubCoin, coinInfo));
     tagToPublicCoin.insert(std::make_pair(tag, pubCoin));
     mintMetaInfo[coinInfo.coinGroupId] += 1;
+
+    frozen_mint_container::Key mintKey = frozen_mint_container::MakeKey(pubCoin.getValue());
+    if (!liveMints.count(mintKey))
+        liveMints = liveMints.set(mintKey, coinInfo);
+    frozen_tag_container::Key tagKey;
+    std::copy(tag.begin(), tag.end(), tagKey.begin());
+    if (!liveTags.count(tagKey))
+        liveTags = liveTags.set(tagKey, mintKey);
     CheckSurgeCondition();
 }
 
@@ -1155,6 +1180,13 @@ void CLelantusState::Containers::RemoveMint(lelantus::PublicCoin const & pubCoin
                 break;
             }
 
+        frozen_mint_container::Key mintKey = frozen_mint_container::MakeKey(pubCoin.getValue());
+        auto tag = std::find_if(liveTags.begin(), liveTags.end(),
+                                [&mintKey](live_tag_map::value_type const & v) { return v.second == mintKey; });
+        if (tag != liveTags.end())
+            liveTags = liveTags.erase(frozen_tag_container::Key(tag->first));
+        liveMints = liveMints.erase(mintKey);
+
         mintMetaInfo[iter->second.coinGroupId] -= 1;
         mintedPubCoins.erase(iter);
         CheckSurgeCondition();
@@ -1164,6 +1196,7 @@ void CLelantusState::Containers::RemoveMint(lelantus::PublicCoin const & pubCoin
 void CLelantusState::Containers::AddSpend(Scalar const & serial, int coinGroupId) {
     if (mintMetaInfo.count(coinGroupId) > 0) {
         usedCoinSerials[serial] = coinGroupId;
+        liveSpends = liveSpends.set(frozen_spend_container::MakeKey(serial), coinGroupId);
         spendMetaInfo[coinGroupId] += 1;
         CheckSurgeCondition();
     }
@@ -1174,6 +1207,7 @@ void CLelantusState::Containers::RemoveSpend(Scalar const & serial) {
     if (iter != usedCoinSerials.end()) {
         spendMetaInfo[iter->second] -= 1;
         usedCoinSerials.erase(iter);
+        liveSpends = liveSpends.erase(frozen_spend_container::MakeKey(serial));
         CheckSurgeCondition();
     }
 }
@@ -1192,10 +1226,6 @@ mint_info_container const & CLelantusState::Containers::GetMints() const {
     return mintedPubCoins;
 }
 
-std::unordered_map<uint256, lelantus::PublicCoin>&  CLelantusState::Containers::GetTagToPublicCoin() {
-    return tagToPublicCoin;
-}
-
 std::unordered_map<Scalar, int> const & CLelantusState::Containers::GetSpends() const {
     return usedCoinSerials;
 }
@@ -1204,12 +1234,144 @@ bool CLelantusState::Containers::IsSurgeCondition() const {
     return surgeCondition;
 }
 
+void CLelantusState::Containers::Freeze() {
+    if (fFrozen)
+        return;
+
+    auto sets = std::make_shared<CFrozenSets>();
+
+    std::vector<frozen_mint_container::Entry> mints;
+    std::vector<frozen_mint_hash_container::Entry> mintHashes;
+    mints.reserve(mintedPubCoins.size());
+    mintHashes.reserve(mintedPubCoins.size());
+    for (auto const & mint : mintedPubCoins) {
+        mints.emplace_back(frozen_mint_container::MakeKey(mint.first.getValue()), mint.second);
+        mintHashes.emplace_back(MakeHashKey(mint.first.getValueHash()), mints.back().first);
+    }
+    sets->mints.Build(std::move(mints));
+    sets->mintHashes.Build(std::move(mintHashes));
+    mint_info_container().swap(mintedPubCoins);
+
+    std::vector<frozen_spend_container::Entry> spends;
+    spends.reserve(usedCoinSerials.size());
+    for (auto const & spend : usedCoinSerials)
+        spends.emplace_back(frozen_spend_container::MakeKey(spend.first), spend.second);
+    sets->spends.Build(std::move(spends));
+    std::unordered_map<Scalar, int>().swap(usedCoinSerials);
+
+    std::vector<frozen_tag_container::Entry> tags;
+    tags.reserve(tagToPublicCoin.size());
+    for (auto const & tag : tagToPublicCoin) {
+        frozen_tag_container::Key key;
+        std::copy(tag.first.begin(), tag.first.end(), key.begin());
+        tags.emplace_back(key, frozen_mint_container::MakeKey(tag.second.getValue()));
+    }
+    sets->tags.Build(std::move(tags));
+    std::unordered_map<uint256, lelantus::PublicCoin>().swap(tagToPublicCoin);
+
+    frozen = std::move(sets);
+    liveMints = live_mint_map();
+    liveSpends = live_spend_map();
+    liveTags = live_tag_map();
+    fFrozen = true;
+}
+
+void CLelantusState::Containers::Thaw() {
+    if (!fFrozen)
+        return;
+
+    for (auto const & mint : frozen->mints) {
+        GroupElement value;
+        value.deserialize(mint.first.data());
+        mintedPubCoins.insert(std::make_pair(lelantus::PublicCoin(value), mint.second));
+        liveMints = liveMints.set(mint.first, mint.second);
+    }
+
+    for (auto const & spend : frozen->spends) {
+        Scalar serial;
+        serial.deserialize(spend.first.data());
+        usedCoinSerials[serial] = spend.second;
+        liveSpends = liveSpends.set(spend.first, spend.second);
+    }
+
+    for (auto const & tag : frozen->tags) {
+        GroupElement value;
+        value.deserialize(tag.second.data());
+        tagToPublicCoin.insert(std::make_pair(uint256(std::vector<unsigned char>(tag.first.begin(), tag.first.end())), lelantus::PublicCoin(value)));
+        liveTags = liveTags.set(tag.first, tag.second);
+    }
+
+    // snapshots taken while frozen keep their own reference
+    frozen = std::make_shared<const CFrozenSets>();
+    fFrozen = false;
+}
+
+bool CLelantusState::Containers::IsFrozen() const {
+    return fFrozen;
+}
+
+CMintedCoinInfo const * CLelantusState::Containers::FindMint(lelantus::PublicCoin const & pubCoin) const {
+    auto iter = mintedPubCoins.find(pubCoin);
+    if (iter != mintedPubCoins.end())
+        return &iter->second;
+    return fFrozen ? frozen->mints.Find(pubCoin.getValue()) : nullptr;
+}
+
+bool CLelantusState::Containers::HasSpend(Scalar const & serial) const {
+    return usedCoinSerials.count(serial) != 0 || (fFrozen && frozen->spends.Find(serial) != nullptr);
+}
+
+bool CLelantusState::Containers::FindFrozenMintHash(uint256 const & pubCoinValueHash, GroupElement & pubCoinValue) const {
+    if (!fFrozen)
+        return false;
+    auto value = frozen->mintHashes.Find(MakeHashKey(pubCoinValueHash));
+    if (!value)
+        return false;
+    pubCoinValue.deserialize(value->data());
+    return true;
+}
+
+bool CLelantusState::Containers::FindTag(uint256 const & tag, GroupElement & pubCoinValue) const {
+    auto iter = tagToPublicCoin.find(tag);
+    if (iter != tagToPublicCoin.end()) {
+        pubCoinValue = iter->second.getValue();
+        return true;
+    }
+    if (!fFrozen)
+        return false;
+
+    frozen_tag_container::Key key;
+    std::copy(tag.begin(), tag.end(), key.begin());
+    auto value = frozen->tags.Find(key);
+    if (!value)
+        return false;
+    pubCoinValue.deserialize(value->data());
+    return true;
+}
+
+size_t CLelantusState::Containers::GetMintCount() const {
+    return mintedPubCoins.size() + frozen->mints.size();
+}
+
+frozen_mint_container const & CLelantusState::Containers::GetFrozenMints() const {
+    return frozen->mints;
+}
+
+frozen_spend_container const & CLelantusState::Containers::GetFrozenSpends() const {
+    return frozen->spends;
+}
+
 void CLelantusState::Containers::Reset() {
     mintedPubCoins.clear();
     usedCoinSerials.clear();
     mintMetaInfo.clear();
     spendMetaInfo.clear();
     tagToPublicCoin.clear();
+    frozen = std::make_shared<const CFrozenSets>();
+    fFrozen = false;
+    liveMints = live_mint_map();
+    liveSpends = live_spend_map();
+    liveTags = live_tag_map();
     surgeCondition = false;
 }
 
@@ -1369,9 +1531,26 @@ void CLelantusState::AddBlock(CBlockIndex *index) {
     for (auto const &serial : index->lelantusSpentSerials) {
         AddSpend(serial.first, serial.second);
     }
+    AddSpendsToLog(index);
+}
+
+void CLelantusState::AddSpendsToLog(CBlockIndex *index) {
+    if (index->lelantusSpentSerials.empty())
+        return;
+
+    std::vector<Scalar> serials;
+    serials.reserve(index->lelantusSpentSerials.size());
+    for (auto const &serial : index->lelantusSpentSerials)
+        serials.push_back(serial.first);
+    spendLog.AddBlock(index->nHeight, std::move(serials));
 }
 
 void CLelantusState::RemoveBlock(CBlockIndex *index) {
+    if (containers.IsFrozen() && (!index->lelantusMintedPubCoins.empty() || !index->lelantusSpentSerials.empty())) {
+        LogPrintf("Disconnecting block %d with Lelantus data, unfreezing the Lelantus state\n", index->nHeight);
+        containers.Thaw();
+    }
+
     // roll back coin group updates
     for (auto &coins : index->lelantusMintedPubCoins)
     {
@@ -1440,6 +1619,7 @@ void CLelantusState::RemoveBlock(CBlockIndex *index) {
     for (auto const &serial : index->lelantusSpentSerials) {
         containers.RemoveSpend(serial.first);
     }
+    spendLog.RemoveFrom(index->nHeight);
 }
 
 bool CLelantusState::GetCoinGroupInfo(
@@ -1453,7 +1633,7 @@ bool CLelantusState::GetCoinGroupInfo(
 }
 
 bool CLelantusState::IsUsedCoinSerial(const Scalar &coinSerial) {
-    return containers.GetSpends().count(coinSerial) != 0;
+    return containers.HasSpend(coinSerial);
 }
 
 bool CLelantusState::IsUsedCoinSerialHash(Scalar &coinSerial, const uint256 &coinSerialHash) {
@@ -1463,11 +1643,19 @@ bool CLelantusState::IsUsedCoinSerialHash(Scalar &coinSerial, const uint256 &coi
             return true;
         }
     }
+    for (auto const & spend : containers.GetFrozenSpends()) {
+        Scalar serial;
+        serial.deserialize(spend.first.data());
+        if (primitives::GetSerialHash(serial) == coinSerialHash) {
+            coinSerial = serial;
+            return true;
+        }
+    }
     return false;
 }
 
 bool CLelantusState::HasCoin(const lelantus::PublicCoin& pubCoin) {
-    return containers.GetMints().find(pubCoin) != containers.GetMints().end();
+    return containers.FindMint(pubCoin) != nullptr;
 }
 
 bool CLelantusState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoinValueHash) {
@@ -1478,16 +1666,11 @@ bool CLelantusState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubC
             return true;
         }
     }
-    return false;
+    return containers.FindFrozenMintHash(pubCoinValueHash, pubCoinValue);
 }
 
 bool CLelantusState::HasCoinTag(GroupElement& pubCoinValue, const uint256& pubCoinTag) {
-    auto const& mints = containers.GetTagToPublicCoin();
-    if(mints.count(pubCoinTag) > 0) {
-        pubCoinValue = mints.at(pubCoinTag).getValue();
-        return true;
-    }
-    return false;
+    return containers.FindTag(pubCoinTag, pubCoinValue);
 }
 
 int CLelantusState::GetCoinSetForSpend(
@@ -1498,6 +1681,7 @@ int CLelantusState::GetCoinSetForSpend(
     std::vector<lelantus::PublicCoin>& coins_out,
     std::vector<unsigned char>& setHash_out,
     std::string start_block_hash) {
+    CPerfTimer perfTimer(PerfStat::LELANTUS_COVER_SET);
 
     coins_out.clear();
 
@@ -1681,10 +1865,10 @@ void CLelantusState::GetAnonymitySet(
 
 std::pair<int, int> CLelantusState::GetMintedCoinHeightAndId(
         const lelantus::PublicCoin& pubCoin) {
-    auto coinIt = containers.GetMints().find(pubCoin);
+    CMintedCoinInfo const * coinInfo = containers.FindMint(pubCoin);
 
-    if (coinIt != containers.GetMints().end()) {
-        return std::make_pair(coinIt->second.nHeight, coinIt->second.coinGroupId);
+    if (coinInfo) {
+        return std::make_pair(coinInfo->nHeight, coinInfo->coinGroupId);
     }
     return std::make_pair(-1, -1);
 }
@@ -1739,6 +1923,25 @@ void CLelantusState::Reset() {
     coinGroups.clear();
     latestCoinId = 0;
     containers.Reset();
+    spendLog.Reset();
+    PublishSnapshot(nullptr);
+}
+
+void CLelantusState::FreezeIfClosed(int nHeight) {
+    if (containers.IsFrozen() || nHeight - ZC_FROZEN_SET_DEPTH < ::Params().GetConsensus().nLelantusGracefulPeriod)
+        return;
+
+    Freeze();
+    LogPrintf("Froze the Lelantus state at height %d: %d coins, %d serials\n",
+        nHeight, containers.GetFrozenMints().size(), containers.GetFrozenSpends().size());
+}
+
+void CLelantusState::Freeze() {
+    containers.Freeze();
+}
+
+bool CLelantusState::IsFrozen() const {
+    return containers.IsFrozen();
 }
 
 CLelantusState* CLelantusState::GetState() {
@@ -1761,6 +1964,20 @@ std::unordered_map<Scalar, int> const & CLelantusState::GetSpends() const {
     return containers.GetSpends();
 }
 
+std::unordered_map<Scalar, int> CLelantusState::GetAllSpends() const {
+    std::unordered_map<Scalar, int> spends = containers.GetSpends();
+    for (auto const & spend : containers.GetFrozenSpends()) {
+        Scalar serial;
+        serial.deserialize(spend.first.data());
+        spends[serial] = spend.second;
+    }
+    return spends;
+}
+
+CSpendLog<Scalar> const & CLelantusState::GetSpendLog() const {
+    return spendLog;
+}
+
 std::unordered_map<int, CLelantusState::LelantusCoinGroupInfo> const & CLelantusState::GetCoinGroups() const {
     return coinGroups;
 }
@@ -1770,6 +1987,26 @@ std::unordered_map<Scalar, uint256, sigma::CScalarHash> const & CLelantusState::
     return mempool.lelantusState.GetMempoolCoinSerials();
 }
 
+void CLelantusState::PublishSnapshot(const CBlockIndex *tip) {
+    auto newSnapshot = std::make_shared<CLelantusStateSnapshot>();
+    if (tip) {
+        newSnapshot->nHeight = tip->nHeight;
+        newSnapshot->blockHash = tip->GetBlockHash();
+    }
+    newSnapshot->latestCoinId = latestCoinId;
+    newSnapshot->coinGroups = coinGroups;
+    newSnapshot->mints = containers.GetLiveMints();
+    newSnapshot->spends = containers.GetLiveSpends();
+    newSnapshot->tags = containers.GetLiveTags();
+    newSnapshot->frozen = containers.GetFrozenSets();
+
+    std::atomic_store(&snapshot, std::shared_ptr<const CLelantusStateSnapshot>(std::move(newSnapshot)));
+}
+
+std::shared_ptr<const CLelantusStateSnapshot> CLelantusState::GetSnapshot() const {
+    return std::atomic_load(&snapshot);
+}
+
 // private
 size_t CLelantusState::CountLastNCoins(int groupId, size_t required, CBlockIndex* &first) {
     first = nullptr;
@@ -1795,6 +2032,50 @@ size_t CLelantusState::CountLastNCoins(int groupId, size_t required, CBlockIndex
     return coins;
 }
 
+// CLelantusStateSnapshot
+
+const CMintedCoinInfo* CLelantusStateSnapshot::FindMint(const lelantus::PublicCoin& pubCoin) const {
+    frozen_mint_container::Key key = frozen_mint_container::MakeKey(pubCoin.getValue());
+    const CMintedCoinInfo* coinInfo = mints.find(key);
+    return coinInfo ? coinInfo : frozen->mints.Find(key);
+}
+
+bool CLelantusStateSnapshot::IsUsedCoinSerial(const Scalar& coinSerial) const {
+    frozen_spend_container::Key key = frozen_spend_container::MakeKey(coinSerial);
+    return spends.count(key) != 0 || frozen->spends.Find(key) != nullptr;
+}
+
+bool CLelantusStateSnapshot::HasCoin(const lelantus::PublicCoin& pubCoin) const {
+    return FindMint(pubCoin) != nullptr;
+}
+
+bool CLelantusStateSnapshot::HasCoinTag(GroupElement& pubCoinValue, const uint256& pubCoinTag) const {
+    frozen_tag_container::Key key;
+    std::copy(pubCoinTag.begin(), pubCoinTag.end(), key.begin());
+    const frozen_mint_container::Key* value = tags.find(key);
+    if (!value)
+        value = frozen->tags.Find(key);
+    if (!value)
+        return false;
+    pubCoinValue.deserialize(value->data());
+    return true;
+}
+
+std::pair<int, int> CLelantusStateSnapshot::GetMintedCoinHeightAndId(const lelantus::PublicCoin& pubCoin) const {
+    const CMintedCoinInfo* coinInfo = FindMint(pubCoin);
+    if (coinInfo)
+        return std::make_pair(coinInfo->nHeight, coinInfo->coinGroupId);
+    return std::make_pair(-1, -1);
+}
+
+bool CLelantusStateSnapshot::GetCoinGroupInfo(int group_id, CLelantusState::LelantusCoinGroupInfo& result) const {
+    auto it = coinGroups.find(group_id);
+    if (it == coinGroups.end())
+        return false;
+    result = it->second;
+    return true;
+}
+
 // CLelantusMempoolState
 
 bool CLelantusMempoolState::HasCoinSerial(const Scalar& coinSerial) {
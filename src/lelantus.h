@@ -12,7 +12,9 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
+#include <memory>
 #include "coin_containers.h"
+#include "spendlog.h"
 
 namespace lelantus_mintspend { class lelantus_mintspend_test; }
 
@@ -135,6 +137,8 @@ public:
     void Reset();
 };
 
+class CLelantusStateSnapshot;
+
 /*
  * State of minted/spent coins as extracted from the index
  */
@@ -169,6 +173,9 @@ public:
     // Disconnect block from the chain rolling back mints and spends
     void RemoveBlock(CBlockIndex *index);
 
+    // Append serials spent in the block to the height ordered spend log
+    void AddSpendsToLog(CBlockIndex *index);
+
     // Query coin group with given id
     bool GetCoinGroupInfo(int group_id, LelantusCoinGroupInfo &result);
 
@@ -217,6 +224,13 @@ public:
     // Reset to initial values
     void Reset();
 
+    // Once the Lelantus graceful period has been over for ZC_FROZEN_SET_DEPTH blocks at nHeight,
+    // move its coins, serials and mint tags into compact sorted arrays. Disconnecting a block
+    // with Lelantus data moves them back.
+    void FreezeIfClosed(int nHeight);
+    void Freeze();
+    bool IsFrozen() const;
+
     // Check if there is a conflicting tx in the blockchain or mempool
     bool CanAddSpendToMempool(const Scalar& coinSerial);
 
@@ -239,15 +253,24 @@ public:
 
     int GetLatestCoinID() const;
 
+    // Coins and serials that are not frozen
     mint_info_container const & GetMints() const;
     std::unordered_map<Scalar, int> const & GetSpends() const;
+    // All used serials, frozen or not
+    std::unordered_map<Scalar, int> GetAllSpends() const;
+    CSpendLog<Scalar> const & GetSpendLog() const;
     std::unordered_map<int, LelantusCoinGroupInfo> const & GetCoinGroups() const ;
     std::unordered_map<Scalar, uint256, sigma::CScalarHash> const & GetMempoolCoinSerials() const;
 
-    std::size_t GetTotalCoins() const { return GetMints().size(); }
+    std::size_t GetTotalCoins() const { return containers.GetMintCount(); }
 
     bool IsSurgeConditionDetected() const;
 
+    // Make the state as of block tip visible to GetSnapshot(), called whenever a block is connected or disconnected
+    void PublishSnapshot(const CBlockIndex *tip);
+    // The last published state, it can be used without cs_main
+    std::shared_ptr<const CLelantusStateSnapshot> GetSnapshot() const;
+
 private:
     size_t CountLastNCoins(int groupId, size_t required, CBlockIndex* &first);
 
@@ -264,6 +287,9 @@ private:
 
     std::atomic<bool> surgeCondition;
 
+    // Used serials in the order they were spent on the active chain
+    CSpendLog<Scalar> spendLog;
+
     struct Containers {
         Containers(std::atomic<bool> & surgeCondition);
 
@@ -278,10 +304,30 @@ private:
 
         void Reset();
 
+        // Move all mints, spends and tags into the frozen sets and back
+        void Freeze();
+        void Thaw();
+        bool IsFrozen() const;
+
+        // Look up mints, spends and tags whether they are frozen or not
+        CMintedCoinInfo const * FindMint(lelantus::PublicCoin const & pubCoin) const;
+        bool HasSpend(Scalar const & serial) const;
+        // Only the frozen mints, the live ones are searched by the caller
+        bool FindFrozenMintHash(uint256 const & pubCoinValueHash, GroupElement & pubCoinValue) const;
+        bool FindTag(uint256 const & tag, GroupElement & pubCoinValue) const;
+        size_t GetMintCount() const;
+
         mint_info_container const & GetMints() const;
         std::unordered_map<Scalar, int> const & GetSpends() const;
-        std::unordered_map<uint256, lelantus::PublicCoin>& GetTagToPublicCoin();
+        frozen_mint_container const & GetFrozenMints() const;
+        frozen_spend_container const & GetFrozenSpends() const;
         bool IsSurgeCondition() const;
+
+        // The same as persistent maps and a shared pointer, for snapshots
+        live_mint_map const & GetLiveMints() const { return liveMints; }
+        live_spend_map const & GetLiveSpends() const { return liveSpends; }
+        live_tag_map const & GetLiveTags() const { return liveTags; }
+        std::shared_ptr<const CFrozenSets> const & GetFrozenSets() const { return frozen; }
     private:
         // Set of all minted pubCoin values, keyed by the public coin.
         // Used for checking if the given coin already exists.
@@ -292,6 +338,15 @@ private:
         //this map keeps hash(G^s*H0^r|seedId) to G^s*H0^r*H1^v
         std::unordered_map<uint256, lelantus::PublicCoin> tagToPublicCoin;
 
+        // The same once the graceful period is over, keyed by the serialized coin value / serial / tag
+        std::shared_ptr<const CFrozenSets> frozen;
+        bool fFrozen;
+
+        // Mints, spends and tags that are not frozen once more, keyed like the frozen sets
+        live_mint_map liveMints;
+        live_spend_map liveSpends;
+        live_tag_map liveTags;
+
         std::atomic<bool> & surgeCondition;
 
         typedef std::map<int, size_t> metainfo_container_t;
@@ -304,9 +359,47 @@ private:
 
     Containers containers;
 
+    // Set with std::atomic_store and read with std::atomic_load
+    std::shared_ptr<const CLelantusStateSnapshot> snapshot;
+
     friend class lelantus_mintspend::lelantus_mintspend_test;
 };
 
+/*
+ * The Lelantus state as of one block of the active chain. It never changes once published and
+ * shares its maps with the state, so it is published at every block connect and disconnect and
+ * readers can query it without cs_main.
+ */
+class CLelantusStateSnapshot {
+public:
+    // Height and hash of the block the snapshot was taken at, -1 and zero before the first one
+    int GetHeight() const { return nHeight; }
+    const uint256& GetBlockHash() const { return blockHash; }
+
+    bool IsUsedCoinSerial(const Scalar& coinSerial) const;
+    bool HasCoin(const lelantus::PublicCoin& pubCoin) const;
+    bool HasCoinTag(GroupElement& pubCoinValue, const uint256& pubCoinTag) const;
+    // Return height of mint transaction and id of minted coin
+    std::pair<int, int> GetMintedCoinHeightAndId(const lelantus::PublicCoin& pubCoin) const;
+    bool GetCoinGroupInfo(int group_id, CLelantusState::LelantusCoinGroupInfo& result) const;
+    int GetLatestCoinID() const { return latestCoinId; }
+
+private:
+    friend class CLelantusState;
+
+    int nHeight = -1;
+    uint256 blockHash;
+    int latestCoinId = 0;
+    std::unordered_map<int, CLelantusState::LelantusCoinGroupInfo> coinGroups;
+
+    live_mint_map mints;
+    live_spend_map spends;
+    live_tag_map tags;
+    std::shared_ptr<const CFrozenSets> frozen;
+
+    const CMintedCoinInfo* FindMint(const lelantus::PublicCoin& pubCoin) const;
+};
+
 } // end of namespace lelantus
 
 #endif // _MAIN_LELANTUS_H__
@@ -2,95 +2,100 @@
 
 namespace spark {
 
+// For our application, we can safely use a zero nonce since keys are never reused
+static const unsigned char ZERO_IV[AEAD_IV_SIZE] = {};
+
 // Perform authenticated encryption with ChaCha20-Poly1305 using key commitment
 // NOTE: This uses a fixed zero nonce, which is safe when used in Spark as directed
 // It is NOT safe in general to do this!
-AEADEncryptedData AEAD::encrypt(const GroupElement& prekey, const std::string additional_data, CDataStream& data) {
+AEADEncryptedData AEAD::encrypt(const GroupElement& prekey, const std::string& additional_data, CDataStream& data) {
 	// Set up the result structure
 	AEADEncryptedData result;
+	result.ciphertext.resize(data.size());
+	result.tag.resize(AEAD_TAG_SIZE);
+	result.key_commitment.resize(AEAD_COMMIT_SIZE);
+
+	encrypt(prekey, additional_data, reinterpret_cast<unsigned char *>(data.data()), data.size(), result.ciphertext.data(), result.tag.data(), result.key_commitment.data());
 
+	return result;
+}
+
+void AEAD::encrypt(const GroupElement& prekey, const std::string& additional_data, const unsigned char* plaintext, std::size_t size, unsigned char* ciphertext, unsigned char* tag, unsigned char* key_commitment) {
 	// Derive the key and commitment
-	std::vector<unsigned char> key = SparkUtils::kdf_aead(prekey);
-	result.key_commitment = SparkUtils::commit_aead(prekey);
+	unsigned char prekey_bytes[GroupElement::serialize_size];
+	prekey.serialize(prekey_bytes);
+	unsigned char key[AEAD_KEY_SIZE];
+	SparkUtils::kdf_aead(prekey_bytes, key);
+	SparkUtils::commit_aead(prekey_bytes, key_commitment);
 
 	// Internal size tracker; we know the size of the data already, and can ignore
 	int TEMP;
 
-	// For our application, we can safely use a zero nonce since keys are never reused
-	std::vector<unsigned char> iv;
-	iv.resize(AEAD_IV_SIZE);
-
 	// Set up the cipher
-	EVP_CIPHER_CTX* ctx;
-	ctx = EVP_CIPHER_CTX_new();
-	EVP_EncryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key.data(), iv.data());
+	PooledCipherContext ctx;
+	EVP_EncryptInit_ex(ctx.get(), EVP_chacha20_poly1305(), NULL, key, ZERO_IV);
 
 	// Include the associated data
-	std::vector<unsigned char> additional_data_bytes(additional_data.begin(), additional_data.end());
-	EVP_EncryptUpdate(ctx, NULL, &TEMP, additional_data_bytes.data(), additional_data_bytes.size());
+	EVP_EncryptUpdate(ctx.get(), NULL, &TEMP, reinterpret_cast<const unsigned char *>(additional_data.data()), additional_data.size());
 
 	// Encrypt the plaintext
-	result.ciphertext.resize(data.size());
-	EVP_EncryptUpdate(ctx, result.ciphertext.data(), &TEMP, reinterpret_cast<unsigned char *>(data.data()), data.size());
-	EVP_EncryptFinal_ex(ctx, NULL, &TEMP);
+	EVP_EncryptUpdate(ctx.get(), ciphertext, &TEMP, plaintext, size);
+	EVP_EncryptFinal_ex(ctx.get(), NULL, &TEMP);
 
 	// Get the tag
-	result.tag.resize(AEAD_TAG_SIZE);
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, AEAD_TAG_SIZE, result.tag.data());
-
-	// Clean up
-	EVP_CIPHER_CTX_free(ctx);
-
-	return result;
+	EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_AEAD_GET_TAG, AEAD_TAG_SIZE, tag);
 }
 
 // Perform authenticated decryption with ChaCha20-Poly1305 using key commitment
 // NOTE: This uses a fixed zero nonce, which is safe when used in Spark as directed
 // It is NOT safe in general to do this!
-CDataStream AEAD::decrypt_and_verify(const GroupElement& prekey, const std::string additional_data, AEADEncryptedData& data) {
+CDataStream AEAD::decrypt_and_verify(const GroupElement& prekey, const std::string& additional_data, const AEADEncryptedData& data) {
+	// Set up the result
+	CDataStream result(SER_NETWORK, PROTOCOL_VERSION);
+	result.resize(data.ciphertext.size());
+
+	decrypt_and_verify(prekey, additional_data, data, reinterpret_cast<unsigned char *>(result.data()));
+
+	return result;
+}
+
+void AEAD::decrypt_and_verify(const GroupElement& prekey, const std::string& additional_data, const AEADEncryptedData& data, unsigned char* plaintext) {
 	// Assert that the key commitment is valid
-	std::vector<unsigned char> key_commitment = SparkUtils::commit_aead(prekey);
-	if (key_commitment != data.key_commitment) {
+	unsigned char prekey_bytes[GroupElement::serialize_size];
+	prekey.serialize(prekey_bytes);
+	unsigned char key_commitment[AEAD_COMMIT_SIZE];
+	SparkUtils::commit_aead(prekey_bytes, key_commitment);
+	if (data.key_commitment.size() != AEAD_COMMIT_SIZE || memcmp(key_commitment, data.key_commitment.data(), AEAD_COMMIT_SIZE) != 0) {
 		throw std::runtime_error("Bad AEAD key commitment");
 	}
+	if (data.tag.size() != AEAD_TAG_SIZE) {
+		throw std::runtime_error("Bad AEAD tag size");
+	}
 
 	// Derive the key
-	std::vector<unsigned char> key = SparkUtils::kdf_aead(prekey);
-
-	// Set up the result
-	CDataStream result(SER_NETWORK, PROTOCOL_VERSION);
+	unsigned char key[AEAD_KEY_SIZE];
+	SparkUtils::kdf_aead(prekey_bytes, key);
 
 	// Internal size tracker; we know the size of the data already, and can ignore
 	int TEMP;
 
-	// For our application, we can safely use a zero nonce since keys are never reused
-	std::vector<unsigned char> iv;
-	iv.resize(AEAD_IV_SIZE);
-
 	// Set up the cipher
-	EVP_CIPHER_CTX* ctx;
-	ctx = EVP_CIPHER_CTX_new();
-	EVP_DecryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key.data(), iv.data());
+	PooledCipherContext ctx;
+	EVP_DecryptInit_ex(ctx.get(), EVP_chacha20_poly1305(), NULL, key, ZERO_IV);
 
 	// Include the associated data
-	std::vector<unsigned char> additional_data_bytes(additional_data.begin(), additional_data.end());
-	EVP_DecryptUpdate(ctx, NULL, &TEMP, additional_data_bytes.data(), additional_data_bytes.size());
+	EVP_DecryptUpdate(ctx.get(), NULL, &TEMP, reinterpret_cast<const unsigned char *>(additional_data.data()), additional_data.size());
 
 	// Decrypt the ciphertext
-	result.resize(data.ciphertext.size());
-	EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char *>(result.data()), &TEMP, data.ciphertext.data(), data.ciphertext.size());
+	EVP_DecryptUpdate(ctx.get(), plaintext, &TEMP, data.ciphertext.data(), data.ciphertext.size());
 	
 	// Set the expected tag
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, AEAD_TAG_SIZE, data.tag.data());
+	EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_AEAD_SET_TAG, AEAD_TAG_SIZE, const_cast<unsigned char *>(data.tag.data()));
 
-	// Decrypt and clean up
-	int ret = EVP_DecryptFinal_ex(ctx, NULL, &TEMP);
-	EVP_CIPHER_CTX_free(ctx);
-	if (ret != 1) {
+	// Decrypt
+	if (EVP_DecryptFinal_ex(ctx.get(), NULL, &TEMP) != 1) {
 		throw std::runtime_error("Bad AEAD authentication");
 	}
-
-	return result;
 }
 
 }
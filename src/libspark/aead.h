@@ -2,6 +2,7 @@
 #define PRIVORA_SPARK_AEAD_H
 #include <openssl/evp.h>
 #include "util.h"
+#include "evp_pool.h"
 
 namespace spark {
 
@@ -34,8 +35,13 @@ struct AEADEncryptedData {
 
 class AEAD {
 public:
-	static AEADEncryptedData encrypt(const GroupElement& prekey, const std::string additional_data, CDataStream& data);
-	static CDataStream decrypt_and_verify(const GroupElement& prekey, const std::string associated_data, AEADEncryptedData& data);
+	static AEADEncryptedData encrypt(const GroupElement& prekey, const std::string& additional_data, CDataStream& data);
+	static CDataStream decrypt_and_verify(const GroupElement& prekey, const std::string& associated_data, const AEADEncryptedData& data);
+
+	// Encrypt size bytes of plaintext into caller buffers of size, AEAD_TAG_SIZE and AEAD_COMMIT_SIZE bytes
+	static void encrypt(const GroupElement& prekey, const std::string& additional_data, const unsigned char* plaintext, std::size_t size, unsigned char* ciphertext, unsigned char* tag, unsigned char* key_commitment);
+	// Decrypt into a caller buffer of data.ciphertext.size() bytes
+	static void decrypt_and_verify(const GroupElement& prekey, const std::string& associated_data, const AEADEncryptedData& data, unsigned char* plaintext);
 };
 
 }
@@ -0,0 +1,64 @@
+#include "evp_pool.h"
+
+#include <new>
+#include <vector>
+
+namespace spark {
+
+namespace {
+
+// Contexts kept per thread, more than are ever in use at the same time
+const std::size_t MAX_POOLED_CONTEXTS = 16;
+
+template <typename T, T* (*New)(), void (*Free)(T*)>
+class ContextPool {
+public:
+    ~ContextPool() {
+        for (T* ctx : contexts)
+            Free(ctx);
+    }
+
+    T* take() {
+        if (contexts.empty()) {
+            T* ctx = New();
+            if (ctx == nullptr)
+                throw std::bad_alloc();
+            return ctx;
+        }
+        T* ctx = contexts.back();
+        contexts.pop_back();
+        return ctx;
+    }
+
+    void give(T* ctx) {
+        if (contexts.size() >= MAX_POOLED_CONTEXTS) {
+            Free(ctx);
+            return;
+        }
+        contexts.push_back(ctx);
+    }
+
+private:
+    std::vector<T*> contexts;
+};
+
+thread_local ContextPool<EVP_MD_CTX, EVP_MD_CTX_new, EVP_MD_CTX_free> md_contexts;
+thread_local ContextPool<EVP_CIPHER_CTX, EVP_CIPHER_CTX_new, EVP_CIPHER_CTX_free> cipher_contexts;
+
+}
+
+PooledMDContext::PooledMDContext() : ctx(md_contexts.take()) {}
+
+PooledMDContext::~PooledMDContext() {
+    EVP_MD_CTX_reset(ctx);
+    md_contexts.give(ctx);
+}
+
+PooledCipherContext::PooledCipherContext() : ctx(cipher_contexts.take()) {}
+
+PooledCipherContext::~PooledCipherContext() {
+    EVP_CIPHER_CTX_reset(ctx);
+    cipher_contexts.give(ctx);
+}
+
+}
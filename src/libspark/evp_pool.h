@@ -0,0 +1,40 @@
+#ifndef PRIVORA_SPARK_EVP_POOL_H
+#define PRIVORA_SPARK_EVP_POOL_H
+#include <openssl/evp.h>
+
+namespace spark {
+
+// Spark hashes, derives keys and encrypts with short-lived OpenSSL contexts all the time, and
+// allocating a context costs about as much as using it for the few bytes involved.
+// These handles take a context from a free list of the current thread instead, and give it
+// back, reset, when they go out of scope.
+
+class PooledMDContext {
+public:
+    PooledMDContext();
+    ~PooledMDContext();
+    PooledMDContext(const PooledMDContext&) = delete;
+    PooledMDContext& operator=(const PooledMDContext&) = delete;
+
+    EVP_MD_CTX* get() const { return ctx; }
+
+private:
+    EVP_MD_CTX* ctx;
+};
+
+class PooledCipherContext {
+public:
+    PooledCipherContext();
+    ~PooledCipherContext();
+    PooledCipherContext(const PooledCipherContext&) = delete;
+    PooledCipherContext& operator=(const PooledCipherContext&) = delete;
+
+    EVP_CIPHER_CTX* get() const { return ctx; }
+
+private:
+    EVP_CIPHER_CTX* ctx;
+};
+
+}
+
+#endif
@@ -1,34 +1,32 @@
 #include "hash.h"
+#include "../crypto/common.h"
 
 namespace spark {
 
 using namespace secp_primitives;
 
 // Set up a labeled hash function
-Hash::Hash(const std::string label) {
-	this->ctx = EVP_MD_CTX_new();
-	EVP_DigestInit_ex(this->ctx, EVP_sha512(), NULL);
+Hash::Hash(const std::string& label) {
+	EVP_DigestInit_ex(this->ctx.get(), EVP_sha512(), NULL);
 
 	// Write the protocol and mode information
-	std::vector<unsigned char> protocol(LABEL_PROTOCOL.begin(), LABEL_PROTOCOL.end());
-	EVP_DigestUpdate(this->ctx, protocol.data(), protocol.size());
-	EVP_DigestUpdate(this->ctx, &HASH_MODE_FUNCTION, sizeof(HASH_MODE_FUNCTION));
+	EVP_DigestUpdate(this->ctx.get(), LABEL_PROTOCOL.data(), LABEL_PROTOCOL.size());
+	EVP_DigestUpdate(this->ctx.get(), &HASH_MODE_FUNCTION, sizeof(HASH_MODE_FUNCTION));
 
 	// Include the label with size
 	include_size(label.size());
-	std::vector<unsigned char> label_bytes(label.begin(), label.end());
-	EVP_DigestUpdate(this->ctx, label_bytes.data(), label_bytes.size());
+	EVP_DigestUpdate(this->ctx.get(), label.data(), label.size());
 }
 
-// Clean up
-Hash::~Hash() {
-	EVP_MD_CTX_free(this->ctx);
+// Include serialized data in the hash function
+void Hash::include(CDataStream& data) {
+	include(reinterpret_cast<unsigned char *>(data.data()), data.size());
 }
 
 // Include serialized data in the hash function
-void Hash::include(CDataStream& data) {
-	include_size(data.size());
-	EVP_DigestUpdate(this->ctx, reinterpret_cast<unsigned char *>(data.data()), data.size());
+void Hash::include(const unsigned char* data, std::size_t size) {
+	include_size(size);
+	EVP_DigestUpdate(this->ctx.get(), data, size);
 }
 
 // Finalize the hash function to a byte array
@@ -36,13 +34,17 @@ std::vector<unsigned char> Hash::finalize() {
     // Use the full output size of the hash function
     std::vector<unsigned char> result;
     result.resize(EVP_MD_size(EVP_sha512()));
-
-    unsigned int TEMP;
-    EVP_DigestFinal_ex(this->ctx, result.data(), &TEMP);
+    finalize(result.data());
 
     return result;
 }
 
+// Finalize the hash function to a byte array
+void Hash::finalize(unsigned char* result) {
+    unsigned int TEMP;
+    EVP_DigestFinal_ex(this->ctx.get(), result, &TEMP);
+}
+
 // Finalize the hash function to a scalar
 Scalar Hash::finalize_scalar() {
     // Ensure we can properly populate a scalar
@@ -50,38 +52,26 @@ Scalar Hash::finalize_scalar() {
         throw std::runtime_error("Bad hash size!");
     }
 
-    std::vector<unsigned char> hash;
-    hash.resize(EVP_MD_size(EVP_sha512()));
+    unsigned char hash[EVP_MAX_MD_SIZE];
     unsigned char counter = 0;
 
-    EVP_MD_CTX* state_counter;
-    state_counter = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(state_counter, EVP_sha512(), NULL);
-
-    EVP_MD_CTX* state_finalize;
-    state_finalize = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(state_finalize, EVP_sha512(), NULL);
+    PooledMDContext state_finalize;
 
     while (1) {
         // Prepare temporary state for counter testing
-        EVP_MD_CTX_copy_ex(state_counter, this->ctx);
+        EVP_MD_CTX_copy_ex(state_finalize.get(), this->ctx.get());
 
         // Embed the counter
-        EVP_DigestUpdate(state_counter, &counter, sizeof(counter));
+        EVP_DigestUpdate(state_finalize.get(), &counter, sizeof(counter));
 
-        // Finalize the hash with a temporary state
-        EVP_MD_CTX_copy_ex(state_finalize, state_counter);
+        // Finalize the hash with the temporary state
         unsigned int TEMP; // We already know the digest length!
-        EVP_DigestFinal_ex(state_finalize, hash.data(), &TEMP);
+        EVP_DigestFinal_ex(state_finalize.get(), hash, &TEMP);
 
         // Check for scalar validity
         Scalar candidate;
         try {
-            candidate.deserialize(hash.data());
-
-            EVP_MD_CTX_free(state_counter);
-            EVP_MD_CTX_free(state_finalize);
-
+            candidate.deserialize(hash);
             return candidate;
         } catch (const std::exception &) {
             counter++;
@@ -99,36 +89,28 @@ GroupElement Hash::finalize_group() {
         throw std::runtime_error("Bad hash size!");
     }
 
-    std::vector<unsigned char> hash;
-    hash.resize(EVP_MD_size(EVP_sha512()));
+    unsigned char hash[EVP_MAX_MD_SIZE];
     unsigned char counter = 0;
 
-    EVP_MD_CTX* state_counter;
-    state_counter = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(state_counter, EVP_sha512(), NULL);
-
-    EVP_MD_CTX* state_finalize;
-    state_finalize = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(state_finalize, EVP_sha512(), NULL);
+    PooledMDContext state_finalize;
 
     while (1) {
         // Prepare temporary state for counter testing
-        EVP_MD_CTX_copy_ex(state_counter, this->ctx);
+        EVP_MD_CTX_copy_ex(state_finalize.get(), this->ctx.get());
 
         // Embed the counter
-        EVP_DigestUpdate(state_counter, &counter, sizeof(counter));
+        EVP_DigestUpdate(state_finalize.get(), &counter, sizeof(counter));
 
-        // Finalize the hash with a temporary state
-        EVP_MD_CTX_copy_ex(state_finalize, state_counter);
+        // Finalize the hash with the temporary state
         unsigned int TEMP; // We already know the digest length!
-        EVP_DigestFinal_ex(state_finalize, hash.data(), &TEMP);
+        EVP_DigestFinal_ex(state_finalize.get(), hash, &TEMP);
 
         // Assemble the serialized input:
 		//	bytes 0..31: x coordinate
 		//	byte 32: even/odd
 		//	byte 33: zero (this point is not infinity)
 		unsigned char candidate_bytes[GROUP_ENCODING];
-		memcpy(candidate_bytes, hash.data(), 33);
+		memcpy(candidate_bytes, hash, 33);
 		memcpy(candidate_bytes + 33, &ZERO, 1);
         GroupElement candidate;
         try {
@@ -140,9 +122,6 @@ GroupElement Hash::finalize_group() {
                 continue;
             }
 
-            EVP_MD_CTX_free(state_counter);
-            EVP_MD_CTX_free(state_finalize);
-
             return candidate;
         } catch (const std::exception &) {
             counter++;
@@ -152,9 +131,10 @@ GroupElement Hash::finalize_group() {
 
 // Include a serialized size in the hash function
 void Hash::include_size(std::size_t size) {
-	CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-	stream << (uint64_t)size;
-	EVP_DigestUpdate(this->ctx, reinterpret_cast<unsigned char *>(stream.data()), stream.size());
+	// as serialized by a CDataStream
+	unsigned char bytes[sizeof(uint64_t)];
+	WriteLE64(bytes, size);
+	EVP_DigestUpdate(this->ctx.get(), bytes, sizeof(bytes));
 }
 
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #ifndef PRIVORA_SPARK_HASH_H
 #define PRIVORA_SPARK_HASH_H
 #include <openssl/evp.h>
+#include "evp_pool.h"
 #include "util.h"
 
 namespace spark {
@@ -9,16 +10,18 @@ using namespace secp_primitives;
 
 class Hash {
 public:
-	Hash(const std::string label);
-	~Hash();
+	Hash(const std::string& label);
 	void include(CDataStream& data);
+	void include(const unsigned char* data, std::size_t size);
 	std::vector<unsigned char> finalize();
+	// Write the EVP_MD_size(EVP_sha512()) byte hash to result
+	void finalize(unsigned char* result);
 	Scalar finalize_scalar();
 	GroupElement finalize_group();
 
 private:
 	void include_size(std::size_t size);
-	EVP_MD_CTX* ctx;
+	PooledMDContext ctx;
 };
 
 }
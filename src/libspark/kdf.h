@@ -1,20 +1,23 @@
 #ifndef PRIVORA_SPARK_KDF_H
 #define PRIVORA_SPARK_KDF_H
 #include <openssl/evp.h>
+#include "evp_pool.h"
 #include "util.h"
 
 namespace spark {
 
 class KDF {
 public:
-	KDF(const std::string label, std::size_t derived_key_size);
-	~KDF();
+	KDF(const std::string& label, std::size_t derived_key_size);
 	void include(CDataStream& data);
+	void include(const unsigned char* data, std::size_t size);
 	std::vector<unsigned char> finalize();
+	// Write the derived key, of the size given to the constructor, to result
+	void finalize(unsigned char* result);
 
 private:
 	void include_size(std::size_t size);
-	EVP_MD_CTX* ctx;
+	PooledMDContext ctx;
 	std::size_t derived_key_size;
 };
 
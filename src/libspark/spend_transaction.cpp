@@ -1,7 +1,14 @@
 #include "spend_transaction.h"
+#include "../liblelantus/threadpool.h"
 
 namespace spark {
 
+// Shared by all spends, its threads are kept for a while after the last proof
+static ParallelOpThreadPool<void>& GetGrootleProverPool() {
+	static ParallelOpThreadPool<void> pool(std::max(1u, boost::thread::hardware_concurrency()));
+	return pool;
+}
+
 // Generate a spend transaction that consumes existing coins and generates new ones
 SpendTransaction::SpendTransaction(
         const Params* params) {
@@ -52,6 +59,8 @@ SpendTransaction::SpendTransaction(
 		this->params->get_n_grootle(),
 		this->params->get_m_grootle()
 	);
+	// Cover set commitments, built once for all the inputs that spend from the same set
+	std::unordered_map<uint64_t, std::pair<std::vector<GroupElement>, std::vector<GroupElement>>> cover_set_commitments;
 	for (std::size_t u = 0; u < w; u++) {
 		// Parse out cover set data for this spend
         uint64_t set_id = inputs[u].cover_set_id;
@@ -59,18 +68,20 @@ SpendTransaction::SpendTransaction(
         if (cover_set_data.count(set_id) == 0 || cover_sets.count(set_id) == 0)
             throw std::invalid_argument("Required set is not passed");
 
-        const auto& cover_set = cover_sets.at(set_id);
-        std::size_t set_size = cover_set.size();
-        if (set_size > N)
-            throw std::invalid_argument("Wrong set size");
-
-        std::vector<GroupElement> S, C;
-		S.reserve(set_size);
-		C.reserve(set_size);
-		for (std::size_t i = 0; i < set_size; i++) {
-			S.emplace_back(cover_set[i].S);
-			C.emplace_back(cover_set[i].C);
-		}
+        if (cover_set_commitments.count(set_id) == 0) {
+            const auto& cover_set = cover_sets.at(set_id);
+            std::size_t set_size = cover_set.size();
+            if (set_size > N)
+                throw std::invalid_argument("Wrong set size");
+
+            auto& commitments = cover_set_commitments[set_id];
+            commitments.first.reserve(set_size);
+            commitments.second.reserve(set_size);
+            for (std::size_t i = 0; i < set_size; i++) {
+                commitments.first.emplace_back(cover_set[i].S);
+                commitments.second.emplace_back(cover_set[i].C);
+            }
+        }
 
 		// Serial commitment offset
 		this->S1.emplace_back(
@@ -88,27 +99,47 @@ SpendTransaction::SpendTransaction(
 		// Tags
 		this->T.emplace_back(inputs[u].T);
 
-		// Grootle proof
-		this->grootle_proofs.emplace_back();
-		std::size_t l = inputs[u].index;
-		grootle.prove(
-			l,
-			SparkUtils::hash_ser1(inputs[u].s, full_view_key.get_D()),
-			S,
-			this->S1.back(),
-			SparkUtils::hash_val(inputs[u].k) - SparkUtils::hash_val1(inputs[u].s, full_view_key.get_D()),
-			C,
-			this->C1.back(),
-			this->cover_set_representations[set_id],
-			this->grootle_proofs.back()
-		);
-
 		// Chaum data
 		chaum_x.emplace_back(inputs[u].s);
 		chaum_y.emplace_back(spend_key.get_r());
 		chaum_z.emplace_back(SparkUtils::hash_ser1(inputs[u].s, full_view_key.get_D()).negate());
 	}
 
+	// Grootle proofs, which are independent of each other and make up most of the proving time,
+	// are generated in parallel on the shared prover pool
+	this->grootle_proofs.resize(w);
+	auto prove_input = [&](std::size_t u) {
+		uint64_t set_id = inputs[u].cover_set_id;
+		const auto& commitments = cover_set_commitments.at(set_id);
+		grootle.prove(
+			inputs[u].index,
+			SparkUtils::hash_ser1(inputs[u].s, full_view_key.get_D()),
+			commitments.first,
+			this->S1[u],
+			SparkUtils::hash_val(inputs[u].k) - SparkUtils::hash_val1(inputs[u].s, full_view_key.get_D()),
+			commitments.second,
+			this->C1[u],
+			this->cover_set_representations.at(set_id),
+			this->grootle_proofs[u]
+		);
+	};
+
+	if (w <= 1 || GetGrootleProverPool().GetNumberOfThreads() <= 1) {
+		for (std::size_t u = 0; u < w; u++)
+			prove_input(u);
+	} else {
+		DoNotDisturb dnd;
+		std::vector<boost::future<void>> tasks;
+		tasks.reserve(w);
+		for (std::size_t u = 0; u < w; u++)
+			tasks.emplace_back(GetGrootleProverPool().PostTask([&prove_input, u]() { prove_input(u); }));
+		// the tasks use this transaction, so all of them have to finish before an error is rethrown
+		for (auto& task : tasks)
+			task.wait();
+		for (auto& task : tasks)
+			task.get();
+	}
+
 	// Generate output coins and prepare range proof vectors
 	std::vector<Scalar> range_v;
 	std::vector<Scalar> range_r;
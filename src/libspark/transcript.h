@@ -2,6 +2,7 @@
 #define PRIVORA_SPARK_TRANSCRIPT_H
 #include <openssl/evp.h>
 #include "util.h"
+#include "evp_pool.h"
 
 namespace spark {
 
@@ -11,7 +12,6 @@ class Transcript {
 public:
     Transcript(const std::string);
     Transcript& operator=(const Transcript&);
-    ~Transcript();
     void add(const std::string, const Scalar&);
     void add(const std::string, const std::vector<Scalar>&);
     void add(const std::string, const GroupElement&);
@@ -23,9 +23,10 @@ public:
 private:
     void size(const std::size_t size_);
     void include_flag(const unsigned char);
-    void include_label(const std::string);
+    void include_label(const std::string&);
     void include_data(const std::vector<unsigned char>&);
-    EVP_MD_CTX* ctx;
+    void include_data(const unsigned char* data, std::size_t size);
+    PooledMDContext ctx;
 };
 
 }
@@ -1,4 +1,5 @@
 #include "util.h"
+#include "evp_pool.h"
 
 namespace spark {
 
@@ -71,50 +72,39 @@ GroupElement SparkUtils::hash_generator(const std::string label) {
         throw std::runtime_error("Bad hash size!");
     }
 
-    EVP_MD_CTX* ctx;
-    ctx = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(ctx, EVP_sha512(), NULL);
+    PooledMDContext ctx;
+    EVP_DigestInit_ex(ctx.get(), EVP_sha512(), NULL);
 
     // Write the protocol and mode
-    std::vector<unsigned char> protocol(LABEL_PROTOCOL.begin(), LABEL_PROTOCOL.end());
-    EVP_DigestUpdate(ctx, protocol.data(), protocol.size());
-    EVP_DigestUpdate(ctx, &HASH_MODE_GROUP_GENERATOR, sizeof(HASH_MODE_GROUP_GENERATOR));
+    EVP_DigestUpdate(ctx.get(), LABEL_PROTOCOL.data(), LABEL_PROTOCOL.size());
+    EVP_DigestUpdate(ctx.get(), &HASH_MODE_GROUP_GENERATOR, sizeof(HASH_MODE_GROUP_GENERATOR));
 
     // Write the label
-    std::vector<unsigned char> bytes(label.begin(), label.end());
-    EVP_DigestUpdate(ctx, bytes.data(), bytes.size());
+    EVP_DigestUpdate(ctx.get(), label.data(), label.size());
 
-    std::vector<unsigned char> hash;
-    hash.resize(EVP_MD_size(EVP_sha512()));
+    unsigned char hash[EVP_MAX_MD_SIZE];
     unsigned char counter = 0;
 
-    EVP_MD_CTX* state_counter;
-    state_counter = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(state_counter, EVP_sha512(), NULL);
-
-    EVP_MD_CTX* state_finalize;
-    state_finalize = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(state_finalize, EVP_sha512(), NULL);
+    PooledMDContext state_finalize;
 
     // Finalize the hash
     while (1) {
         // Prepare temporary state for counter testing
-        EVP_MD_CTX_copy_ex(state_counter, ctx);
+        EVP_MD_CTX_copy_ex(state_finalize.get(), ctx.get());
 
         // Embed the counter
-        EVP_DigestUpdate(state_counter, &counter, sizeof(counter));
+        EVP_DigestUpdate(state_finalize.get(), &counter, sizeof(counter));
 
-        // Finalize the hash with a temporary state
-        EVP_MD_CTX_copy_ex(state_finalize, state_counter);
+        // Finalize the hash with the temporary state
         unsigned int TEMP; // We already know the digest length!
-        EVP_DigestFinal_ex(state_finalize, hash.data(), &TEMP);
+        EVP_DigestFinal_ex(state_finalize.get(), hash, &TEMP);
 
         // Assemble the serialized input:
 		//	bytes 0..31: x coordinate
 		//	byte 32: even/odd
 		//	byte 33: zero (this point is not infinity)
 		unsigned char candidate_bytes[GROUP_ENCODING];
-		memcpy(candidate_bytes, hash.data(), 33);
+		memcpy(candidate_bytes, hash, 33);
 		memcpy(candidate_bytes + 33, &ZERO, 1);
         GroupElement candidate;
         try {
@@ -126,10 +116,6 @@ GroupElement SparkUtils::hash_generator(const std::string label) {
                 continue;
             }
 
-            EVP_MD_CTX_free(ctx);
-            EVP_MD_CTX_free(state_counter);
-            EVP_MD_CTX_free(state_finalize);
-
             return candidate;
         } catch (const std::exception &) {
             counter++;
@@ -150,25 +136,39 @@ std::vector<unsigned char> SparkUtils::kdf_diversifier(const Scalar& s1) {
 
 // Derive a ChaCha20 key for AEAD operations
 std::vector<unsigned char> SparkUtils::kdf_aead(const GroupElement& K_der) {
-    KDF kdf(LABEL_KDF_AEAD, AEAD_KEY_SIZE);
+    unsigned char K_der_bytes[GroupElement::serialize_size];
+    K_der.serialize(K_der_bytes);
 
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << K_der;
-    kdf.include(stream);
+    std::vector<unsigned char> key(AEAD_KEY_SIZE);
+    kdf_aead(K_der_bytes, key.data());
 
-    return kdf.finalize();
+    return key;
 }
 
 // Derive a ChaCha20 key commitment for AEAD operations
 std::vector<unsigned char> SparkUtils::commit_aead(const GroupElement& K_der) {
-    // We use a KDF here because of the output size
-    KDF kdf(LABEL_COMMIT_AEAD, AEAD_COMMIT_SIZE);
+    unsigned char K_der_bytes[GroupElement::serialize_size];
+    K_der.serialize(K_der_bytes);
 
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << K_der;
-    kdf.include(stream);
+    std::vector<unsigned char> key_commitment(AEAD_COMMIT_SIZE);
+    commit_aead(K_der_bytes, key_commitment.data());
 
-    return kdf.finalize();
+    return key_commitment;
+}
+
+// Derive a ChaCha20 key for AEAD operations from a serialized K_der
+void SparkUtils::kdf_aead(const unsigned char* K_der, unsigned char* key) {
+    KDF kdf(LABEL_KDF_AEAD, AEAD_KEY_SIZE);
+    kdf.include(K_der, GroupElement::serialize_size);
+    kdf.finalize(key);
+}
+
+// Derive a ChaCha20 key commitment for AEAD operations from a serialized K_der
+void SparkUtils::commit_aead(const unsigned char* K_der, unsigned char* key_commitment) {
+    // We use a KDF here because of the output size
+    KDF kdf(LABEL_COMMIT_AEAD, AEAD_COMMIT_SIZE);
+    kdf.include(K_der, GroupElement::serialize_size);
+    kdf.finalize(key_commitment);
 }
 
 // Hash-to-group function H_div
@@ -186,10 +186,10 @@ GroupElement SparkUtils::hash_div(const std::vector<unsigned char>& d) {
 Scalar SparkUtils::hash_Q2(const Scalar& s1, const Scalar& i) {
     Hash hash(LABEL_HASH_Q2);
 
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << s1;
-    stream << i;
-    hash.include(stream);
+    unsigned char data[2 * SCALAR_ENCODING];
+    s1.serialize(data);
+    i.serialize(data + SCALAR_ENCODING);
+    hash.include(data, sizeof(data));
 
     return hash.finalize_scalar();
 }
@@ -198,9 +198,9 @@ Scalar SparkUtils::hash_Q2(const Scalar& s1, const Scalar& i) {
 Scalar SparkUtils::hash_k(const Scalar& k) {
     Hash hash(LABEL_HASH_K);
 
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << k;
-    hash.include(stream);
+    unsigned char data[SCALAR_ENCODING];
+    k.serialize(data);
+    hash.include(data, sizeof(data));
 
     return hash.finalize_scalar();
 }
@@ -221,9 +221,9 @@ Scalar SparkUtils::hash_ser(const Scalar& k, const std::vector<unsigned char>& s
 Scalar SparkUtils::hash_val(const Scalar& k) {
     Hash hash(LABEL_HASH_VAL);
 
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << k;
-    hash.include(stream);
+    unsigned char data[SCALAR_ENCODING];
+    k.serialize(data);
+    hash.include(data, sizeof(data));
 
     return hash.finalize_scalar();
 }
@@ -232,10 +232,10 @@ Scalar SparkUtils::hash_val(const Scalar& k) {
 Scalar SparkUtils::hash_ser1(const Scalar& s, const GroupElement& D) {
     Hash hash(LABEL_HASH_SER1);
 
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << s;
-    stream << D;
-    hash.include(stream);
+    unsigned char data[SCALAR_ENCODING + GroupElement::serialize_size];
+    s.serialize(data);
+    D.serialize(data + SCALAR_ENCODING);
+    hash.include(data, sizeof(data));
 
     return hash.finalize_scalar();
 }
@@ -244,10 +244,10 @@ Scalar SparkUtils::hash_ser1(const Scalar& s, const GroupElement& D) {
 Scalar SparkUtils::hash_val1(const Scalar& s, const GroupElement& D) {
     Hash hash(LABEL_HASH_VAL1);
 
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << s;
-    stream << D;
-    hash.include(stream);
+    unsigned char data[SCALAR_ENCODING + GroupElement::serialize_size];
+    s.serialize(data);
+    D.serialize(data + SCALAR_ENCODING);
+    hash.include(data, sizeof(data));
 
     return hash.finalize_scalar();
 }
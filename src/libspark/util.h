@@ -93,6 +93,9 @@ public:
     static std::vector<unsigned char> kdf_diversifier(const Scalar& s1);
     static std::vector<unsigned char> kdf_aead(const GroupElement& K_der);
     static std::vector<unsigned char> commit_aead(const GroupElement& K_der);
+    // As above, from K_der already serialized (GroupElement::serialize_size bytes) into a caller buffer
+    static void kdf_aead(const unsigned char* K_der, unsigned char* key);
+    static void commit_aead(const unsigned char* K_der, unsigned char* key_commitment);
 
     // Diversifier encryption/decryption
     static std::vector<unsigned char> diversifier_encrypt(const std::vector<unsigned char>& key, const uint64_t i);
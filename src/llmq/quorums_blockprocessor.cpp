@@ -403,6 +403,24 @@ bool CQuorumBlockProcessor::GetMinedCommitment(Consensus::LLMQType llmqType, con
     return true;
 }
 
+void CQuorumBlockProcessor::ImportMinedCommitment(const CFinalCommitment& qc, const CBlockIndex* pindexMined)
+{
+    AssertLockHeld(cs_main);
+
+    auto quorumIndex = mapBlockIndex.at(qc.quorumHash);
+    evoDb.Write(std::make_pair(DB_MINED_COMMITMENT, std::make_pair(qc.llmqType, qc.quorumHash)), std::make_pair(qc, pindexMined->GetBlockHash()));
+    evoDb.Write(BuildInversedHeightKey((Consensus::LLMQType)qc.llmqType, pindexMined->nHeight), quorumIndex->nHeight);
+
+    LOCK(minableCommitmentsCs);
+    hasMinedCommitmentCache.erase(std::make_pair((Consensus::LLMQType)qc.llmqType, qc.quorumHash));
+}
+
+void CQuorumBlockProcessor::ImportBestBlock(const CBlockIndex* pindex)
+{
+    // the imported commitments don't need the upgrade from the blocks
+    evoDb.Write(DB_BEST_BLOCK_UPGRADE, pindex->GetBlockHash());
+}
+
 std::vector<const CBlockIndex*> CQuorumBlockProcessor::GetMinedCommitmentsUntilBlock(Consensus::LLMQType llmqType, const CBlockIndex* pindex, size_t maxCount)
 {
     auto dbIt = evoDb.GetCurTransaction().NewIteratorUniquePtr();
@@ -54,6 +54,10 @@ public:
     bool GetMinedCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash, CFinalCommitment& ret, uint256& retMinedBlockHash);
 
     std::vector<const CBlockIndex*> GetMinedCommitmentsUntilBlock(Consensus::LLMQType llmqType, const CBlockIndex* pindex, size_t maxCount);
+
+    // Store commitments mined before a state snapshot's base block, which carries no block data
+    void ImportMinedCommitment(const CFinalCommitment& qc, const CBlockIndex* pindexMined);
+    void ImportBestBlock(const CBlockIndex* pindex);
     std::map<Consensus::LLMQType, std::vector<const CBlockIndex*>> GetMinedAndActiveCommitmentsUntilBlock(const CBlockIndex* pindex);
 
 private:
@@ -19,6 +19,7 @@
 #include "wallet/wallet.h"
 #endif
 #include "primitives/mint_spend.h"
+#include "privacytx.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 #include <limits>
@@ -491,20 +492,21 @@ bool CInstantSendManager::CheckCanLock(const CTransaction& tx, bool printDebug,
     }
 
     if (tx.nType == isutils::INSTANTSEND_ADAPTED_TX ) {
+        // the snapshots are read without cs_main
         if (tx.IsLelantusJoinSplit()) {
+            auto lelantusSnapshot = lelantus::CLelantusState::GetState()->GetSnapshot();
             for (CTxIn const & in : tx.vin) {
                 Scalar serial;
                 serial.deserialize(&in.scriptSig.front());
-                LOCK(cs_main);
-                if (lelantus::CLelantusState::GetState()->IsUsedCoinSerial(serial))
+                if (lelantusSnapshot->IsUsedCoinSerial(serial))
                     return false;
             }
         } else if (tx.IsSparkSpend()) {
+            auto sparkSnapshot = spark::CSparkState::GetState()->GetSnapshot();
             for (CTxIn const & in : tx.vin) {
                 GroupElement lTag;
                 lTag.deserialize(&in.scriptSig.front());
-                LOCK(cs_main);
-                if (spark::CSparkState::GetState()->IsUsedLTag(lTag))
+                if (sparkSnapshot->IsUsedLTag(lTag))
                     return false;
             }
         }
@@ -1557,15 +1559,12 @@ CTransaction AdaptJsplitTx(CTransaction const & tx)
     static size_t const jsplitSerialSize = 32;
 
     CTransaction result{tx};
-    std::unique_ptr <lelantus::JoinSplit> jsplit;
-    try {
-        jsplit = lelantus::ParseLelantusJoinSplit(tx);
-    }
-    catch (...) {
+    std::shared_ptr<const CPrivacyTxData> privacyData = GetPrivacyTxData(tx);
+    if (!privacyData->fParsed) {
         return result;
     }
     const_cast<std::vector<CTxIn>*>(&result.vin)->clear();                      //This const_cast was done intentionally as the current design allows for this way only
-    for (Scalar const & serial : jsplit->getCoinSerialNumbers()) {
+    for (Scalar const & serial : privacyData->lelantusSerials) {
         CTxIn newin;
         newin.scriptSig.resize(jsplitSerialSize);
         serial.serialize(&newin.scriptSig.front());
@@ -1583,16 +1582,13 @@ CTransaction AdaptSparkTx(CTransaction const & tx)
     static size_t const lTagSerialSize = 34;
 
     CTransaction result{tx};
-    std::unique_ptr<spark::SpendTransaction> spend;
-    try {
-        spend = std::make_unique<spark::SpendTransaction>(spark::ParseSparkSpend(tx));
-    }
-    catch (...) {
+    std::shared_ptr<const CPrivacyTxData> privacyData = GetPrivacyTxData(tx);
+    if (!privacyData->fParsed) {
         return result;
     }
 
     const_cast<std::vector<CTxIn>*>(&result.vin)->clear();                         //This const_cast was done intentionally as the current design allows for this way only
-    for (GroupElement const & lTag : spend->getUsedLTags()) {
+    for (GroupElement const & lTag : privacyData->sparkLTags) {
             CTxIn newin;
             newin.scriptSig.resize(lTagSerialSize);
             lTag.serialize(&newin.scriptSig.front());
@@ -11,6 +11,7 @@
 #include "init.h"
 #include "net_processing.h"
 #include "netmessagemaker.h"
+#include "perfstats.h"
 #include "validation.h"
 
 #include "cxxtimer.hpp"
@@ -618,7 +619,9 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
     }
 
     cxxtimer::Timer verifyTimer(true);
+    CPerfTimer perfTimer(PerfStat::LLMQ_SIGSHARES_VERIFY);
     batchVerifier.Verify();
+    perfTimer.Stop();
     verifyTimer.stop();
 
     LogPrint("llmq-sigs", "CSigSharesManager::%s -- verified sig shares. count=%d, vt=%d, nodes=%d\n", __func__, verifyCount, verifyTimer.count(), sigSharesByNodes.size());
@@ -650,10 +653,12 @@ void CSigSharesManager::ProcessPendingSigSharesFromNode(NodeId nodeId,
     auto& nodeState = nodeStates[nodeId];
 
     cxxtimer::Timer t(true);
+    CPerfTimer perfTimer(PerfStat::LLMQ_SIGSHARES_PROCESS);
     for (auto& sigShare : sigShares) {
         auto quorumKey = std::make_pair((Consensus::LLMQType)sigShare.llmqType, sigShare.quorumHash);
         ProcessSigShare(nodeId, sigShare, connman, quorums.at(quorumKey));
     }
+    perfTimer.Stop();
     t.stop();
 
     LogPrint("llmq-sigs", "CSigSharesManager::%s -- processed sigShare batch. shares=%d, time=%d, node=%d\n", __func__,
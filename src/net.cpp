@@ -34,6 +34,29 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#define USE_POLL
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
+
+#ifdef WIN32
+// Messages are sent one buffer at a time
+struct iovec
+{
+    void* iov_base;
+    size_t iov_len;
+};
+static const int MAX_SEND_IOVECS = 1;
+#else
+#include <sys/socket.h>
+#include <sys/uio.h>
+// Buffers handed to a single sendmsg(), two per message (header and payload)
+static const int MAX_SEND_IOVECS = 64;
 #endif
 
 #ifdef USE_UPNP
@@ -52,6 +75,13 @@
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
+// How long the socket handler waits for socket events before checking the send queues
+// and timeouts again.
+static const int SELECT_TIMEOUT_MILLISECONDS = 50;
+#ifdef USE_EPOLL
+static const int MAX_EPOLL_EVENTS = 256;
+#endif
+
 #if !defined(HAVE_MSG_NOSIGNAL) && !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -413,7 +443,7 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed))
     {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!CanHandleSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -741,6 +771,17 @@ void CNode::copyStats(CNodeStats &stats)
 }
 #undef X
 
+void CNode::GetPendingSocketEvents(bool& fRecv, bool& fSend)
+{
+    bool fHasSendData;
+    {
+        LOCK(cs_vSend);
+        fHasSendData = !vSendMsg.empty();
+        fSend = fHasSendData && fCanSendData;
+    }
+    fRecv = !fHasSendData && !fPauseRecv && fHasRecvData;
+}
+
 bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete)
 {
     complete = false;
@@ -910,27 +951,67 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert((*it)->size() > pnode->nSendOffset);
+
+        // Gather the unsent parts of as many queued messages as fit into one call
+        struct iovec iov[MAX_SEND_IOVECS];
+        int nIov = 0;
+        size_t nBatchSize = 0;
+        size_t nOffset = pnode->nSendOffset;
+        for (auto itBatch = it; itBatch != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itBatch) {
+            const CSharedNetMsg& msg = **itBatch;
+            if (nOffset < msg.header.size()) {
+                iov[nIov].iov_base = (void*)(msg.header.data() + nOffset);
+                iov[nIov].iov_len = msg.header.size() - nOffset;
+                nBatchSize += iov[nIov++].iov_len;
+                nOffset = 0;
+            } else {
+                nOffset -= msg.header.size();
+            }
+            if (nIov < MAX_SEND_IOVECS && nOffset < msg.data.size()) {
+                iov[nIov].iov_base = (void*)(msg.data.data() + nOffset);
+                iov[nIov].iov_len = msg.data.size() - nOffset;
+                nBatchSize += iov[nIov++].iov_len;
+            }
+            nOffset = 0;
+        }
+
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(iov[0].iov_base), iov[0].iov_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+            nBatchSize = iov[0].iov_len;
+#else
+            struct msghdr msgh;
+            memset(&msgh, 0, sizeof(msgh));
+            msgh.msg_iov = iov;
+            msgh.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msgh, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            size_t nRemaining = nBytes;
+            while (nRemaining > 0) {
+                size_t nMsgLeft = (*it)->size() - pnode->nSendOffset;
+                if (nRemaining < nMsgLeft) {
+                    pnode->nSendOffset += nRemaining;
+                    break;
+                }
+                nRemaining -= nMsgLeft;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+                pnode->nSendSize -= (*it)->size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nBatchSize) {
+                // could not send everything; stop sending more
+                pnode->fCanSendData = false;
                 break;
             }
         } else {
@@ -944,6 +1025,7 @@ size_t CConnman::SocketSendData(CNode *pnode) const
                 }
             }
             // couldn't send anything at all
+            pnode->fCanSendData = false;
             break;
         }
     }
@@ -1227,7 +1309,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (!CanHandleSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1273,6 +1355,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        RegisterSocketEvents(pnode);
         // Dandelion: new inbound connection
         CNode::vDandelionInbound.push_back(pnode);
         CNode* pto = CNode::SelectFromDandelionDestinations();
@@ -1362,6 +1445,361 @@ void CNode::CloseDandelionConnections(const CNode* const pnode)
     }
 }
 
+SocketEventsMode DefaultSocketEventsMode()
+{
+#if defined(USE_EPOLL)
+    return SOCKETEVENTS_EPOLL;
+#elif defined(USE_POLL)
+    return SOCKETEVENTS_POLL;
+#else
+    return SOCKETEVENTS_SELECT;
+#endif
+}
+
+bool SocketEventsModeFromString(const std::string& str, SocketEventsMode& mode)
+{
+    if (str == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_POLL
+    if (str == "poll") {
+        mode = SOCKETEVENTS_POLL;
+        return true;
+    }
+#endif
+#ifdef USE_EPOLL
+    if (str == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string SocketEventsModeToString(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_SELECT:
+        return "select";
+    case SOCKETEVENTS_POLL:
+        return "poll";
+    case SOCKETEVENTS_EPOLL:
+        return "epoll";
+    }
+    return "unknown";
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+    std::string strModes = "select";
+#ifdef USE_POLL
+    strModes += ", poll";
+#endif
+#ifdef USE_EPOLL
+    strModes += ", epoll";
+#endif
+    return strModes;
+}
+
+bool CConnman::CanHandleSocket(SOCKET s) const
+{
+    return socketEventsMode != SOCKETEVENTS_SELECT || IsSelectableSocket(s);
+}
+
+void CConnman::RegisterSocketEvents(CNode* pnode)
+{
+#ifdef USE_EPOLL
+    if (socketEventsMode != SOCKETEVENTS_EPOLL)
+        return;
+
+    // The registration is dropped by the kernel when the socket is closed, which happens
+    // before the node is deleted, so the pointer in the event data never dangles.
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET)
+        return;
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = pnode;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+        LogPrintf("Failed to add socket of peer=%d to epoll set: %s\n", pnode->id, NetworkErrorString(WSAGetLastError()));
+        pnode->fDisconnect = true;
+    }
+#endif
+}
+
+void CConnman::WakeSocketHandler()
+{
+#ifndef WIN32
+    if (wakeupPipe[1] == -1)
+        return;
+    if (fWakeupPending.exchange(true))
+        return;
+    char buf{0};
+    if (write(wakeupPipe[1], &buf, sizeof(buf)) != sizeof(buf))
+        LogPrint("net", "write to wakeup pipe failed\n");
+#endif
+}
+
+void CConnman::DrainWakeupPipe()
+{
+#ifndef WIN32
+    char buf[128];
+    while (read(wakeupPipe[0], buf, sizeof(buf)) > 0) {}
+    // clear the flag only after draining, a wakeup racing with this is covered by the
+    // pass over all nodes that follows
+    fWakeupPending = false;
+#endif
+}
+
+bool CConnman::GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+        recv_set.insert(hListenSocket.socket);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+        {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            error_set.insert(pnode->hSocket);
+            if (select_send) {
+                send_set.insert(pnode->hSocket);
+                continue;
+            }
+            if (select_recv) {
+                recv_set.insert(pnode->hSocket);
+            }
+        }
+    }
+
+#ifndef WIN32
+    if (wakeupPipe[0] != -1)
+        recv_set.insert(wakeupPipe[0]);
+#endif
+
+    return !recv_set.empty() || !send_set.empty() || !error_set.empty();
+}
+
+void CConnman::SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    bool have_fds = GenerateSelectSet(recv_select_set, send_select_set, error_select_set);
+
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = SELECT_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            // let recv() find out which socket is broken
+            recv_set = recv_select_set;
+            recv_set.insert(send_select_set.begin(), send_select_set.end());
+            recv_set.insert(error_select_set.begin(), error_select_set.end());
+        }
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv))
+            recv_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend))
+            send_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+}
+
+void CConnman::SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+#ifdef USE_POLL
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    std::map<SOCKET, struct pollfd> pollfds;
+    for (SOCKET hSocket : recv_select_set) {
+        pollfds[hSocket].fd = hSocket;
+        pollfds[hSocket].events |= POLLIN;
+    }
+    for (SOCKET hSocket : send_select_set) {
+        pollfds[hSocket].fd = hSocket;
+        pollfds[hSocket].events |= POLLOUT;
+    }
+    for (SOCKET hSocket : error_select_set) {
+        // POLLERR and POLLHUP are always reported
+        pollfds[hSocket].fd = hSocket;
+    }
+
+    std::vector<struct pollfd> vPollfds;
+    vPollfds.reserve(pollfds.size());
+    for (const auto& it : pollfds) {
+        vPollfds.push_back(it.second);
+    }
+
+    if (poll(vPollfds.data(), vPollfds.size(), SELECT_TIMEOUT_MILLISECONDS) < 0) {
+        if (errno != EINTR) {
+            LogPrintf("socket poll error %s\n", NetworkErrorString(WSAGetLastError()));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+    if (interruptNet)
+        return;
+
+    for (const struct pollfd& pollfdEntry : vPollfds) {
+        if (pollfdEntry.revents & POLLIN)
+            recv_set.insert(pollfdEntry.fd);
+        if (pollfdEntry.revents & POLLOUT)
+            send_set.insert(pollfdEntry.fd);
+        if (pollfdEntry.revents & (POLLERR | POLLHUP))
+            error_set.insert(pollfdEntry.fd);
+    }
+#endif
+}
+
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set)
+{
+#ifdef USE_EPOLL
+    // A node whose earlier edge is not used up yet (a full read buffer, a send that
+    // completed) raises no new event, so only check for new events without blocking
+    int nTimeout = SELECT_TIMEOUT_MILLISECONDS;
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            bool fRecv, fSend;
+            pnode->GetPendingSocketEvents(fRecv, fSend);
+            if (fRecv || fSend) {
+                nTimeout = 0;
+                break;
+            }
+        }
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epollFd, events, MAX_EPOLL_EVENTS, nTimeout);
+    if (nEvents < 0) {
+        if (errno != EINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(WSAGetLastError()));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        void* ptr = events[i].data.ptr;
+        if (ptr == nullptr) {
+            // the wakeup pipe, level-triggered
+            DrainWakeupPipe();
+            continue;
+        }
+
+        bool fListenSocket = false;
+        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+            if (ptr == &hListenSocket) {
+                // level-triggered, so a connection not accepted now is reported again
+                recv_set.insert(hListenSocket.socket);
+                fListenSocket = true;
+                break;
+            }
+        }
+        if (fListenSocket)
+            continue;
+
+        CNode* pnode = static_cast<CNode*>(ptr);
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+            // recv() reports the closed connection or the error
+            pnode->fHasRecvData = true;
+        }
+        if (events[i].events & EPOLLOUT) {
+            LOCK(pnode->cs_vSend);
+            pnode->fCanSendData = true;
+        }
+    }
+#endif
+}
+
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    switch (socketEventsMode) {
+    case SOCKETEVENTS_EPOLL:
+        SocketEventsEpoll(recv_set);
+        return;
+    case SOCKETEVENTS_POLL:
+        SocketEventsPoll(recv_set, send_set, error_set);
+        break;
+    case SOCKETEVENTS_SELECT:
+        SocketEventsSelect(recv_set, send_set, error_set);
+        break;
+    }
+
+#ifndef WIN32
+    if (wakeupPipe[0] != -1 && recv_set.count(wakeupPipe[0]) > 0) {
+        DrainWakeupPipe();
+        recv_set.erase(wakeupPipe[0]);
+    }
+#endif
+}
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1434,91 +1872,18 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode* pnode, vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0)
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1545,13 +1910,15 @@ void CConnman::ThreadSocketHandler()
             bool recvSet = false;
             bool sendSet = false;
             bool errorSet = false;
-            {
+            if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+                pnode->GetPendingSocketEvents(recvSet, sendSet);
+            } else {
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
             }
             if (recvSet || errorSet)
             {
@@ -1566,6 +1933,9 @@ void CConnman::ThreadSocketHandler()
                                 continue;
                             nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
                         }
+                        // A short read drained the socket, the next data raises a new edge
+                        if (nBytes < (int)sizeof(pchBuf))
+                            pnode->fHasRecvData = false;
                         if (nBytes > 0)
                         {
                             bool notify = false;
@@ -1668,9 +2038,9 @@ void CConnman::WakeMessageHandler()
 {
     {
         std::lock_guard<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = true;
+        nMsgProcWakeCount++;
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
 }
 
 
@@ -2326,6 +2696,7 @@ bool CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        RegisterSocketEvents(pnode);
     }
 
     return true;
@@ -2335,8 +2706,18 @@ bool CConnman::OpenMasternodeConnection(const CAddress &addrConnect) {
     return OpenNetworkConnection(addrConnect, false, NULL, NULL, false, false, false, true);
 }
 
-void CConnman::ThreadMessageHandler()
+// Whether the next thing to do for pnode is a low-latency message, requires pnode->fMsgProcClaimed
+static bool HasLowLatencyMessage(CNode* pnode)
 {
+    if (!pnode->vRecvGetData.empty())
+        return false;
+    LOCK(pnode->cs_vProcessMsg);
+    return !pnode->vProcessMsg.empty() && IsLowLatencyMessageType(pnode->vProcessMsg.front().hdr.GetCommand());
+}
+
+void CConnman::ThreadMessageHandler(bool fLowLatencyOnly, bool fHasLowLatencyLane)
+{
+    uint64_t nLastWakeCount = 0;
     while (!flagInterruptMsgProc)
     {
         std::vector<CNode*> vNodesCopy;
@@ -2349,23 +2730,48 @@ void CConnman::ThreadMessageHandler()
         }
 
         bool fMoreWork = false;
+        bool fWakeOthers = false;
 
         BOOST_FOREACH(CNode* pnode, vNodesCopy)
         {
             if (pnode->fDisconnect)
                 continue;
 
+            // Another thread is busy with this node, it also takes care of the node's remaining work
+            if (pnode->fMsgProcClaimed.exchange(true))
+                continue;
+
+            // With two lanes each message is processed by the lane of its type only
+            bool fProcess = !fHasLowLatencyLane || (fLowLatencyOnly == HasLowLatencyMessage(pnode));
+            if (fLowLatencyOnly && (!fProcess || pnode->fBanCheckPending)) {
+                pnode->fMsgProcClaimed = false;
+                continue;
+            }
+
             // Receive messages
-            bool fMoreNodeWork = GetNodeSignals().ProcessMessages(pnode, *this, flagInterruptMsgProc);
+            bool fMoreNodeWork = false;
+            if (fProcess) {
+                fMoreNodeWork = GetNodeSignals().ProcessMessages(pnode, *this, flagInterruptMsgProc);
+                if (fHasLowLatencyLane && fMoreNodeWork && fLowLatencyOnly != HasLowLatencyMessage(pnode)) {
+                    // Hand the rest over to the other lane
+                    fMoreNodeWork = false;
+                    fWakeOthers = true;
+                }
+                if (fLowLatencyOnly && pnode->fBanCheckPending)
+                    fWakeOthers = true;
+            }
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
-            if (flagInterruptMsgProc)
+            if (flagInterruptMsgProc) {
+                pnode->fMsgProcClaimed = false;
                 return;
+            }
 
             // Send messages
-            {
+            if (!fLowLatencyOnly) {
                 LOCK(pnode->cs_sendProcessing);
                 GetNodeSignals().SendMessages(pnode, *this, flagInterruptMsgProc);
             }
+            pnode->fMsgProcClaimed = false;
             if (flagInterruptMsgProc)
                 return;
         }
@@ -2376,18 +2782,51 @@ void CConnman::ThreadMessageHandler()
                 pnode->Release();
         }
 
+        if (fWakeOthers)
+            WakeMessageHandler();
+
         std::unique_lock<std::mutex> lock(mutexMsgProc);
         if (!fMoreWork) {
-            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this] { return fMsgProcWake; });
+            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this, nLastWakeCount] { return nMsgProcWakeCount != nLastWakeCount; });
         }
-        fMsgProcWake = false;
+        nLastWakeCount = nMsgProcWakeCount;
     }
 }
 
+void CConnman::StartMessageHandlers(int nThreads)
+{
+    assert(threadMessageHandlers.empty());
+    {
+        std::unique_lock<std::mutex> lock(mutexMsgProc);
+        flagInterruptMsgProc = false;
+        nMsgProcWakeCount = 0;
+    }
 
+    nThreads = std::max(1, std::min(nThreads, MAX_MSG_HANDLER_THREADS));
+    bool fHasLowLatencyLane = nThreads > 1;
+    for (int i = 0; i < nThreads; i++) {
+        bool fLowLatencyOnly = fHasLowLatencyLane && i == 0;
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, fLowLatencyOnly ? "msghand-fast" : "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, fLowLatencyOnly, fHasLowLatencyLane)));
+    }
+}
 
+void CConnman::InterruptMessageHandlers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexMsgProc);
+        flagInterruptMsgProc = true;
+    }
+    condMsgProc.notify_all();
+}
 
-
+void CConnman::StopMessageHandlers()
+{
+    for (std::thread& thread : threadMessageHandlers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessageHandlers.clear();
+}
 
 bool CConnman::BindListenPort(const CService &addrBind, std::string& strError, bool fWhitelisted)
 {
@@ -2655,6 +3094,11 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nBestHeight = 0;
     clientInterface = NULL;
     flagInterruptMsgProc = false;
+    nMsgProcWakeCount = 0;
+    socketEventsMode = SOCKETEVENTS_SELECT;
+    epollFd = -1;
+    wakeupPipe[0] = wakeupPipe[1] = -1;
+    fWakeupPending = false;
 }
 
 NodeId CConnman::GetNewNodeId()
@@ -2678,6 +3122,7 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
 
     nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
     nReceiveFloodSize = connOptions.nReceiveFloodSize;
+    socketEventsMode = connOptions.socketEventsMode;
 
     nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
     nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -2735,17 +3180,55 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
         semMasternodeOutbound = new CSemaphore(fMasternodeMode ? MAX_OUTBOUND_MASTERNODE_CONNECTIONS_ON_MN : MAX_OUTBOUND_MASTERNODE_CONNECTIONS);
     }
 
+#ifndef WIN32
+    if (pipe(wakeupPipe) != 0) {
+        wakeupPipe[0] = wakeupPipe[1] = -1;
+        LogPrint("net", "pipe() for socket handler wakeup failed\n");
+    } else {
+        for (int fd : wakeupPipe) {
+            int flags = fcntl(fd, F_GETFL, 0);
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+    }
+#endif
+
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd == -1) {
+            strNodeError = strprintf("Failed to create epoll instance: %s", NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+
+        // Listening sockets and the wakeup pipe are level-triggered, peers are registered
+        // edge-triggered as they connect
+        for (ListenSocket& hListenSocket : vhListenSocket) {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = &hListenSocket;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0) {
+                strNodeError = strprintf("Failed to add listening socket to epoll set: %s", NetworkErrorString(WSAGetLastError()));
+                return false;
+            }
+        }
+        if (wakeupPipe[0] != -1) {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = nullptr;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupPipe[0], &event) != 0) {
+                strNodeError = strprintf("Failed to add wakeup pipe to epoll set: %s", NetworkErrorString(WSAGetLastError()));
+                return false;
+            }
+        }
+    }
+#endif
+    LogPrintf("Using %s for socket events\n", SocketEventsModeToString(socketEventsMode));
+
     //
     // Start threads
     //
     InterruptSocks5(false);
     interruptNet.reset();
-    flagInterruptMsgProc = false;
-
-    {
-        std::unique_lock<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = false;
-    }
 
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
@@ -2766,7 +3249,7 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     threadOpenMasternodeConnections = std::thread(&TraceThread<std::function<void()> >, "mncon", std::function<void()>(std::bind(&CConnman::ThreadOpenMasternodeConnections, this)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    StartMessageHandlers(connOptions.nMessageHandlerThreads);
 
     // Dandelion shuffle
     threadDandelionShuffle = std::thread(TraceThread<std::function<void()> >, "dandelion", std::function<void()>(std::bind(&CConnman::ThreadDandelionShuffle, this)));
@@ -2794,14 +3277,11 @@ instance_of_cnetcleanup;
 
 void CConnman::Interrupt()
 {
-    {
-        std::lock_guard<std::mutex> lock(mutexMsgProc);
-        flagInterruptMsgProc = true;
-    }
-    condMsgProc.notify_all();
+    InterruptMessageHandlers();
 
     interruptNet();
     InterruptSocks5(true);
+    WakeSocketHandler();
 
     if (semOutbound) {
         for (int i=0; i<(nMaxOutbound + nMaxFeeler); i++) {
@@ -2825,8 +3305,7 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    StopMessageHandlers();
     if (threadOpenMasternodeConnections.joinable())
         threadOpenMasternodeConnections.join();
     if (threadOpenConnections.joinable())
@@ -2854,6 +3333,21 @@ void CConnman::Stop()
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
 
+#ifdef USE_EPOLL
+    if (epollFd != -1) {
+        close(epollFd);
+        epollFd = -1;
+    }
+#endif
+#ifndef WIN32
+    for (int& fd : wakeupPipe) {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
+#endif
+
     // clean up some globals (to help leak detection)
     BOOST_FOREACH(CNode *pnode, vNodes) {
         DeleteNode(pnode);
@@ -3353,6 +3847,11 @@ ServiceFlags CConnman::GetLocalServices() const
     return nLocalServices;
 }
 
+void CConnman::RemoveLocalServices(ServiceFlags flags)
+{
+    nLocalServices = ServiceFlags(nLocalServices & ~flags);
+}
+
 void CConnman::SetBestHeight(int height)
 {
     nBestHeight.store(height, std::memory_order_release);
@@ -3435,6 +3934,10 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     fZnode = false;
     fPauseRecv = false;
     fPauseSend = false;
+    fHasRecvData = false;
+    fCanSendData = false;
+    fMsgProcClaimed = false;
+    fBanCheckPending = false;
     nProcessQueueSize = 0;
     pendingMNVerification = nullptr;
 
@@ -3518,38 +4021,55 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOptimisticSend)
+CSharedNetMsg::CSharedNetMsg(const CMessageHeader::MessageStartChars& messageStart, CSerializedNetMsg&& msg)
+    : command(std::move(msg.command)), data(std::move(msg.data)), header([&] {
+        std::vector<unsigned char> serializedHeader;
+        serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
+        uint256 hash = Hash(data.data(), data.data() + data.size());
+        CMessageHeader hdr(messageStart, command.c_str(), data.size());
+        memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+        CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
+        return serializedHeader;
+    }())
 {
-    size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
+}
 
-    std::vector<unsigned char> serializedHeader;
-    serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
-    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
-    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+CSharedNetMsgRef MakeSharedNetMsg(CSerializedNetMsg&& msg)
+{
+    return std::make_shared<const CSharedNetMsg>(Params().MessageStart(), std::move(msg));
+}
 
-    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOptimisticSend)
+{
+    PushMessage(pnode, MakeSharedNetMsg(std::move(msg)), allowOptimisticSend);
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsgRef& msg, bool allowOptimisticSend)
+{
+    size_t nMessageSize = msg->data.size();
+    size_t nTotalSize = msg->size();
+    LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg->command.c_str()), nMessageSize, pnode->id);
 
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
-        bool optimisticSend(allowOptimisticSend && pnode->vSendMsg.empty());
+        bool fQueueWasEmpty = pnode->vSendMsg.empty();
+        bool optimisticSend(allowOptimisticSend && fQueueWasEmpty);
 
         //log total amount of bytes per command
-        pnode->mapSendBytesPerMsgCmd[msg.command] += nTotalSize;
+        pnode->mapSendBytesPerMsgCmd[msg->command] += nTotalSize;
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.push_back(msg);
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
             nBytesSent = SocketSendData(pnode);
+        // Otherwise let the socket handler send it right away instead of on its next timeout
+        else if (fQueueWasEmpty)
+            WakeSocketHandler();
     }
     if (nBytesSent)
         RecordBytesSent(nBytesSent);
@@ -26,6 +26,7 @@
 
 #include <atomic>
 #include <deque>
+#include <set>
 #include <stdint.h>
 #include <thread>
 #include <memory>
@@ -109,11 +110,30 @@ static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
 static const bool DEFAULT_BLOCKSONLY = false;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
+/** Number of message handler threads, with two one of them is reserved for low-latency messages */
+static const int DEFAULT_MSG_HANDLER_THREADS = 2;
+/** Message handlers (LLMQ, InstantSend, validation) expect one thread per kind of message, so there is at most one per lane */
+static const int MAX_MSG_HANDLER_THREADS = 2;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
+/** How the socket handler thread waits for socket events */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_POLL = 1,
+    SOCKETEVENTS_EPOLL = 2,
+};
+
+/** The most scalable mode supported by this build */
+SocketEventsMode DefaultSocketEventsMode();
+/** Parse a -socketevents value, fails for modes not supported by this build */
+bool SocketEventsModeFromString(const std::string& str, SocketEventsMode& mode);
+std::string SocketEventsModeToString(SocketEventsMode mode);
+/** Comma separated list of the modes supported by this build */
+std::string GetSupportedSocketEventsModes();
+
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 unsigned int ReceiveFloodSize();
@@ -146,6 +166,27 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/**
+ * A message as it goes on the wire: the header with its checksum and the payload,
+ * serialized and hashed once. It is immutable, so one instance can be queued to any
+ * number of peers, e.g. a block or transaction relayed to all of them.
+ */
+class CSharedNetMsg
+{
+public:
+    const std::string command;
+    const std::vector<unsigned char> data;
+    const std::vector<unsigned char> header;
+
+    CSharedNetMsg(const CMessageHeader::MessageStartChars& messageStart, CSerializedNetMsg&& msg);
+
+    size_t size() const { return header.size() + data.size(); }
+};
+typedef std::shared_ptr<const CSharedNetMsg> CSharedNetMsgRef;
+
+/** Wrap msg into a CSharedNetMsg for the current network */
+CSharedNetMsgRef MakeSharedNetMsg(CSerializedNetMsg&& msg);
+
 
 class CConnman
 {
@@ -172,14 +213,29 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
+        int nMessageHandlerThreads = 1;
     };
     CConnman(uint64_t seed0, uint64_t seed1);
     ~CConnman();
     bool Start(CScheduler& scheduler, std::string& strNodeError, Options options);
     void Stop();
     void Interrupt();
+
+    /**
+     * Run ProcessMessages/SendMessages on nThreads (1 or 2) threads. Each peer is handled by
+     * one thread at a time, so its messages are processed in order. With two threads the
+     * first one only processes low-latency messages (see IsLowLatencyMessageType) and the
+     * second one everything else, so those are not held up by peers waiting on validation
+     * while every message type is still handled by a single thread.
+     * Started by Start(), separate so the pool can be driven on its own.
+     */
+    void StartMessageHandlers(int nThreads);
+    void InterruptMessageHandlers();
+    void StopMessageHandlers();
     bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
     bool GetNetworkActive() const { return fNetworkActive; };
+    SocketEventsMode GetSocketEventsMode() const { return socketEventsMode; }
     void SetNetworkActive(bool active);
     bool OpenNetworkConnection(const CAddress& addrConnect, bool fCountFailure, CSemaphoreGrant *grantOutbound = NULL, const char *strDest = NULL, bool fOneShot = false, bool fFeeler = false, bool fAddnode = false, bool fConnectToMasternode = false);
     bool OpenMasternodeConnection(const CAddress& addrConnect);    
@@ -224,6 +280,7 @@ public:
     bool IsMasternodeOrDisconnectRequested(const CService& addr);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOptimisticSend = DEFAULT_ALLOW_OPTIMISTIC_SEND);
+    void PushMessage(CNode* pnode, const CSharedNetMsgRef& msg, bool allowOptimisticSend = DEFAULT_ALLOW_OPTIMISTIC_SEND);
 
     
 
@@ -382,6 +439,8 @@ public:
     void AddWhitelistedRange(const CSubNet &subnet);
 
     ServiceFlags GetLocalServices() const;
+    //! Stop offering services, to the peers connected from now on
+    void RemoveLocalServices(ServiceFlags flags);
 
     //!set the max outbound target in bytes
     void SetMaxOutboundTarget(uint64_t limit);
@@ -427,8 +486,20 @@ private:
     void ThreadOpenAddedConnections();
     void ProcessOneShot();
     void ThreadOpenConnections();
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(bool fLowLatencyOnly, bool fHasLowLatencyLane);
     void AcceptConnection(const ListenSocket& hListenSocket);
+    /** Whether the socket handler can wait on s, select() can't handle descriptors beyond FD_SETSIZE */
+    bool CanHandleSocket(SOCKET s) const;
+    bool GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set);
+    /** Start watching the socket of a new node, only needed with SOCKETEVENTS_EPOLL */
+    void RegisterSocketEvents(CNode* pnode);
+    /** Interrupt the wait for socket events, e.g. because there is data to send */
+    void WakeSocketHandler();
+    void DrainWakeupPipe();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadOpenMasternodeConnections();
@@ -513,7 +584,7 @@ private:
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
-    ServiceFlags nLocalServices;
+    std::atomic<ServiceFlags> nLocalServices;
 
     /** Services this instance cares about */
     ServiceFlags nRelevantServices;
@@ -531,8 +602,8 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
+    /** counter for waking the message processors, each thread waits for it to change */
+    uint64_t nMsgProcWakeCount;
 
     std::condition_variable condMsgProc;
     std::mutex mutexMsgProc;
@@ -540,12 +611,18 @@ private:
 
     CThreadInterrupt interruptNet;
 
+    SocketEventsMode socketEventsMode;
+    int epollFd;
+    /** Written to by WakeSocketHandler(), the read end is watched by the socket handler */
+    int wakeupPipe[2];
+    std::atomic<bool> fWakeupPending;
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadOpenMasternodeConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
     std::thread threadDandelionShuffle;
 };
 extern std::unique_ptr<CConnman> g_connman;
@@ -717,9 +794,9 @@ public:
     ServiceFlags nServicesExpected;
     SOCKET hSocket;
     size_t nSendSize; // total size of all vSendMsg entries
-    size_t nSendOffset; // offset inside the first vSendMsg already sent
+    size_t nSendOffset; // offset inside the first vSendMsg (header and payload) already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CSharedNetMsgRef> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -778,6 +855,15 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // Edge-triggered readiness of hSocket, only maintained with SOCKETEVENTS_EPOLL.
+    // fHasRecvData is only used by the socket handler thread, fCanSendData is guarded by cs_vSend.
+    std::atomic_bool fHasRecvData;
+    std::atomic_bool fCanSendData;
+    // Set while a message handler thread processes this node
+    std::atomic_bool fMsgProcClaimed;
+    // Set when the low-latency lane could not take cs_main to send rejects and check for a
+    // ban, the node then waits for SendMessages to do it
+    std::atomic_bool fBanCheckPending;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -788,6 +874,9 @@ public:
     std::atomic<int> nStartingHeight;
 
     // flood relay
+    // cs_addrToSend guards vAddrToSend and addrKnown, addresses are relayed to a node
+    // while another message handler thread may be running its SendMessages
+    CCriticalSection cs_addrToSend;
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
@@ -921,6 +1010,11 @@ public:
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
 
+    // With SOCKETEVENTS_EPOLL, whether the readiness reported by earlier edge-triggered
+    // events still lets the socket handler receive or send without waiting for a new event.
+    // Follows the select() policy: pending send data is drained before receiving more.
+    void GetPendingSocketEvents(bool& fRecv, bool& fSend);
+
     void SetRecvVersion(int nVersionIn)
     {
         nRecvVersion = nVersionIn;
@@ -951,6 +1045,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrToSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -959,6 +1054,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrToSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = _addr;
@@ -8,6 +8,7 @@
 #include "addrman.h"
 #include "arith_uint256.h"
 #include "blockencodings.h"
+#include "blockfilter.h"
 #include "chainparams.h"
 #include "consensus/validation.h"
 #include "hash.h"
@@ -22,6 +23,8 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "random.h"
+#include "recentblockcache.h"
+#include "txdb.h"
 #include "tinyformat.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -77,6 +80,13 @@ static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUAR
 
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
+/** Maximum number of compact filters served for one getcfilters request (BIP 157) */
+static const uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of filter hashes served for one getcfheaders request (BIP 157) */
+static const uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Distance between the filter headers of a cfcheckpt message (BIP 157) */
+static const int CFCHECKPT_INTERVAL = 1000;
+
 // Internal stuff
 namespace {
     /** Number of nodes with fSyncStarted. */
@@ -132,8 +142,20 @@ namespace {
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads = 0;
 
+    /**
+     * A transaction in the relay map. The tx message is serialized on the first getdata
+     * for it and then shared by the send queues of every peer asking for it, one for
+     * each SERIALIZE_TRANSACTION_NO_WITNESS setting.
+     */
+    struct CRelayTx {
+        CTransactionRef tx;
+        CSharedNetMsgRef txMsg[2];
+
+        explicit CRelayTx(CTransactionRef txIn) : tx(std::move(txIn)) {}
+    };
+
     /** Relay map, protected by cs_main. */
-    typedef std::map<uint256, CTransactionRef> MapRelay;
+    typedef std::map<uint256, CRelayTx> MapRelay;
     MapRelay mapRelay;
     /** Expiration-time ordered list of (expire time, relay map entry) pairs, protected by cs_main). */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
@@ -804,14 +826,10 @@ void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIn
     }
 }
 
-static CCriticalSection cs_most_recent_block;
-static std::shared_ptr<const CBlock> most_recent_block;
-static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block;
-static uint256 most_recent_block_hash;
-
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    CSharedNetMsgRef cmpctblockMsg = MakeSharedNetMsg(msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
 
     LOCK(cs_main);
 
@@ -823,27 +841,26 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
     bool fWitnessEnabled = IsWitnessEnabled(pindex->pprev, Params().GetConsensus());
     uint256 hashBlock(pblock->GetHash());
 
-    {
-        LOCK(cs_most_recent_block);
-        most_recent_block_hash = hashBlock;
-        most_recent_block = pblock;
-        most_recent_compact_block = pcmpctblock;
-    }
+    recentBlocks.Add(std::make_shared<const CCachedBlock>(pblock, cmpctblockMsg));
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
-        // TODO: Avoid the repeated-serialization here
+    connman->ForEachNode([this, &cmpctblockMsg, pindex, fWitnessEnabled, &hashBlock](CNode* pnode) {
         if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
         CNodeState &state = *State(pnode->GetId());
+        // Verified masternodes get it right away too, even without asking for high-bandwidth
+        // mode, so quorum signing on the new tip is not held up by an inv round trip.
+        // verifiedProRegTxHash is read without cs_mnauth (we hold cs_main), as CConnman does.
+        bool fCompactPeer = state.fPreferHeaderAndIDs ||
+                (state.fSupportsDesiredCmpctVersion && !pnode->verifiedProRegTxHash.IsNull());
         // If the peer has, or we announced to them the previous block already,
         // but we don't think they have this one, go ahead and announce it
-        if (state.fPreferHeaderAndIDs && (!fWitnessEnabled || state.fWantsCmpctWitness) &&
+        if (fCompactPeer && (!fWitnessEnabled || state.fWantsCmpctWitness) &&
                 !PeerHasHeader(&state, pindex) && PeerHasHeader(&state, pindex->pprev)) {
 
             LogPrint("net", "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->id);
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            connman->PushMessage(pnode, cmpctblockMsg);
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1048,13 +1065,9 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         // before ActivateBestChain but after AcceptBlock).
                         // In this case, we need to run ActivateBestChain prior to checking the relay
                         // conditions below.
-                        std::shared_ptr<const CBlock> a_recent_block;
-                        {
-                            LOCK(cs_most_recent_block);
-                            a_recent_block = most_recent_block;
-                        }
+                        CCachedBlockRef a_recent_block = recentBlocks.GetMostRecent();
                         CValidationState dummy;
-                        ActivateBestChain(dummy, Params(), a_recent_block);
+                        ActivateBestChain(dummy, Params(), a_recent_block ? a_recent_block->block : nullptr);
                     }
                     if (chainActive.Contains(mi->second)) {
                         send = true;
@@ -1086,15 +1099,37 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
                 {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
+                    // Send block from the recent block cache or from disk. A full block is sent
+                    // as its raw serialization unless its witness data has to be stripped.
+                    bool fSendRaw = inv.type == MSG_WITNESS_BLOCK || (inv.type == MSG_BLOCK && !IsWitnessEnabled(mi->second->pprev, consensusParams));
+                    CCachedBlockRef cachedBlock = recentBlocks.Get(inv.hash);
+                    std::shared_ptr<const CBlock> pblock;
+                    CSharedNetMsgRef rawBlockMsg;
+                    if (fSendRaw) {
+                        if (cachedBlock) {
+                            rawBlockMsg = cachedBlock->GetBlockMsg();
+                        } else {
+                            CSerializedNetMsg msg;
+                            if (!ReadRawBlockFromDisk(msg.data, (*mi).second, Params().MessageStart()))
+                                assert(!"cannot load block from disk");
+                            msg.command = NetMsgType::BLOCK;
+                            rawBlockMsg = MakeSharedNetMsg(std::move(msg));
+                        }
+                    } else if (cachedBlock) {
+                        pblock = cachedBlock->block;
+                    } else {
+                        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+                        if (!ReadBlockFromDisk(*pblockRead, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                        pblock = pblockRead;
+                    }
 
-                    if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block));
+                    if (fSendRaw)
+                        connman.PushMessage(pfrom, rawBlockMsg);
+                    else if (inv.type == MSG_BLOCK)
+                        connman.PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
                     else if (inv.type == MSG_WITNESS_BLOCK)
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
                     else if (inv.type == MSG_FILTERED_BLOCK)
                     {
                         bool sendMerkleBlock = false;
@@ -1103,7 +1138,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                             LOCK(pfrom->cs_filter);
                             if (pfrom->pfilter) {
                                 sendMerkleBlock = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                                merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
                             }
                         }
                         if (sendMerkleBlock) {
@@ -1116,7 +1151,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                             // however we MUST always provide at least what the remote peer needs
                             typedef std::pair<unsigned int, uint256> PairType;
                             BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
-                                connman.PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *block.vtx[pair.first]));
+                                connman.PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *pblock->vtx[pair.first]));
                         }
                         // else
                             // no response
@@ -1130,10 +1165,14 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
                         int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
                         if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                            CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
-                            connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+                            if (cachedBlock && fPeerWantsWitness) {
+                                connman.PushMessage(pfrom, cachedBlock->compactBlockMsg);
+                            } else {
+                                CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
+                                connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+                            }
                         } else
-                            connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, block));
+                            connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
                     }
 
                     // Trigger the peer node to send a getblocks request for the next batch of inventory
@@ -1158,7 +1197,10 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     auto mi = mapRelay.find(inv.hash);
                     int nSendFlags = (inv.type == MSG_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
                     if (mi != mapRelay.end()) {
-                        connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second));
+                        CSharedNetMsgRef& txMsg = mi->second.txMsg[nSendFlags ? 1 : 0];
+                        if (!txMsg)
+                            txMsg = MakeSharedNetMsg(CNetMsgMaker(PROTOCOL_VERSION).Make(nSendFlags, NetMsgType::TX, *mi->second.tx));
+                        connman.PushMessage(pfrom, txMsg);
                         push = true;
                     } else if (pfrom->timeLastMempoolReq) {
                         auto txinfo = mempool.info(inv.hash);
@@ -1200,7 +1242,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                     auto mi = mapRelay.find(inv.hash);
                     if (mi != mapRelay.end()) {
-                        ss << (*mi).second;
+                        ss << mi->second.tx;
                         pushed = true;
                     }
                     if(pushed) {
@@ -1319,6 +1361,145 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
+/**
+ * Validate a BIP 157 request and look up its stop block. Peers asking for filters we don't
+ * serve or for an invalid range are disconnected; a stop block that was never connected
+ * (so has no filter) is silently ignored.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t filterType, uint32_t startHeight, const uint256& stopHash,
+                                      uint32_t maxHeightRange, const CBlockIndex*& stopIndex)
+{
+    AssertLockHeld(cs_main);
+
+    if (!(pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) || BlockFilterType(filterType) != BlockFilterType::BASIC) {
+        LogPrint("net", "peer %d requested unsupported block filter type %d, disconnect\n", pfrom->id, filterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    BlockMap::iterator it = mapBlockIndex.find(stopHash);
+    if (it == mapBlockIndex.end()) {
+        LogPrint("net", "peer %d requested filters for unknown block %s, disconnect\n", pfrom->id, stopHash.ToString());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (!it->second->IsValid(BLOCK_VALID_SCRIPTS)) {
+        LogPrint("net", "peer %d requested filters for unconnected block %s\n", pfrom->id, stopHash.ToString());
+        return false;
+    }
+    stopIndex = it->second;
+
+    uint32_t stopHeight = stopIndex->nHeight;
+    if (startHeight > stopHeight || stopHeight - startHeight >= maxHeightRange) {
+        LogPrint("net", "peer %d requested invalid filter range %u-%u, disconnect\n", pfrom->id, startHeight, stopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
+/** Hashes of the blocks from startHeight up to and including stopIndex */
+static std::vector<uint256> GetBlockFilterRange(const CBlockIndex* stopIndex, uint32_t startHeight)
+{
+    std::vector<uint256> hashes(stopIndex->nHeight - startHeight + 1);
+    for (const CBlockIndex* pindex = stopIndex; pindex && (uint32_t)pindex->nHeight >= startHeight; pindex = pindex->pprev)
+        hashes[pindex->nHeight - startHeight] = pindex->GetBlockHash();
+    return hashes;
+}
+
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, CConnman& connman)
+{
+    uint8_t filterType;
+    uint32_t startHeight;
+    uint256 stopHash;
+    vRecv >> filterType >> startHeight >> stopHash;
+
+    std::vector<uint256> hashes;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* stopIndex;
+        if (!PrepareBlockFilterRequest(pfrom, filterType, startHeight, stopHash, MAX_GETCFILTERS_SIZE, stopIndex))
+            return;
+        hashes = GetBlockFilterRange(stopIndex, startHeight);
+    }
+
+    // the filters are read without cs_main, they are keyed by block hash and never change
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const uint256& hash : hashes) {
+        BlockFilter filter;
+        if (!pblocktree->ReadBlockFilter(BlockFilterType::BASIC, hash, filter)) {
+            LogPrint("net", "%s: no filter for block %s\n", __func__, hash.ToString());
+            return;
+        }
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, CConnman& connman)
+{
+    uint8_t filterType;
+    uint32_t startHeight;
+    uint256 stopHash;
+    vRecv >> filterType >> startHeight >> stopHash;
+
+    std::vector<uint256> hashes;
+    uint256 prevBlockHash;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* stopIndex;
+        if (!PrepareBlockFilterRequest(pfrom, filterType, startHeight, stopHash, MAX_GETCFHEADERS_SIZE, stopIndex))
+            return;
+        hashes = GetBlockFilterRange(stopIndex, startHeight);
+        if (startHeight > 0)
+            prevBlockHash = stopIndex->GetAncestor(startHeight - 1)->GetBlockHash();
+    }
+
+    uint256 prevHeader, header;
+    if (!prevBlockHash.IsNull() && !pblocktree->ReadBlockFilterHeader(BlockFilterType::BASIC, prevBlockHash, prevHeader)) {
+        LogPrint("net", "%s: no filter header for block %s\n", __func__, prevBlockHash.ToString());
+        return;
+    }
+
+    std::vector<uint256> filterHashes(hashes.size());
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (!pblocktree->ReadBlockFilterHeader(BlockFilterType::BASIC, hashes[i], header, &filterHashes[i])) {
+            LogPrint("net", "%s: no filter header for block %s\n", __func__, hashes[i].ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS, filterType, stopHash, prevHeader, filterHashes));
+}
+
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, CConnman& connman)
+{
+    uint8_t filterType;
+    uint256 stopHash;
+    vRecv >> filterType >> stopHash;
+
+    std::vector<uint256> hashes;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* stopIndex;
+        if (!PrepareBlockFilterRequest(pfrom, filterType, 0, stopHash, std::numeric_limits<uint32_t>::max(), stopIndex))
+            return;
+        for (int nHeight = CFCHECKPT_INTERVAL; nHeight <= stopIndex->nHeight; nHeight += CFCHECKPT_INTERVAL)
+            hashes.push_back(stopIndex->GetAncestor(nHeight)->GetBlockHash());
+    }
+
+    std::vector<uint256> headers(hashes.size());
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (!pblocktree->ReadBlockFilterHeader(BlockFilterType::BASIC, hashes[i], headers[i])) {
+            LogPrint("net", "%s: no filter header for block %s\n", __func__, hashes[i].ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT, filterType, stopHash, headers));
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -1343,7 +1524,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
     }
 
-    {
+    if (IsLowLatencyMessageType(strCommand)) {
+        // Low-latency messages are served while block/tx validation holds cs_main,
+        // the embargoes are checked again by the next message that gets the lock
+        TRY_LOCK(cs_main, lockMain);
+        if (lockMain)
+            CNode::CheckDandelionEmbargoes();
+    } else {
         LOCK(cs_main);
         CNode::CheckDandelionEmbargoes();
     }
@@ -1879,13 +2066,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // for getheaders requests, and there are no known nodes which support
         // compact blocks but still use getblocks to request blocks.
         {
-            std::shared_ptr<const CBlock> a_recent_block;
-            {
-                LOCK(cs_most_recent_block);
-                a_recent_block = most_recent_block;
-            }
+            CCachedBlockRef a_recent_block = recentBlocks.GetMostRecent();
             CValidationState dummy;
-            ActivateBestChain(dummy, Params(), a_recent_block);
+            ActivateBestChain(dummy, Params(), a_recent_block ? a_recent_block->block : nullptr);
         }
 
         LOCK(cs_main);
@@ -1931,15 +2114,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         BlockTransactionsRequest req;
         vRecv >> req;
 
-        std::shared_ptr<const CBlock> recent_block;
-        {
-            LOCK(cs_most_recent_block);
-            if (most_recent_block_hash == req.blockhash)
-                recent_block = most_recent_block;
-            // Unlock cs_most_recent_block to avoid cs_main lock inversion
-        }
+        CCachedBlockRef recent_block = recentBlocks.Get(req.blockhash);
         if (recent_block) {
-            SendBlockTransactions(*recent_block, req, pfrom, connman);
+            SendBlockTransactions(*recent_block->block, req, pfrom, connman);
             return true;
         }
 
@@ -1976,6 +2153,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    else if (strCommand == NetMsgType::GETCFILTERS)
+    {
+        ProcessGetCFilters(pfrom, vRecv, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS)
+    {
+        ProcessGetCFHeaders(pfrom, vRecv, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT)
+    {
+        ProcessGetCFCheckPt(pfrom, vRecv, connman);
+    }
+
+
     else if (strCommand == NetMsgType::GETHEADERS)
     {
         CBlockLocator locator;
@@ -2791,9 +2986,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
         std::vector<CAddress> vAddr = connman.GetAddresses();
         FastRandomContext insecure_rand;
+        LOCK(pfrom->cs_addrToSend);
+        pfrom->vAddrToSend.clear();
         BOOST_FOREACH(const CAddress &addr, vAddr)
             pfrom->PushAddress(addr, insecure_rand);
     }
@@ -3075,14 +3271,16 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
     //
     bool fMoreWork = false;
 
-    if (!pfrom->vRecvGetData.empty())
+    bool fGetData = !pfrom->vRecvGetData.empty();
+    if (fGetData)
         ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
 
     if (pfrom->fDisconnect)
         return false;
 
-    // this maintains the order of responses
-    if (!pfrom->vRecvGetData.empty()) return true;
+    // this maintains the order of responses, and lets the caller pick the message handler
+    // lane for the next message
+    if (fGetData) return true;
 
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->fPauseSend)
@@ -3174,8 +3372,18 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
         }
 
-        LOCK(cs_main);
-        SendRejectsAndCheckIfBanned(pfrom, connman);
+        if (IsLowLatencyMessageType(strCommand)) {
+            // Don't wait for validation, SendMessages does the check for the lane instead
+            // and the peer gets no more low-latency service until then
+            TRY_LOCK(cs_main, lockMain);
+            if (lockMain)
+                SendRejectsAndCheckIfBanned(pfrom, connman);
+            else
+                pfrom->fBanCheckPending = true;
+        } else {
+            LOCK(cs_main);
+            SendRejectsAndCheckIfBanned(pfrom, connman);
+        }
 
     return fMoreWork;
 }
@@ -3201,6 +3409,14 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
 {
     const Consensus::Params& consensusParams = Params().GetConsensus();
     {
+        // Left over by the low-latency lane, done even while validation holds cs_main
+        if (pto->fBanCheckPending) {
+            LOCK(cs_main);
+            pto->fBanCheckPending = false;
+            if (SendRejectsAndCheckIfBanned(pto, connman))
+                return true;
+        }
+
         // Don't send anything until the version handshake is complete
         if (!pto->fSuccessfullyConnected || pto->fDisconnect)
             return true;
@@ -3258,6 +3474,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
             std::vector<CAddress> vAddr;
+            LOCK(pto->cs_addrToSend);
             vAddr.reserve(pto->vAddrToSend.size());
             BOOST_FOREACH(const CAddress& addr, pto->vAddrToSend)
             {
@@ -3389,20 +3606,15 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
 
                     int nSendFlags = state.fWantsCmpctWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
 
-                    bool fGotBlockFromCache = false;
-                    {
-                        LOCK(cs_most_recent_block);
-                        if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
-                            if (state.fWantsCmpctWitness)
-                                connman.PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *most_recent_compact_block));
-                            else {
-                                CBlockHeaderAndShortTxIDs cmpctblock(*most_recent_block, state.fWantsCmpctWitness);
-                                connman.PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
-                            }
-                            fGotBlockFromCache = true;
+                    CCachedBlockRef cachedBlock = recentBlocks.Get(pBestIndex->GetBlockHash());
+                    if (cachedBlock) {
+                        if (state.fWantsCmpctWitness)
+                            connman.PushMessage(pto, cachedBlock->compactBlockMsg);
+                        else {
+                            CBlockHeaderAndShortTxIDs cmpctblock(*cachedBlock->block, state.fWantsCmpctWitness);
+                            connman.PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                         }
-                    }
-                    if (!fGotBlockFromCache) {
+                    } else {
                         CBlock block;
                         bool ret = ReadBlockFromDisk(block, pBestIndex, consensusParams);
                         assert(ret);
@@ -3592,7 +3804,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                             vRelayExpiration.pop_front();
                         }
 
-                        auto ret = mapRelay.insert(std::make_pair(hash, std::move(txinfo.tx)));
+                        auto ret = mapRelay.emplace(hash, CRelayTx(std::move(txinfo.tx)));
                         if (ret.second) {
                             vRelayExpiration.push_back(std::make_pair(nNow + 15 * 60 * 1000000, ret.first));
                         }
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "perfstats.h"
+#include "tinyformat.h"
+
+#include <cassert>
+
+static std::atomic<bool> fPerfStatsEnabled{DEFAULT_PERFSTATS};
+
+static CPerfHistogram perfHistograms[(int)PerfStat::COUNT];
+
+static const char* const perfStatNames[(int)PerfStat::COUNT] = {
+    "spark_spend_check",
+    "lelantus_joinsplit_check",
+    "spark_cover_set",
+    "lelantus_cover_set",
+    "batch_verify_sigma",
+    "batch_verify_lelantus",
+    "batch_verify_rangeproofs",
+    "batch_verify_spark",
+    "connectblock_sanity",
+    "connectblock_forks",
+    "connectblock_connect_txs",
+    "connectblock_verify",
+    "connectblock_index",
+    "connectblock_callbacks",
+    "connecttip_total",
+    "mempool_accept",
+    "progpow_hash_light",
+    "progpow_hash_full",
+    "llmq_sigshares_verify",
+    "llmq_sigshares_process",
+    "db_read",
+    "db_write",
+};
+
+int CPerfHistogram::BucketIndex(uint64_t micros)
+{
+    // index of the highest set bit plus one, i.e. the smallest i with micros < 2^i
+    int i = 0;
+    while (micros != 0 && i < NUM_BUCKETS - 1) {
+        micros >>= 1;
+        i++;
+    }
+    return i;
+}
+
+uint64_t CPerfHistogram::BucketUpperBound(int i)
+{
+    assert(i >= 0 && i < NUM_BUCKETS);
+    if (i == NUM_BUCKETS - 1)
+        return 0;
+    return uint64_t(1) << i;
+}
+
+void CPerfHistogram::Add(uint64_t micros)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add(micros, std::memory_order_relaxed);
+    buckets[BucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t prevMax = maxMicros.load(std::memory_order_relaxed);
+    while (prevMax < micros && !maxMicros.compare_exchange_weak(prevMax, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void CPerfHistogram::Reset()
+{
+    count.store(0, std::memory_order_relaxed);
+    sumMicros.store(0, std::memory_order_relaxed);
+    maxMicros.store(0, std::memory_order_relaxed);
+    for (auto& b : buckets)
+        b.store(0, std::memory_order_relaxed);
+}
+
+CPerfHistogram::Snapshot CPerfHistogram::GetSnapshot() const
+{
+    Snapshot s;
+    s.count = count.load(std::memory_order_relaxed);
+    s.sumMicros = sumMicros.load(std::memory_order_relaxed);
+    s.maxMicros = maxMicros.load(std::memory_order_relaxed);
+    for (int i = 0; i < NUM_BUCKETS; i++)
+        s.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+bool IsPerfStatsEnabled()
+{
+    return fPerfStatsEnabled.load(std::memory_order_relaxed);
+}
+
+void SetPerfStatsEnabled(bool fEnabled)
+{
+    fPerfStatsEnabled.store(fEnabled, std::memory_order_relaxed);
+}
+
+const char* GetPerfStatName(PerfStat stat)
+{
+    assert(stat >= PerfStat(0) && stat < PerfStat::COUNT);
+    return perfStatNames[(int)stat];
+}
+
+CPerfHistogram& GetPerfHistogram(PerfStat stat)
+{
+    assert(stat >= PerfStat(0) && stat < PerfStat::COUNT);
+    return perfHistograms[(int)stat];
+}
+
+void ResetPerfStats()
+{
+    for (auto& h : perfHistograms)
+        h.Reset();
+}
+
+std::string PerfStatsToPrometheus()
+{
+    std::string ret;
+    ret += "# HELP privora_perf_duration_seconds Latency of instrumented subsystems\n";
+    ret += "# TYPE privora_perf_duration_seconds histogram\n";
+    for (int n = 0; n < (int)PerfStat::COUNT; n++) {
+        const char* name = perfStatNames[n];
+        CPerfHistogram::Snapshot s = perfHistograms[n].GetSnapshot();
+
+        // Prometheus buckets are cumulative
+        uint64_t cumulative = 0;
+        for (int i = 0; i < CPerfHistogram::NUM_BUCKETS - 1; i++) {
+            cumulative += s.buckets[i];
+            ret += strprintf("privora_perf_duration_seconds_bucket{stat=\"%s\",le=\"%.6f\"} %u\n",
+                             name, CPerfHistogram::BucketUpperBound(i) * 0.000001, cumulative);
+        }
+        // use the bucket total rather than s.count so a racing Add() can't make +Inf smaller than the last bucket
+        cumulative += s.buckets[CPerfHistogram::NUM_BUCKETS - 1];
+        ret += strprintf("privora_perf_duration_seconds_bucket{stat=\"%s\",le=\"+Inf\"} %u\n", name, cumulative);
+        ret += strprintf("privora_perf_duration_seconds_sum{stat=\"%s\"} %.6f\n", name, s.sumMicros * 0.000001);
+        ret += strprintf("privora_perf_duration_seconds_count{stat=\"%s\"} %u\n", name, cumulative);
+    }
+    return ret;
+}
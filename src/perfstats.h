@@ -0,0 +1,129 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_PERFSTATS_H
+#define PRIVORA_PERFSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+static const bool DEFAULT_PERFSTATS = true;
+
+/** Subsystems whose latency is tracked by the perf stats histograms */
+enum class PerfStat : int {
+    SPARK_SPEND_CHECK = 0,
+    LELANTUS_JOINSPLIT_CHECK,
+    SPARK_COVER_SET,
+    LELANTUS_COVER_SET,
+    BATCH_VERIFY_SIGMA,
+    BATCH_VERIFY_LELANTUS,
+    BATCH_VERIFY_RANGEPROOFS,
+    BATCH_VERIFY_SPARK,
+    CONNECTBLOCK_SANITY,
+    CONNECTBLOCK_FORKS,
+    CONNECTBLOCK_CONNECT_TXS,
+    CONNECTBLOCK_VERIFY,
+    CONNECTBLOCK_INDEX,
+    CONNECTBLOCK_CALLBACKS,
+    CONNECTTIP_TOTAL,
+    MEMPOOL_ACCEPT,
+    PROGPOW_HASH_LIGHT,
+    PROGPOW_HASH_FULL,
+    LLMQ_SIGSHARES_VERIFY,
+    LLMQ_SIGSHARES_PROCESS,
+    DB_READ,
+    DB_WRITE,
+
+    COUNT
+};
+
+/**
+ * Lock-free latency histogram. Bucket i counts samples that took less than
+ * 2^i microseconds (and at least 2^(i-1)), the last bucket catches everything
+ * longer. All counters are relaxed atomics: a concurrent reader may observe a
+ * sample in the count before it shows up in the sum, which is fine for stats.
+ */
+class CPerfHistogram
+{
+public:
+    static const int NUM_BUCKETS = 26; // last finite bound is 2^24us (~16.8s)
+
+    struct Snapshot {
+        uint64_t count{0};
+        uint64_t sumMicros{0};
+        uint64_t maxMicros{0};
+        uint64_t buckets[NUM_BUCKETS]{};
+    };
+
+private:
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumMicros{0};
+    std::atomic<uint64_t> maxMicros{0};
+    std::atomic<uint64_t> buckets[NUM_BUCKETS]{};
+
+public:
+    static int BucketIndex(uint64_t micros);
+    /** Upper bound (exclusive) of bucket i in microseconds, 0 for the overflow bucket */
+    static uint64_t BucketUpperBound(int i);
+
+    void Add(uint64_t micros);
+    void Reset();
+    Snapshot GetSnapshot() const;
+};
+
+bool IsPerfStatsEnabled();
+void SetPerfStatsEnabled(bool fEnabled);
+
+const char* GetPerfStatName(PerfStat stat);
+CPerfHistogram& GetPerfHistogram(PerfStat stat);
+void ResetPerfStats();
+
+/** Render all histograms in the Prometheus text exposition format */
+std::string PerfStatsToPrometheus();
+
+/** Records the lifetime of the object into the histogram of the given subsystem */
+class CPerfTimer
+{
+private:
+    CPerfHistogram* histogram;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit CPerfTimer(PerfStat stat) :
+        histogram(IsPerfStatsEnabled() ? &GetPerfHistogram(stat) : nullptr)
+    {
+        if (histogram)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~CPerfTimer()
+    {
+        Stop();
+    }
+
+    /** Record the elapsed time now instead of on destruction */
+    void Stop()
+    {
+        if (!histogram)
+            return;
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        histogram->Add(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        histogram = nullptr;
+    }
+
+    CPerfTimer(const CPerfTimer&) = delete;
+    CPerfTimer& operator=(const CPerfTimer&) = delete;
+};
+
+/** Record an already measured duration, e.g. one of the ConnectBlock "bench" intervals */
+inline void RecordPerfStat(PerfStat stat, int64_t micros)
+{
+    if (IsPerfStatsEnabled())
+        GetPerfHistogram(stat).Add(micros < 0 ? 0 : (uint64_t)micros);
+}
+
+#endif // PRIVORA_PERFSTATS_H
@@ -15,6 +15,7 @@
 #include "crypto/scrypt.h"
 #include "crypto/progpow.h"
 #include "util.h"
+#include "perfstats.h"
 #include <iostream>
 #include <chrono>
 #include <fstream>
@@ -57,10 +58,12 @@ uint256 CBlockHeader::GetProgPowHeaderHash() const
 }
 
 uint256 CBlockHeader::GetProgPowHashFull(uint256& mix_hash) const {
+    CPerfTimer perfTimer(PerfStat::PROGPOW_HASH_FULL);
     return progpow_hash_full(GetProgPowHeader(), mix_hash);
 }
 
 uint256 CBlockHeader::GetProgPowHashLight() const {
+    CPerfTimer perfTimer(PerfStat::PROGPOW_HASH_LIGHT);
     return progpow_hash_light(GetProgPowHeader());
 }
 
@@ -12,6 +12,7 @@
 #include "uint256.h"
 
 #include <exception>
+#include <memory>
 
 static const int SERIALIZE_TRANSACTION_NO_WITNESS = 0x40000000;
 
@@ -362,6 +363,27 @@ inline void SerializeTransaction(const TxType& tx, Stream& s) {
         s << tx.vExtraPayload;
 }
 
+struct CPrivacyTxData;
+
+/**
+ * Slot for the parsed privacy payload of a transaction (see privacytx.h). It is filled on
+ * first use, possibly by several threads at once, so the pointer is only accessed
+ * atomically. A copy of a transaction starts with an empty slot.
+ */
+class CPrivacyTxDataCache
+{
+private:
+    mutable std::shared_ptr<const CPrivacyTxData> data;
+
+public:
+    CPrivacyTxDataCache() {}
+    CPrivacyTxDataCache(const CPrivacyTxDataCache&) {}
+    CPrivacyTxDataCache& operator=(const CPrivacyTxDataCache&) { return *this; }
+
+    std::shared_ptr<const CPrivacyTxData> Get() const { return std::atomic_load(&data); }
+    void Set(const std::shared_ptr<const CPrivacyTxData>& p) const { std::atomic_store(&data, p); }
+};
+
 /** The basic transaction that is broadcasted on the network and contained in
  * blocks.  A transaction can contain multiple inputs and outputs.
  */
@@ -392,9 +414,12 @@ public:
 private:
     /** Memory only. */
     const uint256 hash;
+    CPrivacyTxDataCache privacyData;
 
     uint256 ComputeHash() const;
 
+    friend std::shared_ptr<const CPrivacyTxData> GetPrivacyTxData(const CTransaction& tx);
+
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
     CTransaction();
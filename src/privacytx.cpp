@@ -0,0 +1,152 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "privacytx.h"
+
+#include "cuckoocache.h"
+#include "hash.h"
+#include "lelantus.h"
+#include "random.h"
+#include "spark/state.h"
+
+#include <boost/thread/shared_mutex.hpp>
+
+namespace {
+
+//! Memory used by the verified proof cache, enough for tens of thousands of spends
+static const size_t PRIVACY_PROOF_CACHE_BYTES = 1 << 20;
+
+/** Keys are nonced SHA256 hashes, any four bytes of them are a good hash */
+class PrivacyProofCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "PrivacyProofCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+class CPrivacyProofCache
+{
+private:
+    uint256 nonce;
+    CuckooCache::cache<uint256, PrivacyProofCacheHasher> setValid;
+    boost::shared_mutex cs_cache;
+
+public:
+    CPrivacyProofCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup_bytes(PRIVACY_PROOF_CACHE_BYTES);
+    }
+
+    uint256 ComputeKey(const uint256& hashTx, const std::vector<CPrivacyProofSet>& sets) const
+    {
+        CHashWriter hasher(SER_GETHASH, 0);
+        hasher << nonce << hashTx;
+        for (const CPrivacyProofSet& set : sets)
+            hasher << set.groupId << set.blockHash << (uint64_t)set.nCoins << set.setHash;
+        return hasher.GetHash();
+    }
+
+    bool Contains(const uint256& key)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_cache);
+        return setValid.contains(key, false);
+    }
+
+    void Insert(uint256 key)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_cache);
+        setValid.insert(key);
+    }
+};
+
+static CPrivacyProofCache proofCache;
+
+}
+
+static std::shared_ptr<const CPrivacyTxData> ParsePrivacyTxData(const CTransaction& tx)
+{
+    auto data = std::make_shared<CPrivacyTxData>();
+
+    try {
+        if (tx.IsLelantusJoinSplit()) {
+            std::unique_ptr<lelantus::JoinSplit> joinsplit = lelantus::ParseLelantusJoinSplit(tx);
+            data->lelantusSerials = joinsplit->getCoinSerialNumbers();
+            data->lelantusGroupIds = joinsplit->getCoinGroupIds();
+            for (const auto& idAndHash : joinsplit->getIdAndBlockHashes())
+                data->groupBlockHashes[idAndHash.first] = idAndHash.second;
+            data->nFee = joinsplit->getFee();
+        } else if (tx.IsSparkSpend()) {
+            spark::SpendTransaction spend = spark::ParseSparkSpend(tx);
+            data->sparkLTags = spend.getUsedLTags();
+            data->sparkGroupIds = spend.getCoinGroupIds();
+            data->groupBlockHashes = spend.getBlockHashes();
+            data->nFee = spend.getFee();
+        }
+    } catch (const std::exception&) {
+        data = std::make_shared<CPrivacyTxData>();
+        data->fParsed = false;
+    }
+
+    if (tx.IsSparkTransaction()) {
+        // the serial context of a spend is made of its linking tags, reuse the ones parsed above
+        std::vector<unsigned char> serialContext;
+        if (!tx.IsSparkSpend())
+            serialContext = spark::getSerialContext(tx);
+        else if (data->fParsed)
+            serialContext = spark::getSerialContext(data->sparkLTags);
+        data->sparkMintCoins = spark::ParseSparkMintCoins(tx, serialContext);
+    }
+
+    return data;
+}
+
+std::shared_ptr<const CPrivacyTxData> GetPrivacyTxData(const CTransaction& tx)
+{
+    static const std::shared_ptr<const CPrivacyTxData> empty = std::make_shared<CPrivacyTxData>();
+
+    if (!tx.IsLelantusJoinSplit() && !tx.IsSparkTransaction())
+        return empty;
+
+    std::shared_ptr<const CPrivacyTxData> data = tx.privacyData.Get();
+    if (!data) {
+        // two threads may race to parse the same transaction, both produce the same result
+        data = ParsePrivacyTxData(tx);
+        tx.privacyData.Set(data);
+    }
+    return data;
+}
+
+CAmount GetPrivacyTxFee(const CTransaction& tx)
+{
+    std::shared_ptr<const CPrivacyTxData> data = GetPrivacyTxData(tx);
+    if (data->fParsed)
+        return data->nFee;
+
+    // parse again to surface the original error
+    if (tx.IsLelantusJoinSplit())
+        return lelantus::ParseLelantusJoinSplit(tx)->getFee();
+    return spark::ParseSparkSpend(tx).getFee();
+}
+
+uint256 GetPrivacyProofCacheKey(const uint256& hashTx, const std::vector<CPrivacyProofSet>& sets)
+{
+    return proofCache.ComputeKey(hashTx, sets);
+}
+
+bool IsPrivacyProofVerified(const uint256& key)
+{
+    return proofCache.Contains(key);
+}
+
+void SetPrivacyProofVerified(const uint256& key)
+{
+    proofCache.Insert(key);
+}
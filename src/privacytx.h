@@ -0,0 +1,84 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_PRIVACYTX_H
+#define PRIVORA_PRIVACYTX_H
+
+#include "amount.h"
+#include "libspark/coin.h"
+#include "primitives/transaction.h"
+#include "uint256.h"
+
+#include <secp256k1/include/GroupElement.h>
+#include <secp256k1/include/Scalar.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * Privacy payload of a Lelantus joinsplit or Spark transaction, decoded once per
+ * transaction. Mempool acceptance, block assembly, block connection, InstantSend and the
+ * notification interfaces all need the serials / linking tags of the same transaction and
+ * used to deserialize its proof every time. Only the parts they look at are kept, the
+ * proofs themselves are still verified from the raw payload.
+ */
+struct CPrivacyTxData
+{
+    //! false if the payload failed to deserialize, every other field is then empty
+    bool fParsed{true};
+
+    std::vector<Scalar> lelantusSerials;
+    std::vector<uint32_t> lelantusGroupIds;
+
+    std::vector<GroupElement> sparkLTags;
+    std::vector<uint64_t> sparkGroupIds;
+    std::vector<spark::Coin> sparkMintCoins;
+
+    //! Coin group id -> hash of the last block of the set the spend refers to
+    std::map<uint64_t, uint256> groupBlockHashes;
+
+    CAmount nFee{0};
+};
+
+/**
+ * Get the decoded privacy payload of tx, deserializing it on first use and caching the
+ * result on the transaction. Transactions without a privacy payload share one empty
+ * instance.
+ */
+std::shared_ptr<const CPrivacyTxData> GetPrivacyTxData(const CTransaction& tx);
+
+/**
+ * Fee of a Lelantus joinsplit or Spark spend. Throws the deserialization error of the
+ * payload, like parsing it directly would, if it is malformed.
+ */
+CAmount GetPrivacyTxFee(const CTransaction& tx);
+
+/**
+ * Anonymity set a Lelantus or Spark spend proof was checked against: the coin group, the
+ * block the set ends at, the number of coins in it and the set hash where consensus uses
+ * one.
+ */
+struct CPrivacyProofSet
+{
+    uint64_t groupId;
+    uint256 blockHash;
+    size_t nCoins;
+    std::vector<unsigned char> setHash;
+};
+
+/** Key of a transaction's spend proof in the verified proof cache */
+uint256 GetPrivacyProofCacheKey(const uint256& hashTx, const std::vector<CPrivacyProofSet>& sets);
+
+/**
+ * Verified spend proofs. A proof is added when it passes verification on mempool
+ * acceptance, so connecting a block whose transactions came from our mempool, the common
+ * case for a block reconstructed from a compact block, does not verify the same proofs
+ * again. The key covers the anonymity sets as well as the transaction, a spend checked
+ * against a different set (after a reorg, say) misses the cache.
+ */
+bool IsPrivacyProofVerified(const uint256& key);
+void SetPrivacyProofVerified(const uint256& key);
+
+#endif // PRIVORA_PRIVACYTX_H
@@ -105,6 +105,9 @@ static const int64_t DUST_HARD_LIMIT = 1000;   // 0.00001 PRIVORA mininput
 #define ZC_SPARK_MAX_MINT_NUM    32000
 #define ZC_SPARK_SET_START_SIZE  8000
 
+// Blocks after the end of Sigma / the Lelantus graceful period after which their sets are frozen
+#define ZC_FROZEN_SET_DEPTH                 100
+
 // Version of index that introduced storing accumulators and coin serials
 #define ZC_ADVANCED_INDEX_VERSION           130500
 // Version of wallet.db entry that introduced storing extra information for mints
@@ -8,6 +8,8 @@
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <set>
+
 #ifndef WIN32
 # include <arpa/inet.h>
 #endif
@@ -58,6 +60,12 @@ namespace NetMsgType {
     const char *CLSIG="clsig";
     const char *ISLOCK="islock";
     const char *MNAUTH="mnauth";
+    const char *GETCFILTERS="getcfilters";
+    const char *CFILTER="cfilter";
+    const char *GETCFHEADERS="getcfheaders";
+    const char *CFHEADERS="cfheaders";
+    const char *GETCFCHECKPT="getcfcheckpt";
+    const char *CFCHECKPT="cfcheckpt";
 };
 
 /** All known message types. Keep this in the same order as the list of
@@ -110,6 +118,12 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::CLSIG,
     NetMsgType::ISLOCK,
     NetMsgType::MNAUTH,
+    NetMsgType::GETCFILTERS,
+    NetMsgType::CFILTER,
+    NetMsgType::GETCFHEADERS,
+    NetMsgType::CFHEADERS,
+    NetMsgType::GETCFCHECKPT,
+    NetMsgType::CFCHECKPT,
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
 
@@ -242,3 +256,20 @@ const std::vector<std::string> &getAllNetMessageTypes()
 {
     return allNetMessageTypesVec;
 }
+
+bool IsLowLatencyMessageType(const std::string &msgType)
+{
+    static const std::set<std::string> lowLatencyTypes = {
+        NetMsgType::PING,
+        NetMsgType::PONG,
+        NetMsgType::ADDR,
+        NetMsgType::GETADDR,
+        NetMsgType::QSIGSESANN,
+        NetMsgType::QSIGSHARESINV,
+        NetMsgType::QGETSIGSHARES,
+        NetMsgType::QBSIGSHARES,
+        NetMsgType::QSIGREC,
+        NetMsgType::ISLOCK,
+    };
+    return lowLatencyTypes.count(msgType) > 0;
+}
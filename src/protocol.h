@@ -265,11 +265,42 @@ extern const char *QSIGREC;
 extern const char *CLSIG;
 extern const char *ISLOCK;
 extern const char *MNAUTH;
+/**
+ * getcfilters requests the compact filters of a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by BIP 157.
+ */
+extern const char *GETCFILTERS;
+/**
+ * cfilter is the response to getcfilters, one per block.
+ */
+extern const char *CFILTER;
+/**
+ * getcfheaders requests the filter headers of a range of blocks.
+ */
+extern const char *GETCFHEADERS;
+/**
+ * cfheaders is the response to getcfheaders.
+ */
+extern const char *CFHEADERS;
+/**
+ * getcfcheckpt requests the filter headers at every 1000th block up to a stop block.
+ */
+extern const char *GETCFCHECKPT;
+/**
+ * cfcheckpt is the response to getcfcheckpt.
+ */
+extern const char *CFCHECKPT;
 };
 
 /* Get a vector of all valid message types (see above) */
 const std::vector<std::string> &getAllNetMessageTypes();
 
+/**
+ * Whether processing a message of this type runs no block or transaction validation.
+ * The message handler keeps serving these while its other threads wait for cs_main.
+ */
+bool IsLowLatencyMessageType(const std::string &msgType);
+
 /** nServices flags */
 enum ServiceFlags : uint64_t {
     // Nothing
@@ -292,6 +323,9 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // NODE_COMPACT_FILTERS means the node will serve the compact block filters of BIP 157, which
+    // in this chain also cover the Spark and Lelantus data of the blocks.
+    NODE_COMPACT_FILTERS = (1 << 6),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
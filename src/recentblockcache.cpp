@@ -0,0 +1,70 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "recentblockcache.h"
+
+#include "netmessagemaker.h"
+#include "version.h"
+
+CRecentBlockCache recentBlocks;
+
+CCachedBlock::CCachedBlock(const std::shared_ptr<const CBlock>& blockIn, const CSharedNetMsgRef& compactBlockMsgIn)
+    : hash(blockIn->GetHash()), block(blockIn), compactBlockMsg(compactBlockMsgIn)
+{
+}
+
+CSharedNetMsgRef CCachedBlock::GetBlockMsg() const
+{
+    CSharedNetMsgRef msg = std::atomic_load(&blockMsg);
+    if (!msg) {
+        // concurrent callers may both serialize it, they build the same message
+        msg = MakeSharedNetMsg(CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::BLOCK, *block));
+        std::atomic_store(&blockMsg, msg);
+    }
+    return msg;
+}
+
+CRecentBlockCache::CRecentBlockCache(size_t nMaxBlocksIn)
+    : blocks(std::make_shared<const BlockList>()), nMaxBlocks(nMaxBlocksIn)
+{
+}
+
+void CRecentBlockCache::Add(const CCachedBlockRef& cachedBlock)
+{
+    std::lock_guard<std::mutex> lock(cs_update);
+    std::shared_ptr<const BlockList> current = GetBlocks();
+
+    auto newBlocks = std::make_shared<BlockList>();
+    newBlocks->reserve(nMaxBlocks);
+    newBlocks->push_back(cachedBlock);
+    for (const CCachedBlockRef& b : *current) {
+        if (newBlocks->size() >= nMaxBlocks)
+            break;
+        if (b->hash != cachedBlock->hash)
+            newBlocks->push_back(b);
+    }
+    std::atomic_store(&blocks, std::shared_ptr<const BlockList>(std::move(newBlocks)));
+}
+
+CCachedBlockRef CRecentBlockCache::Get(const uint256& hash) const
+{
+    std::shared_ptr<const BlockList> current = GetBlocks();
+    for (const CCachedBlockRef& b : *current) {
+        if (b->hash == hash)
+            return b;
+    }
+    return nullptr;
+}
+
+CCachedBlockRef CRecentBlockCache::GetMostRecent() const
+{
+    std::shared_ptr<const BlockList> current = GetBlocks();
+    return current->empty() ? nullptr : current->front();
+}
+
+void CRecentBlockCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs_update);
+    std::atomic_store(&blocks, std::make_shared<const BlockList>());
+}
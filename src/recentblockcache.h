@@ -0,0 +1,77 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_RECENTBLOCKCACHE_H
+#define PRIVORA_RECENTBLOCKCACHE_H
+
+#include "net.h"
+#include "primitives/block.h"
+#include "uint256.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** Number of the most recent blocks kept by CRecentBlockCache */
+static const size_t DEFAULT_RECENT_BLOCKS = 8;
+
+/**
+ * A recent block in the forms it is served in: decoded for getblocktxn, filtered blocks
+ * and REST JSON, as a ready witness "cmpctblock" message and as a ready "block" message
+ * whose payload is the raw serialization.
+ */
+class CCachedBlock
+{
+private:
+    mutable CSharedNetMsgRef blockMsg;
+
+public:
+    const uint256 hash;
+    const std::shared_ptr<const CBlock> block;
+    const CSharedNetMsgRef compactBlockMsg;
+
+    CCachedBlock(const std::shared_ptr<const CBlock>& block, const CSharedNetMsgRef& compactBlockMsg);
+
+    /** The block message, serialized the first time it is asked for */
+    CSharedNetMsgRef GetBlockMsg() const;
+};
+typedef std::shared_ptr<const CCachedBlock> CCachedBlockRef;
+
+/**
+ * The last few blocks that passed the proof of work checks and extended our best chain
+ * candidate, most recent first. Readers take an immutable snapshot of the list through an
+ * atomic shared_ptr, so looking a block up never blocks on the validation thread adding
+ * one. Writers replace the whole list and are serialized among themselves.
+ */
+class CRecentBlockCache
+{
+private:
+    typedef std::vector<CCachedBlockRef> BlockList;
+
+    std::shared_ptr<const BlockList> blocks;
+    std::mutex cs_update;
+    const size_t nMaxBlocks;
+
+    std::shared_ptr<const BlockList> GetBlocks() const { return std::atomic_load(&blocks); }
+
+public:
+    explicit CRecentBlockCache(size_t nMaxBlocksIn = DEFAULT_RECENT_BLOCKS);
+
+    /** Add a block as the most recent one, dropping the oldest if the cache is full */
+    void Add(const CCachedBlockRef& cachedBlock);
+
+    /** The cached block with the given hash, null if it is not cached */
+    CCachedBlockRef Get(const uint256& hash) const;
+
+    /** The block added last, null if the cache is empty */
+    CCachedBlockRef GetMostRecent() const;
+
+    size_t Size() const { return GetBlocks()->size(); }
+
+    void Clear();
+};
+
+extern CRecentBlockCache recentBlocks;
+
+#endif // PRIVORA_RECENTBLOCKCACHE_H
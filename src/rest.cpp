@@ -3,14 +3,21 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilter.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "recentblockcache.h"
 #include "validation.h"
 #include "httpserver.h"
+#include "lelantus.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
+#include "spark/state.h"
+#include "spendlog.h"
 #include "streams.h"
+#include "txdb.h"
 #include "sync.h"
 #include "txmempool.h"
 #include "utilstrencodings.h"
@@ -21,6 +28,7 @@
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_SPENDLOG_ENTRIES = 10000; //max linking tags / serials returned per spend log page
 
 enum RetFormat {
     RF_UNDEF,
@@ -60,8 +68,10 @@ struct CCoin {
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void mempoolToJSON(CJSONStreamWriter& writer);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
@@ -213,8 +223,11 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
+    std::shared_ptr<const CBlock> pblock;
     CBlockIndex* pblockindex = NULL;
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    bool fRawBlock;
+    CCachedBlockRef cachedBlock;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -224,12 +237,32 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        // Binary and hex replies are the block as stored unless witness data has to be stripped
+        fRawBlock = rf != RF_JSON && (RPCSerializationFlags() == 0 || !IsWitnessEnabled(pblockindex->pprev, Params().GetConsensus()));
+
+        // Recent blocks are served from memory
+        cachedBlock = recentBlocks.Get(hash);
+        if (cachedBlock) {
+            pblock = cachedBlock->block;
+        } else if (fRawBlock) {
+            std::vector<unsigned char> rawBlock;
+            if (!ReadRawBlockFromDisk(rawBlock, pblockindex, Params().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            ssBlock.write((const char*)rawBlock.data(), rawBlock.size());
+        } else {
+            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockRead, pblockindex, Params().GetConsensus()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            pblock = pblockRead;
+        }
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (fRawBlock && cachedBlock) {
+        CSharedNetMsgRef blockMsg = cachedBlock->GetBlockMsg();
+        ssBlock.write((const char*)blockMsg->data.data(), blockMsg->data.size());
+    } else if (!fRawBlock && rf != RF_JSON) {
+        ssBlock << *pblock;
+    }
 
     switch (rf) {
     case RF_BINARY: {
@@ -247,10 +280,13 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        req->StartReply(HTTP_OK);
+        CJSONStreamWriter writer([req](std::string&& chunk) { req->WriteReplyChunk(std::move(chunk)); });
+        blockToJSON(writer, *pblock, pblockindex, showTxDetails);
+        writer.WriteRaw("\n");
+        writer.Flush();
+        req->EndReply();
         return true;
     }
 
@@ -336,11 +372,13 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        req->StartReply(HTTP_OK);
+        CJSONStreamWriter writer([req](std::string&& chunk) { req->WriteReplyChunk(std::move(chunk)); });
+        mempoolToJSON(writer);
+        writer.WriteRaw("\n");
+        writer.Flush();
+        req->EndReply();
         return true;
     }
     default: {
@@ -591,6 +629,252 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_blockfilter(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilter/<filtertype>/<blockhash>.<ext>.");
+
+    BlockFilterType filterType;
+    if (!BlockFilterTypeByName(path[0], filterType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + path[0]);
+
+    uint256 hash;
+    if (!ParseHashStr(path[1], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    if (!fBlockFilterIndex)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block filters are not available, enable -blockfilterindex");
+
+    BlockFilter filter;
+    if (!pblocktree->ReadBlockFilter(filterType, hash, filter))
+        return RESTERR(req, HTTP_NOT_FOUND, "Filter not found for block " + path[1]);
+
+    CDataStream ssFilter(SER_NETWORK, PROTOCOL_VERSION);
+    ssFilter << filter;
+
+    switch (rf) {
+    case RF_BINARY: {
+        std::string binaryFilter = ssFilter.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryFilter);
+        return true;
+    }
+
+    case RF_HEX: {
+        std::string strHex = HexStr(ssFilter.begin(), ssFilter.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue objFilter(UniValue::VOBJ);
+        objFilter.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+        std::string strJSON = objFilter.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_blockfilterheaders(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilterheaders/<filtertype>/<count>/<blockhash>.<ext>.");
+
+    BlockFilterType filterType;
+    if (!BlockFilterTypeByName(path[0], filterType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + path[0]);
+
+    long count = strtol(path[1].c_str(), NULL, 10);
+    if (count < 1 || count > 2000)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[1]);
+
+    uint256 hash;
+    if (!ParseHashStr(path[2], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[2]);
+
+    if (!fBlockFilterIndex)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block filters are not available, enable -blockfilterindex");
+
+    std::vector<uint256> blockHashes;
+    blockHashes.reserve(count);
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        const CBlockIndex *pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
+        while (pindex != NULL && chainActive.Contains(pindex)) {
+            blockHashes.push_back(pindex->GetBlockHash());
+            if (blockHashes.size() == (unsigned long)count)
+                break;
+            pindex = chainActive.Next(pindex);
+        }
+    }
+
+    std::vector<uint256> filterHeaders;
+    filterHeaders.reserve(blockHashes.size());
+    for (const uint256& blockHash : blockHashes) {
+        uint256 filterHeader;
+        if (!pblocktree->ReadBlockFilterHeader(filterType, blockHash, filterHeader))
+            return RESTERR(req, HTTP_NOT_FOUND, "Filter header not found for block " + blockHash.GetHex());
+        filterHeaders.push_back(filterHeader);
+    }
+
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    for (const uint256& filterHeader : filterHeaders)
+        ssHeader << filterHeader;
+
+    switch (rf) {
+    case RF_BINARY: {
+        std::string binaryHeader = ssHeader.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryHeader);
+        return true;
+    }
+
+    case RF_HEX: {
+        std::string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue jsonHeaders(UniValue::VARR);
+        for (const uint256& filterHeader : filterHeaders)
+            jsonHeaders.push_back(filterHeader.GetHex());
+        std::string strJSON = jsonHeaders.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+/**
+ * Page through a spend log with a (height, offset in height) cursor. The binary reply is
+ * the tip height and hash, the cursor of the next page and the entries (height, value).
+ */
+template <typename T>
+static bool rest_spendlog(HTTPRequest* req, const std::string& strURIPart, const CSpendLog<T>& spendLog, const std::string& strUsage)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No cursor specified. Use " + strUsage);
+
+    int32_t nHeight, nOffset;
+    if (!ParseInt32(path[0], &nHeight) || nHeight < 0 || !ParseInt32(path[1], &nOffset) || nOffset < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid cursor: " + param);
+
+    std::vector<typename CSpendLog<T>::Entry> entries;
+    int32_t nTipHeight, nNextHeight;
+    uint32_t nNextOffset;
+    uint256 tipHash;
+    {
+        LOCK(cs_main);
+        int nNext;
+        nTipHeight = chainActive.Height();
+        entries = spendLog.Read(nHeight, nOffset, MAX_SPENDLOG_ENTRIES, nTipHeight, nNext, nNextOffset);
+        nNextHeight = nNext;
+        tipHash = chainActive.Tip()->GetBlockHash();
+    }
+
+    CDataStream ssLog(SER_NETWORK, PROTOCOL_VERSION);
+    ssLog << nTipHeight << tipHash << nNextHeight << nNextOffset << entries;
+
+    switch (rf) {
+    case RF_BINARY: {
+        std::string binaryLog = ssLog.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryLog);
+        return true;
+    }
+
+    case RF_HEX: {
+        std::string strHex = HexStr(ssLog.begin(), ssLog.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue objLog(UniValue::VOBJ);
+        objLog.push_back(Pair("tipheight", nTipHeight));
+        objLog.push_back(Pair("tiphash", tipHash.GetHex()));
+        UniValue objNext(UniValue::VOBJ);
+        objNext.push_back(Pair("height", nNextHeight));
+        objNext.push_back(Pair("offset", (int64_t)nNextOffset));
+        objLog.push_back(Pair("next", objNext));
+        UniValue arrEntries(UniValue::VARR);
+        for (const auto& entry : entries) {
+            CDataStream ssValue(SER_NETWORK, PROTOCOL_VERSION);
+            ssValue << entry.value;
+            UniValue objEntry(UniValue::VOBJ);
+            objEntry.push_back(Pair("height", entry.nHeight));
+            objEntry.push_back(Pair("value", HexStr(ssValue.begin(), ssValue.end())));
+            arrEntries.push_back(objEntry);
+        }
+        objLog.push_back(Pair("entries", arrEntries));
+
+        std::string strJSON = objLog.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_spark_usedtags(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_spendlog(req, strURIPart, spark::CSparkState::GetState()->GetSpendLog(),
+                         "/rest/spark/usedtags/<height>/<offset>.<ext>.");
+}
+
+static bool rest_lelantus_usedserials(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_spendlog(req, strURIPart, lelantus::CLelantusState::GetState()->GetSpendLog(),
+                         "/rest/lelantus/usedserials/<height>/<offset>.<ext>.");
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -603,6 +887,10 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/blockfilter/", rest_blockfilter},
+      {"/rest/blockfilterheaders/", rest_blockfilterheaders},
+      {"/rest/spark/usedtags/", rest_spark_usedtags},
+      {"/rest/lelantus/usedserials/", rest_lelantus_usedserials},
 };
 
 bool StartREST()
@@ -11,9 +11,12 @@
 #include "core_io.h"
 #include "consensus/validation.h"
 #include "validation.h"
+#include "net.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
+#include "statesnapshot.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
@@ -112,9 +115,9 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/** The fields of a block's JSON before and after its "tx" array */
+static void blockFieldsToJSON(const CBlock& block, const CBlockIndex* blockindex, UniValue& result, UniValue& tail)
 {
-    UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
@@ -128,38 +131,62 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
-    for(const auto& tx : block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(*tx, uint256(), objTx);
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx->GetHash().GetHex());
-    }
-    result.push_back(Pair("tx", txs));
+
     if (!block.vtx[0]->vExtraPayload.empty()) {
-        CbtxToJson(*block.vtx[0], result);
+        CbtxToJson(*block.vtx[0], tail);
     }
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    tail.push_back(Pair("time", block.GetBlockTime()));
+    tail.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    tail.push_back(Pair("nonce", (uint64_t)block.nNonce));
+    tail.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    tail.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    tail.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+        tail.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
     CBlockIndex *pnext = chainActive.Next(blockindex);
     if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-    result.push_back(Pair("chainlock", llmq::chainLocksHandler->HasChainLock(blockindex->nHeight, blockindex->GetBlockHash())));
+        tail.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    tail.push_back(Pair("chainlock", llmq::chainLocksHandler->HasChainLock(blockindex->nHeight, blockindex->GetBlockHash())));
+}
+
+static UniValue blockTxToJSON(const CTransaction& tx, bool txDetails)
+{
+    if (!txDetails)
+        return tx.GetHash().GetHex();
+    UniValue objTx(UniValue::VOBJ);
+    TxToJSON(tx, uint256(), objTx);
+    return objTx;
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    UniValue result(UniValue::VOBJ), tail(UniValue::VOBJ);
+    blockFieldsToJSON(block, blockindex, result, tail);
+    UniValue txs(UniValue::VARR);
+    for(const auto& tx : block.vtx)
+        txs.push_back(blockTxToJSON(*tx, txDetails));
+    result.push_back(Pair("tx", txs));
+    result.pushKVs(tail);
     return result;
 }
 
+/** Write the same as blockToJSON, one transaction at a time */
+void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    UniValue head(UniValue::VOBJ), tail(UniValue::VOBJ);
+    blockFieldsToJSON(block, blockindex, head, tail);
+    writer.BeginObject();
+    writer.KeyValues(head);
+    writer.Key("tx");
+    writer.BeginArray();
+    for (const auto& tx : block.vtx)
+        writer.Value(blockTxToJSON(*tx, txDetails));
+    writer.EndArray();
+    writer.KeyValues(tail);
+    writer.EndObject();
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -495,6 +522,20 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.push_back(Pair("instantlock", llmq::quorumInstantSendManager->IsLocked(tx.GetHash())));
 }
 
+/** Write the same as mempoolToJSON(true), one entry at a time */
+void mempoolToJSON(CJSONStreamWriter& writer)
+{
+    LOCK(mempool.cs);
+    writer.BeginObject();
+    BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+    {
+        UniValue info(UniValue::VOBJ);
+        entryToJSON(info, e);
+        writer.KeyValue(e.GetTx().GetHash().ToString(), info);
+    }
+    writer.EndObject();
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose)
@@ -552,6 +593,10 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (request.params.size() > 0)
         fVerbose = request.params[0].get_bool();
 
+    if (fVerbose && request.replyStream) {
+        mempoolToJSON(request.replyStream->BeginResult());
+        return NullUniValue;
+    }
     return mempoolToJSON(fVerbose);
 }
 
@@ -943,6 +988,10 @@ UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
+    if (request.replyStream) {
+        blockToJSON(request.replyStream->BeginResult(), block, pblockindex);
+        return NullUniValue;
+    }
     return blockToJSON(block, pblockindex);
 }
 
@@ -1128,6 +1177,86 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue StateSnapshotToJSON(const boost::filesystem::path& path, const CStateSnapshotMetadata& metadata, const uint256& contentHash)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("blockhash", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("height", metadata.nHeight));
+    ret.push_back(Pair("contenthash", contentHash.GetHex()));
+    return ret;
+}
+
+UniValue dumpstatesnapshot(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumpstatesnapshot \"path\"\n"
+            "\nWrites the chain state at the tip (block index with the Sigma, Lelantus and Spark sets and\n"
+            "Spark names, masternode lists, LLMQ commitments and coins) to a snapshot file another node\n"
+            "can start from with loadstatesnapshot.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",          (string) The file written\n"
+            "  \"blockhash\": \"hash\",     (string) The block the snapshot was taken at\n"
+            "  \"height\": n,             (numeric) Its height\n"
+            "  \"contenthash\": \"hash\",   (string) The content hash, to check or pin the snapshot with\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumpstatesnapshot", "\"snapshot.dat\"")
+            + HelpExampleRpc("dumpstatesnapshot", "\"snapshot.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+    CStateSnapshotMetadata metadata;
+    uint256 contentHash;
+    std::string strError;
+    if (!DumpStateSnapshot(path, metadata, contentHash, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return StateSnapshotToJSON(path, metadata, contentHash);
+}
+
+UniValue loadstatesnapshot(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "loadstatesnapshot \"path\" ( trusted )\n"
+            "\nStarts the chain from a snapshot written by dumpstatesnapshot: its block becomes the tip and\n"
+            "the node goes on syncing from there. Only possible before any block was connected and without\n"
+            "-txindex, -addressindex, -spentindex or -timestampindex. Blocks before the snapshot are not\n"
+            "downloaded, the node can neither serve them nor reorganize below the snapshot.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The snapshot file, relative to the data directory if not absolute\n"
+            "2. trusted     (boolean, optional, default=false) Load a snapshot at a height no snapshot is pinned at\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",          (string) The file loaded\n"
+            "  \"blockhash\": \"hash\",     (string) The block the snapshot was taken at\n"
+            "  \"height\": n,             (numeric) Its height\n"
+            "  \"contenthash\": \"hash\",   (string) The content hash of the snapshot\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadstatesnapshot", "\"snapshot.dat\"")
+            + HelpExampleRpc("loadstatesnapshot", "\"snapshot.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+    bool fTrusted = request.params.size() > 1 && request.params[1].get_bool();
+    CStateSnapshotMetadata metadata;
+    uint256 contentHash;
+    std::string strError;
+    if (!LoadStateSnapshot(path, fTrusted, metadata, contentHash, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    // the blocks before the snapshot can not be served
+    if (g_connman)
+        g_connman->RemoveLocalServices(NODE_NETWORK);
+    return StateSnapshotToJSON(path, metadata, contentHash);
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1747,30 +1876,32 @@ UniValue getspecialtxes(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafe argNames
-  //  --------------------- ------------------------  -----------------------  ------ ----------
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {} },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
-    { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
-    { "blockchain",         "getsparknamedata",       &getsparknamedata,       true,  {"sparkname"} },
-    { "blockchain",         "getsparknametxdetails",  &getsparknametxdetails,  true,  {"txhash"} },
-    { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbose"} },
-    { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
-    { "blockchain",         "getblockhashes",         &getblockhashes,         true,  {"high", "low"} },
-    { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
-    { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
-    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
-    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true,  {"txid","verbose"} },
-    { "blockchain",         "getmempoolentry",        &getmempoolentry,        true,  {"txid"} },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
+{ //  category              name                      actor (function)         okSafe argNames readOnly
+  //  --------------------- ------------------------  -----------------------  ------ -------- --------
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {}, true },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {}, true },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  {}, true },
+    { "blockchain",         "getsparknamedata",       &getsparknamedata,       true,  {"sparkname"}, true },
+    { "blockchain",         "getsparknametxdetails",  &getsparknametxdetails,  true,  {"txhash"}, true },
+    { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbose"}, true },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"}, true },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true,  {"high", "low"}, true },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"}, true },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,  {}, true },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {}, true },
+    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"}, true },
+    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true,  {"txid","verbose"}, true },
+    { "blockchain",         "getmempoolentry",        &getmempoolentry,        true,  {"txid"}, true },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {}, true },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"}, true },
     { "blockchain",         "clearmempool",           &clearmempool,           true,  {} },
-    { "blockchain",         "getspecialtxes",         &getspecialtxes,         true,  {"blockhash", "type", "count", "skip", "verbosity"} },
-    { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
+    { "blockchain",         "getspecialtxes",         &getspecialtxes,         true,  {"blockhash", "type", "count", "skip", "verbosity"}, true },
+    { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"}, true },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
+    { "blockchain",         "dumpstatesnapshot",      &dumpstatesnapshot,      true,  {"path"} },
+    { "blockchain",         "loadstatesnapshot",      &loadstatesnapshot,      true,  {"path","trusted"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          true,  {"blockhash"} },
 
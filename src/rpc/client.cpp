@@ -31,6 +31,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
 {
     { "stop", 0 },
     { "setmocktime", 0, "timestamp" },
+    { "getperfstats", 1, "reset" },
     { "getaddednodeinfo", 0 },
     { "generate", 0, "nblocks" },
     { "generate", 1, "maxtries" },
@@ -120,6 +121,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "importmulti", 1, "options" },
     { "verifychain", 0, "checklevel" },
     { "verifychain", 1, "nblocks" },
+    { "loadstatesnapshot", 1, "trusted" },
     { "pruneblockchain", 0, "height" },
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
@@ -203,6 +205,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "mintspark", 2 },
     { "spendspark", 0 },
     { "spendspark", 1 },
+    { "queuesparkwithdrawal", 1 },
+    { "queuesparkwithdrawal", 2 },
 
     // Spark names
     { "registersparkname", 2 },
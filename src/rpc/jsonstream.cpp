@@ -0,0 +1,127 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include "mbstring.h"
+
+#include <assert.h>
+
+CJSONStreamWriter::CJSONStreamWriter(ChunkSink sinkIn, bool fSanitizeIn, size_t nChunkSizeIn)
+    : sink(std::move(sinkIn)), fSanitize(fSanitizeIn), nChunkSize(nChunkSizeIn), fAfterKey(false)
+{
+    buffer.reserve(nChunkSize);
+}
+
+void CJSONStreamWriter::Append(const std::string& str)
+{
+    // every piece ends in an ASCII character, so sanitizing them one by one gives the same
+    // result as sanitizing the whole text
+    buffer += fSanitize ? SanitizeInvalidUTF8(str) : str;
+    if (buffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::BeginElement()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vHasElement.empty()) {
+        if (vHasElement.back())
+            buffer += ',';
+        vHasElement.back() = true;
+    }
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    BeginElement();
+    buffer += '{';
+    vHasElement.push_back(false);
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vHasElement.empty() && !fAfterKey);
+    vHasElement.pop_back();
+    buffer += '}';
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    BeginElement();
+    buffer += '[';
+    vHasElement.push_back(false);
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vHasElement.empty() && !fAfterKey);
+    vHasElement.pop_back();
+    buffer += ']';
+}
+
+void CJSONStreamWriter::Key(const std::string& key)
+{
+    BeginElement();
+    Append(UniValue(key).write() + ":");
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    BeginElement();
+    Append(value.write());
+}
+
+void CJSONStreamWriter::KeyValue(const std::string& key, const UniValue& value)
+{
+    Key(key);
+    Value(value);
+}
+
+void CJSONStreamWriter::KeyValues(const UniValue& obj)
+{
+    for (size_t i = 0; i < obj.size(); i++)
+        KeyValue(obj.getKeys()[i], obj.getValues()[i]);
+}
+
+void CJSONStreamWriter::WriteRaw(const std::string& str)
+{
+    Append(str);
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (buffer.empty())
+        return;
+    std::string chunk;
+    chunk.reserve(nChunkSize);
+    chunk.swap(buffer);
+    sink(std::move(chunk));
+}
+
+CRPCReplyStream::CRPCReplyStream(const UniValue& idIn, std::function<void()> startReplyIn, CJSONStreamWriter::ChunkSink sink, bool fSanitize)
+    : startReply(std::move(startReplyIn)), writer(std::move(sink), fSanitize), id(idIn), fStarted(false)
+{
+}
+
+CJSONStreamWriter& CRPCReplyStream::BeginResult()
+{
+    assert(!fStarted);
+    fStarted = true;
+    startReply();
+    // same layout as JSONRPCReply()
+    writer.WriteRaw("{\"result\":");
+    return writer;
+}
+
+void CRPCReplyStream::EndResult()
+{
+    assert(fStarted);
+    writer.WriteRaw(",\"error\":null,\"id\":" + id.write() + "}\n");
+    writer.Flush();
+}
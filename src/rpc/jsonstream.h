@@ -0,0 +1,84 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_RPC_JSONSTREAM_H
+#define PRIVORA_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+//! Size of the chunks a CJSONStreamWriter passes on
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes JSON in exactly the compact form of UniValue::write() while it is produced, and passes
+ * it on in chunks of about JSON_STREAM_CHUNK_SIZE bytes. Large replies are written one element
+ * at a time, so that neither their whole UniValue tree nor their whole text is ever in memory.
+ *
+ * Commas are inserted as needed; inside an object every value has to be preceded by a Key().
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef std::function<void(std::string&&)> ChunkSink;
+
+private:
+    ChunkSink sink;
+    bool fSanitize;
+    size_t nChunkSize;
+    std::string buffer;
+    //! Whether the open arrays/objects already have an element
+    std::vector<bool> vHasElement;
+    bool fAfterKey;
+
+    void BeginElement();
+    void Append(const std::string& str);
+
+public:
+    /** Pass the output to sink. If fSanitize is set, invalid UTF-8 is replaced as by SanitizeInvalidUTF8 */
+    CJSONStreamWriter(ChunkSink sinkIn, bool fSanitizeIn = false, size_t nChunkSizeIn = JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+    void KeyValue(const std::string& key, const UniValue& value);
+    /** Write all the keys and values of obj into the open object */
+    void KeyValues(const UniValue& obj);
+
+    /** Write str as it is */
+    void WriteRaw(const std::string& str);
+    /** Pass on what is buffered */
+    void Flush();
+};
+
+/**
+ * A JSON-RPC reply that a method can write its result into as it goes, offered by transports
+ * that can send a reply in pieces through JSONRPCRequest::replyStream. A method that uses it
+ * calls BeginResult() once it can no longer fail, writes exactly one value and returns
+ * NullUniValue; the transport then finishes the reply with EndResult().
+ */
+class CRPCReplyStream
+{
+private:
+    std::function<void()> startReply;
+    CJSONStreamWriter writer;
+    UniValue id;
+    bool fStarted;
+
+public:
+    CRPCReplyStream(const UniValue& idIn, std::function<void()> startReplyIn, CJSONStreamWriter::ChunkSink sink, bool fSanitize);
+
+    CJSONStreamWriter& BeginResult();
+    void EndResult();
+    bool IsStarted() const { return fStarted; }
+};
+
+#endif // PRIVORA_RPC_JSONSTREAM_H
@@ -9,6 +9,8 @@
 #include "validation.h"
 #include "net.h"
 #include "netbase.h"
+#include "perfstats.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "timedata.h"
 #include "txmempool.h"
@@ -730,6 +732,205 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+namespace {
+/** Read the height range of an address index query, either end may be left out */
+void parseHeightRange(const UniValue& params, int& start, int& end)
+{
+    start = 0;
+    end = 0;
+    if (!params[0].isObject())
+        return;
+    UniValue startValue = find_value(params[0].get_obj(), "start");
+    UniValue endValue = find_value(params[0].get_obj(), "end");
+    if (startValue.isNum())
+        start = std::max(startValue.get_int(), 0);
+    if (endValue.isNum())
+        end = std::max(endValue.get_int(), 0);
+    if (start > 0 && end > 0 && end < start) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
+    }
+}
+
+/** Read the page size and the cursor of an address index query, a limit of 0 asks for everything at once */
+void parsePagination(const UniValue& params, unsigned int& limit, std::string& cursor)
+{
+    limit = 0;
+    cursor.clear();
+    if (!params[0].isObject())
+        return;
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (!limitValue.isNull()) {
+        if (limitValue.get_int() <= 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be positive");
+        limit = limitValue.get_int();
+    }
+    if (!cursorValue.isNull()) {
+        if (limit == 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "A cursor needs a limit");
+        cursor = cursorValue.get_str();
+    }
+}
+
+/** A cursor is the hex encoded key of the address index entry a page continues with */
+template <typename Key>
+std::string encodeAddressCursor(const Key& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return HexStr(ss.begin(), ss.end());
+}
+
+/** Decode a cursor, and find the address in addresses it continues with */
+template <typename Key>
+Key decodeAddressCursor(const std::string& cursor, const std::vector<std::pair<uint160, AddressType> >& addresses, size_t& addressIdx)
+{
+    if (!IsHex(cursor))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    CDataStream ss(ParseHex(cursor), SER_DISK, CLIENT_VERSION);
+    Key key;
+    try {
+        ss >> key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (!ss.empty())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+
+    for (addressIdx = 0; addressIdx < addresses.size(); addressIdx++) {
+        if (addresses[addressIdx].first == key.hashBytes && addresses[addressIdx].second == key.type)
+            return key;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to the addresses");
+}
+
+/** Fail the way the index lookups would without the address index, before a result is started */
+void checkAddressIndex()
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+}
+
+/** Where a query of the address index starts: the first address, or the entry a cursor points at */
+struct CAddressIndexStart
+{
+    size_t addressIdx;
+    bool fCursor;
+    CAddressIndexIteratorTxKey from;
+
+    CAddressIndexStart() : addressIdx(0), fCursor(false) {}
+};
+
+/** Check the address index is there and decode cursor, so that nothing fails once a result is started */
+CAddressIndexStart parseAddressIndexStart(const std::string& cursor, const std::vector<std::pair<uint160, AddressType> >& addresses)
+{
+    checkAddressIndex();
+    CAddressIndexStart first;
+    if (!cursor.empty()) {
+        first.from = decodeAddressCursor<CAddressIndexIteratorTxKey>(cursor, addresses, first.addressIdx);
+        first.fCursor = true;
+    }
+    return first;
+}
+
+/**
+ * The result of an address index query: the array of entries or, for a paginated query, an
+ * object with the entries under a name and the cursor of the next page. The entries are
+ * written out as they are read from the index when the transport can stream the reply, so
+ * that a query never holds all of them. Nothing may fail between creating it and Finish().
+ */
+class CAddressQueryResult
+{
+private:
+    std::string name;
+    bool fPaginated;
+    CJSONStreamWriter* writer;
+    UniValue entries;
+
+public:
+    CAddressQueryResult(const JSONRPCRequest& request, const std::string& nameIn, bool fPaginatedIn)
+        : name(nameIn), fPaginated(fPaginatedIn), writer(nullptr), entries(UniValue::VARR)
+    {
+        if (request.replyStream) {
+            writer = &request.replyStream->BeginResult();
+            if (fPaginated) {
+                writer->BeginObject();
+                writer->Key(name);
+            }
+            writer->BeginArray();
+        }
+    }
+
+    void Add(const UniValue& entry)
+    {
+        if (writer)
+            writer->Value(entry);
+        else
+            entries.push_back(entry);
+    }
+
+    /** Finish the result, next is the cursor of the next page or empty on the last one */
+    UniValue Finish(const std::string& next)
+    {
+        UniValue nextValue = next.empty() ? NullUniValue : UniValue(next);
+        if (writer) {
+            writer->EndArray();
+            if (fPaginated) {
+                writer->KeyValue("next", nextValue);
+                writer->EndObject();
+            }
+            return NullUniValue;
+        }
+        if (!fPaginated)
+            return entries;
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair(name, entries));
+        result.push_back(Pair("next", nextValue));
+        return result;
+    }
+};
+
+/**
+ * Visit the address index entries of addresses in the height range, one page of about limit
+ * entries (of which, if fTxids is set, only one per transaction counts) from first on if
+ * limit is positive. Pages end between transactions, the cursor of the next one is returned.
+ */
+std::string visitAddressIndex(const std::vector<std::pair<uint160, AddressType> >& addresses, int start, int end,
+                              unsigned int limit, const CAddressIndexStart& first, bool fTxids,
+                              const std::function<void(size_t, const CAddressIndexKey&, CAmount, bool)>& visit)
+{
+    CAddressIndexIteratorTxKey from = first.from;
+    std::string next;
+    unsigned int count = 0;
+    for (size_t i = first.addressIdx; i < addresses.size() && next.empty(); i++) {
+        if (!first.fCursor || i != first.addressIdx)
+            from = CAddressIndexIteratorTxKey(addresses[i].second, addresses[i].first, start, 0);
+
+        bool fInTx = false;
+        int lastHeight = 0;
+        unsigned int lastTxIndex = 0;
+        auto visitEntry = [&](const CAddressIndexKey& key, CAmount amount) {
+            bool fNewTx = !fInTx || key.blockHeight != lastHeight || key.txindex != lastTxIndex;
+            if (limit > 0 && count >= limit && fNewTx) {
+                next = encodeAddressCursor(CAddressIndexIteratorTxKey(key.type, key.hashBytes, key.blockHeight, key.txindex));
+                return false;
+            }
+            if (fNewTx || !fTxids)
+                count++;
+            fInTx = true;
+            lastHeight = key.blockHeight;
+            lastTxIndex = key.txindex;
+            visit(i, key, amount, fNewTx);
+            return true;
+        };
+        if (!GetAddressIndex(from, end, visitEntry)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+    return next;
+}
+}
+
 UniValue getaddressmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -813,6 +1014,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
                         "      \"address\"  (string) The base58check encoded address\n"
                         "      ,...\n"
                         "    ]\n"
+                        "  \"limit\" (number, optional) Return a page of at most this many outputs\n"
+                        "  \"cursor\" (string, optional) The cursor of the page to return, as returned with the page before\n"
                         "}\n"
                         "\nResult\n"
                         "[\n"
@@ -825,6 +1028,11 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
                         "    \"height\"  (number) The block height\n"
                         "  }\n"
                         "]\n"
+                        "\nResult with a limit (outputs ordered by address and outpoint instead of height)\n"
+                        "{\n"
+                        "  \"utxos\"  (array) The outputs as above\n"
+                        "  \"next\"  (string) The cursor of the next page, null on the last page\n"
+                        "}\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
                 + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -836,6 +1044,56 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    unsigned int limit;
+    std::string cursor;
+    parsePagination(request.params, limit, cursor);
+
+    auto outputToJSON = [](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+        UniValue output(UniValue::VOBJ);
+        std::string address;
+        if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+
+        output.push_back(Pair("address", address));
+        output.push_back(Pair("txid", key.txhash.GetHex()));
+        output.push_back(Pair("outputIndex", (int)key.index));
+        output.push_back(Pair("script", HexStr(value.script.begin(), value.script.end())));
+        output.push_back(Pair("satoshis", value.satoshis));
+        output.push_back(Pair("height", value.blockHeight));
+        return output;
+    };
+
+    if (limit > 0) {
+        // pages go through the outputs in the order of the index, so that they can be continued from a cursor
+        size_t firstIdx = 0;
+        CAddressUnspentKey from;
+        if (!cursor.empty())
+            from = decodeAddressCursor<CAddressUnspentKey>(cursor, addresses, firstIdx);
+        checkAddressIndex();
+
+        CAddressQueryResult result(request, "utxos", true);
+        std::string next;
+        unsigned int count = 0;
+        for (size_t i = firstIdx; i < addresses.size() && next.empty(); i++) {
+            if (cursor.empty() || i != firstIdx)
+                from = CAddressUnspentKey(addresses[i].second, addresses[i].first, uint256(), 0);
+            auto visitOutput = [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+                if (count >= limit) {
+                    next = encodeAddressCursor(key);
+                    return false;
+                }
+                result.Add(outputToJSON(key, value));
+                count++;
+                return true;
+            };
+            if (!GetAddressUnspent(from, visitOutput)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+        return result.Finish(next);
+    }
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
     for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -849,19 +1107,7 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
-        UniValue output(UniValue::VOBJ);
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        output.push_back(Pair("address", address));
-        output.push_back(Pair("txid", it->first.txhash.GetHex()));
-        output.push_back(Pair("outputIndex", (int)it->first.index));
-        output.push_back(Pair("script", HexStr(it->second.script.begin(), it->second.script.end())));
-        output.push_back(Pair("satoshis", it->second.satoshis));
-        output.push_back(Pair("height", it->second.blockHeight));
-        result.push_back(output);
+        result.push_back(outputToJSON(it->first, it->second));
     }
 
     return result;
@@ -880,8 +1126,10 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         "      \"address\"  (string) The base58check encoded address\n"
                         "      ,...\n"
                         "    ]\n"
-                        "  \"start\" (number) The start block height\n"
-                        "  \"end\" (number) The end block height\n"
+                        "  \"start\" (number, optional) The start block height\n"
+                        "  \"end\" (number, optional) The end block height\n"
+                        "  \"limit\" (number, optional) Return a page of about this many changes, pages end between transactions\n"
+                        "  \"cursor\" (string, optional) The cursor of the page to return, as returned with the page before\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
@@ -894,25 +1142,23 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         "    \"address\"  (string) The base58check encoded address\n"
                         "  }\n"
                         "]\n"
+                        "\nResult with a limit:\n"
+                        "{\n"
+                        "  \"deltas\"  (array) The changes as above\n"
+                        "  \"next\"  (string) The cursor of the next page, null on the last page\n"
+                        "}\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
                 + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
 
-    UniValue startValue = find_value(request.params[0].get_obj(), "start");
-    UniValue endValue = find_value(request.params[0].get_obj(), "end");
+    int start, end;
+    parseHeightRange(request.params, start, end);
 
-    int start = 0;
-    int end = 0;
-
-    if (startValue.isNum() && endValue.isNum()) {
-        start = startValue.get_int();
-        end = endValue.get_int();
-        if (end < start) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
-        }
-    }
+    unsigned int limit;
+    std::string cursor;
+    parsePagination(request.params, limit, cursor);
 
     std::vector<std::pair<uint160, AddressType> > addresses;
 
@@ -920,39 +1166,31 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
-
-    UniValue result(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+    std::vector<std::string> deltaAddresses;
+    deltaAddresses.reserve(addresses.size());
+    for (std::vector<std::pair<uint160, AddressType> >::const_iterator it=addresses.begin(); it!=addresses.end(); it++) {
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+        if (!getAddressFromIndex(it->second, it->first, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
-
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
-    }
-
-    return result;
+        deltaAddresses.push_back(address);
+    }
+
+    CAddressIndexStart first = parseAddressIndexStart(cursor, addresses);
+    CAddressQueryResult result(request, "deltas", limit > 0);
+    std::string next = visitAddressIndex(addresses, start, end, limit, first, false,
+            [&](size_t addressIdx, const CAddressIndexKey& key, CAmount amount, bool fNewTx) {
+                UniValue delta(UniValue::VOBJ);
+                delta.push_back(Pair("satoshis", amount));
+                delta.push_back(Pair("txid", key.txhash.GetHex()));
+                delta.push_back(Pair("index", (int)key.index));
+                delta.push_back(Pair("blockindex", (int)key.txindex));
+                delta.push_back(Pair("height", key.blockHeight));
+                delta.push_back(Pair("address", deltaAddresses[addressIdx]));
+                result.Add(delta);
+            });
+
+    return result.Finish(next);
 }
 
 UniValue getaddressbalance(const JSONRPCRequest& request)
@@ -985,22 +1223,16 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalance addressBalance;
+        if (!GetAddressBalance((*it).first, (*it).second, addressBalance)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += addressBalance.balance;
+        received += addressBalance.received;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -1132,7 +1364,7 @@ UniValue getmintmetadata(const JSONRPCRequest& request)
     if (!mintValues.isArray()) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "mints is expected to be an array");
     }
-    lelantus::CLelantusState* lelantusState = lelantus::CLelantusState::GetState();
+    auto lelantusSnapshot = lelantus::CLelantusState::GetState()->GetSnapshot();
     UniValue ret(UniValue::VARR);
     for(UniValue const & mintData : mintValues.getValues()){
         std::vector<unsigned char> serializedCoin = ParseHex(find_value(mintData, "pubcoin").get_str().c_str());
@@ -1140,11 +1372,7 @@ UniValue getmintmetadata(const JSONRPCRequest& request)
         secp_primitives::GroupElement pubCoin;
         pubCoin.deserialize(serializedCoin.data());
 
-        std::pair<int, int> coinHeightAndId;
-        {
-            LOCK(cs_main);
-            coinHeightAndId = lelantusState->GetMintedCoinHeightAndId(lelantus::PublicCoin(pubCoin));
-        }
+        std::pair<int, int> coinHeightAndId = lelantusSnapshot->GetMintedCoinHeightAndId(lelantus::PublicCoin(pubCoin));
         UniValue metaData(UniValue::VOBJ);
         metaData.pushKV(std::to_string(coinHeightAndId.first), coinHeightAndId.second);
         ret.push_back(metaData);
@@ -1179,7 +1407,7 @@ UniValue getusedcoinserials(const JSONRPCRequest& request)
     std::unordered_map<Scalar, int>  serials;
     {
         LOCK(cs_main);
-        serials = lelantusState->GetSpends();
+        serials = lelantusState->GetAllSpends();
     }
 
     UniValue serializedSerials(UniValue::VARR);
@@ -1234,12 +1462,7 @@ UniValue getlatestcoinid(const JSONRPCRequest& request)
                 "}\n"
         );
 
-    lelantus::CLelantusState* lelantusState = lelantus::CLelantusState::GetState();
-    int latestCoinId;
-    {
-        LOCK(cs_main);
-        latestCoinId = lelantusState->GetLatestCoinID();
-    }
+    int latestCoinId = lelantus::CLelantusState::GetState()->GetSnapshot()->GetLatestCoinID();
 
     return UniValue(latestCoinId);
 }
@@ -1296,10 +1519,7 @@ UniValue getsparkanonymityset(const JSONRPCRequest& request)
                 setHash);
     }
 
-    UniValue ret(UniValue::VOBJ);
-    UniValue mints(UniValue::VARR);
-
-    for (const auto& coin : coins) {
+    auto coinToJSON = [](const std::pair<spark::Coin, std::pair<uint256, std::vector<unsigned char>>>& coin) {
         CDataStream serializedCoin(SER_NETWORK, PROTOCOL_VERSION);
         serializedCoin << coin;
         std::vector<unsigned char> vch(serializedCoin.begin(), serializedCoin.end());
@@ -1311,9 +1531,29 @@ UniValue getsparkanonymityset(const JSONRPCRequest& request)
 
         UniValue entity(UniValue::VARR);
         entity.push_backV(data);
-        mints.push_back(entity);
+        return entity;
+    };
+
+    if (request.replyStream) {
+        CJSONStreamWriter& writer = request.replyStream->BeginResult();
+        writer.BeginObject();
+        writer.KeyValue("blockHash", EncodeBase64(blockHash.begin(), blockHash.size()));
+        writer.KeyValue("setHash", EncodeBase64(setHash.data(), setHash.size()));
+        writer.Key("coins");
+        writer.BeginArray();
+        for (const auto& coin : coins)
+            writer.Value(coinToJSON(coin));
+        writer.EndArray();
+        writer.EndObject();
+        return NullUniValue;
     }
 
+    UniValue ret(UniValue::VOBJ);
+    UniValue mints(UniValue::VARR);
+
+    for (const auto& coin : coins)
+        mints.push_back(coinToJSON(coin));
+
     ret.push_back(Pair("blockHash", EncodeBase64(blockHash.begin(), blockHash.size())));
     ret.push_back(Pair("setHash", UniValue(EncodeBase64(setHash.data(), setHash.size()))));
     ret.push_back(Pair("coins", mints));
@@ -1493,21 +1733,16 @@ UniValue getsparkmintmetadata(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "mints is expected to be an array");
     }
 
-    spark::CSparkState* sparkState =  spark::CSparkState::GetState();
+    auto sparkSnapshot = spark::CSparkState::GetState()->GetSnapshot();
 
     UniValue ret(UniValue::VARR);
     for(UniValue const & element : coinHashes.getValues()) {
         uint256 coinHash;
         coinHash.SetHex(element.get_str());
-        spark::Coin coin(spark::Params::get_default());
-        if(!sparkState->HasCoinHash(coin, coinHash))
+        std::pair<int, int> coinHeightAndId = sparkSnapshot->GetMintedCoinHeightAndId(coinHash);
+        if (coinHeightAndId.first == -1)
             continue;
 
-        std::pair<int, int> coinHeightAndId;
-        {
-            LOCK(cs_main);
-            coinHeightAndId = sparkState->GetMintedCoinHeightAndId(coin);
-        }
         UniValue metaData(UniValue::VOBJ);
         metaData.pushKV(std::to_string(coinHeightAndId.first), coinHeightAndId.second);
         ret.push_back(metaData);
@@ -1545,17 +1780,32 @@ UniValue getusedcoinstags(const JSONRPCRequest& request)
         LOCK(cs_main);
         tags = sparkState->GetSpends();
     }
-    UniValue serializedTags(UniValue::VARR);
-    int i = 0;
-    for ( auto it = tags.begin(); it != tags.end(); ++it, ++i) {
-        if ((tags.size() - i - 1) < startNumber)
-            continue;
-        std::vector<unsigned char> serialized;
-        serialized.resize(34);
-        it->first.serialize(serialized.data());
-        serializedTags.push_back(EncodeBase64(serialized.data(), 34));
+    auto forEachTag = [&](std::function<void(const std::string&)> f) {
+        int i = 0;
+        for ( auto it = tags.begin(); it != tags.end(); ++it, ++i) {
+            if ((tags.size() - i - 1) < startNumber)
+                continue;
+            std::vector<unsigned char> serialized;
+            serialized.resize(34);
+            it->first.serialize(serialized.data());
+            f(EncodeBase64(serialized.data(), 34));
+        }
+    };
+
+    if (request.replyStream) {
+        CJSONStreamWriter& writer = request.replyStream->BeginResult();
+        writer.BeginObject();
+        writer.Key("tags");
+        writer.BeginArray();
+        forEachTag([&writer](const std::string& tag) { writer.Value(tag); });
+        writer.EndArray();
+        writer.EndObject();
+        return NullUniValue;
     }
 
+    UniValue serializedTags(UniValue::VARR);
+    forEachTag([&serializedTags](const std::string& tag) { serializedTags.push_back(tag); });
+
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("tags", serializedTags));
 
@@ -1636,12 +1886,7 @@ UniValue getsparklatestcoinid(const JSONRPCRequest& request)
                 "}\n"
         );
 
-    spark::CSparkState* sparkState =  spark::CSparkState::GetState();
-    int latestCoinId;
-    {
-        LOCK(cs_main);
-        latestCoinId = sparkState->GetLatestCoinID();
-    }
+    int latestCoinId = spark::CSparkState::GetState()->GetSnapshot()->GetLatestCoinID();
 
     return UniValue(latestCoinId);
 }
@@ -1799,14 +2044,21 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                         "      \"address\"  (string) The base58check encoded address\n"
                         "      ,...\n"
                         "    ]\n"
-                        "  \"start\" (number) The start block height\n"
-                        "  \"end\" (number) The end block height\n"
+                        "  \"start\" (number, optional) The start block height\n"
+                        "  \"end\" (number, optional) The end block height\n"
+                        "  \"limit\" (number, optional) Return a page of at most this many txids\n"
+                        "  \"cursor\" (string, optional) The cursor of the page to return, as returned with the page before\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
                         "  \"transactionid\"  (string) The transaction id\n"
                         "  ,...\n"
                         "]\n"
+                        "\nResult with a limit (txids ordered by address, then height):\n"
+                        "{\n"
+                        "  \"txids\"  (array) The txids as above\n"
+                        "  \"next\"  (string) The cursor of the next page, null on the last page\n"
+                        "}\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
                 + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -1818,55 +2070,39 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    int start = 0;
-    int end = 0;
-    if (request.params[0].isObject()) {
-        UniValue startValue = find_value(request.params[0].get_obj(), "start");
-        UniValue endValue = find_value(request.params[0].get_obj(), "end");
-        if (startValue.isNum() && endValue.isNum()) {
-            start = startValue.get_int();
-            end = endValue.get_int();
-        }
-    }
+    int start, end;
+    parseHeightRange(request.params, start, end);
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    unsigned int limit;
+    std::string cursor;
+    parsePagination(request.params, limit, cursor);
 
-    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
-
-    std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
-        }
-    }
+    if (addresses.size() > 1 && limit == 0) {
+        // the txids of several addresses are merged by height
+        std::set<std::pair<int, std::string> > txids;
+        visitAddressIndex(addresses, start, end, 0, CAddressIndexStart(), true,
+                [&txids](size_t, const CAddressIndexKey& key, CAmount, bool fNewTx) {
+                    if (fNewTx)
+                        txids.insert(std::make_pair(key.blockHeight, key.txhash.GetHex()));
+                });
 
-    if (addresses.size() > 1) {
+        UniValue result(UniValue::VARR);
         for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
             result.push_back(it->second);
         }
+        return result;
     }
 
-    return result;
+    // the entries of a transaction are next to each other in the index of an address
+    CAddressIndexStart first = parseAddressIndexStart(cursor, addresses);
+    CAddressQueryResult result(request, "txids", limit > 0);
+    std::string next = visitAddressIndex(addresses, start, end, limit, first, true,
+            [&result](size_t, const CAddressIndexKey& key, CAmount, bool fNewTx) {
+                if (fNewTx)
+                    result.Add(key.txhash.GetHex());
+            });
 
+    return result.Finish(next);
 }
 
 UniValue getspentinfo(const JSONRPCRequest& request)
@@ -2072,6 +2308,143 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getperfstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "getperfstats ( \"format\" reset )\n"
+            "Returns latency histograms of instrumented subsystems (proof verification, block connection,\n"
+            "mempool acceptance, ProgPoW hashing, LLMQ sig shares and database access).\n"
+            "\nArguments:\n"
+            "1. \"format\"     (string, optional, default=\"json\") \"json\" or \"prometheus\" for the Prometheus text exposition format\n"
+            "2. reset        (boolean, optional, default=false) Clear all histograms after reading them\n"
+            "\nResult (for format=json):\n"
+            "{\n"
+            "  \"enabled\": true|false,        (boolean) Whether samples are being recorded (-perfstats)\n"
+            "  \"stats\": {\n"
+            "    \"name\": {                   (json object) One entry per instrumented subsystem\n"
+            "      \"count\": xxxxx,           (numeric) Number of samples\n"
+            "      \"total_us\": xxxxx,        (numeric) Sum of all samples in microseconds\n"
+            "      \"avg_us\": xxxxx,          (numeric) Average sample in microseconds\n"
+            "      \"max_us\": xxxxx,          (numeric) Largest sample in microseconds\n"
+            "      \"buckets\": {              (json object) Non-empty buckets, keyed by exclusive upper bound in microseconds\n"
+            "        \"bound\": n,             (numeric) Number of samples in the bucket, \"inf\" is the overflow bucket\n"
+            "        ...\n"
+            "      }\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nResult (for format=prometheus):\n"
+            "\"text\"                        (string) Histograms in Prometheus text format\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getperfstats", "")
+            + HelpExampleCli("getperfstats", "\"prometheus\"")
+            + HelpExampleRpc("getperfstats", "\"json\", true")
+        );
+
+    std::string format = "json";
+    if (request.params.size() > 0 && !request.params[0].isNull())
+        format = request.params[0].get_str();
+    if (format != "json" && format != "prometheus")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "format must be \"json\" or \"prometheus\"");
+    bool fReset = request.params.size() > 1 && request.params[1].get_bool();
+
+    UniValue result;
+    if (format == "prometheus") {
+        result = UniValue(PerfStatsToPrometheus());
+    } else {
+        UniValue stats(UniValue::VOBJ);
+        for (int n = 0; n < (int)PerfStat::COUNT; n++) {
+            CPerfHistogram::Snapshot s = GetPerfHistogram((PerfStat)n).GetSnapshot();
+
+            UniValue buckets(UniValue::VOBJ);
+            for (int i = 0; i < CPerfHistogram::NUM_BUCKETS; i++) {
+                if (s.buckets[i] == 0)
+                    continue;
+                uint64_t bound = CPerfHistogram::BucketUpperBound(i);
+                buckets.pushKV(bound ? std::to_string(bound) : std::string("inf"), s.buckets[i]);
+            }
+
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("count", s.count));
+            entry.push_back(Pair("total_us", s.sumMicros));
+            entry.push_back(Pair("avg_us", s.count ? s.sumMicros / s.count : 0));
+            entry.push_back(Pair("max_us", s.maxMicros));
+            entry.push_back(Pair("buckets", buckets));
+            stats.push_back(Pair(GetPerfStatName((PerfStat)n), entry));
+        }
+
+        result = UniValue(UniValue::VOBJ);
+        result.push_back(Pair("enabled", IsPerfStatsEnabled()));
+        result.push_back(Pair("stats", stats));
+    }
+
+    if (fReset)
+        ResetPerfStats();
+
+    return result;
+}
+
+UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "getdbstats\n"
+            "Returns settings, read counters and compaction figures of the LevelDB databases.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                       (json object) One entry per database (blocktree, chainstate, evo, llmq)\n"
+            "    \"cache_size\": xxxxx,          (numeric) Cache size in bytes (-<name>dbcache), half of it is the block cache\n"
+            "    \"write_buffer_size\": xxxxx,   (numeric) Write buffer size in bytes (-<name>dbwritebuffer)\n"
+            "    \"max_open_files\": xxxxx,      (numeric) Open table file limit (-<name>dbmaxopenfiles)\n"
+            "    \"bloom_bits\": xxxxx,          (numeric) Bloom filter bits per key (-<name>dbbloombits)\n"
+            "    \"reads\": xxxxx,               (numeric) Single key reads\n"
+            "    \"cache_hits\": xxxxx,          (numeric) Single key reads served from memtables, block cache or memory mapped tables\n"
+            "    \"cache_hit_rate\": x.xxx,      (numeric) cache_hits / reads\n"
+            "    \"multi_reads\": xxxxx,         (numeric) Batched reads\n"
+            "    \"multi_read_keys\": xxxxx,     (numeric) Keys looked up by batched reads\n"
+            "    \"bytes_read\": xxxxx,          (numeric) Bytes of values returned by reads\n"
+            "    \"file_reads\": xxxxx,          (numeric) Reads copied from table files that are not memory mapped, including compactions\n"
+            "    \"file_bytes_read\": xxxxx,     (numeric) Bytes of those reads\n"
+            "    \"compaction_time\": xxxxx,     (numeric) Seconds spent compacting\n"
+            "    \"compaction_bytes_read\": xxxxx,    (numeric) Bytes read by compactions\n"
+            "    \"compaction_bytes_written\": xxxxx, (numeric) Bytes written by compactions\n"
+            "    \"size_on_disk\": xxxxx,        (numeric) Size of the table files in bytes\n"
+            "    \"memory_usage\": xxxxx         (numeric) Bytes used by the block cache and memtables\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+        );
+
+    UniValue result(UniValue::VOBJ);
+    for (const CDBWrapperStats& stats : GetDBWrapperStats()) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("cache_size", (uint64_t)stats.options.nCacheSize));
+        entry.push_back(Pair("write_buffer_size", (uint64_t)(stats.options.nWriteBufferSize ? stats.options.nWriteBufferSize : stats.options.nCacheSize / 4)));
+        entry.push_back(Pair("max_open_files", stats.options.nMaxOpenFiles));
+        entry.push_back(Pair("bloom_bits", stats.options.nBloomBits));
+        entry.push_back(Pair("reads", stats.nReads));
+        entry.push_back(Pair("cache_hits", stats.nCacheHits));
+        entry.push_back(Pair("cache_hit_rate", stats.nReads ? (double)stats.nCacheHits / stats.nReads : 0.0));
+        entry.push_back(Pair("multi_reads", stats.nMultiReads));
+        entry.push_back(Pair("multi_read_keys", stats.nMultiReadKeys));
+        entry.push_back(Pair("bytes_read", stats.nBytesRead));
+        entry.push_back(Pair("file_reads", stats.nFileReads));
+        entry.push_back(Pair("file_bytes_read", stats.nFileBytesRead));
+        entry.push_back(Pair("compaction_time", stats.nCompactionSeconds));
+        entry.push_back(Pair("compaction_bytes_read", stats.nCompactionBytesRead));
+        entry.push_back(Pair("compaction_bytes_written", stats.nCompactionBytesWritten));
+        entry.push_back(Pair("size_on_disk", stats.nSizeOnDisk));
+        entry.push_back(Pair("memory_usage", stats.nMemoryUsage));
+        result.push_back(Pair(stats.options.strName, entry));
+    }
+    return result;
+}
+
 UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -2086,21 +2459,24 @@ UniValue echo(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode argNames readOnly
+  //  --------------------- ------------------------  -----------------------  ---------- -------- --------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
+    { "control",            "getperfstats",           &getperfstats,           true,  {"format","reset"} },
+    { "control",            "getdbstats",             &getdbstats,             true,  {} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, true,  {"privkey","message"} },
 
         /* Address index */
-    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
-    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false },
-    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false },
-    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false },
-    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false },
+    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true,  {}, true },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false, {}, true },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false, {}, true },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false, {}, true },
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false, {}, true },
+    { "addressindex",       "getspentinfo",           &getspentinfo,           false, {}, true },
 
     /* Znode features */
     { "privora",              "znsync",                 &mnsync,                 true,  {} },
@@ -2113,22 +2489,22 @@ static const CRPCCommand commands[] =
     { "addressindex",       "gettotalsupply",         &gettotalsupply,         false },
     { "addressindex",       "getzerocoinpoolbalance", &getzerocoinpoolbalance, false },
         /* Mobile related */
-    { "mobile",             "getanonymityset",        &getanonymityset,        false  },
-    { "mobile",             "getmintmetadata",        &getmintmetadata,        true  },
-    { "mobile",             "getusedcoinserials",     &getusedcoinserials,     false  },
-    { "mobile",             "getfeerate",             &getfeerate,             true  },
-    { "mobile",             "getlatestcoinid",        &getlatestcoinid,        true  },
+    { "mobile",             "getanonymityset",        &getanonymityset,        false, {}, true },
+    { "mobile",             "getmintmetadata",        &getmintmetadata,        true,  {}, true },
+    { "mobile",             "getusedcoinserials",     &getusedcoinserials,     false, {}, true },
+    { "mobile",             "getfeerate",             &getfeerate,             true,  {}, true },
+    { "mobile",             "getlatestcoinid",        &getlatestcoinid,        true,  {}, true },
 
         /* Mobile Spark */
-    { "mobile",             "getsparkanonymityset",   &getsparkanonymityset, false },
-    { "mobile",             "getsparkanonymitysetmeta",   &getsparkanonymitysetmeta, false },
-    { "mobile",             "getsparkanonymitysetsector",   &getsparkanonymitysetsector, false },
-    { "mobile",             "getsparkmintmetadata",   &getsparkmintmetadata, true  },
-    { "mobile",             "getusedcoinstags",       &getusedcoinstags,     false },
-    { "mobile",             "getusedcoinstagstxhashes", &getusedcoinstagstxhashes, false },
-    { "mobile",             "getsparklatestcoinid",   &getsparklatestcoinid, true  },
-    { "mobile",             "getmempoolsparktxids",   &getmempoolsparktxids, true },
-    { "mobile",             "getmempoolsparktxs",     &getmempoolsparktxs,       true  },
+    { "mobile",             "getsparkanonymityset",   &getsparkanonymityset, false, {}, true },
+    { "mobile",             "getsparkanonymitysetmeta",   &getsparkanonymitysetmeta, false, {}, true },
+    { "mobile",             "getsparkanonymitysetsector",   &getsparkanonymitysetsector, false, {}, true },
+    { "mobile",             "getsparkmintmetadata",   &getsparkmintmetadata, true,  {}, true },
+    { "mobile",             "getusedcoinstags",       &getusedcoinstags,     false, {}, true },
+    { "mobile",             "getusedcoinstagstxhashes", &getusedcoinstagstxhashes, false, {}, true },
+    { "mobile",             "getsparklatestcoinid",   &getsparklatestcoinid, true,  {}, true },
+    { "mobile",             "getmempoolsparktxids",   &getmempoolsparktxids, true,  {}, true },
+    { "mobile",             "getmempoolsparktxs",     &getmempoolsparktxs,       true,  {}, true },
 
     { "mobile",             "checkifmncollateral",   &checkifmncollateral, false  },
 
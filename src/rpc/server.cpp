@@ -6,6 +6,7 @@
 #include "rpc/server.h"
 
 #include "base58.h"
+#include "ctpl.h"
 #include "init.h"
 #include "random.h"
 #include "sync.h"
@@ -23,7 +24,10 @@
 #include <boost/thread.hpp>
 #include <boost/algorithm/string/case_conv.hpp> // for to_upper()
 
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
+#include <mutex>
 #include <unordered_map>
 
 using namespace RPCServer;
@@ -36,6 +40,9 @@ static CCriticalSection cs_rpcWarmup;
 static RPCTimerInterface* timerInterface = NULL;
 /* Map of name to timer. */
 static std::map<std::string, std::unique_ptr<RPCTimerBase> > deadlineTimers;
+/* Workers for the read-only calls of batches, shared by all of them */
+static std::shared_ptr<ctpl::thread_pool> rpcBatchPool;
+static int nRPCBatchConcurrency = DEFAULT_RPC_BATCH_CONCURRENCY;
 
 static struct CRPCSignals
 {
@@ -394,6 +401,13 @@ bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
     fRPCRunning = true;
+    nRPCBatchConcurrency = std::max((int)GetArg("-rpcbatchconcurrency", DEFAULT_RPC_BATCH_CONCURRENCY), 1);
+    int nBatchThreads = GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS);
+    if (nBatchThreads > 0 && nRPCBatchConcurrency > 1) {
+        std::shared_ptr<ctpl::thread_pool> pool = std::make_shared<ctpl::thread_pool>(nBatchThreads);
+        RenameThreadPool(*pool, "privora-rpcbatch");
+        std::atomic_store(&rpcBatchPool, pool);
+    }
     g_rpcSignals.Started();
     return true;
 }
@@ -409,6 +423,10 @@ void StopRPC()
 {
     LogPrint("rpc", "Stopping RPC\n");
     deadlineTimers.clear();
+    // batches still running carry on without the workers
+    std::shared_ptr<ctpl::thread_pool> pool = std::atomic_exchange(&rpcBatchPool, std::shared_ptr<ctpl::thread_pool>());
+    if (pool)
+        pool->stop(true);
     DeleteAuthCookie();
     g_rpcSignals.Stopped();
 }
@@ -493,13 +511,105 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+/** Whether req calls a command that may run alongside the other read-only calls of its batch */
+static bool IsReadOnlyRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    if (!method.isStr())
+        return false;
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->fReadOnly;
+}
+
+/**
+ * A run of read-only calls of a batch. The calls are taken in turn by the thread that executes
+ * the batch and by the batch workers helping it, and the replies are written to their place.
+ */
+class CRPCBatchRun
+{
+private:
+    // only touched for the calls taken, which the batch is waiting for
+    const UniValue& vReq;
+    std::vector<std::string>& vReplies;
+    const size_t nEnd;
+    std::atomic<size_t> nNext;
+
+    std::mutex mutex;
+    std::condition_variable cvDone;
+    size_t nLeft;
+
+public:
+    CRPCBatchRun(const UniValue& vReqIn, std::vector<std::string>& vRepliesIn, size_t nBegin, size_t nEndIn)
+        : vReq(vReqIn), vReplies(vRepliesIn), nEnd(nEndIn), nNext(nBegin), nLeft(nEndIn - nBegin) {}
+
+    /** Execute calls until none is left to take */
+    void Work()
+    {
+        size_t nDone = 0;
+        for (size_t i = nNext++; i < nEnd; i = nNext++) {
+            try {
+                vReplies[i] = JSONRPCExecOne(vReq[i]).write();
+            } catch (...) {
+                vReplies[i] = JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_MISC_ERROR, "Unknown exception"), find_value(vReq[i], "id")).write();
+            }
+            nDone++;
+        }
+        if (nDone > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            nLeft -= nDone;
+            if (nLeft == 0)
+                cvDone.notify_all();
+        }
+    }
+
+    /** Wait until all the calls are done */
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cvDone.wait(lock, [this] { return nLeft == 0; });
+    }
+};
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    std::shared_ptr<ctpl::thread_pool> pool = std::atomic_load(&rpcBatchPool);
+    std::vector<std::string> vReplies(vReq.size());
 
-    return ret.write() + "\n";
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t nEnd = reqIdx;
+        if (pool) {
+            while (nEnd < vReq.size() && IsReadOnlyRequest(vReq[nEnd]))
+                nEnd++;
+        }
+
+        if (nEnd - reqIdx < 2) {
+            // calls that may change state run on their own and in order, after everything before them
+            vReplies[reqIdx] = JSONRPCExecOne(vReq[reqIdx]).write();
+            reqIdx++;
+            continue;
+        }
+
+        // this thread works as well, so that the batch goes on while all the workers are busy
+        std::shared_ptr<CRPCBatchRun> run = std::make_shared<CRPCBatchRun>(vReq, vReplies, reqIdx, nEnd);
+        size_t nHelpers = std::min((size_t)nRPCBatchConcurrency, nEnd - reqIdx) - 1;
+        for (size_t i = 0; i < nHelpers; i++)
+            pool->push([run](int) { run->Work(); });
+        run->Work();
+        run->Wait();
+        reqIdx = nEnd;
+    }
+
+    // same as writing an array of the replies
+    std::string strReply = "[";
+    for (size_t i = 0; i < vReplies.size(); i++) {
+        if (i > 0)
+            strReply += ",";
+        strReply += vReplies[i];
+    }
+    return strReply + "]\n";
 }
 
 /**
@@ -20,6 +20,10 @@
 #include <univalue.h>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+//! Threads shared by all JSON-RPC batches to run their read-only calls on, 0 to run batches one call at a time
+static const int DEFAULT_RPC_BATCH_THREADS = 8;
+//! Calls of one batch that may run at the same time
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
 
 class CRPCCommand;
 
@@ -33,6 +37,7 @@ namespace RPCServer
 
 class CBlockIndex;
 class CNetAddr;
+class CRPCReplyStream;
 
 /** Wrapper for UniValue::VType, which includes typeAny:
  * Used to denote don't care type. Only used by RPCTypeCheckObj */
@@ -52,8 +57,10 @@ public:
     bool fHelp;
     std::string URI;
     std::string authUser;
+    //! Set by transports that can send the result while it is written, see CRPCReplyStream
+    CRPCReplyStream* replyStream;
 
-    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; }
+    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; replyStream = nullptr; }
     void parse(const UniValue& valRequest);
 };
 
@@ -142,6 +149,8 @@ public:
     rpcfn_type actor;
     bool okSafeMode;
     std::vector<std::string> argNames;
+    //! Whether the call changes no state, so that it may run alongside the other read-only calls of a batch
+    bool fReadOnly = false;
 };
 
 /**
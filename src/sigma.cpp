@@ -660,6 +660,9 @@ bool ConnectBlockSigma(
     else if (!fJustCheck) { // TODO(martun): not sure if this else is necessary here. Check again later.
         sigmaState.AddBlock(pindexNew);
     }
+
+    if (!fJustCheck)
+        sigmaState.FreezeIfClosed(pindexNew->nHeight);
     return true;
 }
 
@@ -753,6 +756,7 @@ bool BuildSigmaStateFromIndex(CChain *chain) {
     for (CBlockIndex *blockIndex = chain->Genesis(); blockIndex; blockIndex=chain->Next(blockIndex))
     {
         sigmaState.AddBlock(blockIndex);
+        sigmaState.FreezeIfClosed(blockIndex->nHeight);
     }
     // DEBUG
     LogPrintf(
@@ -787,7 +791,7 @@ void CSigmaTxInfo::Complete() {
 /******************************************************************************/
 
 CSigmaState::Containers::Containers(std::atomic<bool> & surgeCondition)
-: surgeCondition(surgeCondition)
+: fFrozen(false), surgeCondition(surgeCondition)
 {}
 
 void CSigmaState::Containers::AddMint(sigma::PublicCoin const & pubCoin, CMintedCoinInfo const & coinInfo) {
@@ -834,9 +838,98 @@ bool CSigmaState::Containers::IsSurgeCondition() const {
     return surgeCondition;
 }
 
+void CSigmaState::Containers::Freeze() {
+    if (fFrozen)
+        return;
+
+    std::vector<frozen_mint_container::Entry> mints;
+    std::vector<frozen_mint_hash_container::Entry> mintHashes;
+    mints.reserve(mintedPubCoins.size());
+    mintHashes.reserve(mintedPubCoins.size());
+    for (auto const & mint : mintedPubCoins) {
+        mints.emplace_back(MakeFrozenMintKey(mint.first.getValue(), mint.second.denomination), mint.second);
+        mintHashes.emplace_back(MakeHashKey(mint.first.getValueHash()), mints.back().first);
+    }
+    frozenMints.Build(std::move(mints));
+    frozenMintHashes.Build(std::move(mintHashes));
+    mint_info_container().swap(mintedPubCoins);
+
+    std::vector<frozen_spend_container::Entry> spends;
+    spends.reserve(usedCoinSerials.size());
+    for (auto const & spend : usedCoinSerials)
+        spends.emplace_back(frozen_spend_container::MakeKey(spend.first), spend.second);
+    frozenSpends.Build(std::move(spends));
+    spend_info_container().swap(usedCoinSerials);
+
+    fFrozen = true;
+}
+
+void CSigmaState::Containers::Thaw() {
+    if (!fFrozen)
+        return;
+
+    for (auto const & mint : frozenMints) {
+        GroupElement value;
+        value.deserialize(mint.first.data());
+        mintedPubCoins.insert(std::make_pair(sigma::PublicCoin(value, mint.second.denomination), mint.second));
+    }
+    frozenMints.clear();
+    frozenMintHashes.clear();
+
+    for (auto const & spend : frozenSpends) {
+        Scalar serial;
+        serial.deserialize(spend.first.data());
+        usedCoinSerials[serial] = spend.second;
+    }
+    frozenSpends.clear();
+
+    fFrozen = false;
+}
+
+bool CSigmaState::Containers::IsFrozen() const {
+    return fFrozen;
+}
+
+CMintedCoinInfo const * CSigmaState::Containers::FindMint(sigma::PublicCoin const & pubCoin) const {
+    auto iter = mintedPubCoins.find(pubCoin);
+    if (iter != mintedPubCoins.end())
+        return &iter->second;
+    return fFrozen ? frozenMints.Find(MakeFrozenMintKey(pubCoin.getValue(), pubCoin.getDenomination())) : nullptr;
+}
+
+bool CSigmaState::Containers::FindFrozenMintHash(uint256 const & pubCoinValueHash, GroupElement & pubCoinValue) const {
+    if (!fFrozen)
+        return false;
+    auto key = frozenMintHashes.Find(MakeHashKey(pubCoinValueHash));
+    if (!key)
+        return false;
+    pubCoinValue.deserialize(key->data());
+    return true;
+}
+
+bool CSigmaState::Containers::HasSpend(Scalar const & serial) const {
+    return usedCoinSerials.count(serial) != 0 || (fFrozen && frozenSpends.Find(serial) != nullptr);
+}
+
+size_t CSigmaState::Containers::GetMintCount() const {
+    return mintedPubCoins.size() + frozenMints.size();
+}
+
+frozen_mint_container const & CSigmaState::Containers::GetFrozenMints() const {
+    return frozenMints;
+}
+
+frozen_spend_container const & CSigmaState::Containers::GetFrozenSpends() const {
+    return frozenSpends;
+}
+
 void CSigmaState::Containers::Reset() {
     mintedPubCoins.clear();
     usedCoinSerials.clear();
+    frozenMints.clear();
+    frozenSpends.clear();
+    frozenMintHashes.clear();
+    fFrozen = false;
     mintMetaInfo.clear();
     spendMetaInfo.clear();
     surgeCondition = false;
@@ -954,6 +1047,11 @@ void CSigmaState::AddBlock(CBlockIndex *index) {
 }
 
 void CSigmaState::RemoveBlock(CBlockIndex *index) {
+    if (containers.IsFrozen() && (!index->sigmaMintedPubCoins.empty() || !index->sigmaSpentSerials.empty())) {
+        LogPrintf("Disconnecting block %d with Sigma data, unfreezing the Sigma state\n", index->nHeight);
+        containers.Thaw();
+    }
+
     // roll back accumulator updates
     BOOST_FOREACH(
         const PAIRTYPE(PAIRTYPE(sigma::CoinDenomination, int),std::vector<sigma::PublicCoin>) &coin,
@@ -1024,7 +1122,7 @@ bool CSigmaState::GetCoinGroupInfo(
 }
 
 bool CSigmaState::IsUsedCoinSerial(const Scalar &coinSerial) {
-    return containers.GetSpends().count(coinSerial) != 0;
+    return containers.HasSpend(coinSerial);
 }
 
 bool CSigmaState::IsUsedCoinSerialHash(Scalar &coinSerial, const uint256 &coinSerialHash) {
@@ -1034,11 +1132,19 @@ bool CSigmaState::IsUsedCoinSerialHash(Scalar &coinSerial, const uint256 &coinSe
             return true;
         }
     }
+    for (auto const & spend : containers.GetFrozenSpends()) {
+        Scalar serial;
+        serial.deserialize(spend.first.data());
+        if (primitives::GetSerialHash(serial) == coinSerialHash) {
+            coinSerial = serial;
+            return true;
+        }
+    }
     return false;
 }
 
 bool CSigmaState::HasCoin(const sigma::PublicCoin& pubCoin) {
-    return containers.GetMints().find(pubCoin) != containers.GetMints().end();
+    return containers.FindMint(pubCoin) != nullptr;
 }
 
 bool CSigmaState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoinValueHash) {
@@ -1049,7 +1155,7 @@ bool CSigmaState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoin
             return true;
         }
     }
-    return false;
+    return containers.FindFrozenMintHash(pubCoinValueHash, pubCoinValue);
 }
 
 int CSigmaState::GetCoinSetForSpend(
@@ -1142,10 +1248,10 @@ void CSigmaState::GetAnonymitySet(
 
 std::pair<int, int> CSigmaState::GetMintedCoinHeightAndId(
         const sigma::PublicCoin& pubCoin) {
-    auto coinIt = containers.GetMints().find(pubCoin);
+    CMintedCoinInfo const * coinInfo = containers.FindMint(pubCoin);
 
-    if (coinIt != containers.GetMints().end()) {
-        return std::make_pair(coinIt->second.nHeight, coinIt->second.coinGroupId);
+    if (coinInfo) {
+        return std::make_pair(coinInfo->nHeight, coinInfo->coinGroupId);
     }
     return std::make_pair(-1, -1);
 }
@@ -1206,6 +1312,23 @@ void CSigmaState::Reset() {
     containers.Reset();
 }
 
+void CSigmaState::FreezeIfClosed(int nHeight) {
+    if (containers.IsFrozen() || nHeight - ZC_FROZEN_SET_DEPTH < ::Params().GetConsensus().nSigmaEndBlock)
+        return;
+
+    Freeze();
+    LogPrintf("Froze the Sigma state at height %d: %d coins, %d serials\n",
+        nHeight, containers.GetFrozenMints().size(), containers.GetFrozenSpends().size());
+}
+
+void CSigmaState::Freeze() {
+    containers.Freeze();
+}
+
+bool CSigmaState::IsFrozen() const {
+    return containers.IsFrozen();
+}
+
 CSigmaState* CSigmaState::GetState() {
     return &sigmaState;
 }
@@ -171,6 +171,12 @@ public:
     // Reset to initial values
     void Reset();
 
+    // Once Sigma has been closed for ZC_FROZEN_SET_DEPTH blocks at nHeight, move its coins and
+    // serials into compact sorted arrays. Disconnecting a block with Sigma data moves them back.
+    void FreezeIfClosed(int nHeight);
+    void Freeze();
+    bool IsFrozen() const;
+
     // Check if there is a conflicting tx in the blockchain or mempool
     bool CanAddSpendToMempool(const Scalar& coinSerial);
 
@@ -200,13 +206,14 @@ public:
 
     int GetLatestCoinID(sigma::CoinDenomination denomination) const;
 
+    // Coins and serials that are not frozen
     mint_info_container const & GetMints() const;
     spend_info_container const & GetSpends() const;
     std::unordered_map<std::pair<CoinDenomination, int>, SigmaCoinGroupInfo, pairhash> const & GetCoinGroups() const ;
     std::unordered_map<CoinDenomination, int> const & GetLatestCoinIds() const;
     std::unordered_map<Scalar, uint256, sigma::CScalarHash> const & GetMempoolCoinSerials() const;
 
-    std::size_t GetTotalCoins() const { return GetMints().size(); }
+    std::size_t GetTotalCoins() const { return containers.GetMintCount(); }
 
     bool IsSurgeConditionDetected() const;
 
@@ -235,8 +242,22 @@ private:
 
         void Reset();
 
+        // Move all mints and spends into the frozen sets and back
+        void Freeze();
+        void Thaw();
+        bool IsFrozen() const;
+
+        // Look up mints and spends whether they are frozen or not
+        CMintedCoinInfo const * FindMint(sigma::PublicCoin const & pubCoin) const;
+        bool HasSpend(Scalar const & serial) const;
+        // Only the frozen mints, the live ones are searched by the caller
+        bool FindFrozenMintHash(uint256 const & pubCoinValueHash, GroupElement & pubCoinValue) const;
+        size_t GetMintCount() const;
+
         mint_info_container const & GetMints() const;
         spend_info_container const & GetSpends() const;
+        frozen_mint_container const & GetFrozenMints() const;
+        frozen_spend_container const & GetFrozenSpends() const;
         bool IsSurgeCondition() const;
     private:
         // Set of all minted pubCoin values, keyed by the public coin.
@@ -245,6 +266,13 @@ private:
         // Set of all used coin serials.
         spend_info_container usedCoinSerials;
 
+        // The same once Sigma is closed, keyed by the serialized coin value and denomination / serial
+        frozen_mint_container frozenMints;
+        frozen_spend_container frozenSpends;
+        // The frozen mints by the hash of their coin value
+        frozen_mint_hash_container frozenMintHashes;
+        bool fFrozen;
+
         std::atomic<bool> & surgeCondition;
 
         typedef std::map<int, std::map<CoinDenomination, size_t>> metainfo_container_t;
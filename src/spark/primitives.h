@@ -2,6 +2,7 @@
 #define PRIVORA_PRIMITIVES_H
 
 #include "libspark/coin.h"
+#include "../primitives/transaction.h"
 #include "serialize.h"
 #include "../uint256.h"
 
@@ -20,6 +21,8 @@ struct CSparkMintMeta
     char type;
     spark::Coin coin;
     mutable boost::optional<uint256> nonceHash;
+    //! Outpoint of the coin and the height it was mined at when it was looked up, not stored
+    mutable boost::optional<std::pair<COutPoint, int> > outPoint;
 
     uint256 GetNonceHash() const;
 
@@ -119,6 +122,66 @@ public:
     }
 };
 
+enum SparkPayoutStatus : uint8_t {
+    SPARK_PAYOUT_QUEUED = 0,
+    //! Put into a transaction that may not be committed yet
+    SPARK_PAYOUT_SENDING = 1,
+    SPARK_PAYOUT_SENT = 2,
+    SPARK_PAYOUT_FAILED = 3,
+};
+
+// A payout waiting in, or sent from, the Spark withdrawal queue
+class CSparkPayout
+{
+public:
+    uint256 id;
+    // Spark or transparent address
+    std::string address;
+    int64_t amount;
+    bool subtractFee;
+    std::string memo;
+    int64_t nTime;
+    uint8_t status;
+    uint256 txid;
+    // the part of the transaction fee that falls on this payout
+    int64_t fee;
+    std::string error;
+
+    CSparkPayout()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        id = uint256();
+        address = "";
+        amount = 0;
+        subtractFee = false;
+        memo = "";
+        nTime = 0;
+        status = SPARK_PAYOUT_QUEUED;
+        txid = uint256();
+        fee = 0;
+        error = "";
+    }
+
+    ADD_SERIALIZE_METHODS;
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(id);
+        READWRITE(address);
+        READWRITE(amount);
+        READWRITE(subtractFee);
+        READWRITE(memo);
+        READWRITE(nTime);
+        READWRITE(status);
+        READWRITE(txid);
+        READWRITE(fee);
+        READWRITE(error);
+    }
+};
+
 namespace primitives {
     uint256 GetNonceHash(const secp_primitives::Scalar& nonce);
     uint256 GetLTagHash(const secp_primitives::GroupElement& tag);
@@ -7,6 +7,8 @@
 #include "../validation.h"
 #include "../policy/policy.h"
 #include "../script/sign.h"
+#include "../net.h"
+#include "../utilmoneystr.h"
 #include "state.h"
 #include "sparkname.h"
 
@@ -14,7 +16,19 @@
 
 const uint32_t DEFAULT_SPARK_NCOUNT = 1;
 
-CSparkWallet::CSparkWallet(const std::string& strWalletFile) {
+// Serialized size estimate of a Spark spend transaction, the fee is computed from it
+static const size_t SPEND_TX_BASE_SIZE = 924;    // constant parts of the transaction
+static const size_t SPEND_TX_INPUT_SIZE = 1803;  // grootle proof and aux data of each spent coin
+static const size_t SPEND_TX_MINT_SIZE = 322;    // each private output, the change included
+static const size_t SPEND_TX_UTXO_SIZE = 34;     // each transparent output
+
+static size_t EstimateSparkSpendSize(size_t nInputs, size_t nMints, size_t nUtxos) {
+    return SPEND_TX_BASE_SIZE + SPEND_TX_INPUT_SIZE * nInputs + SPEND_TX_MINT_SIZE * nMints + SPEND_TX_UTXO_SIZE * nUtxos;
+}
+
+CSparkWallet::CSparkWallet(const std::string& strWalletFile)
+    : nAvailableBalance(0), nUnconfirmedBalance(0), consolidationConfig(CSparkConsolidationConfig::FromArgs()), nLastSpendTime(GetTime()),
+      withdrawalQueue(strWalletFile) {
 
     CWalletDB walletdb(strWalletFile);
     this->strWalletFile = strWalletFile;
@@ -69,7 +83,7 @@ CSparkWallet::CSparkWallet(const std::string& strWalletFile) {
             for (auto& coin : coinMeta) {
                 coin.second.coin.setParams(params);
                 coin.second.coin.setSerialContext(coin.second.serial_context);
-
+                tallyMint(coin.second, true);
             }
         }
 
@@ -97,40 +111,35 @@ CAmount CSparkWallet::getFullBalance() {
 }
 
 CAmount CSparkWallet::getAvailableBalance() {
-    CAmount result = 0;
-    LOCK(cs_spark_wallet);
-    for (auto& it : coinMeta) {
-        CSparkMintMeta mint = it.second;
-
-        if (mint.isUsed)
-            continue;
-
-        // Not confirmed
-        if (mint.nHeight < 1)
-            continue;
-
-        result += mint.v;
-    }
-
-    return result;
+    return nAvailableBalance;
 }
 
 CAmount CSparkWallet::getUnconfirmedBalance() {
-    CAmount result = 0;
-    LOCK(cs_spark_wallet);
-    for (auto& it : coinMeta) {
-        CSparkMintMeta mint = it.second;
-        if (mint.isUsed)
-            continue;
+    return nUnconfirmedBalance;
+}
 
-        // Continue if confirmed
-        if (mint.nHeight > 1)
-            continue;
+void CSparkWallet::tallyMint(const CSparkMintMeta& mint, bool fAdd) {
+    if (mint.isUsed)
+        return;
 
-        result += mint.v;
-    }
+    CAmount value = fAdd ? mint.v : -(CAmount)mint.v;
+    // a coin at height 1 is counted as both, the way the balances always were
+    if (mint.nHeight >= 1)
+        nAvailableBalance += value;
+    if (mint.nHeight <= 1)
+        nUnconfirmedBalance += value;
+}
 
-    return result;
+void CSparkWallet::setMint(const uint256& lTagHash, const CSparkMintMeta& mint) {
+    AssertLockHeld(cs_spark_wallet);
+    auto it = coinMeta.find(lTagHash);
+    if (it != coinMeta.end()) {
+        tallyMint(it->second, false);
+        it->second = mint;
+    } else {
+        coinMeta.emplace(lTagHash, mint);
+    }
+    tallyMint(mint, true);
 }
 
 CAmount CSparkWallet::getAddressFullBalance(const spark::Address& address) {
@@ -356,6 +365,8 @@ void CSparkWallet::clearAllMints(CWalletDB& walletdb) {
     }
 
     coinMeta.clear();
+    nAvailableBalance = 0;
+    nUnconfirmedBalance = 0;
     lastDiversifier = 0;
     walletdb.writeDiversifier(lastDiversifier);
 }
@@ -363,7 +374,11 @@ void CSparkWallet::clearAllMints(CWalletDB& walletdb) {
 void CSparkWallet::eraseMint(const uint256& hash, CWalletDB& walletdb) {
     LOCK(cs_spark_wallet);
     walletdb.EraseSparkMint(hash);
-    coinMeta.erase(hash);
+    auto it = coinMeta.find(hash);
+    if (it != coinMeta.end()) {
+        tallyMint(it->second, false);
+        coinMeta.erase(it);
+    }
 }
 
 void CSparkWallet::addOrUpdateMint(const CSparkMintMeta& mint, const uint256& lTagHash, CWalletDB& walletdb) {
@@ -373,7 +388,7 @@ void CSparkWallet::addOrUpdateMint(const CSparkMintMeta& mint, const uint256& lT
         lastDiversifier = mint.i;
         walletdb.writeDiversifier(lastDiversifier);
     }
-    coinMeta[lTagHash] = mint;
+    setMint(lTagHash, mint);
     walletdb.WriteSparkMint(lTagHash, mint);
 }
 
@@ -402,7 +417,7 @@ void CSparkWallet::updateMintInMemory(const CSparkMintMeta& mint) {
     LOCK(cs_spark_wallet);
     for (auto& itr : coinMeta) {
         if (itr.second == mint) {
-            coinMeta[itr.first] = mint;
+            setMint(itr.first, mint);
             break;
         }
     }
@@ -580,13 +595,14 @@ CAmount CSparkWallet::getMySpendAmount(const std::vector<GroupElement>& lTags) c
 }
 
 void CSparkWallet::UpdateMintState(const std::vector<spark::Coin>& coins, const uint256& txHash, CWalletDB& walletdb) {
-    spark::CSparkState *sparkState = spark::CSparkState::GetState();
+    // called without cs_main, so read the published snapshot
+    auto sparkSnapshot = spark::CSparkState::GetState()->GetSnapshot();
     for (auto coin : coins) {
         try {
             spark::IdentifiedCoinData identifiedCoinData = coin.identify(this->viewKey);
             spark::RecoveredCoinData recoveredCoinData = coin.recover(this->fullViewKey, identifiedCoinData);
             CSparkMintMeta mintMeta;
-            auto mintedCoinHeightAndId = sparkState->GetMintedCoinHeightAndId(coin);
+            auto mintedCoinHeightAndId = sparkSnapshot->GetMintedCoinHeightAndId(coin);
             mintMeta.nHeight = mintedCoinHeightAndId.first;
             mintMeta.nId = mintedCoinHeightAndId.second;
             mintMeta.isUsed = false;
@@ -1287,6 +1303,8 @@ CWalletTx CSparkWallet::CreateSparkSpendTransaction(
     if (vOut > consensusParams.nMaxValueSparkSpendPerTransaction)
         throw std::runtime_error(_("Spend to transparent address limit exceeded (10,000 Privora per transaction)."));
 
+    nLastSpendTime = GetTime();
+
     std::vector<CWalletTx> result;
     std::vector<CMutableTransaction> txs;
     CWalletTx wtxNew;
@@ -1762,9 +1780,8 @@ std::pair<CAmount, std::vector<CSparkMintMeta>> CSparkWallet::SelectSparkCoins(
             throw std::invalid_argument(_("Unable to select cons for spend"));
         }
 
-        // 1803 is for first grootle proof/aux data
-        // 213 for each private output, 34 for each utxo,924 constant parts of tx parts of tx,
-        size = 924 + 1803*(spendCoins.size()) + 322*(mintNum+1) + 34*utxoNum + additionalTxSize;
+        // the private outputs and the change
+        size = EstimateSparkSpendSize(spendCoins.size(), mintNum + 1, utxoNum) + additionalTxSize;
         CAmount feeNeeded = CWallet::GetMinimumFee(size, nTxConfirmTarget, mempool);
 
         if (fee >= feeNeeded) {
@@ -1783,43 +1800,212 @@ std::pair<CAmount, std::vector<CSparkMintMeta>> CSparkWallet::SelectSparkCoins(
     return std::make_pair(fee, spendCoins);
 }
 
+bool CSparkWallet::getMintOutPoint(const CSparkMintMeta& mint, COutPoint& outPoint) const {
+    // ignore if the coin is not actually on chain
+    int mintHeight = spark::CSparkState::GetState()->GetSnapshot()->GetMintedCoinHeightAndId(mint.coin).first;
+    if (mintHeight == -1)
+        return false;
+
+    // the cached outpoint is only good for the block it was looked up in
+    if (!mint.outPoint || mint.outPoint->second != mintHeight) {
+        if (!spark::GetOutPoint(outPoint, mint.coin))
+            return false;
+        mint.outPoint = std::make_pair(outPoint, mintHeight);
+    }
+
+    outPoint = mint.outPoint->first;
+    return true;
+}
+
 std::list<CSparkMintMeta> CSparkWallet::GetAvailableSparkCoins(const CCoinControl *coinControl) const {
     std::list<CSparkMintMeta> coins;
-    // get all unsued coins from spark wallet
-    std::vector<CSparkMintMeta> vecMints = this->ListSparkMints(true, true);
-    for (const auto& mint : vecMints) {
-        if (mint.v == 0) // ignore 0 mints which where created to increase privacy
+    std::set<COutPoint> lockedCoins = pwalletMain->setLockedCoins;
+
+    // go over the stored mints rather than copies, so that their outpoints stay cached
+    LOCK2(cs_spark_wallet, cs_consolidation);
+    for (const auto& it : coinMeta) {
+        const CSparkMintMeta& mint = it.second;
+        // ignore used and unconfirmed coins, and 0 mints which where created to increase privacy
+        if (mint.isUsed || mint.nHeight < 1 || mint.v == 0)
+            continue;
+
+        COutPoint outPoint;
+        if (!getMintOutPoint(mint, outPoint))
+            continue;
+
+        // if we are using coincontrol, filter out unselected coins
+        if (coinControl != NULL && coinControl->HasSelected() && !coinControl->IsSelected(outPoint))
             continue;
+
+        // leave the coins being consolidated to the consolidation, which selects them
+        if (setConsolidating.count(outPoint) > 0 && (coinControl == NULL || !coinControl->IsSelected(outPoint)))
+            continue;
+
+        // ignore if coin is locked
+        if (lockedCoins.count(outPoint) > 0)
+            continue;
+
         coins.push_back(mint);
     }
 
-    std::set<COutPoint> lockedCoins = pwalletMain->setLockedCoins;
+    return coins;
+}
+CSparkConsolidationConfig CSparkConsolidationConfig::FromArgs()
+{
+    CSparkConsolidationConfig config;
+    config.fEnabled = GetBoolArg("-sparkconsolidate", DEFAULT_SPARK_CONSOLIDATE);
+    config.nMinCoins = std::max<int64_t>(0, GetArg("-sparkconsolidatemincoins", DEFAULT_SPARK_CONSOLIDATE_MIN_COINS));
+    config.nMaxInputs = std::max<int64_t>(2, GetArg("-sparkconsolidatemaxinputs", DEFAULT_SPARK_CONSOLIDATE_MAX_INPUTS));
+    config.nInterval = std::max<int64_t>(0, GetArg("-sparkconsolidateinterval", DEFAULT_SPARK_CONSOLIDATE_INTERVAL));
+    // checked in CWallet::ParameterInteraction()
+    config.nMaxFeePerDay = DEFAULT_SPARK_CONSOLIDATE_MAX_FEE;
+    if (IsArgSet("-sparkconsolidatemaxfee"))
+        ParseMoney(GetArg("-sparkconsolidatemaxfee", ""), config.nMaxFeePerDay);
+    return config;
+}
+
+std::vector<CSparkMintMeta> CSparkWallet::SelectCoinsToConsolidate(unsigned int nMinCoins, unsigned int nMaxInputs) const {
+    std::vector<CSparkMintMeta> result;
+    std::list<CSparkMintMeta> coins = GetAvailableSparkCoins();
+    if (nMaxInputs < 2 || coins.size() < 2 || coins.size() <= nMinCoins)
+        return result;
+
+    // merging n coins leaves n - 1 coins less
+    size_t nInputs = std::min<size_t>({nMaxInputs, coins.size(), coins.size() - nMinCoins + 1});
+
+    // smallest first, the older one if the amounts are the same
+    coins.sort([](const CSparkMintMeta& a, const CSparkMintMeta& b) {
+        return a.v != b.v ? a.v < b.v : a.nHeight < b.nHeight;
+    });
+    result.assign(coins.begin(), std::next(coins.begin(), nInputs));
+    return result;
+}
 
-    // Filter out coins that have not been selected from CoinControl should that be used
-    coins.remove_if([lockedCoins, coinControl](const CSparkMintMeta& coin) {
+bool CSparkWallet::ConsolidateCoins(const CSparkConsolidationConfig& config) {
+    auto setStatus = [this](const std::string& strStatus) {
+        LOCK(cs_consolidation);
+        consolidationStats.strStatus = strStatus;
+    };
+
+    std::vector<CSparkMintMeta> coins = SelectCoinsToConsolidate(config.nMinCoins, config.nMaxInputs);
+    if (coins.empty()) {
+        setStatus("nothing to consolidate");
+        return false;
+    }
+
+    CAmount nValue = 0;
+    CCoinControl coinControl;
+    std::vector<COutPoint> outPoints;
+    for (const CSparkMintMeta& coin : coins) {
         COutPoint outPoint;
+        if (!getMintOutPoint(coin, outPoint))
+            continue;
+        coinControl.Select(outPoint);
+        outPoints.push_back(outPoint);
+        nValue += coin.v;
+    }
+    if (outPoints.size() < 2) {
+        setStatus("nothing to consolidate");
+        return false;
+    }
 
-        // ignore if the coin is not actually on chain
-        if (!spark::GetOutPoint(outPoint, coin.coin)) {
-            return true;
-        }
+    int64_t nNow = GetTime();
+    CAmount nRecentFees = 0;
+    {
+        LOCK(cs_consolidation);
+        while (!recentConsolidationFees.empty() && recentConsolidationFees.front().first <= nNow - 24 * 60 * 60)
+            recentConsolidationFees.pop_front();
+        for (const auto& entry : recentConsolidationFees)
+            nRecentFees += entry.second;
+        consolidationStats.nRecentFees = nRecentFees;
+    }
 
-        // if we are using coincontrol, filter out unselected coins
-        if (coinControl != NULL){
-            if (coinControl->HasSelected()){
-                if (!coinControl->IsSelected(outPoint)){
-                    return true;
-                }
-            }
-        }
+    // what SelectSparkCoins() estimates for one private output and the change
+    CAmount nFeeEstimate = CWallet::GetMinimumFee(EstimateSparkSpendSize(outPoints.size(), 2, 0), nTxConfirmTarget, mempool);
+    if (nRecentFees + nFeeEstimate > config.nMaxFeePerDay) {
+        setStatus("fee budget of the last 24 hours used up");
+        return false;
+    }
+    if (nFeeEstimate >= nValue) {
+        setStatus("coins too small to pay for their consolidation");
+        return false;
+    }
 
-        // ignore if coin is locked
-        if (lockedCoins.count(outPoint) > 0){
-            return true;
+    {
+        LOCK(cs_consolidation);
+        setConsolidating.insert(outPoints.begin(), outPoints.end());
+    }
+
+    bool fSent = false;
+    try {
+        // the merged coin goes to the change address, like any other value the wallet moves to itself
+        spark::OutputCoinData output;
+        output.address = getChangeAddress();
+        output.v = nValue;
+        output.memo = "";
+        std::vector<std::pair<spark::OutputCoinData, bool>> privateRecipients = {{output, true}};
+
+        CAmount nFee = 0;
+        CWalletTx wtx = pwalletMain->CreateSparkSpendTransaction({}, privateRecipients, nFee, &coinControl);
+        if (nRecentFees + nFee > config.nMaxFeePerDay) {
+            setStatus("fee budget of the last 24 hours used up");
+        } else {
+            CValidationState state;
+            CReserveKey reserveKey(pwalletMain);
+            // the wallet keeps a transaction the memory pool rejected, only the state tells
+            if (!pwalletMain->CommitTransaction(wtx, reserveKey, g_connman.get(), state) || !state.IsValid())
+                throw std::runtime_error(strprintf("transaction %s rejected: %s", wtx.GetHash().ToString(), FormatStateMessage(state)));
+            fSent = true;
+
+            LOCK(cs_consolidation);
+            recentConsolidationFees.emplace_back(nNow, nFee);
+            consolidationStats.nTransactions++;
+            consolidationStats.nCoinsMerged += outPoints.size();
+            consolidationStats.nFeesPaid += nFee;
+            consolidationStats.nRecentFees = nRecentFees + nFee;
+            consolidationStats.nLastTxTime = nNow;
+            consolidationStats.lastTxHash = wtx.GetHash();
+            consolidationStats.strStatus = strprintf("merged %u coins", outPoints.size());
+            LogPrintf("%s: merged %u Spark coins worth %s in %s, fee %s\n", __func__, outPoints.size(),
+                      FormatMoney(nValue), wtx.GetHash().ToString(), FormatMoney(nFee));
         }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: consolidation failed: %s\n", __func__, e.what());
+        LOCK(cs_consolidation);
+        consolidationStats.strStatus = "failed";
+        consolidationStats.strLastError = e.what();
+    }
 
-        return false;
-    });
+    LOCK(cs_consolidation);
+    for (const COutPoint& outPoint : outPoints)
+        setConsolidating.erase(outPoint);
+    return fSent;
+}
 
-    return coins;
-}
\ No newline at end of file
+void CSparkWallet::MaybeConsolidateCoins() {
+    auto setStatus = [this](const std::string& strStatus) {
+        LOCK(cs_consolidation);
+        consolidationStats.nLastCheckTime = GetTime();
+        consolidationStats.strStatus = strStatus;
+    };
+
+    if (!consolidationConfig.fEnabled)
+        return;
+    if (fImporting || fReindex || IsInitialBlockDownload())
+        return setStatus("waiting for the chain to sync");
+    if (pwalletMain->IsLocked())
+        return setStatus("waiting for the wallet to be unlocked");
+    // incoming coins and change, including that of the last consolidation, are not settled yet
+    if (nUnconfirmedBalance != 0)
+        return setStatus("waiting for unconfirmed coins");
+    if (GetTime() - nLastSpendTime < consolidationConfig.nInterval)
+        return setStatus("waiting for the wallet to be idle");
+
+    setStatus("consolidating");
+    ConsolidateCoins(consolidationConfig);
+}
+
+CSparkConsolidationStats CSparkWallet::GetConsolidationStats() const {
+    LOCK(cs_consolidation);
+    return consolidationStats;
+}
@@ -12,6 +12,10 @@
 #include "../wallet/walletdb.h"
 #include "../sync.h"
 #include "../sparkname.h"
+#include "withdrawalqueue.h"
+
+#include <deque>
+#include <set>
 
 class CRecipient;
 class CReserveKey;
@@ -21,6 +25,44 @@ extern CChain chainActive;
 const uint32_t BIP44_SPARK_INDEX = 0x6;
 const uint32_t SPARK_CHANGE_D = 0x270F;
 
+//! Background consolidation of small Spark coins, off by default
+static const bool DEFAULT_SPARK_CONSOLIDATE = false;
+//! Coins the wallet may keep before it consolidates
+static const unsigned int DEFAULT_SPARK_CONSOLIDATE_MIN_COINS = 50;
+//! Inputs of a consolidation transaction, bounds how long it holds the wallet
+static const unsigned int DEFAULT_SPARK_CONSOLIDATE_MAX_INPUTS = 20;
+//! Seconds the Spark wallet has to be idle before a consolidation transaction
+static const int64_t DEFAULT_SPARK_CONSOLIDATE_INTERVAL = 30 * 60;
+//! Fees consolidation may spend in 24 hours
+static const CAmount DEFAULT_SPARK_CONSOLIDATE_MAX_FEE = COIN / 10;
+//! Seconds between checks whether to consolidate
+static const int64_t SPARK_CONSOLIDATE_CHECK_INTERVAL = 60;
+
+/** Budgets of the background consolidation, from the -sparkconsolidate* options */
+struct CSparkConsolidationConfig {
+    bool fEnabled;
+    unsigned int nMinCoins;
+    unsigned int nMaxInputs;
+    int64_t nInterval;
+    CAmount nMaxFeePerDay;
+
+    static CSparkConsolidationConfig FromArgs();
+};
+
+/** What the background consolidation did so far */
+struct CSparkConsolidationStats {
+    int64_t nLastCheckTime = 0;
+    std::string strStatus;
+    unsigned int nTransactions = 0;
+    unsigned int nCoinsMerged = 0;
+    CAmount nFeesPaid = 0;
+    //! Fees of the last 24 hours
+    CAmount nRecentFees = 0;
+    int64_t nLastTxTime = 0;
+    uint256 lastTxHash;
+    std::string strLastError;
+};
+
 class CSparkWallet  {
 public:
     CSparkWallet(const std::string& strWalletFile);
@@ -153,6 +195,21 @@ public:
     // Returns the list of pairs of coins and metadata for that coin,
     std::list<CSparkMintMeta> GetAvailableSparkCoins(const CCoinControl *coinControl = NULL) const;
 
+    // Outpoint of a coin that is on chain, cached in its metadata
+    bool getMintOutPoint(const CSparkMintMeta& mint, COutPoint& outPoint) const;
+
+    // The smallest spendable coins whose merging brings the wallet down towards nMinCoins coins
+    std::vector<CSparkMintMeta> SelectCoinsToConsolidate(unsigned int nMinCoins, unsigned int nMaxInputs) const;
+    // Merge the smallest coins into one within the budgets of config, returns whether a
+    // transaction was sent
+    bool ConsolidateCoins(const CSparkConsolidationConfig& config);
+    // Periodic task of the Spark wallet thread, consolidates if the wallet is unlocked and has been idle long enough
+    void MaybeConsolidateCoins();
+    CSparkConsolidationStats GetConsolidationStats() const;
+    const CSparkConsolidationConfig& GetConsolidationConfig() const { return consolidationConfig; }
+
+    CSparkWithdrawalQueue& GetWithdrawalQueue() { return withdrawalQueue; }
+
 public:
     // to protect coinMeta
     mutable CCriticalSection cs_spark_wallet;
@@ -173,6 +230,25 @@ private:
     // map lTagHash to coin meta
     std::unordered_map<uint256, CSparkMintMeta> coinMeta;
 
+    // running totals of the values of unused coins in coinMeta, confirmed and not
+    std::atomic<CAmount> nAvailableBalance;
+    std::atomic<CAmount> nUnconfirmedBalance;
+    void tallyMint(const CSparkMintMeta& mint, bool fAdd);
+    void setMint(const uint256& lTagHash, const CSparkMintMeta& mint);
+
+    CSparkConsolidationConfig consolidationConfig;
+    // when a spend was last created, consolidation waits for the wallet to be idle
+    std::atomic<int64_t> nLastSpendTime;
+    // outpoints of the coins a consolidation is spending, other spends leave them alone
+    std::set<COutPoint> setConsolidating;
+    mutable CCriticalSection cs_consolidation;
+    CSparkConsolidationStats consolidationStats;
+    // (time, fee) of the consolidation transactions of the last 24 hours
+    std::deque<std::pair<int64_t, CAmount>> recentConsolidationFees;
+
+    // payouts sent in batches
+    CSparkWithdrawalQueue withdrawalQueue;
+
     void* threadPool;
 };
 
@@ -2,6 +2,9 @@
 #include "sparkname.h"
 #include "../validation.h"
 #include "../batchproof_container.h"
+#include "../perfstats.h"
+#include "../privacytx.h"
+#include "../txdb.h"
 
 namespace spark {
 
@@ -35,6 +38,7 @@ bool BuildSparkStateFromIndex(CChain *chain) {
         sparkState.AddBlock(blockIndex);
         CSparkNameManager::GetInstance()->AddBlock(blockIndex);
     }
+    sparkState.PublishSnapshot(chain->Tip());
     // DEBUG
     LogPrintf(
             "Latest ID for Spark coin group  %d\n",
@@ -181,24 +185,25 @@ spark::SpendTransaction ParseSparkSpend(const CTransaction &tx)
 
 std::vector<GroupElement> GetSparkUsedTags(const CTransaction &tx)
 {
-    const spark::Params* params = spark::Params::get_default();
-
-    spark::SpendTransaction spendTransaction(params);
-    try {
-        spendTransaction = ParseSparkSpend(tx);
-    } catch (const std::exception &) {
+    if (!tx.IsSparkSpend())
         return std::vector<GroupElement>();
-    }
 
-    return  spendTransaction.getUsedLTags();
+    return GetPrivacyTxData(tx)->sparkLTags;
 }
 
-std::vector<spark::Coin> GetSparkMintCoins(const CTransaction &tx)
+std::vector<spark::Coin> ParseSparkMintCoins(const CTransaction &tx)
+{
+    if (!tx.IsSparkTransaction())
+        return std::vector<spark::Coin>();
+
+    return ParseSparkMintCoins(tx, getSerialContext(tx));
+}
+
+std::vector<spark::Coin> ParseSparkMintCoins(const CTransaction &tx, const std::vector<unsigned char> &serial_context)
 {
     std::vector<spark::Coin> result;
 
     if (tx.IsSparkTransaction()) {
-        std::vector<unsigned char> serial_context = getSerialContext(tx);
         for (const auto& vout : tx.vout) {
             const auto& script = vout.scriptPubKey;
             if (script.IsSparkMint() || script.IsSparkSMint()) {
@@ -217,9 +222,17 @@ std::vector<spark::Coin> GetSparkMintCoins(const CTransaction &tx)
     return result;
 }
 
+std::vector<spark::Coin> GetSparkMintCoins(const CTransaction &tx)
+{
+    if (!tx.IsSparkTransaction())
+        return std::vector<spark::Coin>();
+
+    return GetPrivacyTxData(tx)->sparkMintCoins;
+}
+
 size_t GetSpendInputs(const CTransaction &tx) {
     return tx.IsSparkSpend() ?
-           GetSparkUsedTags(tx).size() : 0;
+           GetPrivacyTxData(tx)->sparkLTags.size() : 0;
 }
 
 CAmount GetSpendTransparentAmount(const CTransaction& tx) {
@@ -232,6 +245,37 @@ CAmount GetSpendTransparentAmount(const CTransaction& tx) {
     return result;
 }
 
+/**
+ * Record the outpoint of every mint of a block, so that GetOutPoint() finds it without reading
+ * the block again.
+ */
+static bool IndexSparkMintOutPoints(const CBlock& block, int nHeight)
+{
+    std::vector<std::pair<uint256, std::pair<COutPoint, int> > > vect;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsSparkTransaction())
+            continue;
+
+        std::vector<uint32_t> mintOutputs;
+        for (uint32_t n = 0; n < tx->vout.size(); n++) {
+            const CScript& script = tx->vout[n].scriptPubKey;
+            if (script.IsSparkMint() || script.IsSparkSMint())
+                mintOutputs.push_back(n);
+        }
+        // the coins line up with the mint outputs unless one failed to parse, GetOutPoint()
+        // falls back to searching the block for those
+        std::vector<spark::Coin> coins = GetSparkMintCoins(*tx);
+        if (coins.size() != mintOutputs.size())
+            continue;
+
+        uint256 txHash = tx->GetHash();
+        for (size_t i = 0; i < coins.size(); i++)
+            vect.emplace_back(coins[i].getHash(), std::make_pair(COutPoint(txHash, mintOutputs[i]), nHeight));
+    }
+
+    return vect.empty() || pblocktree->WriteSparkMintOutPoints(vect);
+}
+
 /**
  * Connect a new ZCblock to chainActive. pblock is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -274,6 +318,7 @@ bool ConnectBlockSpark(
                 pindexNew->spentLTags.insert(lTag);
                 sparkState.AddSpend(lTag.first, lTag.second);
             }
+            sparkState.AddSpendsToLog(pindexNew);
             if (GetBoolArg("-mobile", false)) {
                 BOOST_FOREACH (auto& lTag, pblock->sparkTxInfo->ltagTxhash) {
                     pindexNew->ltagTxhash.insert(lTag);
@@ -291,6 +336,8 @@ bool ConnectBlockSpark(
 
         if (!pblock->sparkTxInfo->mints.empty()) {
             sparkState.AddMintsToStateAndBlockIndex(pindexNew, pblock);
+            if (!IndexSparkMintOutPoints(*pblock, pindexNew->nHeight))
+                return state.Error("Failed to write Spark mint outpoints");
             int latestCoinId  = sparkState.GetLatestCoinID();
             // add  coins into hasher, for generating set hash
             updateHash = true;
@@ -340,6 +387,9 @@ bool ConnectBlockSpark(
         sparkState.AddBlock(pindexNew);
     }
 
+    if (!fJustCheck)
+        sparkState.PublishSnapshot(pindexNew);
+
     CSparkNameManager *sparkNameManager = CSparkNameManager::GetInstance();
     pindexNew->removedSparkNames = sparkNameManager->RemoveSparkNamesLosingValidity(pindexNew->nHeight);
     sparkNameManager->AddBlock(pindexNew, fBackupRewrittenSparkNames);
@@ -390,7 +440,16 @@ void DisconnectTipSpark(CBlock& block, CBlockIndex *pindexDelete) {
     CSparkNameManager *sparkNameManager = CSparkNameManager::GetInstance();
     sparkNameManager->RemoveBlock(pindexDelete);
 
+    std::vector<uint256> mintHashes;
+    for (const auto& coins : pindexDelete->sparkMintedCoins) {
+        for (const spark::Coin& coin : coins.second)
+            mintHashes.push_back(coin.getHash());
+    }
+    if (!mintHashes.empty() && !pblocktree->EraseSparkMintOutPoints(mintHashes))
+        LogPrintf("DisconnectTipSpark: failed to erase Spark mint outpoints\n");
+
     sparkState.RemoveBlock(pindexDelete);
+    sparkState.PublishSnapshot(pindexDelete->pprev);
 
     // Also remove from mempool spends that reference given block hash.
     RemoveSpendReferencingBlock(mempool, pindexDelete);
@@ -530,6 +589,7 @@ bool CheckSparkSpendTransaction(
         bool isCheckWallet,
         bool fStatefulSigmaCheck,
         CSparkTxInfo* sparkTxInfo) {
+    CPerfTimer perfTimer(PerfStat::SPARK_SPEND_CHECK);
     std::unordered_set<GroupElement, spark::CLTagHash> txLTags;
 
     if (tx.vin.size() != 1 || !tx.vin[0].scriptSig.IsSparkSpend()) {
@@ -614,6 +674,7 @@ bool CheckSparkSpendTransaction(
     spend->setOutCoins(out_coins);
     std::unordered_map<uint64_t, std::vector<Coin>> cover_sets;
     std::unordered_map<uint64_t, CoverSetData> cover_set_data;
+    std::vector<CPrivacyProofSet> proofSets;
     const auto idAndBlockHashes = spend->getBlockHashes();
 
     BatchProofContainer* batchProofContainer = BatchProofContainer::get_instance();
@@ -632,6 +693,7 @@ bool CheckSparkSpendTransaction(
 
         // take the hash from last block of anonymity set
         std::vector<unsigned char> set_hash = GetAnonymitySetHash(index, idAndHash.first);
+        uint256 setBlockHash = index->GetBlockHash();
 
         std::vector<Coin> cover_set;
         cover_set.reserve(coinGroup.nCoins);
@@ -671,6 +733,7 @@ bool CheckSparkSpendTransaction(
 
         cover_sets[idAndHash.first] = std::move(cover_set);
         cover_set_data [idAndHash.first] = setData;
+        proofSets.push_back({idAndHash.first, setBlockHash, set_size, set_hash});
     }
     spend->setCoverSets(cover_set_data);
     spend->setVout(Vout);
@@ -682,9 +745,13 @@ bool CheckSparkSpendTransaction(
                              error("CheckSparkSpendTransaction: No cover set found."));
     }
     
-    // if we are collecting proofs, skip verification and collect proofs
-    // add proofs into container
-    if (useBatching) {
+    // the proof already passed against these cover sets when the tx entered the mempool
+    uint256 proofCacheKey = GetPrivacyProofCacheKey(hashTx, proofSets);
+    if (IsPrivacyProofVerified(proofCacheKey)) {
+        passVerify = true;
+    } else if (useBatching) {
+        // if we are collecting proofs, skip verification and collect proofs
+        // add proofs into container
         passVerify = true;
         batchProofContainer->add(*spend);
     } else {
@@ -693,6 +760,8 @@ bool CheckSparkSpendTransaction(
         } catch (const std::exception &) {
             passVerify = false;
         }
+        if (passVerify && !isVerifyDB)
+            SetPrivacyProofVerified(proofCacheKey);
     }
 
     if (passVerify) {
@@ -846,16 +915,27 @@ bool GetOutPoint(COutPoint& outPoint, const spark::Coin& coin)
     if (mintHeight==-1 && coinId==-1)
         return false;
 
-    // get block containing mint
+    // an entry left behind by a reorg the node didn't finish has a different height
+    uint256 coinHash = coin.getHash();
+    int nIndexedHeight;
+    if (pblocktree->ReadSparkMintOutPoint(coinHash, outPoint, nIndexedHeight) && nIndexedHeight == mintHeight)
+        return true;
+
+    // not indexed, the block was connected by an older version: search it and index the mint
     CBlockIndex *mintBlock = chainActive[mintHeight];
     CBlock block;
-    //TODO levon, try to optimize this
     if (!ReadBlockFromDisk(block, mintBlock, ::Params().GetConsensus())) {
         LogPrintf("can't read block from disk.\n");
         return false;
     }
 
-    return GetOutPointFromBlock(outPoint, coin, block);
+    if (!GetOutPointFromBlock(outPoint, coin, block))
+        return false;
+
+    std::vector<std::pair<uint256, std::pair<COutPoint, int> > > vect;
+    vect.emplace_back(coinHash, std::make_pair(outPoint, mintHeight));
+    pblocktree->WriteSparkMintOutPoints(vect);
+    return true;
 }
 
 bool GetOutPoint(COutPoint& outPoint, const uint256& coinHash)
@@ -898,7 +978,7 @@ std::vector<unsigned char> getSerialContext(const CTransaction &tx) {
     if (tx.IsSparkSpend()) {
         try {
             spark::SpendTransaction spend = ParseSparkSpend(tx);
-            serialContextStream << spend.getUsedLTags();
+            return getSerialContext(spend.getUsedLTags());
         } catch (const std::exception &) {
             return std::vector<unsigned char>();
         }
@@ -913,6 +993,12 @@ std::vector<unsigned char> getSerialContext(const CTransaction &tx) {
     return serial_context;
 }
 
+std::vector<unsigned char> getSerialContext(const std::vector<GroupElement> &lTags) {
+    CDataStream serialContextStream(SER_NETWORK, PROTOCOL_VERSION);
+    serialContextStream << lTags;
+    return std::vector<unsigned char>(serialContextStream.begin(), serialContextStream.end());
+}
+
 static bool CheckSparkSpendTAg(
         CValidationState& state,
         CSparkTxInfo* sparkTxInfo,
@@ -954,8 +1040,12 @@ void CSparkState::Reset() {
     latestCoinId = 0;
     mintedCoins.clear();
     usedLTags.clear();
+    mintsByHash = coin_hash_map();
+    lTagsByHash = ltag_hash_map();
+    spendLog.Reset();
     mintMetaInfo.clear();
     spendMetaInfo.clear();
+    PublishSnapshot(nullptr);
 }
 
 std::pair<int, int> CSparkState::GetMintedCoinHeightAndId(const spark::Coin& coin) {
@@ -1025,6 +1115,10 @@ bool CSparkState::CanAddMintToMempool(const spark::Coin& coin){
 void CSparkState::AddMint(const spark::Coin& coin, const CMintedCoinInfo& coinInfo) {
     mintedCoins.insert(std::make_pair(coin, coinInfo));
     mintMetaInfo[coinInfo.coinGroupId] += 1;
+
+    uint256 coinHash = primitives::GetSparkCoinHash(coin);
+    if (!mintsByHash.count(coinHash))
+        mintsByHash = mintsByHash.set(coinHash, coinInfo);
 }
 
 void CSparkState::RemoveMint(const spark::Coin& coin) {
@@ -1032,6 +1126,7 @@ void CSparkState::RemoveMint(const spark::Coin& coin) {
     if (iter != mintedCoins.end()) {
         mintMetaInfo[iter->second.coinGroupId] -= 1;
         mintedCoins.erase(iter);
+        mintsByHash = mintsByHash.erase(primitives::GetSparkCoinHash(coin));
     }
 }
 
@@ -1089,6 +1184,7 @@ void CSparkState::AddMintsToStateAndBlockIndex(
 void CSparkState::AddSpend(const GroupElement& lTag, int coinGroupId) {
     if (mintMetaInfo.count(coinGroupId) > 0) {
         usedLTags[lTag] = coinGroupId;
+        lTagsByHash = lTagsByHash.set(primitives::GetLTagHash(lTag), std::make_pair(lTag, coinGroupId));
         spendMetaInfo[coinGroupId] += 1;
     }
 }
@@ -1102,6 +1198,7 @@ void CSparkState::RemoveSpend(const GroupElement& lTag) {
     if (iter != usedLTags.end()) {
         spendMetaInfo[iter->second] -= 1;
         usedLTags.erase(iter);
+        lTagsByHash = lTagsByHash.erase(primitives::GetLTagHash(lTag));
     }
 }
 
@@ -1133,6 +1230,7 @@ void CSparkState::AddBlock(CBlockIndex *index) {
     for (auto const &lTags : index->spentLTags) {
         AddSpend(lTags.first, lTags.second);
     }
+    AddSpendsToLog(index);
     if (GetBoolArg("-mobile", false)) {
         for (auto const &elem : index->ltagTxhash) {
             AddLTagTxHash(elem.first, elem.second);
@@ -1140,6 +1238,17 @@ void CSparkState::AddBlock(CBlockIndex *index) {
     }
 }
 
+void CSparkState::AddSpendsToLog(CBlockIndex *index) {
+    if (index->spentLTags.empty())
+        return;
+
+    std::vector<GroupElement> lTags;
+    lTags.reserve(index->spentLTags.size());
+    for (auto const &lTag : index->spentLTags)
+        lTags.push_back(lTag.first);
+    spendLog.AddBlock(index->nHeight, std::move(lTags));
+}
+
 void CSparkState::RemoveBlock(CBlockIndex *index) {
     // roll back coin group updates
     for (auto &coins : index->sparkMintedCoins)
@@ -1207,6 +1316,7 @@ void CSparkState::RemoveBlock(CBlockIndex *index) {
     for (auto const& lTag : index->spentLTags) {
         RemoveSpend(lTag.first);
     }
+    spendLog.RemoveFrom(index->nHeight);
 }
 
 bool CSparkState::AddSpendToMempool(const std::vector<GroupElement>& lTags, uint256 txHash) {
@@ -1276,6 +1386,7 @@ int CSparkState::GetCoinSetForSpend(
         uint256& blockHash_out,
         std::vector<spark::Coin>& coins_out,
         std::vector<unsigned char>& setHash_out) {
+    CPerfTimer perfTimer(PerfStat::SPARK_COVER_SET);
 
     coins_out.clear();
 
@@ -1481,6 +1592,10 @@ std::unordered_map<uint256, uint256> const& CSparkState::GetSpendTxIds() const {
     return ltagTxhash;
 }
 
+CSpendLog<GroupElement> const & CSparkState::GetSpendLog() const {
+    return spendLog;
+}
+
 std::unordered_map<int, CSparkState::SparkCoinGroupInfo> const& CSparkState::GetCoinGroups() const {
     return coinGroups;
 }
@@ -1515,6 +1630,59 @@ size_t CSparkState::CountLastNCoins(int groupId, size_t required, CBlockIndex* &
     return coins;
 }
 
+void CSparkState::PublishSnapshot(const CBlockIndex *tip) {
+    auto newSnapshot = std::make_shared<CSparkStateSnapshot>();
+    if (tip) {
+        newSnapshot->nHeight = tip->nHeight;
+        newSnapshot->blockHash = tip->GetBlockHash();
+    }
+    newSnapshot->latestCoinId = latestCoinId;
+    newSnapshot->coinGroups = coinGroups;
+    newSnapshot->mints = mintsByHash;
+    newSnapshot->lTags = lTagsByHash;
+
+    std::atomic_store(&snapshot, std::shared_ptr<const CSparkStateSnapshot>(std::move(newSnapshot)));
+}
+
+std::shared_ptr<const CSparkStateSnapshot> CSparkState::GetSnapshot() const {
+    return std::atomic_load(&snapshot);
+}
+
+// CSparkStateSnapshot
+bool CSparkStateSnapshot::IsUsedLTag(const GroupElement& lTag) const {
+    return lTags.count(primitives::GetLTagHash(lTag)) != 0;
+}
+
+bool CSparkStateSnapshot::IsUsedLTagHash(GroupElement& lTag, const uint256& lTagHash) const {
+    auto entry = lTags.find(lTagHash);
+    if (!entry)
+        return false;
+    lTag = entry->first;
+    return true;
+}
+
+bool CSparkStateSnapshot::HasCoin(const spark::Coin& coin) const {
+    return mints.count(primitives::GetSparkCoinHash(coin)) != 0;
+}
+
+std::pair<int, int> CSparkStateSnapshot::GetMintedCoinHeightAndId(const spark::Coin& coin) const {
+    return GetMintedCoinHeightAndId(primitives::GetSparkCoinHash(coin));
+}
+
+std::pair<int, int> CSparkStateSnapshot::GetMintedCoinHeightAndId(const uint256& coinHash) const {
+    auto coinInfo = mints.find(coinHash);
+    if (coinInfo)
+        return std::make_pair(coinInfo->nHeight, coinInfo->coinGroupId);
+    return std::make_pair(-1, -1);
+}
+
+bool CSparkStateSnapshot::GetCoinGroupInfo(int group_id, CSparkState::SparkCoinGroupInfo& result) const {
+    auto it = coinGroups.find(group_id);
+    if (it == coinGroups.end())
+        return false;
+    result = it->second;
+    return true;
+}
 
 // CSparkMempoolState
 bool CSparkMempoolState::HasMint(const spark::Coin& coin) {
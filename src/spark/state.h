@@ -11,6 +11,11 @@
 #include "../libspark/spend_transaction.h"
 #include "primitives.h"
 #include "sparkname.h"
+#include "../spendlog.h"
+
+#include "immer/map.hpp"
+
+#include <memory>
 
 namespace spark_mintspend { class spark_mintspend_test; }
 
@@ -50,9 +55,14 @@ unsigned char GetNetworkType();
 void ParseSparkMintTransaction(const std::vector<CScript>& scripts, MintTransaction& mintTransaction);
 void ParseSparkMintCoin(const CScript& script, spark::Coin& txCoin);
 std::vector<unsigned char> getSerialContext(const CTransaction &tx);
+// serial context of a spark spend whose linking tags have already been parsed
+std::vector<unsigned char> getSerialContext(const std::vector<GroupElement> &lTags);
 spark::SpendTransaction ParseSparkSpend(const CTransaction &tx);
 
 std::vector<GroupElement>  GetSparkUsedTags(const CTransaction &tx);
+// GetSparkMintCoins() returns the coins cached on the transaction, ParseSparkMintCoins() always decodes them
+std::vector<spark::Coin>  ParseSparkMintCoins(const CTransaction &tx);
+std::vector<spark::Coin>  ParseSparkMintCoins(const CTransaction &tx, const std::vector<unsigned char> &serial_context);
 std::vector<spark::Coin>  GetSparkMintCoins(const CTransaction &tx);
 
 size_t GetSpendInputs(const CTransaction &tx);
@@ -119,6 +129,13 @@ public:
     void Reset();
 };
 
+//! Minted coins by GetSparkCoinHash() and used linking tags with their group by GetLTagHash(), as
+//! persistent maps. Copies share their nodes, so a copy costs the same whatever the size.
+using coin_hash_map = immer::map<uint256, CMintedCoinInfo>;
+using ltag_hash_map = immer::map<uint256, std::pair<GroupElement, int>>;
+
+class CSparkStateSnapshot;
+
 /*
  * State of minted/spent coins as extracted from the index
  */
@@ -179,6 +196,8 @@ public:
     void AddBlock(CBlockIndex *index);
     // Disconnect block from the chain rolling back mints and spends
     void RemoveBlock(CBlockIndex *index);
+    // Append linking tags spent in the block to the height ordered spend log
+    void AddSpendsToLog(CBlockIndex *index);
 
     // Add spend into the mempool.
     // Check if there is a coin with such serial in either blockchain or mempool
@@ -239,11 +258,17 @@ public:
     std::unordered_map<uint256, uint256> const& GetSpendTxIds() const;
     std::unordered_map<int, SparkCoinGroupInfo> const & GetCoinGroups() const;
     std::unordered_map<GroupElement, uint256, spark::CLTagHash> const & GetMempoolLTags() const;
+    CSpendLog<GroupElement> const & GetSpendLog() const;
 
     static CSparkState* GetState();
 
     std::size_t GetTotalCoins() const { return mintedCoins.size(); }
 
+    // Make the state as of block tip visible to GetSnapshot(), called whenever a block is connected or disconnected
+    void PublishSnapshot(const CBlockIndex *tip);
+    // The last published state, it can be used without cs_main
+    std::shared_ptr<const CSparkStateSnapshot> GetSnapshot() const;
+
 private:
     size_t CountLastNCoins(int groupId, size_t required, CBlockIndex* &first);
 
@@ -262,8 +287,15 @@ private:
     std::unordered_map<spark::Coin, CMintedCoinInfo, spark::CoinHash> mintedCoins;
     // Set of all used coin linking tags.
     std::unordered_map<GroupElement, int, spark::CLTagHash> usedLTags;
+    // The same two by hash, for snapshots
+    coin_hash_map mintsByHash;
+    ltag_hash_map lTagsByHash;
+    // Set with std::atomic_store and read with std::atomic_load
+    std::shared_ptr<const CSparkStateSnapshot> snapshot;
     // linking tag hash mapped to tx hash
     std::unordered_map<uint256, uint256> ltagTxhash;
+    // Used linking tags in the order they were spent on the active chain
+    CSpendLog<GroupElement> spendLog;
 
     typedef std::map<int, size_t> metainfo_container_t;
     metainfo_container_t extendedMintMetaInfo, mintMetaInfo, spendMetaInfo;
@@ -271,6 +303,40 @@ private:
     friend class spark_mintspend::spark_mintspend_test;
 };
 
+/*
+ * The Spark state as of one block of the active chain. It never changes once published and
+ * shares its maps with the state, so it is published at every block connect and disconnect and
+ * readers can query it without cs_main.
+ */
+class CSparkStateSnapshot {
+public:
+    // Height and hash of the block the snapshot was taken at, -1 and zero before the first one
+    int GetHeight() const { return nHeight; }
+    const uint256& GetBlockHash() const { return blockHash; }
+
+    bool IsUsedLTag(const GroupElement& lTag) const;
+    // If the linking tag with the given hash was used, store it in lTag
+    bool IsUsedLTagHash(GroupElement& lTag, const uint256& lTagHash) const;
+    bool HasCoin(const spark::Coin& coin) const;
+    // Return height of mint transaction and id of minted coin, by the coin or by its hash
+    std::pair<int, int> GetMintedCoinHeightAndId(const spark::Coin& coin) const;
+    std::pair<int, int> GetMintedCoinHeightAndId(const uint256& coinHash) const;
+    bool GetCoinGroupInfo(int group_id, CSparkState::SparkCoinGroupInfo& result) const;
+    int GetLatestCoinID() const { return latestCoinId; }
+    std::size_t GetTotalCoins() const { return mints.size(); }
+
+private:
+    friend class CSparkState;
+
+    int nHeight = -1;
+    uint256 blockHash;
+    int latestCoinId = 0;
+    std::unordered_map<int, CSparkState::SparkCoinGroupInfo> coinGroups;
+
+    coin_hash_map mints;
+    ltag_hash_map lTags;
+};
+
 } // namespace spark
 
 #endif //_MAIN_SPARK_STATE_H_
@@ -0,0 +1,341 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "withdrawalqueue.h"
+#include "state.h"
+#include "../base58.h"
+#include "../chainparams.h"
+#include "../net.h"
+#include "../policy/policy.h"
+#include "../random.h"
+#include "../util.h"
+#include "../utilmoneystr.h"
+#include "../validation.h"
+#include "../wallet/wallet.h"
+#include "../wallet/walletexcept.h"
+
+#include <algorithm>
+
+static bool DecodeSparkAddress(const std::string& str, spark::Address& address)
+{
+    try {
+        return address.decode(str) == spark::GetNetworkType();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+CSparkWithdrawalQueue::CSparkWithdrawalQueue(const std::string& strWalletFileIn)
+    : strWalletFile(strWalletFileIn)
+{
+    nWindow = std::max<int64_t>(0, GetArg("-sparkwithdrawalwindow", DEFAULT_SPARK_WITHDRAWAL_WINDOW));
+    nMaxPayouts = std::max<int64_t>(1, GetArg("-sparkwithdrawalmaxpayouts", DEFAULT_SPARK_WITHDRAWAL_MAX_PAYOUTS));
+
+    CWalletDB walletdb(strWalletFile);
+    for (CSparkPayout& payout : walletdb.ListSparkPayouts()) {
+        // a transaction that made it into the wallet may have been broadcast, any other was not
+        if (payout.status == SPARK_PAYOUT_SENDING) {
+            bool fInWallet = !payout.txid.IsNull() && pwalletMain->GetWalletTx(payout.txid) != nullptr;
+            payout.status = fInWallet ? SPARK_PAYOUT_SENT : SPARK_PAYOUT_QUEUED;
+            if (!fInWallet)
+                payout.txid.SetNull();
+            walletdb.WriteSparkPayout(payout);
+        }
+        payouts[payout.id] = payout;
+    }
+}
+
+uint256 CSparkWithdrawalQueue::Add(const std::string& address, CAmount amount, bool subtractFee, const std::string& memo)
+{
+    const auto& consensusParams = Params().GetConsensus();
+    const spark::Params* params = spark::Params::get_default();
+
+    if (amount <= 0 || !MoneyRange(amount))
+        throw std::invalid_argument(_("Invalid amount"));
+
+    spark::Address sparkAddress(params);
+    if (DecodeSparkAddress(address, sparkAddress)) {
+        if (memo.size() > params->get_memo_bytes())
+            throw std::invalid_argument(_("Memo is too long"));
+    } else {
+        CPrivoraAddress privoraAddress(address);
+        if (!privoraAddress.IsValid())
+            throw std::invalid_argument(_("Invalid Privora address"));
+        CScript scriptPubKey = GetScriptForDestination(privoraAddress.Get());
+        if (scriptPubKey.IsPayToExchangeAddress())
+            throw std::invalid_argument(_("Exchange addresses cannot receive private funds"));
+        if (!memo.empty())
+            throw std::invalid_argument(_("Only Spark addresses take a memo"));
+        if (amount > consensusParams.nMaxValueSparkSpendPerTransaction)
+            throw std::invalid_argument(_("Amount exceeds the transparent value of a Spark spend"));
+        if (!subtractFee && CTxOut(amount, scriptPubKey).IsDust(minRelayTxFee))
+            throw std::invalid_argument(_("Amount is too small"));
+    }
+
+    CSparkPayout payout;
+    payout.id = GetRandHash();
+    payout.address = address;
+    payout.amount = amount;
+    payout.subtractFee = subtractFee;
+    payout.memo = memo;
+    payout.nTime = GetTime();
+    payout.status = SPARK_PAYOUT_QUEUED;
+
+    LOCK(cs);
+    if (!CWalletDB(strWalletFile).WriteSparkPayout(payout))
+        throw std::runtime_error(_("Unable to write the payout to the wallet"));
+    payouts[payout.id] = payout;
+    return payout.id;
+}
+
+bool CSparkWithdrawalQueue::Get(const uint256& id, CSparkPayout& payout) const
+{
+    LOCK(cs);
+    auto it = payouts.find(id);
+    if (it == payouts.end())
+        return false;
+    payout = it->second;
+    return true;
+}
+
+std::vector<CSparkPayout> CSparkWithdrawalQueue::List() const
+{
+    std::vector<CSparkPayout> result;
+    {
+        LOCK(cs);
+        result.reserve(payouts.size());
+        for (const auto& it : payouts)
+            result.push_back(it.second);
+    }
+    std::sort(result.begin(), result.end(), [](const CSparkPayout& a, const CSparkPayout& b) {
+        return a.nTime != b.nTime ? a.nTime < b.nTime : a.id < b.id;
+    });
+    return result;
+}
+
+void CSparkWithdrawalQueue::PruneFinished(int64_t nNow)
+{
+    AssertLockHeld(cs);
+    CWalletDB walletdb(strWalletFile);
+    for (auto it = payouts.begin(); it != payouts.end();) {
+        const CSparkPayout& payout = it->second;
+        if ((payout.status == SPARK_PAYOUT_SENT || payout.status == SPARK_PAYOUT_FAILED) && payout.nTime < nNow - SPARK_PAYOUT_KEEP_TIME) {
+            walletdb.EraseSparkPayout(payout.id);
+            it = payouts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CSparkWithdrawalQueue::SetStatus(const std::vector<uint256>& ids, uint8_t status, const std::string& strError)
+{
+    LOCK(cs);
+    CWalletDB walletdb(strWalletFile);
+    for (const uint256& id : ids) {
+        CSparkPayout& payout = payouts[id];
+        payout.status = status;
+        payout.error = strError;
+        // drop the transaction of a failed batch, the payout is not in it
+        if (status == SPARK_PAYOUT_QUEUED || status == SPARK_PAYOUT_FAILED) {
+            payout.txid.SetNull();
+            payout.fee = 0;
+        }
+        // a payout that is only being put into a transaction is still queued on disk
+        if (status != SPARK_PAYOUT_SENDING)
+            walletdb.WriteSparkPayout(payout);
+    }
+}
+
+std::vector<std::vector<uint256>> CSparkWithdrawalQueue::MakeBatches(const std::vector<const CSparkPayout*>& queued) const
+{
+    const auto& consensusParams = Params().GetConsensus();
+    const spark::Params* params = spark::Params::get_default();
+    // CreateSparkSpendTransaction() needs room for the change
+    const size_t nMaxPrivate = consensusParams.nMaxSparkOutLimitPerTx - 2;
+
+    std::vector<std::vector<uint256>> batches;
+    std::vector<uint256> batch;
+    size_t nPrivate = 0;
+    CAmount nTransparent = 0;
+    for (const CSparkPayout* payout : queued) {
+        spark::Address address(params);
+        bool fPrivate = DecodeSparkAddress(payout->address, address);
+        if (batch.size() >= nMaxPayouts ||
+                (fPrivate && nPrivate >= nMaxPrivate) ||
+                (!fPrivate && nTransparent + payout->amount > consensusParams.nMaxValueSparkSpendPerTransaction)) {
+            batches.push_back(std::move(batch));
+            batch.clear();
+            nPrivate = 0;
+            nTransparent = 0;
+        }
+        batch.push_back(payout->id);
+        if (fPrivate)
+            nPrivate++;
+        else
+            nTransparent += payout->amount;
+    }
+    if (!batch.empty())
+        batches.push_back(std::move(batch));
+    return batches;
+}
+
+CSparkWithdrawalQueue::BatchResult CSparkWithdrawalQueue::SendBatch(const std::vector<uint256>& ids, std::string& strError)
+{
+    const spark::Params* params = spark::Params::get_default();
+
+    // outputs in the order of ids, the transparent ones first as CreateSparkSpendTransaction() subtracts the fee from them first
+    std::vector<CRecipient> recipients;
+    std::vector<std::pair<spark::OutputCoinData, bool>> privateRecipients;
+    std::vector<uint256> transparentIds, privateIds;
+    {
+        LOCK(cs);
+        for (const uint256& id : ids) {
+            const CSparkPayout& payout = payouts.at(id);
+            spark::Address address(params);
+            if (DecodeSparkAddress(payout.address, address)) {
+                spark::OutputCoinData output;
+                output.address = address;
+                output.v = payout.amount;
+                output.memo = payout.memo;
+                privateRecipients.emplace_back(output, payout.subtractFee);
+                privateIds.push_back(id);
+            } else {
+                CRecipient recipient = {GetScriptForDestination(CPrivoraAddress(payout.address).Get()), payout.amount, payout.subtractFee};
+                recipients.push_back(recipient);
+                transparentIds.push_back(id);
+            }
+        }
+    }
+
+    CAmount nFee = 0;
+    CWalletTx wtx;
+    try {
+        wtx = pwalletMain->CreateSparkSpendTransaction(recipients, privateRecipients, nFee);
+    } catch (const InsufficientFunds& e) {
+        strError = e.what();
+        return BATCH_RETRY;
+    } catch (const std::exception& e) {
+        strError = e.what();
+        return BATCH_FAILED;
+    }
+
+    std::vector<uint256> outputIds = transparentIds;
+    outputIds.insert(outputIds.end(), privateIds.begin(), privateIds.end());
+    {
+        LOCK(cs);
+        size_t nSubtractFee = 0;
+        for (const uint256& id : outputIds)
+            nSubtractFee += payouts.at(id).subtractFee;
+
+        // record the transaction before committing it
+        CWalletDB walletdb(strWalletFile);
+        bool fRemainder = true;
+        for (const uint256& id : outputIds) {
+            CSparkPayout& payout = payouts.at(id);
+            payout.txid = wtx.GetHash();
+            payout.fee = 0;
+            if (payout.subtractFee) {
+                payout.fee = nFee / nSubtractFee;
+                if (fRemainder) {
+                    payout.fee += nFee % nSubtractFee;
+                    fRemainder = false;
+                }
+            }
+            walletdb.WriteSparkPayout(payout);
+        }
+    }
+
+    CValidationState state;
+    bool fCommitted = false;
+    try {
+        CReserveKey reserveKey(pwalletMain);
+        fCommitted = pwalletMain->CommitTransaction(wtx, reserveKey, g_connman.get(), state);
+    } catch (const std::exception& e) {
+        strError = e.what();
+    }
+
+    // once the transaction is in the wallet it may have been broadcast, so it must not be sent again
+    if (pwalletMain->GetWalletTx(wtx.GetHash()) == nullptr)
+        return BATCH_FAILED;
+
+    // the wallet keeps a transaction the memory pool rejected, it was not relayed and its coins
+    // are given back for the payouts to be sent again
+    if ((!fCommitted || !state.IsValid()) && pwalletMain->AbandonTransaction(wtx.GetHash())) {
+        if (!state.IsValid())
+            strError = state.GetRejectReason();
+        else if (strError.empty())
+            strError = "the transaction could not be committed";
+        LogPrintf("%s: transaction %s rejected: %s\n", __func__, wtx.GetHash().ToString(), FormatStateMessage(state));
+        return BATCH_FAILED;
+    }
+
+    LogPrintf("%s: sent %u payouts in %s, fee %s\n", __func__, ids.size(), wtx.GetHash().ToString(), FormatMoney(nFee));
+    strError.clear();
+    return BATCH_SENT;
+}
+
+void CSparkWithdrawalQueue::Process(bool fForce)
+{
+    LOCK(cs_process);
+
+    if (pwalletMain->IsLocked() || !spark::IsSparkAllowed())
+        return;
+
+    int64_t nNow = GetTime();
+    std::vector<std::vector<uint256>> batches;
+    {
+        LOCK(cs);
+        PruneFinished(nNow);
+
+        std::vector<const CSparkPayout*> queued;
+        for (const auto& it : payouts) {
+            if (it.second.status == SPARK_PAYOUT_QUEUED)
+                queued.push_back(&it.second);
+        }
+        if (queued.empty())
+            return;
+
+        std::sort(queued.begin(), queued.end(), [](const CSparkPayout* a, const CSparkPayout* b) {
+            return a->nTime != b->nTime ? a->nTime < b->nTime : a->id < b->id;
+        });
+        if (!fForce && queued.front()->nTime > nNow - nWindow && queued.size() < nMaxPayouts)
+            return;
+
+        batches = MakeBatches(queued);
+        for (const auto& batch : batches) {
+            for (const uint256& id : batch)
+                payouts[id].status = SPARK_PAYOUT_SENDING;
+        }
+    }
+
+    for (size_t i = 0; i < batches.size(); i++) {
+        std::string strError;
+        BatchResult result = SendBatch(batches[i], strError);
+
+        if (result == BATCH_FAILED && batches[i].size() > 1) {
+            // find the payouts that can not be sent by sending them one by one
+            LogPrintf("%s: batch of %u payouts failed (%s), sending them one by one\n", __func__, batches[i].size(), strError);
+            for (const uint256& id : batches[i]) {
+                if (result != BATCH_RETRY)
+                    result = SendBatch({id}, strError);
+                if (result == BATCH_SENT)
+                    SetStatus({id}, SPARK_PAYOUT_SENT, "");
+                else
+                    SetStatus({id}, result == BATCH_RETRY ? SPARK_PAYOUT_QUEUED : SPARK_PAYOUT_FAILED, strError);
+            }
+        } else if (result == BATCH_SENT) {
+            SetStatus(batches[i], SPARK_PAYOUT_SENT, "");
+        } else {
+            SetStatus(batches[i], result == BATCH_RETRY ? SPARK_PAYOUT_QUEUED : SPARK_PAYOUT_FAILED, strError);
+        }
+
+        // the next batches need coins as well, try again once some are confirmed
+        if (result == BATCH_RETRY) {
+            for (size_t j = i + 1; j < batches.size(); j++)
+                SetStatus(batches[j], SPARK_PAYOUT_QUEUED, strError);
+            break;
+        }
+    }
+}
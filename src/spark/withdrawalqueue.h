@@ -0,0 +1,71 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_SPARK_WITHDRAWALQUEUE_H
+#define PRIVORA_SPARK_WITHDRAWALQUEUE_H
+
+#include "primitives.h"
+#include "../amount.h"
+#include "../sync.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+//! Seconds a payout waits for others to be sent with it
+static const int64_t DEFAULT_SPARK_WITHDRAWAL_WINDOW = 60;
+//! Payouts sent in one transaction at most
+static const unsigned int DEFAULT_SPARK_WITHDRAWAL_MAX_PAYOUTS = 100;
+//! Seconds between checks of the queue
+static const int64_t SPARK_WITHDRAWAL_CHECK_INTERVAL = 5;
+//! Seconds sent and failed payouts are kept so that their status can be asked for
+static const int64_t SPARK_PAYOUT_KEEP_TIME = 7 * 24 * 60 * 60;
+
+/**
+ * Collects payouts from the Spark wallet for -sparkwithdrawalwindow seconds and sends them
+ * together, as many per transaction as the consensus limits on Spark outputs and transparent
+ * value and -sparkwithdrawalmaxpayouts allow. A batch needs one coin selection, one fetch of
+ * each cover set and one set of proofs instead of one per payout.
+ *
+ * Payouts are kept in the wallet database. A payout is marked as sending, together with the
+ * transaction, before the transaction is committed, so that after a crash it is found in the
+ * wallet rather than sent again.
+ */
+class CSparkWithdrawalQueue
+{
+private:
+    std::string strWalletFile;
+    int64_t nWindow;
+    unsigned int nMaxPayouts;
+
+    mutable CCriticalSection cs;
+    std::map<uint256, CSparkPayout> payouts;
+    // only one Process() at a time
+    CCriticalSection cs_process;
+
+    enum BatchResult {
+        BATCH_SENT,
+        BATCH_FAILED,
+        // the wallet is short of spendable coins right now, the payouts stay queued
+        BATCH_RETRY,
+    };
+
+    std::vector<std::vector<uint256>> MakeBatches(const std::vector<const CSparkPayout*>& queued) const;
+    BatchResult SendBatch(const std::vector<uint256>& ids, std::string& strError);
+    void SetStatus(const std::vector<uint256>& ids, uint8_t status, const std::string& strError);
+    void PruneFinished(int64_t nNow);
+
+public:
+    explicit CSparkWithdrawalQueue(const std::string& strWalletFileIn);
+
+    /** Check a payout and queue it, returns its id. Throws std::invalid_argument if it can not be sent */
+    uint256 Add(const std::string& address, CAmount amount, bool subtractFee, const std::string& memo);
+    bool Get(const uint256& id, CSparkPayout& payout) const;
+    std::vector<CSparkPayout> List() const;
+
+    /** Send the queued payouts once the oldest one waited for the window or enough are queued, or right away if fForce is set */
+    void Process(bool fForce = false);
+};
+
+#endif // PRIVORA_SPARK_WITHDRAWALQUEUE_H
@@ -0,0 +1,112 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_SPENDLOG_H
+#define PRIVORA_SPENDLOG_H
+
+#include "hash.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * Append-only log of spent linking tags / serials, ordered by the height of the block
+ * they were spent in. Within a block the entries are sorted by the hash of their
+ * serialization so every node produces the same order. Light wallets page through it
+ * with a (height, offset in height) cursor and after a reorg simply restart from the
+ * fork height, which is why disconnecting a block truncates the log.
+ */
+template <typename T>
+class CSpendLog
+{
+public:
+    struct Entry {
+        int32_t nHeight;
+        T value;
+
+        Entry() : nHeight(0) {}
+        Entry(int32_t nHeightIn, const T& valueIn) : nHeight(nHeightIn), value(valueIn) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            READWRITE(nHeight);
+            READWRITE(value);
+        }
+    };
+
+private:
+    std::vector<Entry> entries;
+
+    typename std::vector<Entry>::const_iterator FirstAtHeight(int nHeight) const
+    {
+        return std::lower_bound(entries.begin(), entries.end(), nHeight,
+                                [](const Entry& e, int h) { return e.nHeight < h; });
+    }
+
+public:
+    /** Append the spends of a newly connected block, replacing anything logged at or above its height */
+    void AddBlock(int nHeight, std::vector<T> values)
+    {
+        RemoveFrom(nHeight);
+
+        std::vector<std::pair<uint256, T>> sorted;
+        sorted.reserve(values.size());
+        for (auto& value : values)
+            sorted.emplace_back(SerializeHash(value), std::move(value));
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const std::pair<uint256, T>& a, const std::pair<uint256, T>& b) { return a.first < b.first; });
+
+        entries.reserve(entries.size() + sorted.size());
+        for (auto& p : sorted)
+            entries.emplace_back(nHeight, std::move(p.second));
+    }
+
+    /** Drop every entry spent at nHeight or above */
+    void RemoveFrom(int nHeight)
+    {
+        entries.erase(entries.begin() + (FirstAtHeight(nHeight) - entries.cbegin()), entries.end());
+    }
+
+    void Reset()
+    {
+        entries.clear();
+        entries.shrink_to_fit();
+    }
+
+    size_t size() const { return entries.size(); }
+
+    /**
+     * Return up to maxCount entries starting at the nOffset-th entry of height nHeight
+     * (or the first entry above it). The cursor of the entry following the returned
+     * page is stored in nNextHeight/nNextOffset; once the log is exhausted it points past
+     * nTipHeight, the height the log is complete up to.
+     */
+    std::vector<Entry> Read(int nHeight, uint32_t nOffset, size_t maxCount, int nTipHeight, int& nNextHeight, uint32_t& nNextOffset) const
+    {
+        auto it = FirstAtHeight(nHeight);
+        auto heightEnd = nHeight < std::numeric_limits<int>::max() ? FirstAtHeight(nHeight + 1) : entries.cend();
+        it += std::min<size_t>(nOffset, heightEnd - it);
+
+        auto end = it + std::min<size_t>(maxCount, entries.cend() - it);
+        std::vector<Entry> result(it, end);
+
+        if (end == entries.cend()) {
+            nNextHeight = std::max(nHeight, nTipHeight + 1);
+            nNextOffset = 0;
+        } else {
+            nNextHeight = end->nHeight;
+            nNextOffset = end - FirstAtHeight(end->nHeight);
+        }
+        return result;
+    }
+};
+
+#endif // PRIVORA_SPENDLOG_H
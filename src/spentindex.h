@@ -357,4 +357,85 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/** Where a transaction starts in the address index of an address, to seek to or continue from */
+struct CAddressIndexIteratorTxKey {
+    AddressType type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, static_cast<unsigned int>(type));
+        hashBytes.Serialize(s);
+        ser_writedata32be(s, blockHeight);
+        ser_writedata32be(s, txindex);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        type = static_cast<AddressType>(ser_readdata8(s));
+        hashBytes.Unserialize(s);
+        blockHeight = ser_readdata32be(s);
+        txindex = ser_readdata32be(s);
+    }
+
+    CAddressIndexIteratorTxKey(AddressType addressType, uint160 addressHash, int height, unsigned int blockindex) {
+        type = addressType;
+        hashBytes = addressHash;
+        blockHeight = height;
+        txindex = blockindex;
+    }
+
+    CAddressIndexIteratorTxKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        type = AddressType::unknown;
+        hashBytes.SetNull();
+        blockHeight = 0;
+        txindex = 0;
+    }
+};
+
+/** The sum of the address index entries of an address, kept along with them */
+struct CAddressBalance {
+    CAmount balance;
+    //! Sum of the positive entries, change included
+    CAmount received;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+    }
+
+    CAddressBalance() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+    }
+
+    void Add(CAmount amount) {
+        balance += amount;
+        if (amount > 0)
+            received += amount;
+    }
+
+    void Remove(CAmount amount) {
+        balance -= amount;
+        if (amount > 0)
+            received -= amount;
+    }
+
+    bool IsNull() const {
+        return balance == 0 && received == 0;
+    }
+};
+
 #endif // PRIVORA_SPENTINDEX_H
@@ -0,0 +1,584 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "statesnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "consensus/validation.h"
+#include "evo/deterministicmns.h"
+#include "llmq/quorums_blockprocessor.h"
+#include "llmq/quorums_commitment.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+static const int MAX_SNAPSHOT_THREADS = 16;
+
+static int GetSnapshotThreads()
+{
+    return std::max(1, std::min(GetNumCores(), MAX_SNAPSHOT_THREADS));
+}
+
+/** Run func(i) for every i below nItems on up to nThreads threads, this one included */
+static void ParallelFor(size_t nItems, int nThreads, const std::function<void(size_t)>& func)
+{
+    std::atomic<size_t> nNext(0);
+    auto worker = [&]() {
+        for (size_t i = nNext++; i < nItems; i = nNext++)
+            func(i);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads && (size_t)i < nItems; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+}
+
+/**
+ * Blocks before the base block whose masternode lists the snapshot carries, enough to
+ * check the commitments and signatures of the quorums still active after it.
+ */
+static int GetMNListWindow(const Consensus::Params& consensusParams)
+{
+    int nWindow = 0;
+    for (const auto& p : consensusParams.llmqs)
+        nWindow = std::max(nWindow, p.second.dkgInterval * (p.second.signingActiveQuorumCount + 1));
+    return nWindow;
+}
+
+CStateSnapshotWriter::CStateSnapshotWriter(FILE* fileIn, const CStateSnapshotMetadata& metadata)
+    : file(fileIn, SER_DISK, STATE_SNAPSHOT_RECORD_VERSION),
+      hasher(SER_GETHASH, 0),
+      ssRecords(SER_DISK, metadata.nRecordVersion),
+      nType(SNAPSHOT_CHUNK_END),
+      nRecords(0)
+{
+    file << metadata;
+    hasher << metadata;
+}
+
+void CStateSnapshotWriter::WriteChunk(uint8_t nChunkType)
+{
+    CStateSnapshotChunk chunk;
+    chunk.nType = nChunkType;
+    chunk.nRecords = nRecords;
+    chunk.vchData.assign(ssRecords.begin(), ssRecords.end());
+    chunk.hash = chunk.ComputeHash();
+    file << chunk;
+    hasher << chunk.nType << chunk.nRecords << chunk.hash;
+
+    ssRecords.clear();
+    nRecords = 0;
+}
+
+uint256 CStateSnapshotWriter::Finish()
+{
+    if (nRecords > 0)
+        WriteChunk(nType);
+    WriteChunk(SNAPSHOT_CHUNK_END);
+    if (fflush(file.Get()) != 0)
+        throw std::ios_base::failure("CStateSnapshotWriter::Finish: cannot write the snapshot");
+    FileCommit(file.Get());
+    file.fclose();
+    return hasher.GetHash();
+}
+
+CStateSnapshotReader::CStateSnapshotReader(FILE* fileIn)
+    : file(fileIn, SER_DISK, STATE_SNAPSHOT_RECORD_VERSION),
+      hasher(SER_GETHASH, 0),
+      nLastType(SNAPSHOT_CHUNK_END),
+      fEnd(false)
+{
+    if (file.IsNull())
+        throw std::ios_base::failure("CStateSnapshotReader: file is null");
+    file >> metadata;
+    hasher << metadata;
+}
+
+bool CStateSnapshotReader::ReadChunks(std::vector<CStateSnapshotChunk>& chunks, size_t nMaxChunks)
+{
+    chunks.clear();
+    while (!fEnd && chunks.size() < nMaxChunks) {
+        CStateSnapshotChunk chunk;
+        file >> chunk;
+        hasher << chunk.nType << chunk.nRecords << chunk.hash;
+        if (chunk.nType == SNAPSHOT_CHUNK_END) {
+            fEnd = true;
+            break;
+        }
+        // the coins have to come last, so that everything else can be checked before they are written
+        if (chunk.nType < nLastType)
+            throw std::ios_base::failure("CStateSnapshotReader::ReadChunks: chunks out of order");
+        nLastType = chunk.nType;
+        chunks.push_back(std::move(chunk));
+    }
+    return !fEnd;
+}
+
+uint256 CStateSnapshotReader::GetContentHash()
+{
+    assert(fEnd);
+    return hasher.GetHash();
+}
+
+bool VerifyStateSnapshotChunks(const std::vector<CStateSnapshotChunk>& chunks, int nThreads)
+{
+    std::atomic<bool> fValid(true);
+    ParallelFor(chunks.size(), nThreads, [&](size_t i) {
+        if (chunks[i].ComputeHash() != chunks[i].hash)
+            fValid = false;
+    });
+    return fValid;
+}
+
+bool HashStateSnapshot(const boost::filesystem::path& path, CStateSnapshotMetadata& metadata, uint256& contentHash, std::string& strError)
+{
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file) {
+        strError = strprintf("cannot open %s", path.string());
+        return false;
+    }
+
+    try {
+        CStateSnapshotReader reader(file);
+        metadata = reader.GetMetadata();
+        if (metadata.nVersion != STATE_SNAPSHOT_VERSION) {
+            strError = strprintf("unsupported snapshot version %u", metadata.nVersion);
+            return false;
+        }
+
+        int nThreads = GetSnapshotThreads();
+        std::vector<CStateSnapshotChunk> chunks;
+        bool fMore;
+        do {
+            fMore = reader.ReadChunks(chunks, nThreads * STATE_SNAPSHOT_CHUNKS_PER_THREAD);
+            if (!VerifyStateSnapshotChunks(chunks, nThreads)) {
+                strError = "snapshot chunk hash mismatch";
+                return false;
+            }
+        } while (fMore);
+        contentHash = reader.GetContentHash();
+    } catch (const std::exception& e) {
+        strError = strprintf("cannot read snapshot: %s", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool DumpStateSnapshot(const boost::filesystem::path& path, CStateSnapshotMetadata& metadata, uint256& contentHash, std::string& strError)
+{
+    // the block index records of -mobile nodes carry extra data
+    if (GetBoolArg("-mobile", false)) {
+        strError = "state snapshots cannot be made with -mobile";
+        return false;
+    }
+    if (boost::filesystem::exists(path)) {
+        strError = strprintf("%s already exists", path.string());
+        return false;
+    }
+    boost::filesystem::path pathTemp = path.string() + ".incomplete";
+    FILE* file = fopen(pathTemp.string().c_str(), "wb");
+    if (!file) {
+        strError = strprintf("cannot open %s for writing", pathTemp.string());
+        return false;
+    }
+
+    try {
+        std::unique_ptr<CStateSnapshotWriter> writer;
+        std::unique_ptr<CCoinsViewCursor> pcursor;
+        size_t nCoins = 0;
+        {
+            LOCK(cs_main);
+            FlushStateToDisk();
+            const Consensus::Params& consensusParams = Params().GetConsensus();
+            CBlockIndex* pindexBase = chainActive.Tip();
+            pcursor.reset(pcoinsTip->Cursor());
+            assert(pcursor->GetBestBlock() == pindexBase->GetBlockHash());
+
+            metadata.nVersion = STATE_SNAPSHOT_VERSION;
+            memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+            metadata.nRecordVersion = STATE_SNAPSHOT_RECORD_VERSION;
+            metadata.hashBlock = pindexBase->GetBlockHash();
+            metadata.nHeight = pindexBase->nHeight;
+            writer.reset(new CStateSnapshotWriter(file, metadata));
+
+            // only what the block tree database keeps, so it hashes the same on every node
+            for (const CBlockIndex* pindex = chainActive.Genesis(); pindex; pindex = chainActive.Next(pindex)) {
+                CDiskBlockIndex diskindex(pindex);
+                diskindex.nStatus = BLOCK_VALID_SCRIPTS;
+                diskindex.nFile = 0;
+                diskindex.nDataPos = 0;
+                diskindex.nUndoPos = 0;
+                writer->Add(SNAPSHOT_CHUNK_BLOCK_INDEX, diskindex);
+            }
+
+            if (pindexBase->nHeight >= consensusParams.DIP0003Height) {
+                int nStartHeight = std::max(pindexBase->nHeight - GetMNListWindow(consensusParams), consensusParams.DIP0003Height);
+                CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(pindexBase->GetAncestor(nStartHeight));
+                writer->Add(SNAPSHOT_CHUNK_MN_LIST, mnList);
+                for (int nHeight = nStartHeight + 1; nHeight <= pindexBase->nHeight; nHeight++) {
+                    CDeterministicMNList mnListNext = deterministicMNManager->GetListForBlock(pindexBase->GetAncestor(nHeight));
+                    writer->Add(SNAPSHOT_CHUNK_MN_LIST_DIFF, mnList.BuildDiff(mnListNext));
+                    mnList = std::move(mnListNext);
+                }
+
+                for (const auto& p : consensusParams.llmqs) {
+                    size_t nMaxQuorums = pindexBase->nHeight / p.second.dkgInterval + 1;
+                    for (const CBlockIndex* pindexQuorum : llmq::quorumBlockProcessor->GetMinedCommitmentsUntilBlock(p.first, pindexBase, nMaxQuorums)) {
+                        llmq::CFinalCommitment qc;
+                        uint256 hashMinedBlock;
+                        if (!llmq::quorumBlockProcessor->GetMinedCommitment(p.first, pindexQuorum->GetBlockHash(), qc, hashMinedBlock))
+                            throw std::runtime_error(strprintf("cannot read the commitment of quorum %s", pindexQuorum->GetBlockHash().ToString()));
+                        writer->Add(SNAPSHOT_CHUNK_LLMQ_COMMITMENT, std::make_pair(qc, hashMinedBlock));
+                    }
+                }
+            }
+        }
+
+        // the cursor reads a database snapshot, the node can go on meanwhile
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint outpoint;
+            Coin coin;
+            if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin))
+                throw std::runtime_error("cannot read a coin");
+            writer->Add(SNAPSHOT_CHUNK_COINS, std::make_pair(outpoint, coin));
+            nCoins++;
+            pcursor->Next();
+        }
+        contentHash = writer->Finish();
+        LogPrintf("%s: wrote %u coins at block %s (%d), content hash %s\n", __func__, nCoins,
+            metadata.hashBlock.ToString(), metadata.nHeight, contentHash.ToString());
+    } catch (const std::exception& e) {
+        boost::filesystem::remove(pathTemp);
+        strError = strprintf("cannot write snapshot: %s", e.what());
+        return false;
+    }
+
+    if (!RenameOver(pathTemp, path)) {
+        strError = strprintf("cannot rename %s", pathTemp.string());
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+struct CDecodedChunk
+{
+    std::vector<CDiskBlockIndex> blocks;
+    std::vector<CDeterministicMNList> mnLists;
+    std::vector<CDeterministicMNListDiff> mnListDiffs;
+    std::vector<std::pair<llmq::CFinalCommitment, uint256>> commitments;
+    std::vector<std::pair<COutPoint, Coin>> coins;
+};
+
+bool DecodeChunk(const CStateSnapshotChunk& chunk, int nRecordVersion, CDecodedChunk& decoded)
+{
+    try {
+        CDataStream ss(chunk.vchData, SER_DISK, nRecordVersion);
+        for (uint32_t i = 0; i < chunk.nRecords; i++) {
+            switch (chunk.nType) {
+            case SNAPSHOT_CHUNK_BLOCK_INDEX:
+                decoded.blocks.emplace_back();
+                ss >> decoded.blocks.back();
+                break;
+            case SNAPSHOT_CHUNK_MN_LIST:
+                decoded.mnLists.emplace_back();
+                ss >> decoded.mnLists.back();
+                break;
+            case SNAPSHOT_CHUNK_MN_LIST_DIFF:
+                decoded.mnListDiffs.emplace_back();
+                ss >> decoded.mnListDiffs.back();
+                break;
+            case SNAPSHOT_CHUNK_LLMQ_COMMITMENT:
+                decoded.commitments.emplace_back();
+                ss >> decoded.commitments.back();
+                break;
+            case SNAPSHOT_CHUNK_COINS:
+                decoded.coins.emplace_back();
+                ss >> decoded.coins.back();
+                break;
+            default:
+                return false;
+            }
+        }
+        return ss.empty();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+template <typename T>
+void MoveAppend(std::vector<T>& to, std::vector<T>& from)
+{
+    to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+}
+
+/**
+ * Check the records of a snapshot other than its coins, without touching any global state: the
+ * block index is one chain from our genesis block to the base block, and the masternode lists
+ * and commitments are of that chain. Fills vBlockHashes with the hashes of its blocks.
+ */
+bool CheckSnapshotState(const CDecodedChunk& state, const CStateSnapshotMetadata& metadata, std::vector<uint256>& vBlockHashes, std::string& strError)
+{
+    if (state.blocks.size() != (size_t)metadata.nHeight + 1) {
+        strError = "the snapshot's block index does not end at its base block";
+        return false;
+    }
+    vBlockHashes.clear();
+    vBlockHashes.reserve(state.blocks.size());
+    std::unordered_map<uint256, int, BlockHasher> mapHeights;
+    uint256 hashPrev;
+    for (size_t i = 0; i < state.blocks.size(); i++) {
+        uint256 hash = state.blocks[i].GetBlockHash();
+        if (state.blocks[i].hashPrev != hashPrev || state.blocks[i].nHeight != (int)i ||
+                (i == 0 && hash != Params().GetConsensus().hashGenesisBlock)) {
+            strError = strprintf("the snapshot's block index is broken at height %u", i);
+            return false;
+        }
+        vBlockHashes.push_back(hash);
+        mapHeights.emplace(hash, (int)i);
+        hashPrev = hash;
+    }
+    if (hashPrev != metadata.hashBlock) {
+        strError = "the snapshot's block index does not end at its base block";
+        return false;
+    }
+
+    if (state.mnLists.size() > 1 || (state.mnLists.empty() && !state.mnListDiffs.empty()) ||
+            (!state.mnLists.empty() && state.mnLists[0].GetHeight() + (int)state.mnListDiffs.size() != metadata.nHeight)) {
+        strError = "the snapshot's masternode lists do not end at its base block";
+        return false;
+    }
+    if (!state.mnLists.empty() && (state.mnLists[0].GetHeight() < 0 ||
+            vBlockHashes[state.mnLists[0].GetHeight()] != state.mnLists[0].GetBlockHash())) {
+        strError = "the snapshot's masternode list is not of its chain";
+        return false;
+    }
+
+    for (const auto& commitment : state.commitments) {
+        auto itMined = mapHeights.find(commitment.second);
+        auto itQuorum = mapHeights.find(commitment.first.quorumHash);
+        if (itMined == mapHeights.end() || itQuorum == mapHeights.end() || itQuorum->second > itMined->second) {
+            strError = strprintf("the snapshot's commitment of quorum %s was not mined in its chain", commitment.first.quorumHash.ToString());
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * A coin database of its own the coins of a snapshot are written to while it is read, so
+ * that the chainstate is only touched once the whole snapshot checked out. It is wiped when
+ * opened and removed when it goes out of scope.
+ */
+class CSnapshotCoinsStaging
+{
+public:
+    const boost::filesystem::path path;
+    std::unique_ptr<CCoinsViewDB> db;
+
+    CSnapshotCoinsStaging()
+        : path(GetDataDir() / "snapshotcoins"),
+          db(new CCoinsViewDB(path, "snapshotcoins", nMaxCoinsDBCache << 20, false, true))
+    {
+    }
+
+    ~CSnapshotCoinsStaging()
+    {
+        db.reset();
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(path, ec);
+    }
+};
+
+/**
+ * Copy the staged coins of a snapshot to the chainstate. The coin database keeps the best
+ * block of the genesis tip meanwhile, the loading flag marks it as incomplete until the
+ * snapshot's base block is set.
+ */
+bool CopySnapshotCoins(const CCoinsViewDB& staging, CCoinsViewCache& coins)
+{
+    std::unique_ptr<CCoinsViewCursor> pcursor(staging.Cursor());
+    while (pcursor->Valid()) {
+        COutPoint outpoint;
+        Coin coin;
+        if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin))
+            return false;
+        coins.AddCoin(outpoint, std::move(coin), true);
+        if (coins.DynamicMemoryUsage() > nCoinCacheUsage && (!coins.Flush() || !pcoinsTip->Flush()))
+            return false;
+        pcursor->Next();
+    }
+    return true;
+}
+
+}
+
+bool LoadStateSnapshot(const boost::filesystem::path& path, bool fTrusted, CStateSnapshotMetadata& metadata, uint256& contentHash, std::string& strError)
+{
+    const CChainParams& chainparams = Params();
+
+    if (GetBoolArg("-mobile", false)) {
+        strError = "state snapshots cannot be loaded with -mobile";
+        return false;
+    }
+    // those cover every block, which the node won't have
+    if (fTxIndex || fAddressIndex || fSpentIndex || fTimestampIndex) {
+        strError = "state snapshots cannot be loaded with -txindex, -addressindex, -spentindex or -timestampindex";
+        return false;
+    }
+    {
+        LOCK(cs_main);
+        if (chainActive.Height() != 0) {
+            strError = "the node has connected blocks already";
+            return false;
+        }
+        bool fLoading = false;
+        if (pblocktree->ReadFlag(STATE_SNAPSHOT_LOADING_FLAG, fLoading) && fLoading) {
+            strError = "an earlier snapshot load was interrupted, restart with -reindex-chainstate";
+            return false;
+        }
+    }
+
+    // first check the whole file and its content hash, before touching any state
+    if (!HashStateSnapshot(path, metadata, contentHash, strError))
+        return false;
+    if (memcmp(metadata.pchMessageStart, chainparams.MessageStart(), sizeof(metadata.pchMessageStart)) != 0) {
+        strError = "the snapshot is of another network";
+        return false;
+    }
+    const MapStateSnapshots& mapSnapshots = chainparams.StateSnapshots().mapSnapshots;
+    MapStateSnapshots::const_iterator itPinned = mapSnapshots.find(metadata.nHeight);
+    if (itPinned != mapSnapshots.end()) {
+        if (itPinned->second.first != metadata.hashBlock || itPinned->second.second != contentHash) {
+            strError = strprintf("the snapshot does not match the one pinned at height %d", metadata.nHeight);
+            return false;
+        }
+    } else if (!fTrusted) {
+        strError = strprintf("no snapshot is pinned at height %d, it has to be trusted explicitly", metadata.nHeight);
+        return false;
+    }
+
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file) {
+        strError = strprintf("cannot open %s", path.string());
+        return false;
+    }
+
+    LOCK(cs_main);
+    if (chainActive.Height() != 0) {
+        strError = "the node has connected blocks already";
+        return false;
+    }
+
+    // the records before the coins are kept, the coins are staged in batches as they come
+    CDecodedChunk state;
+    std::vector<uint256> vBlockHashes;
+    bool fChecked = false;
+    CSnapshotCoinsStaging staging;
+    CCoinsViewCache stagedCoins(staging.db.get());
+    try {
+        CStateSnapshotReader reader(file);
+        int nThreads = GetSnapshotThreads();
+        std::vector<CStateSnapshotChunk> chunks;
+        bool fMore;
+        do {
+            fMore = reader.ReadChunks(chunks, nThreads * STATE_SNAPSHOT_CHUNKS_PER_THREAD);
+            std::vector<CDecodedChunk> decoded(chunks.size());
+            std::atomic<bool> fValid(true);
+            ParallelFor(chunks.size(), nThreads, [&](size_t i) {
+                if (chunks[i].ComputeHash() != chunks[i].hash || !DecodeChunk(chunks[i], metadata.nRecordVersion, decoded[i]))
+                    fValid = false;
+            });
+            if (!fValid) {
+                strError = "snapshot chunk is corrupt";
+                return false;
+            }
+            for (CDecodedChunk& chunk : decoded) {
+                MoveAppend(state.blocks, chunk.blocks);
+                MoveAppend(state.mnLists, chunk.mnLists);
+                MoveAppend(state.mnListDiffs, chunk.mnListDiffs);
+                MoveAppend(state.commitments, chunk.commitments);
+                if (chunk.coins.empty())
+                    continue;
+
+                // the coins come last, everything else is checked before the first of them is staged
+                if (!fChecked) {
+                    if (!CheckSnapshotState(state, metadata, vBlockHashes, strError))
+                        return false;
+                    fChecked = true;
+                }
+                for (auto& coin : chunk.coins)
+                    stagedCoins.AddCoin(coin.first, std::move(coin.second), true);
+                if (stagedCoins.DynamicMemoryUsage() > nCoinCacheUsage && !stagedCoins.Flush()) {
+                    strError = "cannot stage the snapshot's coins";
+                    return false;
+                }
+            }
+        } while (fMore);
+        if (reader.GetContentHash() != contentHash) {
+            strError = "the snapshot changed while it was loaded";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("cannot read snapshot: %s", e.what());
+        return false;
+    }
+    if (!fChecked && !CheckSnapshotState(state, metadata, vBlockHashes, strError))
+        return false;
+    if (!stagedCoins.Flush()) {
+        strError = "cannot stage the snapshot's coins";
+        return false;
+    }
+
+    // every check passed, from here on a failure leaves the chainstate half written
+    pblocktree->WriteFlag(STATE_SNAPSHOT_LOADING_FLAG, true);
+    CCoinsViewCache coins(pcoinsTip);
+    if (!CopySnapshotCoins(*staging.db, coins)) {
+        strError = "cannot write the snapshot's coins, restart with -reindex-chainstate";
+        return AbortNode(strError, "");
+    }
+
+    CBlockIndex* pindexBase = nullptr;
+    for (const CDiskBlockIndex& diskindex : state.blocks)
+        pindexBase = AddSnapshotBlockIndex(diskindex);
+
+    if (!state.mnLists.empty()) {
+        const CBlockIndex* pindexStart = pindexBase->GetAncestor(state.mnLists[0].GetHeight());
+        deterministicMNManager->ImportLists(pindexStart, state.mnLists[0], state.mnListDiffs, pindexBase);
+    }
+    for (const auto& commitment : state.commitments)
+        llmq::quorumBlockProcessor->ImportMinedCommitment(commitment.first, mapBlockIndex.at(commitment.second));
+    llmq::quorumBlockProcessor->ImportBestBlock(pindexBase);
+
+    coins.SetBestBlock(pindexBase->GetBlockHash());
+    if (!coins.Flush()) {
+        strError = "cannot write the snapshot's coins, restart with -reindex-chainstate";
+        return AbortNode(strError, "");
+    }
+
+    CValidationState validationState;
+    if (!ActivateSnapshotChainTip(validationState, chainparams, pindexBase)) {
+        strError = strprintf("cannot activate the snapshot: %s, restart with -reindex-chainstate", FormatStateMessage(validationState));
+        return AbortNode(strError, "");
+    }
+    pblocktree->WriteFlag(STATE_SNAPSHOT_LOADING_FLAG, false);
+    pblocktree->WriteFlag(STATE_SNAPSHOT_FLAG, true);
+    LogPrintf("%s: loaded snapshot of block %s (%d), content hash %s\n", __func__,
+        metadata.hashBlock.ToString(), metadata.nHeight, contentHash.ToString());
+    return true;
+}
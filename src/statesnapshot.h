@@ -0,0 +1,171 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRIVORA_STATESNAPSHOT_H
+#define PRIVORA_STATESNAPSHOT_H
+
+#include "hash.h"
+#include "protocol.h"
+#include "serialize.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/**
+ * A state snapshot holds what a node needs to continue validating from a block without the
+ * blocks before it: the block index of the chain up to it (which carries the Sigma, Lelantus
+ * and Spark sets and the Spark names), the deterministic masternode lists and mined LLMQ
+ * commitments the next blocks are checked against, and the coins.
+ *
+ * The file is the metadata followed by chunks of at most STATE_SNAPSHOT_CHUNK_RECORDS records
+ * of one kind, in the order of their types, each with the hash of its data, and an empty end
+ * chunk. Chunks are read in
+ * order but hashed and decoded on all cores. The content hash commits to the metadata and
+ * every chunk hash and can be pinned in the chain parameters.
+ */
+
+static const uint32_t STATE_SNAPSHOT_VERSION = 1;
+//! Serialization version of the records, fixed so that every build hashes the same state the same
+static const int STATE_SNAPSHOT_RECORD_VERSION = 141401;
+static const uint32_t STATE_SNAPSHOT_CHUNK_RECORDS = 4096;
+//! Chunks read and checked in one go, per thread
+static const size_t STATE_SNAPSHOT_CHUNKS_PER_THREAD = 4;
+//! Block tree database flag set while the coins of a snapshot are copied to the chainstate, until it is the chain tip
+static const char* const STATE_SNAPSHOT_LOADING_FLAG = "statesnapshotloading";
+//! Block tree database flag of a chain started from a snapshot, which lacks the blocks before it
+static const char* const STATE_SNAPSHOT_FLAG = "statesnapshot";
+
+enum StateSnapshotChunkType : uint8_t {
+    SNAPSHOT_CHUNK_END = 0,
+    //! CDiskBlockIndex of every block from the genesis block to the base block
+    SNAPSHOT_CHUNK_BLOCK_INDEX = 1,
+    //! The masternode list some blocks before the base block, then a diff per block up to it
+    SNAPSHOT_CHUNK_MN_LIST = 2,
+    SNAPSHOT_CHUNK_MN_LIST_DIFF = 3,
+    //! (commitment, hash of the block it was mined in)
+    SNAPSHOT_CHUNK_LLMQ_COMMITMENT = 4,
+    //! (outpoint, coin)
+    SNAPSHOT_CHUNK_COINS = 5,
+};
+
+class CStateSnapshotMetadata
+{
+public:
+    uint32_t nVersion;
+    CMessageHeader::MessageStartChars pchMessageStart;
+    //! Version the records were serialized with
+    int nRecordVersion;
+    uint256 hashBlock;
+    int nHeight;
+
+    CStateSnapshotMetadata() : nVersion(0), pchMessageStart(), nRecordVersion(0), nHeight(-1) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(nRecordVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+    }
+};
+
+class CStateSnapshotChunk
+{
+public:
+    uint8_t nType;
+    uint32_t nRecords;
+    std::vector<unsigned char> vchData;
+    uint256 hash;
+
+    CStateSnapshotChunk() : nType(SNAPSHOT_CHUNK_END), nRecords(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nType);
+        READWRITE(nRecords);
+        READWRITE(vchData);
+        READWRITE(hash);
+    }
+
+    uint256 ComputeHash() const { return Hash(vchData.begin(), vchData.end()); }
+};
+
+/** Writes a snapshot, one record at a time, to a file it takes ownership of */
+class CStateSnapshotWriter
+{
+private:
+    CAutoFile file;
+    CHashWriter hasher;
+    CDataStream ssRecords;
+    uint8_t nType;
+    uint32_t nRecords;
+
+    void WriteChunk(uint8_t nChunkType);
+
+public:
+    CStateSnapshotWriter(FILE* fileIn, const CStateSnapshotMetadata& metadata);
+
+    template <typename T>
+    void Add(uint8_t nRecordType, const T& record)
+    {
+        if (nRecords > 0 && nRecordType != nType)
+            WriteChunk(nType);
+        nType = nRecordType;
+        ssRecords << record;
+        if (++nRecords >= STATE_SNAPSHOT_CHUNK_RECORDS)
+            WriteChunk(nType);
+    }
+
+    /** Write the last chunks and close the file, returns the content hash */
+    uint256 Finish();
+};
+
+/** Reads a snapshot a group of chunks at a time from a file it takes ownership of */
+class CStateSnapshotReader
+{
+private:
+    CAutoFile file;
+    CHashWriter hasher;
+    CStateSnapshotMetadata metadata;
+    uint8_t nLastType;
+    bool fEnd;
+
+public:
+    explicit CStateSnapshotReader(FILE* fileIn);
+
+    const CStateSnapshotMetadata& GetMetadata() const { return metadata; }
+
+    /** Read up to nMaxChunks chunks, returns false once the end chunk was read. Throws if they are out of order */
+    bool ReadChunks(std::vector<CStateSnapshotChunk>& chunks, size_t nMaxChunks);
+
+    /** The content hash, once the end chunk was read */
+    uint256 GetContentHash();
+};
+
+/** Check the hashes of the chunks on nThreads threads */
+bool VerifyStateSnapshotChunks(const std::vector<CStateSnapshotChunk>& chunks, int nThreads);
+
+/** Read a whole snapshot file, checking every chunk, and compute its content hash */
+bool HashStateSnapshot(const boost::filesystem::path& path, CStateSnapshotMetadata& metadata, uint256& contentHash, std::string& strError);
+
+/** Write a snapshot of the state at the chain tip */
+bool DumpStateSnapshot(const boost::filesystem::path& path, CStateSnapshotMetadata& metadata, uint256& contentHash, std::string& strError);
+
+/**
+ * Load a snapshot into a node that has not connected any block yet and make its base block
+ * the chain tip. A snapshot at a height pinned in the chain parameters must match the pinned
+ * hashes, any other is only loaded if fTrusted is set.
+ */
+bool LoadStateSnapshot(const boost::filesystem::path& path, bool fTrusted, CStateSnapshotMetadata& metadata, uint256& contentHash, std::string& strError);
+
+#endif // PRIVORA_STATESNAPSHOT_H
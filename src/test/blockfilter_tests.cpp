@@ -0,0 +1,164 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "coins.h"
+#include "lelantus.h"
+#include "primitives/block.h"
+#include "primitives/mint_spend.h"
+#include "random.h"
+#include "script/standard.h"
+#include "spark/primitives.h"
+#include "spark/state.h"
+#include "streams.h"
+#include "undo.h"
+
+#include "test/test_privora.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+static GCSFilter::Element HashElement(const uint256& hash)
+{
+    return GCSFilter::Element(hash.begin(), hash.end());
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet includedElements, excludedElements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        includedElements.insert(std::move(element1));
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excludedElements.insert(std::move(element2));
+    }
+
+    GCSFilter filter(GCSFilter::Params(0, 0, 10, 1 << 10), includedElements);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100);
+    for (const auto& element : includedElements) {
+        BOOST_CHECK(filter.Match(element));
+
+        auto insertedElements = excludedElements;
+        insertedElements.insert(element);
+        BOOST_CHECK(filter.MatchAny(insertedElements));
+    }
+
+    // a filter decoded from its encoding behaves the same
+    GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), 100);
+    BOOST_CHECK(decoded.GetEncoded() == filter.GetEncoded());
+    for (const auto& element : includedElements)
+        BOOST_CHECK(decoded.Match(element));
+
+    // trailing garbage is rejected
+    std::vector<unsigned char> encoded = filter.GetEncoded();
+    encoded.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), encoded), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
+{
+    GCSFilter filter;
+    BOOST_CHECK_EQUAL(filter.GetN(), 0);
+    BOOST_CHECK_EQUAL(filter.GetEncoded().size(), 1);
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(32)));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript includedScripts[3], excludedScripts[2];
+
+    // first two are outputs on a single transaction
+    includedScripts[0] << std::vector<unsigned char>(0, 65) << OP_CHECKSIG;
+    includedScripts[1] << OP_DUP << OP_HASH160 << std::vector<unsigned char>(1, 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+    // third is an output of a second transaction
+    includedScripts[2] << OP_1 << std::vector<unsigned char>(2, 33) << OP_1 << OP_CHECKMULTISIG;
+    // the prevout script is looked up in the undo data
+    CScript includedPrevout;
+    includedPrevout << OP_DUP << OP_HASH160 << std::vector<unsigned char>(3, 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    excludedScripts[0] << OP_RETURN << OP_4 << OP_ADD << OP_8 << OP_EQUAL;
+    excludedScripts[1] << std::vector<unsigned char>(4, 65) << OP_CHECKSIG;
+
+    CMutableTransaction tx1;
+    tx1.vout.resize(3);
+    tx1.vout[0].scriptPubKey = includedScripts[0];
+    tx1.vout[1].scriptPubKey = includedScripts[1];
+    tx1.vout[2].scriptPubKey = excludedScripts[0];
+
+    CMutableTransaction tx2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = includedScripts[2];
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(tx1));
+    block.vtx.push_back(MakeTransactionRef(tx2));
+
+    CBlockUndo blockUndo;
+    blockUndo.vtxundo.emplace_back();
+    blockUndo.vtxundo.back().vprevout.emplace_back(CTxOut(500, includedPrevout), 1000, false);
+
+    // privacy data as collected by ConnectBlock
+    GroupElement lTag;
+    lTag.randomize();
+    Scalar serial;
+    serial.randomize();
+    CSparkNameTxData sparkName;
+    sparkName.name = "privora";
+    sparkName.sparkAddress = "sr1testaddress";
+
+    block.sparkTxInfo = std::make_shared<spark::CSparkTxInfo>();
+    block.sparkTxInfo->spentLTags[lTag] = 1;
+    block.sparkTxInfo->sparkNames["PRIVORA"] = sparkName;
+    block.lelantusTxInfo = std::make_shared<lelantus::CLelantusTxInfo>();
+    block.lelantusTxInfo->spentSerials[serial] = 1;
+
+    BlockFilter blockFilter(BlockFilterType::BASIC, block, blockUndo);
+    const GCSFilter& filter = blockFilter.GetFilter();
+
+    for (const CScript& script : includedScripts)
+        BOOST_CHECK(filter.Match(GCSFilter::Element(script.begin(), script.end())));
+    BOOST_CHECK(filter.Match(GCSFilter::Element(includedPrevout.begin(), includedPrevout.end())));
+    for (const CScript& script : excludedScripts)
+        BOOST_CHECK(!filter.Match(GCSFilter::Element(script.begin(), script.end())));
+
+    BOOST_CHECK(filter.Match(HashElement(primitives::GetLTagHash(lTag))));
+    BOOST_CHECK(filter.Match(HashElement(primitives::GetSerialHash(serial))));
+    BOOST_CHECK(filter.Match(GCSFilter::Element(sparkName.sparkAddress.begin(), sparkName.sparkAddress.end())));
+
+    GroupElement otherTag;
+    otherTag.randomize();
+    BOOST_CHECK(!filter.Match(HashElement(primitives::GetLTagHash(otherTag))));
+
+    // serialization round trip
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << blockFilter;
+    BlockFilter decoded;
+    stream >> decoded;
+    BOOST_CHECK(decoded.GetFilterType() == blockFilter.GetFilterType());
+    BOOST_CHECK(decoded.GetBlockHash() == blockFilter.GetBlockHash());
+    BOOST_CHECK(decoded.GetEncodedFilter() == blockFilter.GetEncodedFilter());
+
+    // headers chain over the previous header
+    uint256 prevHeader = GetRandHash();
+    BOOST_CHECK(decoded.ComputeHeader(prevHeader) == blockFilter.ComputeHeader(prevHeader));
+    BOOST_CHECK(blockFilter.ComputeHeader(prevHeader) != blockFilter.ComputeHeader(uint256()));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_type_names)
+{
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BlockFilterType::BASIC), "basic");
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BlockFilterType::INVALID), "");
+
+    BlockFilterType filterType;
+    BOOST_CHECK(BlockFilterTypeByName("basic", filterType));
+    BOOST_CHECK(filterType == BlockFilterType::BASIC);
+    BOOST_CHECK(!BlockFilterTypeByName("unknown", filterType));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,200 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "random.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "validation.h"
+
+#include "test/test_privora.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinsflusher_tests, TestingSetup)
+
+static Coin MakeCoin(CAmount nValue)
+{
+    CScript script = CScript() << OP_TRUE;
+    return Coin(CTxOut(nValue, script), 1, false);
+}
+
+static CCoinsMap CopyCoins(const CCoinsView& view)
+{
+    CCoinsMap coins;
+    std::unique_ptr<CCoinsViewCursor> cursor(view.Cursor());
+    for (; cursor->Valid(); cursor->Next()) {
+        COutPoint key;
+        Coin coin;
+        if (cursor->GetKey(key) && cursor->GetValue(coin)) {
+            CCoinsCacheEntry& entry = coins[key];
+            entry.coin = std::move(coin);
+            entry.flags = CCoinsCacheEntry::DIRTY;
+        }
+    }
+    return coins;
+}
+
+BOOST_AUTO_TEST_CASE(coinsflusher_write)
+{
+    CCoinsViewDB db(1 << 20, true);
+    // one byte batches, so that every coin is a batch of its own
+    CCoinsViewFlusher flusher(&db, true, 1);
+
+    // a few blocks for the flusher to tell whether it can write incrementally
+    CBlockIndex indexOld, indexNew;
+    uint256 hashOld = GetRandHash(), hashNew = GetRandHash();
+    indexOld.phashBlock = &hashOld;
+    indexOld.nHeight = 1000;
+    indexNew.phashBlock = &hashNew;
+    indexNew.pprev = &indexOld;
+    indexNew.nHeight = 1001;
+    indexNew.BuildSkip();
+    {
+        LOCK(cs_main);
+        mapBlockIndex[hashOld] = &indexOld;
+        mapBlockIndex[hashNew] = &indexNew;
+    }
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 10; i++)
+        outpoints.emplace_back(GetRandHash(), i);
+
+    // the first flush has nothing to roll forward from and is written right away
+    CCoinsViewCache cache(&flusher);
+    for (int i = 0; i < 5; i++)
+        cache.AddCoin(outpoints[i], MakeCoin(i + 1), false);
+    cache.SetBestBlock(hashOld);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0);
+    BOOST_CHECK(!flusher.IsWritePending());
+    BOOST_CHECK_EQUAL(flusher.GetPendingUsage(), 0);
+    BOOST_CHECK(flusher.GetBestBlock() == hashOld);
+    BOOST_CHECK(flusher.HaveCoin(outpoints[0]));
+    BOOST_CHECK(db.GetBestBlock() == hashOld);
+    BOOST_CHECK(db.HaveCoin(outpoints[4]));
+
+    // the next one extends the chain on disk and is written in batches
+    cache.SpendCoin(outpoints[0]);
+    for (int i = 5; i < 10; i++)
+        cache.AddCoin(outpoints[i], MakeCoin(i + 1), false);
+    cache.SetBestBlock(hashNew);
+    BOOST_CHECK(cache.Flush());
+
+    // from the hand-off on, the database can be rolled forward to the new best block
+    std::vector<uint256> vhashHeads = db.GetHeadBlocks();
+    BOOST_CHECK(db.GetBestBlock() == hashNew || vhashHeads == (std::vector<uint256>{hashNew, hashOld}));
+
+    // the new state is visible whether or not the write is done
+    Coin coin;
+    BOOST_CHECK(!cache.HaveCoin(outpoints[0]));
+    BOOST_CHECK(!flusher.GetCoin(outpoints[0], coin));
+    BOOST_CHECK(flusher.GetCoin(outpoints[7], coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 8);
+    BOOST_CHECK(flusher.GetBestBlock() == hashNew);
+    BOOST_CHECK(flusher.GetHeadBlocks().empty());
+
+    BOOST_CHECK(flusher.Sync());
+    BOOST_CHECK_EQUAL(flusher.GetPendingUsage(), 0);
+    BOOST_CHECK(db.GetBestBlock() == hashNew);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(!db.HaveCoin(outpoints[0]));
+    for (int i = 1; i < 10; i++) {
+        BOOST_CHECK(db.GetCoin(outpoints[i], coin));
+        BOOST_CHECK_EQUAL(coin.out.nValue, i + 1);
+    }
+
+    {
+        LOCK(cs_main);
+        mapBlockIndex.erase(hashOld);
+        mapBlockIndex.erase(hashNew);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coinsflusher_rollforward)
+{
+    // rolling a block forward over coins that are partly written already must not fail
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewCache base(&db);
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 1;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    tx.vout[1].nValue = 2;
+    tx.vout[1].scriptPubKey = CScript() << OP_TRUE;
+    CTransaction txFinal(tx);
+
+    AddCoins(base, txFinal, 1);
+    BOOST_CHECK_THROW(AddCoins(base, txFinal, 1), std::logic_error);
+    AddCoins(base, txFinal, 1, true);
+    BOOST_CHECK(base.HaveCoin(COutPoint(txFinal.GetHash(), 1)));
+}
+
+BOOST_FIXTURE_TEST_CASE(coinsflusher_replay, TestChain100Setup)
+{
+    // the coins as a flush at the current tip left them on disk
+    CCoinsViewDB db(1 << 20, true);
+    uint256 hashOld;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->Flush());
+        hashOld = chainActive.Tip()->GetBlockHash();
+        CCoinsMap coins = CopyCoins(*pcoinsdbview);
+        BOOST_CHECK(db.BatchWrite(coins, hashOld));
+    }
+
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::vector<CTransaction> coinbases;
+    for (int i = 0; i < 3; i++)
+        coinbases.push_back(*CreateAndProcessBlock({}, scriptPubKey).vtx[0]);
+
+    uint256 hashNew;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->Flush());
+        hashNew = chainActive.Tip()->GetBlockHash();
+    }
+    const CCoinsMap coinsNew = CopyCoins(*pcoinsdbview);
+    BOOST_CHECK(hashNew != hashOld);
+
+    // a background flush from hashOld to hashNew that stopped after its first batch
+    BOOST_CHECK(db.WriteHeadBlocks(hashNew));
+    CCoinsMap firstBatch;
+    for (size_t n = 0; n < coinbases[1].vout.size(); n++) {
+        CCoinsMap::const_iterator it = coinsNew.find(COutPoint(coinbases[1].GetHash(), n));
+        if (it != coinsNew.end())
+            firstBatch.insert(*it);
+    }
+    BOOST_CHECK(!firstBatch.empty());
+    BOOST_CHECK(db.BatchWrite(firstBatch, uint256()));
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    BOOST_CHECK(db.GetHeadBlocks() == (std::vector<uint256>{hashNew, hashOld}));
+
+    // is rolled forward on startup to the very coins of hashNew
+    BOOST_CHECK(ReplayBlocks(Params(), &db));
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.GetBestBlock() == hashNew);
+    BOOST_CHECK_EQUAL(CopyCoins(db).size(), coinsNew.size());
+    for (const auto& entry : coinsNew) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(entry.first, coin));
+        BOOST_CHECK(coin.out == entry.second.coin.out);
+        BOOST_CHECK_EQUAL(coin.nHeight, entry.second.coin.nHeight);
+    }
+
+    // a consistent database is left alone
+    BOOST_CHECK(ReplayBlocks(Params(), &db));
+    BOOST_CHECK(db.GetBestBlock() == hashNew);
+
+    // head blocks that can not be rolled forward are an error
+    BOOST_CHECK(db.WriteHeadBlocks(hashOld));
+    BOOST_CHECK(!ReplayBlocks(Params(), &db));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
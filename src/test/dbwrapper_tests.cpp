@@ -11,6 +11,8 @@
 #include <boost/assert.hpp>
 #include <boost/test/unit_test.hpp>
 
+extern std::map<std::string, std::string> mapArgs;
+
 // Test if a string consists entirely of null characters
 bool is_null_key(const std::vector<unsigned char>& key) {
     bool isnull = true;
@@ -43,6 +45,68 @@ BOOST_AUTO_TEST_CASE(dbwrapper)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_readmany)
+{
+    // Perform tests both obfuscated and non-obfuscated.
+    for (int i = 0; i < 2; i++) {
+        bool obfuscate = (bool)i;
+        boost::filesystem::path ph = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        std::map<uint32_t, uint256> written;
+        for (uint32_t k = 0; k < 100; k += 2) {
+            written[k] = GetRandHash();
+            BOOST_CHECK(dbw.Write(std::make_pair('m', k), written[k]));
+        }
+
+        // unsorted, with missing keys, a duplicate and a key past the last one
+        std::vector<std::pair<char, uint32_t>> keys;
+        for (uint32_t k : {51u, 10u, 11u, 98u, 0u, 10u, 200u})
+            keys.push_back(std::make_pair('m', k));
+        std::vector<uint256> values;
+        std::vector<bool> found;
+        BOOST_CHECK_EQUAL(dbw.ReadMany(keys, values, found), 4);
+        BOOST_CHECK_EQUAL(values.size(), keys.size());
+        for (size_t j = 0; j < keys.size(); j++) {
+            BOOST_CHECK_EQUAL(found[j], written.count(keys[j].second) > 0);
+            if (found[j])
+                BOOST_CHECK(values[j] == written[keys[j].second]);
+        }
+
+        BOOST_CHECK_EQUAL(dbw.ReadMany(std::vector<std::pair<char, uint32_t>>(), values, found), 0);
+        BOOST_CHECK(values.empty() && found.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_stats)
+{
+    boost::filesystem::path ph = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    ForceSetArg("-testdbmaxopenfiles", "100");
+    CDBWrapperOptions options = GetDBWrapperOptions("test", 1 << 20);
+    BOOST_CHECK_EQUAL(options.nMaxOpenFiles, 100);
+    BOOST_CHECK_EQUAL(options.nBloomBits, DEFAULT_DB_BLOOM_BITS);
+    mapArgs.erase("-testdbmaxopenfiles");
+
+    CDBWrapper dbw(ph, options, true);
+    uint256 in = GetRandHash(), res;
+    BOOST_CHECK(dbw.Write('k', in));
+    BOOST_CHECK(dbw.Read('k', res));
+    BOOST_CHECK(!dbw.Read('l', res));
+
+    CDBWrapperStats stats = dbw.GetStats();
+    BOOST_CHECK_EQUAL(stats.options.strName, "test");
+    // the obfuscation key lookup on open is a read too
+    BOOST_CHECK_EQUAL(stats.nReads, 3);
+    // nothing was flushed to a table file yet
+    BOOST_CHECK_EQUAL(stats.nCacheHits, 3);
+    BOOST_CHECK_EQUAL(stats.nBytesRead, in.size());
+
+    bool fListed = false;
+    for (const CDBWrapperStats& s : GetDBWrapperStats())
+        fListed |= s.options.strName == "test";
+    BOOST_CHECK(fListed);
+}
+
 // Test batch operations
 BOOST_AUTO_TEST_CASE(dbwrapper_batch)
 {
@@ -16,6 +16,8 @@
 #include "evo/specialtx.h"
 #include "evo/providertx.h"
 #include "evo/deterministicmns.h"
+#include "evo/evodb.h"
+#include "compat/endian.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -217,6 +219,41 @@ static CDeterministicMNCPtr FindPayoutDmn(const CBlock& block)
     return nullptr;
 }
 
+// Keys of the list records as CDeterministicMNManager stores them, spelled out to pin the layout
+static const uint8_t LIST_RECORD_SNAPSHOT = 0;
+static const uint8_t LIST_RECORD_DIFF = 1;
+
+static std::tuple<std::string, uint32_t, uint256, uint8_t> ListByHeightKey(const CBlockIndex* pindex, uint8_t recordType)
+{
+    return std::make_tuple(std::string("dmn_H"), htobe32(std::numeric_limits<uint32_t>::max() - pindex->nHeight), pindex->GetBlockHash(), recordType);
+}
+
+// Move the records of pindex to the layout used before the height index, keyed by block hash only
+static void ConvertToLegacyRecords(const CBlockIndex* pindex)
+{
+    CDeterministicMNList snapshot;
+    if (evoDb->Read(ListByHeightKey(pindex, LIST_RECORD_SNAPSHOT), snapshot)) {
+        evoDb->Write(std::make_pair(std::string("dmn_S"), pindex->GetBlockHash()), snapshot);
+        evoDb->Erase(ListByHeightKey(pindex, LIST_RECORD_SNAPSHOT));
+    }
+    CDeterministicMNListDiff diff;
+    if (evoDb->Read(ListByHeightKey(pindex, LIST_RECORD_DIFF), diff)) {
+        evoDb->Write(std::make_pair(std::string("dmn_D"), pindex->GetBlockHash()), diff);
+        evoDb->Erase(ListByHeightKey(pindex, LIST_RECORD_DIFF));
+    }
+}
+
+// Compare with the list a manager without cached lists rebuilds from the records
+static void CheckListFromRecords(const CBlockIndex* pindex, const CDeterministicMNList& expected)
+{
+    CDeterministicMNManager manager(*evoDb);
+    CDeterministicMNList list = manager.GetListForBlock(pindex);
+    BOOST_CHECK(list.GetBlockHash() == expected.GetBlockHash());
+    BOOST_CHECK_EQUAL(list.GetHeight(), expected.GetHeight());
+    BOOST_CHECK_EQUAL(list.GetAllMNsCount(), expected.GetAllMNsCount());
+    BOOST_CHECK(!expected.BuildDiff(list).HasChanges());
+}
+
 BOOST_AUTO_TEST_SUITE(evo_dip3_activation_tests)
 
 BOOST_FIXTURE_TEST_CASE(dip3_activation, TestChainDIP3BeforeActivationSetup)
@@ -408,4 +445,134 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
 
     const_cast<Consensus::Params&>(Params().GetConsensus()).DIP0003EnforcementHeight = DIP0003EnforcementHeightBackup;
 }
+// Register nCount MNs, one per block
+static std::vector<std::pair<uint256, CBLSSecretKey>> RegisterMNs(TestChainDIP3Setup& setup, SimpleUTXOMap& utxos, int nCount)
+{
+    std::vector<std::pair<uint256, CBLSSecretKey>> mns;
+    for (int i = 0; i < nCount; i++) {
+        CKey ownerKey;
+        CBLSSecretKey operatorKey;
+        auto tx = CreateProRegTx(utxos, i + 1, GenerateRandomAddress(), setup.coinbaseKey, ownerKey, operatorKey);
+        mns.emplace_back(tx.GetHash(), operatorKey);
+        setup.CreateAndProcessBlock({tx}, setup.coinbaseKey);
+        deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    }
+    return mns;
+}
+
+// Mine nBlocks blocks that each move one of the MNs to another port, so every block has a diff
+static std::vector<const CBlockIndex*> UpdateMNs(TestChainDIP3Setup& setup, SimpleUTXOMap& utxos, const std::vector<std::pair<uint256, CBLSSecretKey>>& mns, int nBlocks, int nFirstPort)
+{
+    std::vector<const CBlockIndex*> blocks;
+    for (int i = 0; i < nBlocks; i++) {
+        const auto& mn = mns[i % mns.size()];
+        auto tx = CreateProUpServTx(utxos, mn.first, mn.second, nFirstPort + i, CScript(), setup.coinbaseKey);
+        setup.CreateAndProcessBlock({tx}, setup.coinbaseKey);
+        deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+        blocks.emplace_back(chainActive.Tip());
+    }
+    return blocks;
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_list_records, TestChainDIP3Setup)
+{
+    auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
+    auto mns = RegisterMNs(*this, utxos, 3);
+    auto blocks = UpdateMNs(*this, utxos, mns, 40, 2000);
+
+    LOCK(cs_main);
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    std::vector<const CBlockIndex*> checked = {pindexTip, blocks[29], blocks[28], blocks[10], blocks[0], blocks[0]->pprev};
+    std::map<const CBlockIndex*, CDeterministicMNList> expected;
+    for (const CBlockIndex* pindex : checked) {
+        expected[pindex] = deterministicMNManager->GetListForBlock(pindex);
+    }
+    BOOST_CHECK_EQUAL(expected[pindexTip].GetAllMNsCount(), 3);
+    BOOST_CHECK_EQUAL(expected[pindexTip].GetMN(mns[0].first)->pdmnState->addr.GetPort(), 2039);
+
+    // height ordered records only
+    for (const CBlockIndex* pindex : checked) {
+        CheckListFromRecords(pindex, expected[pindex]);
+    }
+
+    // records of an upgraded node: legacy ones below the newer height ordered ones
+    for (const CBlockIndex* pindex = blocks[28]; pindex; pindex = pindex->pprev) {
+        ConvertToLegacyRecords(pindex);
+    }
+    BOOST_CHECK(!evoDb->Exists(ListByHeightKey(blocks[28], LIST_RECORD_DIFF)));
+    BOOST_CHECK(evoDb->Exists(std::make_pair(std::string("dmn_D"), blocks[28]->GetBlockHash())));
+    for (const CBlockIndex* pindex : checked) {
+        CheckListFromRecords(pindex, expected[pindex]);
+    }
+
+    // legacy records only
+    for (const CBlockIndex* pindex = pindexTip; pindex != blocks[28]; pindex = pindex->pprev) {
+        ConvertToLegacyRecords(pindex);
+    }
+    for (const CBlockIndex* pindex : checked) {
+        CheckListFromRecords(pindex, expected[pindex]);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_list_reorg, TestChainDIP3Setup)
+{
+    // snapshots written for list churn are at least this many blocks apart
+    static const int MIN_SNAPSHOT_LIST_PERIOD = 16;
+
+    auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
+    auto mns = RegisterMNs(*this, utxos, 3);
+    const CBlockIndex* pindexFork = chainActive.Tip();
+    SimpleUTXOMap utxosFork = utxos;
+
+    auto oldBlocks = UpdateMNs(*this, utxos, mns, 48, 2000);
+    int nOldSnapshots = 0;
+    for (const CBlockIndex* pindex : oldBlocks) {
+        nOldSnapshots += evoDb->Exists(ListByHeightKey(pindex, LIST_RECORD_SNAPSHOT));
+    }
+    BOOST_CHECK(nOldSnapshots > 0);
+
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), mapBlockIndex.at(oldBlocks[0]->GetBlockHash())));
+        BOOST_CHECK(ActivateBestChain(state, Params()));
+        BOOST_CHECK(chainActive.Tip() == pindexFork);
+        deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    }
+
+    // undoing the blocks removed their records, early snapshot included
+    for (const CBlockIndex* pindex : oldBlocks) {
+        BOOST_CHECK(!evoDb->Exists(ListByHeightKey(pindex, LIST_RECORD_DIFF)));
+        BOOST_CHECK(!evoDb->Exists(ListByHeightKey(pindex, LIST_RECORD_SNAPSHOT)));
+    }
+
+    utxos = utxosFork;
+    auto newBlocks = UpdateMNs(*this, utxos, mns, 48, 3000);
+
+    LOCK(cs_main);
+    // the snapshot interval continues from the last snapshot left on the active chain
+    int nLastSnapshotHeight = -1;
+    for (const CBlockIndex* pindex = pindexFork; pindex && nLastSnapshotHeight == -1; pindex = pindex->pprev) {
+        if (evoDb->Exists(ListByHeightKey(pindex, LIST_RECORD_SNAPSHOT))) {
+            nLastSnapshotHeight = pindex->nHeight;
+        }
+    }
+    BOOST_CHECK(nLastSnapshotHeight != -1);
+    int nNewSnapshots = 0;
+    for (const CBlockIndex* pindex : newBlocks) {
+        if (evoDb->Exists(ListByHeightKey(pindex, LIST_RECORD_SNAPSHOT))) {
+            BOOST_CHECK(pindex->nHeight - nLastSnapshotHeight >= MIN_SNAPSHOT_LIST_PERIOD);
+            nLastSnapshotHeight = pindex->nHeight;
+            nNewSnapshots++;
+        }
+    }
+    BOOST_CHECK(nNewSnapshots > 0);
+
+    CDeterministicMNList tipList = deterministicMNManager->GetListAtChainTip();
+    BOOST_CHECK(tipList.GetBlockHash() == newBlocks.back()->GetBlockHash());
+    BOOST_CHECK_EQUAL(tipList.GetMN(mns[0].first)->pdmnState->addr.GetPort(), 3045);
+    for (const CBlockIndex* pindex : {newBlocks.back(), newBlocks[20], newBlocks[0], pindexFork}) {
+        CheckListFromRecords(pindex, deterministicMNManager->GetListForBlock(pindex));
+    }
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,113 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include "mbstring.h"
+#include "rpc/protocol.h"
+
+#include "test/test_privora.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+static UniValue MakeEntry(int i)
+{
+    UniValue entry(UniValue::VOBJ);
+    entry.push_back(Pair("n", i));
+    entry.push_back(Pair("name", "entry \"" + std::to_string(i) + "\"\n"));
+    entry.push_back(Pair("value", 1.5 * i));
+    UniValue list(UniValue::VARR);
+    list.push_back(true);
+    list.push_back(NullUniValue);
+    list.push_back(UniValue(UniValue::VOBJ));
+    entry.push_back(Pair("list", list));
+    return entry;
+}
+
+BOOST_AUTO_TEST_CASE(stream_matches_write)
+{
+    std::vector<std::string> chunks;
+    // tiny chunks so that every piece is passed on separately
+    CJSONStreamWriter writer([&chunks](std::string&& chunk) { chunks.push_back(std::move(chunk)); }, false, 8);
+
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("hash", "00ff"));
+    expected.push_back(Pair("empty", UniValue(UniValue::VARR)));
+    UniValue entries(UniValue::VARR);
+    for (int i = 0; i < 10; i++)
+        entries.push_back(MakeEntry(i));
+    expected.push_back(Pair("entries", entries));
+    UniValue tail(UniValue::VOBJ);
+    tail.push_back(Pair("time", 1234567890));
+    tail.push_back(Pair("chainlock", false));
+    expected.pushKVs(tail);
+
+    writer.BeginObject();
+    writer.KeyValue("hash", "00ff");
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Key("entries");
+    writer.BeginArray();
+    for (int i = 0; i < 10; i++)
+        writer.Value(MakeEntry(i));
+    writer.EndArray();
+    writer.KeyValues(tail);
+    writer.EndObject();
+    writer.Flush();
+
+    BOOST_CHECK(chunks.size() > 1);
+    std::string streamed;
+    for (const std::string& chunk : chunks) {
+        BOOST_CHECK(!chunk.empty());
+        streamed += chunk;
+    }
+    BOOST_CHECK_EQUAL(streamed, expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(stream_sanitize)
+{
+    std::string streamed;
+    CJSONStreamWriter writer([&streamed](std::string&& chunk) { streamed += chunk; }, true, 4);
+
+    UniValue expected(UniValue::VARR);
+    expected.push_back("valid \xe3\x81\x82");
+    expected.push_back("invalid \xed\xa0\x80");
+    expected.push_back("cut \xe3\x81");
+
+    writer.BeginArray();
+    for (const UniValue& value : expected.getValues())
+        writer.Value(value);
+    writer.EndArray();
+    writer.Flush();
+
+    BOOST_CHECK_EQUAL(streamed, SanitizeInvalidUTF8(expected.write()));
+}
+
+BOOST_AUTO_TEST_CASE(stream_rpc_reply)
+{
+    std::string streamed;
+    bool fStarted = false;
+    CRPCReplyStream replyStream(UniValue(7), [&fStarted]() { fStarted = true; },
+                                [&streamed](std::string&& chunk) { streamed += chunk; }, false);
+    BOOST_CHECK(!replyStream.IsStarted());
+
+    UniValue result(UniValue::VARR);
+    result.push_back("a");
+    result.push_back(MakeEntry(1));
+
+    CJSONStreamWriter& writer = replyStream.BeginResult();
+    BOOST_CHECK(fStarted && replyStream.IsStarted());
+    writer.BeginArray();
+    for (const UniValue& value : result.getValues())
+        writer.Value(value);
+    writer.EndArray();
+    replyStream.EndResult();
+
+    BOOST_CHECK_EQUAL(streamed, JSONRPCReply(result, NullUniValue, UniValue(7)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -327,6 +327,144 @@ BOOST_AUTO_TEST_CASE(add_remove_block)
     lelantusState->Reset();
 }
 
+BOOST_AUTO_TEST_CASE(freeze_state)
+{
+    GroupElement mint1, mint2;
+    mint1.randomize();
+    mint2.randomize();
+    uint256 tag1 = GetRandHash();
+
+    auto index1 = GenerateBlock({});
+    auto block1 = GetCBlock(index1);
+    PopulateLelantusTxInfo(block1, {{mint1, {1, tag1}}, {mint2, {1, uint256()}}}, {});
+    lelantusState->AddMintsToStateAndBlockIndex(index1, &block1);
+
+    Scalar serial1, serial2;
+    serial1.randomize();
+    serial2.randomize();
+
+    auto index2 = GenerateBlock({});
+    auto block2 = GetCBlock(index2);
+    PopulateLelantusTxInfo(block2, {}, {{serial1, 1}});
+    index2->lelantusSpentSerials = block2.lelantusTxInfo->spentSerials;
+    lelantusState->AddBlock(index2);
+
+    // the graceful period never ends on regtest
+    lelantusState->FreezeIfClosed(chainActive.Height());
+    BOOST_CHECK(!lelantusState->IsFrozen());
+
+    lelantusState->Freeze();
+    BOOST_CHECK(lelantusState->IsFrozen());
+    BOOST_CHECK_EQUAL(0, lelantusState->GetMints().size());
+    BOOST_CHECK_EQUAL(0, lelantusState->GetSpends().size());
+    BOOST_CHECK_EQUAL(2, lelantusState->GetTotalCoins());
+    BOOST_CHECK_EQUAL(1, lelantusState->GetAllSpends().count(serial1));
+
+    // lookups see the frozen coins, serials and tags
+    BOOST_CHECK(lelantusState->HasCoin(mint1));
+    BOOST_CHECK(lelantusState->HasCoin(mint2));
+    GroupElement received;
+    BOOST_CHECK(lelantusState->HasCoinHash(received, lelantus::PublicCoin(mint2).getValueHash()));
+    BOOST_CHECK(received == mint2);
+    BOOST_CHECK(lelantusState->HasCoinTag(received, tag1));
+    BOOST_CHECK(received == mint1);
+    BOOST_CHECK(!lelantusState->HasCoinTag(received, GetRandHash()));
+    BOOST_CHECK_EQUAL(std::make_pair(index1->nHeight, 1), lelantusState->GetMintedCoinHeightAndId(mint1));
+
+    BOOST_CHECK(lelantusState->IsUsedCoinSerial(serial1));
+    BOOST_CHECK(!lelantusState->IsUsedCoinSerial(serial2));
+    Scalar receivedSerial;
+    BOOST_CHECK(lelantusState->IsUsedCoinSerialHash(receivedSerial, primitives::GetSerialHash(serial1)));
+    BOOST_CHECK(receivedSerial == serial1);
+    BOOST_CHECK(!lelantusState->CanAddSpendToMempool(serial1));
+
+    // a block with Lelantus data added after freezing is still found
+    Scalar serial3;
+    serial3.randomize();
+    lelantusState->AddSpend(serial3, 1);
+    BOOST_CHECK(lelantusState->IsUsedCoinSerial(serial3));
+
+    // disconnecting a block with Lelantus data unfreezes the state
+    lelantusState->RemoveBlock(index2);
+    BOOST_CHECK(!lelantusState->IsFrozen());
+    BOOST_CHECK_EQUAL(2, lelantusState->GetMints().size());
+    BOOST_CHECK(!lelantusState->IsUsedCoinSerial(serial1));
+    BOOST_CHECK(lelantusState->IsUsedCoinSerial(serial3));
+    BOOST_CHECK(lelantusState->HasCoinTag(received, tag1));
+    BOOST_CHECK(received == mint1);
+
+    lelantusState->RemoveBlock(index1);
+    BOOST_CHECK_EQUAL(0, lelantusState->GetTotalCoins());
+
+    lelantusState->Reset();
+}
+
+BOOST_AUTO_TEST_CASE(snapshot)
+{
+    GroupElement mint1, mint2;
+    mint1.randomize();
+    mint2.randomize();
+    uint256 tag1 = GetRandHash();
+
+    auto index1 = GenerateBlock({});
+    auto block1 = GetCBlock(index1);
+    PopulateLelantusTxInfo(block1, {{mint1, {1, tag1}}}, {});
+    lelantusState->AddMintsToStateAndBlockIndex(index1, &block1);
+
+    Scalar serial1;
+    serial1.randomize();
+
+    auto index2 = GenerateBlock({});
+    auto block2 = GetCBlock(index2);
+    PopulateLelantusTxInfo(block2, {}, {{serial1, 1}});
+    index2->lelantusSpentSerials = block2.lelantusTxInfo->spentSerials;
+    lelantusState->AddBlock(index2);
+
+    // nothing is visible until it is published
+    BOOST_CHECK(!lelantusState->GetSnapshot()->HasCoin(mint1));
+    lelantusState->PublishSnapshot(index2);
+
+    auto published = lelantusState->GetSnapshot();
+    BOOST_CHECK_EQUAL(index2->nHeight, published->GetHeight());
+    BOOST_CHECK(index2->GetBlockHash() == published->GetBlockHash());
+    BOOST_CHECK(published->HasCoin(mint1));
+    BOOST_CHECK(!published->HasCoin(mint2));
+    BOOST_CHECK_EQUAL(std::make_pair(index1->nHeight, 1), published->GetMintedCoinHeightAndId(mint1));
+    BOOST_CHECK_EQUAL(std::make_pair(-1, -1), published->GetMintedCoinHeightAndId(mint2));
+    BOOST_CHECK(published->IsUsedCoinSerial(serial1));
+    GroupElement received;
+    BOOST_CHECK(published->HasCoinTag(received, tag1));
+    BOOST_CHECK(received == mint1);
+    BOOST_CHECK_EQUAL(1, published->GetLatestCoinID());
+
+    // freezing moves the coins into sets the snapshots share
+    lelantusState->Freeze();
+    lelantusState->PublishSnapshot(index2);
+    auto frozen = lelantusState->GetSnapshot();
+    BOOST_CHECK(frozen->HasCoin(mint1));
+    BOOST_CHECK(frozen->IsUsedCoinSerial(serial1));
+    BOOST_CHECK(frozen->HasCoinTag(received, tag1));
+
+    // published snapshots keep their state when blocks are removed
+    lelantusState->RemoveBlock(index2);
+    lelantusState->PublishSnapshot(index1);
+    auto removed = lelantusState->GetSnapshot();
+    BOOST_CHECK_EQUAL(index1->nHeight, removed->GetHeight());
+    BOOST_CHECK(removed->HasCoin(mint1));
+    BOOST_CHECK(!removed->IsUsedCoinSerial(serial1));
+    BOOST_CHECK(published->IsUsedCoinSerial(serial1));
+    BOOST_CHECK(frozen->IsUsedCoinSerial(serial1));
+
+    lelantusState->RemoveBlock(index1);
+    lelantusState->PublishSnapshot(index1->pprev);
+    BOOST_CHECK(!lelantusState->GetSnapshot()->HasCoin(mint1));
+    BOOST_CHECK(published->HasCoin(mint1));
+    BOOST_CHECK(frozen->HasCoin(mint1));
+
+    lelantusState->Reset();
+    BOOST_CHECK_EQUAL(-1, lelantusState->GetSnapshot()->GetHeight());
+}
+
 BOOST_AUTO_TEST_CASE(get_coin_group)
 {
     GenerateBlocks(120);
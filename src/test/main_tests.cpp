@@ -5,6 +5,7 @@
 #include "chainparams.h"
 #include "validation.h"
 #include "net.h"
+#include "streams.h"
 
 #include "test/test_privora.h"
 
@@ -47,4 +48,28 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_FIXTURE_TEST_CASE(read_raw_block, TestChain100Setup)
+{
+    LOCK(cs_main);
+    const CBlockIndex* pindex = chainActive.Tip();
+
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+    CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+    ssBlock << block;
+
+    std::vector<unsigned char> rawBlock;
+    BOOST_CHECK(ReadRawBlockFromDisk(rawBlock, pindex, Params().MessageStart()));
+    BOOST_CHECK(rawBlock == std::vector<unsigned char>(ssBlock.begin(), ssBlock.end()));
+
+    // the stored header has to match the index
+    CBlockIndex wrongIndex(*pindex);
+    wrongIndex.nTime++;
+    BOOST_CHECK(!ReadRawBlockFromDisk(rawBlock, &wrongIndex, Params().MessageStart()));
+
+    CMessageHeader::MessageStartChars wrongStart = {0, 0, 0, 0};
+    BOOST_CHECK(!ReadRawBlockFromDisk(rawBlock, pindex, wrongStart));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
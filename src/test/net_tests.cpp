@@ -172,4 +172,86 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(socket_events_mode_names)
+{
+    SocketEventsMode mode;
+    BOOST_CHECK(SocketEventsModeFromString("select", mode));
+    BOOST_CHECK(mode == SOCKETEVENTS_SELECT);
+    BOOST_CHECK(!SocketEventsModeFromString("kqueue", mode));
+    BOOST_CHECK(!SocketEventsModeFromString("", mode));
+
+    // the default is always supported and round trips through its name
+    BOOST_CHECK(SocketEventsModeFromString(SocketEventsModeToString(DefaultSocketEventsMode()), mode));
+    BOOST_CHECK(mode == DefaultSocketEventsMode());
+    BOOST_CHECK(GetSupportedSocketEventsModes().find(SocketEventsModeToString(mode)) != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(socket_events_pending)
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    std::unique_ptr<CNode> pnode(new CNode(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", true));
+
+    // nothing reported yet
+    bool fRecv, fSend;
+    pnode->GetPendingSocketEvents(fRecv, fSend);
+    BOOST_CHECK(!fRecv && !fSend);
+
+    // a read that filled the buffer leaves the node readable until a short read
+    pnode->fHasRecvData = true;
+    pnode->GetPendingSocketEvents(fRecv, fSend);
+    BOOST_CHECK(fRecv && !fSend);
+
+    // a paused node is not read from, it must not keep the handler from waiting
+    pnode->fPauseRecv = true;
+    pnode->GetPendingSocketEvents(fRecv, fSend);
+    BOOST_CHECK(!fRecv && !fSend);
+    pnode->fPauseRecv = false;
+
+    // queued send data is drained first, and only while the socket accepts it
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::PING;
+    msg.data = {1, 2, 3, 4, 5, 6, 7, 8};
+    {
+        LOCK(pnode->cs_vSend);
+        pnode->vSendMsg.push_back(MakeSharedNetMsg(std::move(msg)));
+    }
+    pnode->GetPendingSocketEvents(fRecv, fSend);
+    BOOST_CHECK(!fRecv && !fSend);
+    pnode->fCanSendData = true;
+    pnode->GetPendingSocketEvents(fRecv, fSend);
+    BOOST_CHECK(!fRecv && fSend);
+
+    {
+        LOCK(pnode->cs_vSend);
+        pnode->vSendMsg.clear();
+    }
+    pnode->GetPendingSocketEvents(fRecv, fSend);
+    BOOST_CHECK(fRecv && !fSend);
+}
+
+BOOST_AUTO_TEST_CASE(shared_net_msg)
+{
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::PING;
+    msg.data = {1, 2, 3, 4, 5, 6, 7, 8};
+    CSharedNetMsgRef shared = MakeSharedNetMsg(std::move(msg));
+
+    BOOST_CHECK_EQUAL(shared->command, NetMsgType::PING);
+    BOOST_CHECK_EQUAL(shared->data.size(), 8);
+    BOOST_CHECK_EQUAL(shared->header.size(), CMessageHeader::HEADER_SIZE);
+    BOOST_CHECK_EQUAL(shared->size(), CMessageHeader::HEADER_SIZE + 8);
+
+    // the header is what the receiving side parses and checks the payload against
+    CDataStream ss(shared->header, SER_NETWORK, INIT_PROTO_VERSION);
+    CMessageHeader hdr(Params().MessageStart());
+    ss >> hdr;
+    BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), NetMsgType::PING);
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, 8);
+    uint256 hash = Hash(shared->data.begin(), shared->data.end());
+    BOOST_CHECK(memcmp(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
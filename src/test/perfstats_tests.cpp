@@ -0,0 +1,79 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "perfstats.h"
+
+#include "test/test_privora.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(perfstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(perfstats_buckets)
+{
+    BOOST_CHECK_EQUAL(CPerfHistogram::BucketIndex(0), 0);
+    BOOST_CHECK_EQUAL(CPerfHistogram::BucketIndex(1), 1);
+    BOOST_CHECK_EQUAL(CPerfHistogram::BucketIndex(3), 2);
+    BOOST_CHECK_EQUAL(CPerfHistogram::BucketIndex(4), 3);
+    BOOST_CHECK_EQUAL(CPerfHistogram::BucketIndex(uint64_t(1) << 40), CPerfHistogram::NUM_BUCKETS - 1);
+
+    // every sample must be strictly below the upper bound of its bucket
+    for (uint64_t v : {0, 1, 2, 7, 8, 1000, 123456}) {
+        int i = CPerfHistogram::BucketIndex(v);
+        BOOST_CHECK(v < CPerfHistogram::BucketUpperBound(i));
+        if (i > 0)
+            BOOST_CHECK(v >= CPerfHistogram::BucketUpperBound(i - 1));
+    }
+    BOOST_CHECK_EQUAL(CPerfHistogram::BucketUpperBound(CPerfHistogram::NUM_BUCKETS - 1), 0);
+}
+
+BOOST_AUTO_TEST_CASE(perfstats_histogram)
+{
+    CPerfHistogram h;
+    h.Add(5);
+    h.Add(5);
+    h.Add(100);
+
+    CPerfHistogram::Snapshot s = h.GetSnapshot();
+    BOOST_CHECK_EQUAL(s.count, 3);
+    BOOST_CHECK_EQUAL(s.sumMicros, 110);
+    BOOST_CHECK_EQUAL(s.maxMicros, 100);
+    BOOST_CHECK_EQUAL(s.buckets[CPerfHistogram::BucketIndex(5)], 2);
+    BOOST_CHECK_EQUAL(s.buckets[CPerfHistogram::BucketIndex(100)], 1);
+
+    h.Reset();
+    s = h.GetSnapshot();
+    BOOST_CHECK_EQUAL(s.count, 0);
+    BOOST_CHECK_EQUAL(s.maxMicros, 0);
+}
+
+BOOST_AUTO_TEST_CASE(perfstats_timer)
+{
+    ResetPerfStats();
+
+    SetPerfStatsEnabled(false);
+    {
+        CPerfTimer timer(PerfStat::DB_READ);
+    }
+    BOOST_CHECK_EQUAL(GetPerfHistogram(PerfStat::DB_READ).GetSnapshot().count, 0);
+
+    SetPerfStatsEnabled(true);
+    {
+        CPerfTimer timer(PerfStat::DB_READ);
+        timer.Stop();
+        // stopping twice must not record a second sample
+    }
+    RecordPerfStat(PerfStat::DB_WRITE, 42);
+    BOOST_CHECK_EQUAL(GetPerfHistogram(PerfStat::DB_READ).GetSnapshot().count, 1);
+    BOOST_CHECK_EQUAL(GetPerfHistogram(PerfStat::DB_WRITE).GetSnapshot().sumMicros, 42);
+
+    std::string text = PerfStatsToPrometheus();
+    BOOST_CHECK(text.find("privora_perf_duration_seconds_count{stat=\"db_write\"} 1\n") != std::string::npos);
+    BOOST_CHECK(text.find("privora_perf_duration_seconds_bucket{stat=\"db_write\",le=\"+Inf\"} 1\n") != std::string::npos);
+
+    SetPerfStatsEnabled(DEFAULT_PERFSTATS);
+    ResetPerfStats();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "privacytx.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "script/script.h"
+
+#include "test/test_privora.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(privacytx_tests, BasicTestingSetup)
+
+static CMutableTransaction MalformedSparkSpend()
+{
+    CMutableTransaction tx;
+    tx.nVersion = 3;
+    tx.nType = TRANSACTION_SPARK;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig << OP_SPARKSPEND;
+    tx.vExtraPayload.assign(10, 0xff);
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(privacytx_plain_transaction)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vout.resize(1);
+    CTransaction tx(mtx), tx2(mtx);
+
+    // transactions without a privacy payload share the empty instance
+    std::shared_ptr<const CPrivacyTxData> data = GetPrivacyTxData(tx);
+    BOOST_CHECK(data->fParsed);
+    BOOST_CHECK(data->lelantusSerials.empty());
+    BOOST_CHECK(data->sparkLTags.empty());
+    BOOST_CHECK(data == GetPrivacyTxData(tx2));
+}
+
+BOOST_AUTO_TEST_CASE(privacytx_malformed_spend)
+{
+    CTransaction tx(MalformedSparkSpend());
+    BOOST_CHECK(tx.IsSparkSpend());
+
+    std::shared_ptr<const CPrivacyTxData> data = GetPrivacyTxData(tx);
+    BOOST_CHECK(!data->fParsed);
+    BOOST_CHECK(data->sparkLTags.empty());
+    BOOST_CHECK_THROW(GetPrivacyTxFee(tx), std::exception);
+
+    // the result is cached on the transaction
+    BOOST_CHECK(data == GetPrivacyTxData(tx));
+
+    // a copy decodes the payload again
+    CTransaction copy(tx);
+    BOOST_CHECK(copy.GetHash() == tx.GetHash());
+    std::shared_ptr<const CPrivacyTxData> copyData = GetPrivacyTxData(copy);
+    BOOST_CHECK(copyData != data);
+    BOOST_CHECK(!copyData->fParsed);
+}
+
+BOOST_AUTO_TEST_CASE(privacytx_proof_cache)
+{
+    uint256 hashTx = GetRandHash();
+    std::vector<CPrivacyProofSet> sets = {{1, GetRandHash(), 100, {1, 2, 3}}, {2, GetRandHash(), 5, {}}};
+
+    uint256 key = GetPrivacyProofCacheKey(hashTx, sets);
+    BOOST_CHECK(key == GetPrivacyProofCacheKey(hashTx, sets));
+    BOOST_CHECK(!IsPrivacyProofVerified(key));
+    SetPrivacyProofVerified(key);
+    BOOST_CHECK(IsPrivacyProofVerified(key));
+
+    // the same spend against a different anonymity set is not covered
+    std::vector<CPrivacyProofSet> grown = sets;
+    grown[0].nCoins++;
+    BOOST_CHECK(!IsPrivacyProofVerified(GetPrivacyProofCacheKey(hashTx, grown)));
+    std::vector<CPrivacyProofSet> otherBlock = sets;
+    otherBlock[1].blockHash = GetRandHash();
+    BOOST_CHECK(!IsPrivacyProofVerified(GetPrivacyProofCacheKey(hashTx, otherBlock)));
+    BOOST_CHECK(!IsPrivacyProofVerified(GetPrivacyProofCacheKey(GetRandHash(), sets)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
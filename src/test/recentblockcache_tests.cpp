@@ -0,0 +1,83 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "recentblockcache.h"
+
+#include "blockencodings.h"
+#include "netmessagemaker.h"
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+
+#include "test/test_privora.h"
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(recentblockcache_tests, BasicTestingSetup)
+
+static CCachedBlockRef MakeCachedBlock()
+{
+    auto block = std::make_shared<CBlock>();
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+    block->vtx.push_back(MakeTransactionRef(tx));
+    block->hashPrevBlock = GetRandHash();
+    block->mix_hash = GetRandHash();
+    block->nNonce64 = GetRand(std::numeric_limits<uint64_t>::max());
+
+    CBlockHeaderAndShortTxIDs compactBlock(*block, true);
+    CSharedNetMsgRef compactBlockMsg = MakeSharedNetMsg(CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::CMPCTBLOCK, compactBlock));
+    return std::make_shared<const CCachedBlock>(block, compactBlockMsg);
+}
+
+BOOST_AUTO_TEST_CASE(recent_block_cache)
+{
+    CRecentBlockCache cache(3);
+    BOOST_CHECK(cache.GetMostRecent() == nullptr);
+
+    std::vector<CCachedBlockRef> blocks;
+    for (int i = 0; i < 4; i++) {
+        blocks.push_back(MakeCachedBlock());
+        cache.Add(blocks.back());
+        BOOST_CHECK(cache.GetMostRecent() == blocks.back());
+    }
+
+    // the oldest block was dropped
+    BOOST_CHECK_EQUAL(cache.Size(), 3);
+    BOOST_CHECK(cache.Get(blocks[0]->hash) == nullptr);
+    for (int i = 1; i < 4; i++)
+        BOOST_CHECK(cache.Get(blocks[i]->hash) == blocks[i]);
+
+    // adding a cached block again makes it the most recent without duplicating it
+    cache.Add(blocks[1]);
+    BOOST_CHECK_EQUAL(cache.Size(), 3);
+    BOOST_CHECK(cache.GetMostRecent() == blocks[1]);
+    BOOST_CHECK(cache.Get(blocks[3]->hash) == blocks[3]);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+    BOOST_CHECK(cache.Get(blocks[3]->hash) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(cached_block_msg)
+{
+    CCachedBlockRef cachedBlock = MakeCachedBlock();
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << *cachedBlock->block;
+
+    CSharedNetMsgRef blockMsg = cachedBlock->GetBlockMsg();
+    BOOST_CHECK_EQUAL(blockMsg->command, NetMsgType::BLOCK);
+    BOOST_CHECK(blockMsg->data == std::vector<unsigned char>(ss.begin(), ss.end()));
+    // serialized once
+    BOOST_CHECK(cachedBlock->GetBlockMsg() == blockMsg);
+    BOOST_CHECK_EQUAL(cachedBlock->compactBlockMsg->command, NetMsgType::CMPCTBLOCK);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
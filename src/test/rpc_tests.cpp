@@ -343,4 +343,44 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_parallel)
+{
+    if (RPCIsInWarmup(NULL))
+        SetRPCWarmupFinished();
+
+    // read-only calls, calls that run on their own and broken entries, mixed
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 40; i++) {
+        UniValue params(UniValue::VARR);
+        std::string strMethod;
+        switch (i % 5) {
+        case 0: strMethod = "getblockhash"; params.push_back(0); break;
+        case 1: strMethod = "getblockcount"; break;
+        case 2: strMethod = "decodescript"; params.push_back(strprintf("%02x", 0x51 + i % 16)); break;
+        case 3: strMethod = i % 2 ? "echo" : "nosuchmethod"; params.push_back(i); break;
+        case 4: strMethod = "getblockhash"; params.push_back(i); break;
+        }
+        UniValue req = JSONRPCRequestObj(strMethod, params, i);
+        batch.push_back(i == 17 ? UniValue("not an object") : req);
+    }
+
+    ForceSetArg("-rpcbatchthreads", "0");
+    StartRPC();
+    std::string strSerial = JSONRPCExecBatch(batch);
+    InterruptRPC();
+    StopRPC();
+
+    ForceSetArg("-rpcbatchthreads", "4");
+    ForceSetArg("-rpcbatchconcurrency", "3");
+    StartRPC();
+    std::string strParallel = JSONRPCExecBatch(batch);
+    InterruptRPC();
+    StopRPC();
+
+    UniValue replies;
+    BOOST_CHECK(replies.read(strParallel));
+    BOOST_CHECK_EQUAL(replies.size(), batch.size());
+    BOOST_CHECK_EQUAL(strParallel, strSerial);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
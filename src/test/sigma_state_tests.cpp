@@ -120,6 +120,32 @@ BOOST_AUTO_TEST_CASE(sigma_hascoin_true)
     sigmaState->Reset();
 }
 
+// Checking HasCoin and HasCoinHash once the state is frozen
+BOOST_AUTO_TEST_CASE(sigma_hascoin_frozen)
+{
+    sigma::CSigmaState *sigmaState = sigma::CSigmaState::GetState();
+    auto params = sigma::Params::get_default();
+
+    const sigma::PrivateCoin privcoin(params, sigma::CoinDenomination::SIGMA_DENOM_1);
+    sigma::PublicCoin pubcoin = privcoin.getPublicCoin();
+    CBlockIndex index = CreateBlockIndex(1);
+    auto mintsBlock = CreateBlockWithMints({pubcoin});
+    sigmaState->AddMintsToStateAndBlockIndex(&index, &mintsBlock);
+
+    sigmaState->Freeze();
+    BOOST_CHECK(sigmaState->IsFrozen());
+    BOOST_CHECK(sigmaState->HasCoin(pubcoin));
+    // the frozen mints are keyed by the denomination too
+    BOOST_CHECK(!sigmaState->HasCoin(sigma::PublicCoin(pubcoin.getValue(), sigma::CoinDenomination::SIGMA_DENOM_10)));
+
+    GroupElement received;
+    BOOST_CHECK(sigmaState->HasCoinHash(received, pubcoin.getValueHash()));
+    BOOST_CHECK(received == pubcoin.getValue());
+    BOOST_CHECK(!sigmaState->HasCoinHash(received, GetRandHash()));
+
+    sigmaState->Reset();
+}
+
 // Checking GetMintedCoinHeightAndId when coin exists
 BOOST_AUTO_TEST_CASE(sigma_getmintcoinheightandid_true)
 {
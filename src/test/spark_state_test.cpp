@@ -1,4 +1,5 @@
 #include "../spark/state.h"
+#include "../txdb.h"
 #include "../validation.h"
 #include "../wallet/wallet.h"
 #include "fixtures.h"
@@ -503,4 +504,112 @@ BOOST_AUTO_TEST_CASE(get_coin_group)
     sparkState->Reset();
 }
 
+BOOST_AUTO_TEST_CASE(mint_outpoint_index)
+{
+    GenerateBlocks(1100);
+
+    std::vector<CMutableTransaction> txs;
+    auto mints = GenerateMints({1 * COIN}, txs);
+    ::mempool.clear();
+    auto blockIdx = GenerateBlock({txs[0]});
+    BOOST_REQUIRE(blockIdx);
+
+    auto coin = pwalletMain->sparkWallet->getCoinFromMeta(mints[0]);
+    uint256 coinHash = coin.getHash();
+    COutPoint outPoint, indexed;
+    int nHeight;
+
+    // connecting the block indexed the mint
+    BOOST_CHECK(pblocktree->ReadSparkMintOutPoint(coinHash, indexed, nHeight));
+    BOOST_CHECK_EQUAL(blockIdx->nHeight, nHeight);
+    BOOST_CHECK(indexed.hash == txs[0].GetHash());
+    BOOST_CHECK(txs[0].vout[indexed.n].scriptPubKey.IsSparkMint());
+    BOOST_CHECK(spark::GetOutPoint(outPoint, coin));
+    BOOST_CHECK(outPoint == indexed);
+
+    // and the wallet caches it
+    BOOST_CHECK(pwalletMain->sparkWallet->getMintOutPoint(mints[0], outPoint));
+    BOOST_CHECK(outPoint == indexed);
+    BOOST_CHECK(mints[0].outPoint && mints[0].outPoint->first == indexed);
+
+    // a mint missing from the index is searched in its block and indexed again
+    BOOST_CHECK(pblocktree->EraseSparkMintOutPoints({coinHash}));
+    BOOST_CHECK(spark::GetOutPoint(outPoint, coin));
+    BOOST_CHECK(outPoint == indexed);
+    BOOST_CHECK(pblocktree->ReadSparkMintOutPoint(coinHash, outPoint, nHeight));
+
+    // disconnecting the block drops it
+    {
+        LOCK(cs_main);
+        DisconnectBlocks(1);
+    }
+    BOOST_CHECK(!pblocktree->ReadSparkMintOutPoint(coinHash, outPoint, nHeight));
+    BOOST_CHECK(!spark::GetOutPoint(outPoint, coin));
+    BOOST_CHECK(!pwalletMain->sparkWallet->getMintOutPoint(mints[0], outPoint));
+
+    sparkState->Reset();
+    ::mempool.clear();
+}
+
+BOOST_AUTO_TEST_CASE(snapshot)
+{
+    GenerateBlocks(1100);
+
+    std::vector<CMutableTransaction> txs;
+    auto mints = GenerateMints({1 * COIN}, txs);
+    ::mempool.clear();
+    auto blockIdx = GenerateBlock({txs[0]});
+    BOOST_REQUIRE(blockIdx);
+
+    auto coin = pwalletMain->sparkWallet->getCoinFromMeta(mints[0]);
+
+    // connecting the block published it
+    auto connected = sparkState->GetSnapshot();
+    BOOST_CHECK_EQUAL(blockIdx->nHeight, connected->GetHeight());
+    BOOST_CHECK(blockIdx->GetBlockHash() == connected->GetBlockHash());
+    BOOST_CHECK(connected->HasCoin(coin));
+    BOOST_CHECK_EQUAL(sparkState->GetMintedCoinHeightAndId(coin), connected->GetMintedCoinHeightAndId(coin));
+    BOOST_CHECK_EQUAL(std::make_pair(blockIdx->nHeight, 1), connected->GetMintedCoinHeightAndId(coin.getHash()));
+    BOOST_CHECK_EQUAL(sparkState->GetLatestCoinID(), connected->GetLatestCoinID());
+    BOOST_CHECK_EQUAL(sparkState->GetTotalCoins(), connected->GetTotalCoins());
+
+    spark::CSparkState::SparkCoinGroupInfo group;
+    BOOST_CHECK(connected->GetCoinGroupInfo(1, group));
+    BOOST_CHECK(blockIdx == group.lastBlock);
+
+    // linking tags show up once published
+    GroupElement lTag;
+    lTag.randomize();
+    sparkState->AddSpend(lTag, 1);
+    BOOST_CHECK(!connected->IsUsedLTag(lTag));
+    {
+        LOCK(cs_main);
+        sparkState->PublishSnapshot(chainActive.Tip());
+    }
+    auto spent = sparkState->GetSnapshot();
+    GroupElement found;
+    BOOST_CHECK(spent->IsUsedLTag(lTag));
+    BOOST_CHECK(spent->IsUsedLTagHash(found, primitives::GetLTagHash(lTag)));
+    BOOST_CHECK(found == lTag);
+    sparkState->RemoveSpend(lTag);
+
+    // disconnecting publishes a new snapshot and leaves the old ones as they were
+    {
+        LOCK(cs_main);
+        DisconnectBlocks(1);
+    }
+    auto disconnected = sparkState->GetSnapshot();
+    BOOST_CHECK_EQUAL(blockIdx->nHeight - 1, disconnected->GetHeight());
+    BOOST_CHECK(!disconnected->HasCoin(coin));
+    BOOST_CHECK(!disconnected->IsUsedLTag(lTag));
+    BOOST_CHECK_EQUAL(std::make_pair(-1, -1), disconnected->GetMintedCoinHeightAndId(coin));
+    BOOST_CHECK(connected->HasCoin(coin));
+    BOOST_CHECK(spent->IsUsedLTag(lTag));
+
+    sparkState->Reset();
+    BOOST_CHECK_EQUAL(-1, sparkState->GetSnapshot()->GetHeight());
+    BOOST_CHECK_EQUAL(0, sparkState->GetSnapshot()->GetTotalCoins());
+    ::mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
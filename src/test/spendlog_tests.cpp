@@ -0,0 +1,112 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "spendlog.h"
+
+#include "test/test_privora.h"
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(spendlog_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(spendlog_order)
+{
+    CSpendLog<uint32_t> log;
+    log.AddBlock(10, {5, 3, 9});
+    log.AddBlock(12, {1});
+    BOOST_CHECK_EQUAL(log.size(), 4);
+
+    int nNextHeight;
+    uint32_t nNextOffset;
+    auto entries = log.Read(0, 0, 100, 12, nNextHeight, nNextOffset);
+    BOOST_REQUIRE_EQUAL(entries.size(), 4);
+    BOOST_CHECK_EQUAL(nNextHeight, 13);
+    BOOST_CHECK_EQUAL(nNextOffset, 0);
+
+    // entries of one block are ordered by hash, independent of insertion order
+    CSpendLog<uint32_t> other;
+    other.AddBlock(10, {9, 5, 3});
+    auto otherEntries = other.Read(10, 0, 100, 10, nNextHeight, nNextOffset);
+    BOOST_REQUIRE_EQUAL(otherEntries.size(), 3);
+    for (size_t i = 0; i < 3; i++) {
+        BOOST_CHECK_EQUAL(entries[i].nHeight, 10);
+        BOOST_CHECK_EQUAL(entries[i].value, otherEntries[i].value);
+    }
+    BOOST_CHECK(SerializeHash(entries[0].value) < SerializeHash(entries[1].value));
+    BOOST_CHECK(SerializeHash(entries[1].value) < SerializeHash(entries[2].value));
+    BOOST_CHECK_EQUAL(entries[3].nHeight, 12);
+    BOOST_CHECK_EQUAL(entries[3].value, 1);
+}
+
+BOOST_AUTO_TEST_CASE(spendlog_cursor)
+{
+    CSpendLog<uint32_t> log;
+    log.AddBlock(1, {1, 2});
+    log.AddBlock(3, {3, 4, 5});
+
+    int nNextHeight;
+    uint32_t nNextOffset;
+    auto page = log.Read(0, 0, 3, 3, nNextHeight, nNextOffset);
+    BOOST_CHECK_EQUAL(page.size(), 3);
+    BOOST_CHECK_EQUAL(nNextHeight, 3);
+    BOOST_CHECK_EQUAL(nNextOffset, 1);
+
+    page = log.Read(nNextHeight, nNextOffset, 3, 3, nNextHeight, nNextOffset);
+    BOOST_CHECK_EQUAL(page.size(), 2);
+    BOOST_CHECK_EQUAL(nNextHeight, 4);
+    BOOST_CHECK_EQUAL(nNextOffset, 0);
+
+    // an offset past the end of a height continues with the next height
+    page = log.Read(1, 7, 10, 3, nNextHeight, nNextOffset);
+    BOOST_CHECK_EQUAL(page.size(), 3);
+
+    // with no spends in the last blocks the last page still ends past the tip
+    page = log.Read(3, 0, 10, 20, nNextHeight, nNextOffset);
+    BOOST_CHECK_EQUAL(page.size(), 3);
+    BOOST_CHECK_EQUAL(nNextHeight, 21);
+    BOOST_CHECK_EQUAL(nNextOffset, 0);
+    page = log.Read(0, 0, 10, 20, nNextHeight, nNextOffset);
+    BOOST_CHECK_EQUAL(page.size(), 5);
+    BOOST_CHECK_EQUAL(nNextHeight, 21);
+    CSpendLog<uint32_t> empty;
+    page = empty.Read(0, 0, 10, 20, nNextHeight, nNextOffset);
+    BOOST_CHECK(page.empty());
+    BOOST_CHECK_EQUAL(nNextHeight, 21);
+
+    // reading past the tip returns nothing and keeps the cursor
+    page = log.Read(100, 0, 10, 20, nNextHeight, nNextOffset);
+    BOOST_CHECK(page.empty());
+    BOOST_CHECK_EQUAL(nNextHeight, 100);
+    BOOST_CHECK_EQUAL(nNextOffset, 0);
+    page = log.Read(std::numeric_limits<int>::max(), 5, 10, 20, nNextHeight, nNextOffset);
+    BOOST_CHECK(page.empty());
+    BOOST_CHECK_EQUAL(nNextHeight, std::numeric_limits<int>::max());
+}
+
+BOOST_AUTO_TEST_CASE(spendlog_reorg)
+{
+    CSpendLog<uint32_t> log;
+    log.AddBlock(1, {1});
+    log.AddBlock(2, {2, 3});
+    log.AddBlock(3, {4});
+
+    log.RemoveFrom(2);
+    BOOST_CHECK_EQUAL(log.size(), 1);
+
+    // reconnecting a height replaces whatever was logged there before
+    log.AddBlock(2, {7});
+    log.AddBlock(2, {8, 9});
+    int nNextHeight;
+    uint32_t nNextOffset;
+    auto entries = log.Read(2, 0, 10, 2, nNextHeight, nNextOffset);
+    BOOST_CHECK_EQUAL(entries.size(), 2);
+    BOOST_CHECK_EQUAL(nNextHeight, 3);
+
+    log.Reset();
+    BOOST_CHECK_EQUAL(log.size(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
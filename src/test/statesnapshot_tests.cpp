@@ -0,0 +1,204 @@
+// Copyright (c) 2024 The Privora Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "statesnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "random.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+
+#include "test/test_privora.h"
+#include "test/testutil.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(statesnapshot_tests, BasicTestingSetup)
+
+static CStateSnapshotMetadata MakeMetadata()
+{
+    CStateSnapshotMetadata metadata;
+    metadata.nVersion = STATE_SNAPSHOT_VERSION;
+    memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+    metadata.nRecordVersion = STATE_SNAPSHOT_RECORD_VERSION;
+    metadata.hashBlock = GetRandHash();
+    metadata.nHeight = 1234;
+    return metadata;
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_roundtrip)
+{
+    boost::filesystem::path path = GetDataDir() / "statesnapshot_roundtrip.dat";
+    CStateSnapshotMetadata metadata = MakeMetadata();
+
+    // more records than fit a chunk, and a change of type in between
+    std::vector<uint256> hashes;
+    for (uint32_t i = 0; i < STATE_SNAPSHOT_CHUNK_RECORDS + 10; i++)
+        hashes.push_back(GetRandHash());
+
+    CStateSnapshotWriter writer(fopen(path.string().c_str(), "wb"), metadata);
+    for (const uint256& hash : hashes)
+        writer.Add(SNAPSHOT_CHUNK_BLOCK_INDEX, hash);
+    writer.Add(SNAPSHOT_CHUNK_COINS, (uint32_t)7);
+    uint256 contentHash = writer.Finish();
+
+    CStateSnapshotReader reader(fopen(path.string().c_str(), "rb"));
+    BOOST_CHECK(reader.GetMetadata().hashBlock == metadata.hashBlock);
+    BOOST_CHECK_EQUAL(reader.GetMetadata().nHeight, 1234);
+
+    std::vector<CStateSnapshotChunk> chunks, allChunks;
+    while (reader.ReadChunks(chunks, 2))
+        allChunks.insert(allChunks.end(), chunks.begin(), chunks.end());
+    allChunks.insert(allChunks.end(), chunks.begin(), chunks.end());
+    BOOST_CHECK(reader.GetContentHash() == contentHash);
+
+    BOOST_REQUIRE_EQUAL(allChunks.size(), 3);
+    BOOST_CHECK_EQUAL(allChunks[0].nType, SNAPSHOT_CHUNK_BLOCK_INDEX);
+    BOOST_CHECK_EQUAL(allChunks[0].nRecords, STATE_SNAPSHOT_CHUNK_RECORDS);
+    BOOST_CHECK_EQUAL(allChunks[1].nType, SNAPSHOT_CHUNK_BLOCK_INDEX);
+    BOOST_CHECK_EQUAL(allChunks[1].nRecords, 10);
+    BOOST_CHECK_EQUAL(allChunks[2].nType, SNAPSHOT_CHUNK_COINS);
+    BOOST_CHECK_EQUAL(allChunks[2].nRecords, 1);
+    BOOST_CHECK(VerifyStateSnapshotChunks(allChunks, 2));
+
+    CDataStream ss(allChunks[1].vchData, SER_DISK, STATE_SNAPSHOT_RECORD_VERSION);
+    uint256 hash;
+    for (int i = 0; i < 10; i++)
+        ss >> hash;
+    BOOST_CHECK(hash == hashes.back());
+    BOOST_CHECK(ss.empty());
+
+    CStateSnapshotMetadata metadataRead;
+    uint256 contentHashRead;
+    std::string strError;
+    BOOST_CHECK(HashStateSnapshot(path, metadataRead, contentHashRead, strError));
+    BOOST_CHECK(contentHashRead == contentHash);
+
+    // a changed record no longer matches its chunk hash
+    allChunks[1].vchData[0] ^= 1;
+    BOOST_CHECK(!VerifyStateSnapshotChunks(allChunks, 2));
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_content_hash)
+{
+    // the content hash commits to the metadata
+    boost::filesystem::path path = GetDataDir() / "statesnapshot_content_hash.dat";
+    CStateSnapshotMetadata metadata = MakeMetadata();
+    uint256 hash = GetRandHash();
+
+    CStateSnapshotWriter writer1(fopen(path.string().c_str(), "wb"), metadata);
+    writer1.Add(SNAPSHOT_CHUNK_COINS, hash);
+    uint256 contentHash1 = writer1.Finish();
+
+    metadata.nHeight++;
+    CStateSnapshotWriter writer2(fopen(path.string().c_str(), "wb"), metadata);
+    writer2.Add(SNAPSHOT_CHUNK_COINS, hash);
+    uint256 contentHash2 = writer2.Finish();
+    BOOST_CHECK(contentHash1 != contentHash2);
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// every case sets up its nodes itself, one after the other
+BOOST_AUTO_TEST_SUITE(statesnapshot_load_tests)
+
+static bool IsSnapshotLoading()
+{
+    bool fLoading = false;
+    return pblocktree->ReadFlag(STATE_SNAPSHOT_LOADING_FLAG, fLoading) && fLoading;
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_dump_load)
+{
+    boost::filesystem::path path = GetTempPath() / strprintf("statesnapshot_dump_load_%lu.dat", (unsigned long)GetRand(1000000));
+    CStateSnapshotMetadata metadata;
+    uint256 contentHash;
+    uint256 txidLast;
+    std::string strError;
+    {
+        TestChain100Setup node;
+        BOOST_CHECK(DumpStateSnapshot(path, metadata, contentHash, strError));
+        BOOST_CHECK_EQUAL(metadata.nHeight, 100);
+        // not the client version, so every build hashes the same state the same
+        BOOST_CHECK_EQUAL(metadata.nRecordVersion, STATE_SNAPSHOT_RECORD_VERSION);
+        BOOST_CHECK(metadata.hashBlock == chainActive.Tip()->GetBlockHash());
+        txidLast = node.coinbaseTxns.back().GetHash();
+
+        // an existing file is not overwritten
+        CStateSnapshotMetadata metadataAgain;
+        uint256 contentHashAgain;
+        BOOST_CHECK(!DumpStateSnapshot(path, metadataAgain, contentHashAgain, strError));
+
+        // a node with blocks does not load one
+        BOOST_CHECK(!LoadStateSnapshot(path, true, metadataAgain, contentHashAgain, strError));
+    }
+
+    TestingSetup node(CBaseChainParams::REGTEST);
+    CStateSnapshotMetadata metadataRead;
+    uint256 contentHashRead;
+    size_t nBlockIndex = mapBlockIndex.size();
+
+    // nothing is pinned on regtest, the snapshot has to be trusted
+    BOOST_CHECK(!LoadStateSnapshot(path, false, metadataRead, contentHashRead, strError));
+    BOOST_CHECK(contentHashRead == contentHash);
+
+    // snapshots that fail their checks leave the node as it was
+    boost::filesystem::path pathBad = path.string() + ".bad";
+    {
+        CStateSnapshotMetadata metadataBad = metadata;
+        CStateSnapshotWriter writer(fopen(pathBad.string().c_str(), "wb"), metadataBad);
+        writer.Add(SNAPSHOT_CHUNK_BLOCK_INDEX, CDiskBlockIndex(chainActive.Genesis()));
+        writer.Finish();
+    }
+    BOOST_CHECK(!LoadStateSnapshot(pathBad, true, metadataRead, contentHashRead, strError));
+    BOOST_CHECK_EQUAL(strError, "the snapshot's block index does not end at its base block");
+    {
+        CStateSnapshotWriter writer(fopen(pathBad.string().c_str(), "wb"), metadata);
+        writer.Add(SNAPSHOT_CHUNK_COINS, std::make_pair(COutPoint(GetRandHash(), 0), Coin(CTxOut(1, CScript() << OP_TRUE), 1, false)));
+        writer.Add(SNAPSHOT_CHUNK_BLOCK_INDEX, CDiskBlockIndex(chainActive.Genesis()));
+        writer.Finish();
+    }
+    BOOST_CHECK(!LoadStateSnapshot(pathBad, true, metadataRead, contentHashRead, strError));
+    boost::filesystem::remove(pathBad);
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), nBlockIndex);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 0);
+    BOOST_CHECK(!IsSnapshotLoading());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->GetBestBlock() == chainActive.Genesis()->GetBlockHash());
+        BOOST_CHECK(AccessByTxid(*pcoinsTip, txidLast).IsSpent());
+    }
+    BOOST_CHECK(!boost::filesystem::exists(GetDataDir() / "snapshotcoins"));
+
+    // a good one becomes the chain tip with its coins
+    BOOST_CHECK(LoadStateSnapshot(path, true, metadataRead, contentHashRead, strError));
+    BOOST_CHECK(contentHashRead == contentHash);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 100);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == metadata.hashBlock);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->GetBestBlock() == metadata.hashBlock);
+        BOOST_CHECK(!AccessByTxid(*pcoinsTip, txidLast).IsSpent());
+    }
+    BOOST_CHECK(!IsSnapshotLoading());
+    BOOST_CHECK(!boost::filesystem::exists(GetDataDir() / "snapshotcoins"));
+    bool fSnapshot = false;
+    BOOST_CHECK(pblocktree->ReadFlag(STATE_SNAPSHOT_FLAG, fSnapshot) && fSnapshot);
+
+    // and only once
+    BOOST_CHECK(!LoadStateSnapshot(path, true, metadataRead, contentHashRead, strError));
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -338,4 +338,66 @@ BOOST_AUTO_TEST_CASE(dbindexhelper_zerospend)
     }
 }
 
+BOOST_AUTO_TEST_CASE(address_index_seek_and_balances)
+{
+    CBlockTreeDB db(1 << 20, true, true);
+
+    uint160 const hashA(std::vector<unsigned char>(20, 0x0a)), hashB(std::vector<unsigned char>(20, 0x0b));
+    uint256 const tx1 = uint256S("01"), tx2 = uint256S("02"), tx3 = uint256S("03");
+    std::vector<std::pair<CAddressIndexKey, CAmount> > const block10 {
+        {CAddressIndexKey(AddressType::payToPubKeyHash, hashA, 10, 1, tx1, 0, false), 500},
+        {CAddressIndexKey(AddressType::payToPubKeyHash, hashA, 10, 1, tx1, 1, false), 400},
+        {CAddressIndexKey(AddressType::payToPubKeyHash, hashB, 10, 1, tx1, 2, false), 700}};
+    std::vector<std::pair<CAddressIndexKey, CAmount> > const block20 {
+        {CAddressIndexKey(AddressType::payToPubKeyHash, hashA, 20, 2, tx2, 0, true), -500}};
+    std::vector<std::pair<CAddressIndexKey, CAmount> > const block30 {
+        {CAddressIndexKey(AddressType::payToPubKeyHash, hashA, 30, 1, tx3, 0, false), 100}};
+
+    BOOST_CHECK(db.BuildAddressBalances());
+    BOOST_CHECK(db.HaveAddressBalances());
+    BOOST_CHECK(db.WriteAddressIndex(block10));
+    BOOST_CHECK(db.WriteAddressIndex(block20));
+    BOOST_CHECK(db.WriteAddressIndex(block30));
+    // written once more, as after a crash
+    BOOST_CHECK(db.WriteAddressIndex(block30));
+
+    CAddressBalance balance;
+    BOOST_CHECK(db.ReadAddressBalance(AddressType::payToPubKeyHash, hashA, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 500);
+    BOOST_CHECK_EQUAL(balance.received, 1000);
+    BOOST_CHECK(db.ReadAddressBalance(AddressType::payToPubKeyHash, hashB, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 700);
+    BOOST_CHECK(!db.ReadAddressBalance(AddressType::payToScriptHash, hashA, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 0);
+
+    // seek to a transaction and stop after a height
+    std::vector<int> heights;
+    auto collect = [&heights](const CAddressIndexKey& key, CAmount) { heights.push_back(key.blockHeight); return true; };
+    BOOST_CHECK(db.ReadAddressIndex(CAddressIndexIteratorTxKey(AddressType::payToPubKeyHash, hashA, 10, 2), 0, collect));
+    BOOST_CHECK(heights == std::vector<int>({20, 30}));
+    heights.clear();
+    BOOST_CHECK(db.ReadAddressIndex(CAddressIndexIteratorTxKey(AddressType::payToPubKeyHash, hashA, 0, 0), 20, collect));
+    BOOST_CHECK(heights == std::vector<int>({10, 10, 20}));
+    heights.clear();
+    BOOST_CHECK(db.ReadAddressIndex(CAddressIndexIteratorTxKey(AddressType::payToPubKeyHash, hashA, 0, 0), 0,
+            [&heights](const CAddressIndexKey& key, CAmount) { heights.push_back(key.blockHeight); return heights.size() < 2; }));
+    BOOST_CHECK(heights == std::vector<int>({10, 10}));
+
+    // erasing a block twice takes it off once
+    BOOST_CHECK(db.EraseAddressIndex(block30));
+    BOOST_CHECK(db.EraseAddressIndex(block30));
+    BOOST_CHECK(db.ReadAddressBalance(AddressType::payToPubKeyHash, hashA, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 400);
+    BOOST_CHECK_EQUAL(balance.received, 900);
+
+    // summing up from scratch gives the same
+    BOOST_CHECK(db.EraseAddressIndex(block20));
+    BOOST_CHECK(db.BuildAddressBalances());
+    BOOST_CHECK(db.ReadAddressBalance(AddressType::payToPubKeyHash, hashA, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 900);
+    BOOST_CHECK_EQUAL(balance.received, 900);
+    BOOST_CHECK(db.ReadAddressBalance(AddressType::payToPubKeyHash, hashB, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 700);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,16 +5,21 @@
 
 #include "txdb.h"
 
+#include "blockfilter.h"
 #include "chainparams.h"
 #include "hash.h"
+#include "memusage.h"
 #include "pow.h"
 #include "uint256.h"
+#include "util.h"
 #include "validation.h"
 #include "consensus/consensus.h"
 #include "base58.h"
 
 #include <stdint.h>
 
+#include <functional>
+
 #include <boost/thread.hpp>
 
 #ifdef __linux__
@@ -32,10 +37,20 @@ static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 static const char DB_TOTAL_SUPPLY = 'S';
+static const char DB_BLOCK_FILTER = 'G';
+static const char DB_BLOCK_FILTER_HEADER = 'g';
+static const char DB_SPARK_MINT_OUTPOINT = 'k';
+static const char DB_ADDRESSBALANCE = 'A';
+
+//! Flag set once the address balances match the address index
+static const std::string ADDRESS_BALANCES_FLAG = "addressbalances";
+//! Size of the batches the address balances are written in when they are built
+static const size_t ADDRESS_BALANCES_BATCH_SIZE = 16 << 20;
 
 namespace {
 
@@ -61,7 +76,12 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", GetDBWrapperOptions("chainstate", nCacheSize), fMemory, fWipe, true)
+{
+}
+
+CCoinsViewDB::CCoinsViewDB(const boost::filesystem::path& path, const std::string& strName, size_t nCacheSize, bool fMemory, bool fWipe)
+    : db(path, GetDBWrapperOptions(strName, nCacheSize), fMemory, fWipe, true)
 {
 }
 
@@ -97,20 +117,224 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
     }
-    if (!hashBlock.IsNull())
+    if (!hashBlock.IsNull()) {
+        batch.Erase(DB_HEAD_BLOCKS);
         batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
 
     bool ret = db.WriteBatch(batch);
     LogPrint("coindb", "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return ret;
 }
 
+std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
+    std::vector<uint256> vhashHeadBlocks;
+    if (!db.Read(DB_HEAD_BLOCKS, vhashHeadBlocks))
+        return std::vector<uint256>();
+    return vhashHeadBlocks;
+}
+
+bool CCoinsViewDB::BatchWriteIncremental(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t nMaxBatchSize) {
+    assert(!hashBlock.IsNull());
+    std::vector<uint256> vhashHeadBlocks = GetHeadBlocks();
+    assert(vhashHeadBlocks.size() == 2 && vhashHeadBlocks[0] == hashBlock);
+
+    CDBBatch batch(db);
+    size_t count = 0;
+    size_t changed = 0;
+    size_t batches = 0;
+    for (const auto &it : mapCoins) {
+        if (it.second.flags & CCoinsCacheEntry::DIRTY) {
+            CoinEntry entry(&it.first);
+            if (it.second.coin.IsSpent())
+                batch.Erase(entry);
+            else
+                batch.Write(entry, it.second.coin);
+            changed++;
+        }
+        count++;
+        if (batch.SizeEstimate() > nMaxBatchSize) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            batches++;
+        }
+    }
+    batch.Erase(DB_HEAD_BLOCKS);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+
+    bool ret = db.WriteBatch(batch);
+    LogPrint("coindb", "Committed %u changed transaction outputs (out of %u) to coin database in %u batches...\n", (unsigned int)changed, (unsigned int)count, (unsigned int)batches + 1);
+    return ret;
+}
+
+bool CCoinsViewDB::WriteHeadBlocks(const uint256 &hashBlock) {
+    CDBBatch batch(db);
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, GetBestBlock()});
+    return db.WriteBatch(batch, true);
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+/** Whether hashNew is a descendant of hashOld, so the blocks in between can be rolled forward */
+static bool IsRollForwardPossible(const uint256 &hashOld, const uint256 &hashNew)
+{
+    if (hashOld.IsNull() || hashNew.IsNull())
+        return false;
+    LOCK(cs_main);
+    BlockMap::const_iterator itOld = mapBlockIndex.find(hashOld);
+    BlockMap::const_iterator itNew = mapBlockIndex.find(hashNew);
+    if (itOld == mapBlockIndex.end() || itNew == mapBlockIndex.end())
+        return false;
+    return itNew->second->GetAncestor(itOld->second->nHeight) == itOld->second;
+}
+
+CCoinsViewFlusher::CCoinsViewFlusher(CCoinsViewDB *dbIn, bool fAsyncIn, size_t nMaxBatchSizeIn)
+    : db(dbIn), fAsync(fAsyncIn), nMaxBatchSize(nMaxBatchSizeIn), fWriteQueued(false), fWriteFailed(false), fStop(false)
+{
+    if (fAsync)
+        threadFlush = std::thread(&TraceThread<std::function<void()> >, "coinsflush", std::function<void()>(std::bind(&CCoinsViewFlusher::ThreadFlush, this)));
+}
+
+CCoinsViewFlusher::~CCoinsViewFlusher()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    if (threadFlush.joinable())
+        threadFlush.join();
+}
+
+bool CCoinsViewFlusher::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    std::shared_ptr<const PendingWrite> write = GetPending();
+    if (write) {
+        CCoinsMap::const_iterator it = write->coins.find(outpoint);
+        if (it != write->coins.end()) {
+            if (it->second.coin.IsSpent())
+                return false;
+            coin = it->second.coin;
+            return true;
+        }
+    }
+    return db->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewFlusher::HaveCoin(const COutPoint &outpoint) const {
+    std::shared_ptr<const PendingWrite> write = GetPending();
+    if (write) {
+        CCoinsMap::const_iterator it = write->coins.find(outpoint);
+        if (it != write->coins.end())
+            return !it->second.coin.IsSpent();
+    }
+    return db->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewFlusher::GetBestBlock() const {
+    std::shared_ptr<const PendingWrite> write = GetPending();
+    if (write && !write->hashBlock.IsNull())
+        return write->hashBlock;
+    return db->GetBestBlock();
+}
+
+std::vector<uint256> CCoinsViewFlusher::GetHeadBlocks() const {
+    // the head blocks of a write in flight are not an inconsistency to repair
+    if (GetPending())
+        return std::vector<uint256>();
+    return db->GetHeadBlocks();
+}
+
+bool CCoinsViewFlusher::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    if (!Sync())
+        return false;
+    if (!fAsync || hashBlock.IsNull())
+        return db->BatchWrite(mapCoins, hashBlock);
+
+    // Nothing to roll forward from after a crash, write it before anything that follows
+    if (!IsRollForwardPossible(db->GetBestBlock(), hashBlock))
+        return db->BatchWrite(mapCoins, hashBlock);
+    if (!db->WriteHeadBlocks(hashBlock))
+        return false;
+
+    size_t nUsage = memusage::DynamicUsage(mapCoins);
+    for (const auto &it : mapCoins)
+        nUsage += it.second.coin.DynamicMemoryUsage();
+    std::shared_ptr<const PendingWrite> write = std::make_shared<const PendingWrite>(std::move(mapCoins), hashBlock, nUsage);
+    mapCoins.clear();
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        std::atomic_store(&pending, write);
+        fWriteQueued = true;
+    }
+    cond.notify_all();
+    return true;
+}
+
+CCoinsViewCursor *CCoinsViewFlusher::Cursor() const {
+    // the cursor iterates the database only, let it see the pending coins too
+    Sync();
+    return db->Cursor();
+}
+
+size_t CCoinsViewFlusher::EstimateSize() const {
+    return db->EstimateSize();
+}
+
+bool CCoinsViewFlusher::Sync() const {
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [this] { return !fWriteQueued; });
+    return !fWriteFailed;
+}
+
+size_t CCoinsViewFlusher::GetPendingUsage() const {
+    std::shared_ptr<const PendingWrite> write = GetPending();
+    return write ? write->nUsage : 0;
+}
+
+bool CCoinsViewFlusher::Write(const PendingWrite &write) {
+    try {
+        return db->BatchWriteIncremental(write.coins, write.hashBlock, nMaxBatchSize);
+    } catch (const std::exception &e) {
+        LogPrintf("%s: error writing to coin database: %s\n", __func__, e.what());
+        return false;
+    }
+}
+
+void CCoinsViewFlusher::ThreadFlush()
+{
+    while (true) {
+        std::shared_ptr<const PendingWrite> write;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait(lock, [this] { return fWriteQueued || fStop; });
+            if (!fWriteQueued)
+                return;
+            write = GetPending();
+        }
+
+        int64_t nStart = GetTimeMicros();
+        bool fOk = Write(*write);
+        LogPrint("coindb", "%s: wrote %u coins for block %s in %.2fms\n", __func__, (unsigned int)write->coins.size(),
+            write->hashBlock.ToString(), (GetTimeMicros() - nStart) * 0.001);
+
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            // keep serving a failed write from memory, the node shuts down on the next Sync()
+            if (fOk)
+                std::atomic_store(&pending, std::shared_ptr<const PendingWrite>());
+            fWriteFailed = !fOk;
+            fWriteQueued = false;
+        }
+        cond.notify_all();
+    }
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", GetDBWrapperOptions("blocktree", nCacheSize), fMemory, fWipe) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -214,6 +438,14 @@ bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return Read(std::make_pair(DB_SPENTINDEX, key), value);
 }
 
+void CBlockTreeDB::ReadSpentIndex(const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values, std::vector<bool> &found) {
+    std::vector<std::pair<char, CSpentIndexKey> > dbKeys;
+    dbKeys.reserve(keys.size());
+    for (const CSpentIndexKey &key : keys)
+        dbKeys.push_back(std::make_pair(DB_SPENTINDEX, key));
+    ReadMany(dbKeys, values, found);
+}
+
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
@@ -226,6 +458,29 @@ bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey,
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadSparkMintOutPoint(const uint256 &coinHash, COutPoint &outPoint, int &nHeight) {
+    std::pair<COutPoint, int> value;
+    if (!Read(std::make_pair(DB_SPARK_MINT_OUTPOINT, coinHash), value))
+        return false;
+    outPoint = value.first;
+    nHeight = value.second;
+    return true;
+}
+
+bool CBlockTreeDB::WriteSparkMintOutPoints(const std::vector<std::pair<uint256, std::pair<COutPoint, int> > > &vect) {
+    CDBBatch batch(*this);
+    for (const auto &entry : vect)
+        batch.Write(std::make_pair(DB_SPARK_MINT_OUTPOINT, entry.first), entry.second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseSparkMintOutPoints(const std::vector<uint256> &coinHashes) {
+    CDBBatch batch(*this);
+    for (const uint256 &coinHash : coinHashes)
+        batch.Erase(std::make_pair(DB_SPARK_MINT_OUTPOINT, coinHash));
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
@@ -240,32 +495,65 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    return ReadAddressUnspentIndex(CAddressUnspentKey(type, addressHash, uint256(), 0),
+            [&unspentOutputs](const CAddressUnspentKey &key, const CAddressUnspentValue &value) {
+                unspentOutputs.push_back(std::make_pair(key, value));
+                return true;
+            });
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(const CAddressUnspentKey &from,
+                                           const std::function<bool(const CAddressUnspentKey &, const CAddressUnspentValue &)> &visit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, from));
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX || key.second.hashBytes != from.hashBytes || key.second.type != from.type)
             break;
-        }
+        CAddressUnspentValue nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address unspent value");
+        if (!visit(key.second, nValue))
+            break;
+        pcursor->Next();
     }
 
     return true;
 }
 
+void CBlockTreeDB::UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) {
+    std::map<std::pair<AddressType, uint160>, CAddressBalance> balances;
+    for (const std::pair<CAddressIndexKey, CAmount> &entry : vect) {
+        std::pair<AddressType, uint160> address(entry.first.type, entry.first.hashBytes);
+        auto it = balances.find(address);
+        if (it == balances.end()) {
+            it = balances.emplace(address, CAddressBalance()).first;
+            Read(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(address.first, address.second)), it->second);
+        }
+        // blocks connected again after a crash write their entries once more, so what is stored is what counts
+        CAmount nStored;
+        if (Read(std::make_pair(DB_ADDRESSINDEX, entry.first), nStored))
+            it->second.Remove(nStored);
+        if (!fErase)
+            it->second.Add(entry.second);
+    }
+
+    for (const auto &balance : balances) {
+        auto key = std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(balance.first.first, balance.first.second));
+        if (balance.second.IsNull())
+            batch.Erase(key);
+        else
+            batch.Write(key, balance.second);
+    }
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    UpdateAddressBalances(batch, vect, false);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
     }
@@ -274,6 +562,7 @@ bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    UpdateAddressBalances(batch, vect, true);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
     batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
     return WriteBatch(batch);
@@ -282,35 +571,90 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, AddressType type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
+    // a height range only applies with both of its ends
+    if (start <= 0 || end <= 0) {
+        start = 0;
+        end = 0;
+    }
+    return ReadAddressIndex(CAddressIndexIteratorTxKey(type, addressHash, start, 0), end,
+            [&addressIndex](const CAddressIndexKey &key, CAmount nValue) {
+                addressIndex.push_back(std::make_pair(key, nValue));
+                return true;
+            });
+}
+
+bool CBlockTreeDB::ReadAddressIndex(const CAddressIndexIteratorTxKey &from, int end,
+                                    const std::function<bool(const CAddressIndexKey &, CAmount)> &visit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, from));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX || key.second.hashBytes != from.hashBytes || key.second.type != from.type)
+            break;
+        if (end > 0 && key.second.blockHeight > end)
+            break;
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+        if (!visit(key.second, nValue))
+            break;
+        pcursor->Next();
     }
 
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalance(AddressType type, const uint160 &addressHash, CAddressBalance &balance) {
+    balance.SetNull();
+    return Read(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), balance);
+}
+
+bool CBlockTreeDB::HaveAddressBalances() {
+    bool fBalances = false;
+    return ReadFlag(ADDRESS_BALANCES_FLAG, fBalances) && fBalances;
+}
+
+bool CBlockTreeDB::BuildAddressBalances() {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+
+    CAddressIndexIteratorKey address;
+    CAddressBalance balance;
+    bool fAddress = false;
+
+    // the entries of an address are next to each other, so the addresses are summed up one at a time
+    pcursor->Seek(DB_ADDRESSINDEX);
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash && key.second.type == type) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
-            }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX)
             break;
+        if (fAddress && (key.second.type != address.type || key.second.hashBytes != address.hashBytes)) {
+            batch.Write(std::make_pair(DB_ADDRESSBALANCE, address), balance);
+            balance.SetNull();
+            if (batch.SizeEstimate() > ADDRESS_BALANCES_BATCH_SIZE) {
+                if (!WriteBatch(batch))
+                    return error("failed to write address balances");
+                batch.Clear();
+            }
         }
+        address = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+        fAddress = true;
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+        balance.Add(nValue);
+        pcursor->Next();
     }
 
-    return true;
+    if (fAddress)
+        batch.Write(std::make_pair(DB_ADDRESSBALANCE, address), balance);
+    batch.Write(std::make_pair(DB_FLAG, ADDRESS_BALANCES_FLAG), '1');
+    return WriteBatch(batch, true);
 }
 
 size_t CBlockTreeDB::findAddressNumWBalance() {
@@ -366,6 +710,36 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
+bool CBlockTreeDB::WriteBlockFilter(const BlockFilter &filter, const uint256 &header) {
+    auto key = std::make_pair((uint8_t)filter.GetFilterType(), filter.GetBlockHash());
+    CDBBatch batch(*this);
+    batch.Write(std::make_pair(DB_BLOCK_FILTER, key), filter.GetEncodedFilter());
+    batch.Write(std::make_pair(DB_BLOCK_FILTER_HEADER, key), std::make_pair(filter.GetHash(), header));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadBlockFilter(BlockFilterType filterType, const uint256 &blockHash, BlockFilter &filter) {
+    std::vector<unsigned char> encodedFilter;
+    if (!Read(std::make_pair(DB_BLOCK_FILTER, std::make_pair((uint8_t)filterType, blockHash)), encodedFilter))
+        return false;
+    try {
+        filter = BlockFilter(filterType, blockHash, std::move(encodedFilter));
+    } catch (const std::exception &e) {
+        return error("%s: corrupt filter for block %s: %s", __func__, blockHash.ToString(), e.what());
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadBlockFilterHeader(BlockFilterType filterType, const uint256 &blockHash, uint256 &header, uint256 *filterHash) {
+    std::pair<uint256, uint256> value;
+    if (!Read(std::make_pair(DB_BLOCK_FILTER_HEADER, std::make_pair((uint8_t)filterType, blockHash)), value))
+        return false;
+    if (filterHash)
+        *filterHash = value.first;
+    header = value.second;
+    return true;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -378,6 +752,43 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+void LoadDiskBlockIndex(const CDiskBlockIndex &diskindex, CBlockIndex *pindexNew)
+{
+    pindexNew->nHeight        = diskindex.nHeight;
+    pindexNew->nFile          = diskindex.nFile;
+    pindexNew->nDataPos       = diskindex.nDataPos;
+    pindexNew->nUndoPos       = diskindex.nUndoPos;
+    pindexNew->nVersion       = diskindex.nVersion;
+    pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+    pindexNew->nTime          = diskindex.nTime;
+    pindexNew->nBits          = diskindex.nBits;
+    pindexNew->nNonce         = diskindex.nNonce;
+    pindexNew->nStatus        = diskindex.nStatus;
+    pindexNew->nTx            = diskindex.nTx;
+
+    pindexNew->nNonce64 = diskindex.nNonce64;
+    pindexNew->mix_hash = diskindex.mix_hash;
+
+    pindexNew->sigmaMintedPubCoins   = diskindex.sigmaMintedPubCoins;
+    pindexNew->sigmaSpentSerials     = diskindex.sigmaSpentSerials;
+
+    pindexNew->lelantusMintedPubCoins   = diskindex.lelantusMintedPubCoins;
+    pindexNew->lelantusMintData         = diskindex.lelantusMintData;
+    pindexNew->lelantusSpentSerials     = diskindex.lelantusSpentSerials;
+    pindexNew->anonymitySetHash         = diskindex.anonymitySetHash;
+
+    pindexNew->sparkMintedCoins   = diskindex.sparkMintedCoins;
+    pindexNew->sparkSetHash       = diskindex.sparkSetHash;
+    pindexNew->spentLTags         = diskindex.spentLTags;
+    pindexNew->sparkTxHashContext = diskindex.sparkTxHashContext;
+    pindexNew->ltagTxhash         = diskindex.ltagTxhash;
+
+    pindexNew->activeDisablingSporks = diskindex.activeDisablingSporks;
+
+    pindexNew->addedSparkNames = diskindex.addedSparkNames;
+    pindexNew->removedSparkNames = diskindex.removedSparkNames;
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     const auto &consensusParams = Params().GetConsensus();
@@ -413,39 +824,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
                 // Construct block index object
                 CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                pindexNew->nNonce64 = diskindex.nNonce64;
-                pindexNew->mix_hash = diskindex.mix_hash;
-
-                pindexNew->sigmaMintedPubCoins   = diskindex.sigmaMintedPubCoins;
-                pindexNew->sigmaSpentSerials     = diskindex.sigmaSpentSerials;
-
-                pindexNew->lelantusMintedPubCoins   = diskindex.lelantusMintedPubCoins;
-                pindexNew->lelantusMintData         = diskindex.lelantusMintData;
-                pindexNew->lelantusSpentSerials     = diskindex.lelantusSpentSerials;
-                pindexNew->anonymitySetHash         = diskindex.anonymitySetHash;
-
-                pindexNew->sparkMintedCoins   = diskindex.sparkMintedCoins;
-                pindexNew->sparkSetHash       = diskindex.sparkSetHash;
-                pindexNew->spentLTags         = diskindex.spentLTags;
-                pindexNew->sparkTxHashContext = diskindex.sparkTxHashContext;
-                pindexNew->ltagTxhash         = diskindex.ltagTxhash;
-
-                pindexNew->activeDisablingSporks = diskindex.activeDisablingSporks;
-
-                pindexNew->addedSparkNames = diskindex.addedSparkNames;
-                pindexNew->removedSparkNames = diskindex.removedSparkNames;
+                LoadDiskBlockIndex(diskindex, pindexNew);
 
                 if (fCheckPoWForAllBlocks) {
                     if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
@@ -11,17 +11,25 @@
 #include "chain.h"
 #include "spentindex.h"
 
+#include <condition_variable>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <boost/function.hpp>
 
+class BlockFilter;
 class CBlockIndex;
 class CCoinsViewDBCursor;
 class uint256;
 
+enum class BlockFilterType : uint8_t;
+
 //! Compensate for extra memory peak (x1.5-x1.9) at flush time.
 static constexpr int DB_PEAK_USAGE_FACTOR = 2;
 //! Factor to estimate actual memory usage.
@@ -42,6 +50,10 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Do not write flushed coins to the coin database from a background thread by default
+static const bool DEFAULT_ASYNC_COINS_FLUSH = false;
+//! -coinsflushbatch default (MiB), size of the batches a background coins flush is written in
+static const int64_t DEFAULT_COINS_FLUSH_BATCH = 16;
 
 //! By default don't check block index PoW on client startup
 static const bool DEFAULT_FULL_BLOCKINDEX_CHECK = false;
@@ -82,18 +94,93 @@ protected:
     CDBWrapper db;
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    //! A coin database other than the chainstate, named strName in the database stats
+    CCoinsViewDB(const boost::filesystem::path& path, const std::string& strName, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
+    std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * Write the dirty entries of mapCoins in batches of about nMaxBatchSize bytes. The head
+     * blocks have to be written with WriteHeadBlocks(hashBlock) first, they stay until the last
+     * batch is written, a crash in between is repaired by ReplayBlocks on startup.
+     */
+    bool BatchWriteIncremental(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t nMaxBatchSize);
+    //! Replace the best block with head blocks {hashBlock, previous best block} and sync it to disk
+    bool WriteHeadBlocks(const uint256 &hashBlock);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
 };
 
+/**
+ * Sits in front of the coin database and writes the coins flushed from the tip cache from a
+ * background thread, so that validation goes on with an empty cache while they are written.
+ * Until the write is done the flushed entries are served from an immutable snapshot. Only
+ * one write is in flight at a time, a flush that comes in while one is pending waits for it.
+ *
+ * Only a flush whose new best block descends from the one on disk is written in the
+ * background. Before it is handed off the head blocks are synced to disk, so that whatever
+ * is committed after the flush (EvoDB) is never ahead of what ReplayBlocks can roll the
+ * coins forward to after a crash. The write is split in bounded batches. Anything else (the
+ * first flush, a reorg) has nothing to roll forward from and is written synchronously in
+ * one atomic batch as before.
+ */
+class CCoinsViewFlusher : public CCoinsView
+{
+private:
+    struct PendingWrite {
+        const CCoinsMap coins;
+        const uint256 hashBlock;
+        const size_t nUsage;
+
+        PendingWrite(CCoinsMap &&coinsIn, const uint256 &hashBlockIn, size_t nUsageIn)
+            : coins(std::move(coinsIn)), hashBlock(hashBlockIn), nUsage(nUsageIn) {}
+    };
+
+    CCoinsViewDB *db;
+    const bool fAsync;
+    const size_t nMaxBatchSize;
+
+    //! The write in flight, readers look here first. Null once it reached the database.
+    std::shared_ptr<const PendingWrite> pending;
+
+    mutable std::mutex cs;
+    mutable std::condition_variable cond;
+    bool fWriteQueued;
+    bool fWriteFailed;
+    bool fStop;
+    std::thread threadFlush;
+
+    std::shared_ptr<const PendingWrite> GetPending() const { return std::atomic_load(&pending); }
+    bool Write(const PendingWrite &write);
+    void ThreadFlush();
+
+public:
+    CCoinsViewFlusher(CCoinsViewDB *dbIn, bool fAsyncIn, size_t nMaxBatchSizeIn);
+    ~CCoinsViewFlusher();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    std::vector<uint256> GetHeadBlocks() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    CCoinsViewCursor *Cursor() const override;
+    size_t EstimateSize() const override;
+
+    //! Wait until the pending write, if any, reached the database. Returns false if it failed.
+    bool Sync() const;
+    //! Whether a write is in flight
+    bool IsWritePending() const { return GetPending() != nullptr; }
+    //! Memory held by the write in flight, it counts against the coins cache
+    size_t GetPendingUsage() const;
+};
+
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
@@ -116,6 +203,9 @@ private:
     friend class CCoinsViewDB;
 };
 
+/** Copy the fields the block tree database stores, all but pprev, into a block index entry */
+void LoadDiskBlockIndex(const CDiskBlockIndex &diskindex, CBlockIndex *pindexNew);
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
@@ -124,6 +214,8 @@ public:
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
+
+    void UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase);
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &fileinfo);
@@ -133,19 +225,45 @@ public:
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    /** Look up several spent index entries in one pass, found[i] tells whether keys[i] exists */
+    void ReadSpentIndex(const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values, std::vector<bool> &found);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
+    /** Where a Spark mint is, with the height of the block it was mined in, by the hash of its coin */
+    bool ReadSparkMintOutPoint(const uint256 &coinHash, COutPoint &outPoint, int &nHeight);
+    bool WriteSparkMintOutPoints(const std::vector<std::pair<uint256, std::pair<COutPoint, int> > > &vect);
+    bool EraseSparkMintOutPoints(const std::vector<uint256> &coinHashes);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    /** Pass the unspent outputs of the address of from to visit in order, from the one from points to on, until visit returns false */
+    bool ReadAddressUnspentIndex(const CAddressUnspentKey &from,
+                                 const std::function<bool(const CAddressUnspentKey &, const CAddressUnspentValue &)> &visit);
+    /** Write or erase address index entries, along with the balances of their addresses */
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, AddressType type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    /**
+     * Pass the address index entries of the address of from to visit in order, from the transaction
+     * from points to on, until visit returns false or, if end is positive, the block at height end is passed
+     */
+    bool ReadAddressIndex(const CAddressIndexIteratorTxKey &from, int end,
+                          const std::function<bool(const CAddressIndexKey &, CAmount)> &visit);
+    /** The balance of an address, returns false (and a null balance) if none is stored for it */
+    bool ReadAddressBalance(AddressType type, const uint160 &addressHash, CAddressBalance &balance);
+    /** Whether the address balances match the address index */
+    bool HaveAddressBalances();
+    /** Sum up the balances of all the addresses in the address index, for an index that was built without them */
+    bool BuildAddressBalances();
     size_t findAddressNumWBalance();
 
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    bool WriteBlockFilter(const BlockFilter &filter, const uint256 &header);
+    bool ReadBlockFilter(BlockFilterType filterType, const uint256 &blockHash, BlockFilter &filter);
+    /** Read the filter header of a block and, optionally, the hash of its filter */
+    bool ReadBlockFilterHeader(BlockFilterType filterType, const uint256 &blockHash, uint256 &header, uint256 *filterHash = nullptr);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
@@ -32,6 +32,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
     spendsCoinbase(_spendsCoinbase), sigOpCost(_sigOpsCost), lockPoints(lp)
 {
     nTxWeight = GetTransactionWeight(*tx);
+    privacyData = GetPrivacyTxData(*tx);
     nModSize = tx->CalculateModifiedSize(GetTxSize());
     nUsageSize = RecursiveDynamicUsage(*tx) + memusage::DynamicUsage(tx);
 
@@ -582,16 +583,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     else if (it->GetTx().IsLelantusTransaction()) {
         // Remove mints and spend serials from lelantus mempool state
         const CTransaction &tx = it->GetTx();
-        if (tx.IsLelantusJoinSplit()) {
-            std::vector<Scalar> serials;
-            try {
-                serials = lelantus::GetLelantusJoinSplitSerialNumbers(tx, tx.vin[0]);
-                for (const Scalar &serial: serials)
-                    lelantusState.RemoveSpendFromMempool(serial);
-            }
-            catch (CBadTxIn&) {
-            }
-        }
+        for (const Scalar &serial: it->GetPrivacyData().lelantusSerials)
+            lelantusState.RemoveSpendFromMempool(serial);
 
         BOOST_FOREACH(const CTxOut &txout, tx.vout)
         {
@@ -616,14 +609,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
         // Remove mints and spends from spark mempool state
         const CTransaction &tx = it->GetTx();
         if (tx.IsSparkSpend()) {
-            std::vector<GroupElement> lTags;
-            try {
-                lTags = spark::GetSparkUsedTags(tx);
-                for (const auto& lTag : lTags)
-                    sparkState.RemoveSpendFromMempool(lTag);
-            }
-            catch (CBadTxIn&) {
-            }
+            for (const auto& lTag : it->GetPrivacyData().sparkLTags)
+                sparkState.RemoveSpendFromMempool(lTag);
 
             // remove all the spark name transactions referencing this tx
             for (auto it = sparkNames.begin(); it!=sparkNames.end();) {
@@ -25,6 +25,7 @@
 #include "bls/bls.h"
 #include "lelantus.h"
 #include "spark/state.h"
+#include "privacytx.h"
 
 #include "evo/spork.h"
 
@@ -102,6 +103,7 @@ private:
     int64_t sigOpCost;         //!< Total sigop cost
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
+    std::shared_ptr<const CPrivacyTxData> privacyData; //!< Decoded privacy payload, shared with tx
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -128,6 +130,7 @@ public:
 
     const CTransaction& GetTx() const { return *this->tx; }
     CTransactionRef GetSharedTx() const { return this->tx; }
+    const CPrivacyTxData& GetPrivacyData() const { return *privacyData; }
     /**
      * Fast calculation of lower bound of current priority as update
      * from entry priority. Only inputs that were originally in-chain will age.
@@ -10,12 +10,14 @@
 #endif
 
 #include "arith_uint256.h"
+#include "blockfilter.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "init.h"
 #include "base58.h"
@@ -23,7 +25,9 @@
 #include "net.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
+#include "perfstats.h"
 #include "pow.h"
+#include "privacytx.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "random.h"
@@ -72,6 +76,11 @@
 #include <sstream>
 #include <chrono>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/filesystem.hpp>
@@ -102,6 +111,7 @@ int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
 bool fTxIndex = false;
+bool fBlockFilterIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fAddressIndex = false;
@@ -271,6 +281,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewFlusher *pcoinsflusher = NULL;
 CBlockTreeDB *pblocktree = NULL;
 
 enum FlushStateMode {
@@ -1245,7 +1256,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
                 nFees = nValueIn - nValueOut;
             } else if (tx.IsLelantusJoinSplit()) {
                 try {
-                    nFees = lelantus::ParseLelantusJoinSplit(tx)->getFee();
+                    nFees = GetPrivacyTxFee(tx);
                 }
                 catch (CBadTxIn&) {
                     return state.DoS(0, false, REJECT_INVALID, "unable to parse joinsplit");
@@ -1255,7 +1266,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
                 }
             } else {
                 try {
-                    nFees = spark::ParseSparkSpend(tx).getFee();
+                    nFees = GetPrivacyTxFee(tx);
                 }
                 catch (CBadTxIn&) {
                     return state.DoS(0, false, REJECT_INVALID, "unable to parse joinsplit");
@@ -1699,6 +1710,7 @@ bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const
     std::vector<COutPoint> coins_to_uncache;
     bool res = false;
     try {
+        CPerfTimer perfTimer(PerfStat::MEMPOOL_ACCEPT);
         res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee, coins_to_uncache, isCheckWalletTransaction, markPrivoraSpendTransactionSerial);
     }
     catch (const std::exception &x) {
@@ -1815,6 +1827,39 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return true;
 }
 
+void GetSpentIndex(const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values, std::vector<bool> &found)
+{
+    values.assign(keys.size(), CSpentIndexValue());
+    found.assign(keys.size(), false);
+    if (!fSpentIndex)
+        return;
+
+    // spends in the mempool first, the rest from the block tree db in one pass
+    std::vector<size_t> dbIndexes;
+    std::vector<CSpentIndexKey> dbKeys;
+    for (size_t i = 0; i < keys.size(); i++) {
+        CSpentIndexKey key = keys[i];
+        if (mempool.getSpentIndex(key, values[i])) {
+            found[i] = true;
+        } else {
+            dbIndexes.push_back(i);
+            dbKeys.push_back(key);
+        }
+    }
+    if (dbKeys.empty())
+        return;
+
+    std::vector<CSpentIndexValue> dbValues;
+    std::vector<bool> dbFound;
+    pblocktree->ReadSpentIndex(dbKeys, dbValues, dbFound);
+    for (size_t j = 0; j < dbIndexes.size(); j++) {
+        if (dbFound[j]) {
+            values[dbIndexes[j]] = dbValues[j];
+            found[dbIndexes[j]] = true;
+        }
+    }
+}
+
 bool GetAddressIndex(uint160 addressHash, AddressType type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
 {
@@ -1839,6 +1884,39 @@ bool GetAddressUnspent(uint160 addressHash, AddressType type,
     return true;
 }
 
+bool GetAddressIndex(const CAddressIndexIteratorTxKey &from, int end,
+                     const std::function<bool(const CAddressIndexKey &, CAmount)> &visit)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressIndex(from, end, visit))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspent(const CAddressUnspentKey &from,
+                       const std::function<bool(const CAddressUnspentKey &, const CAddressUnspentValue &)> &visit)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndex(from, visit))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressBalance(uint160 addressHash, AddressType type, CAddressBalance &balance)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    pblocktree->ReadAddressBalance(type, addressHash, balance);
+    return true;
+}
+
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1902,6 +1980,65 @@ bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex, const Consensus
     return true;
 }
 
+// Read n bytes at pos of the block file, with a single pread where available
+static bool ReadBlockFileBytes(const CDiskBlockPos& pos, unsigned char* dest, size_t n)
+{
+#ifndef WIN32
+    int fd = open(GetBlockPosFilename(pos, "blk").string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    size_t nRead = 0;
+    while (nRead < n) {
+        ssize_t ret = pread(fd, dest + nRead, n - nRead, (off_t)pos.nPos + nRead);
+        if (ret <= 0 && !(ret == -1 && errno == EINTR))
+            break;
+        if (ret > 0)
+            nRead += ret;
+    }
+    close(fd);
+    return nRead == n;
+#else
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    try {
+        filein.read((char*)dest, n);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t))
+        return error("%s: invalid block position %s", __func__, pos.ToString());
+
+    // Index header written by WriteBlockToDisk: message start and block size
+    unsigned char indexHeader[CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t)];
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - sizeof(indexHeader));
+    if (!ReadBlockFileBytes(posHeader, indexHeader, sizeof(indexHeader)))
+        return error("%s: failed to read index header at %s", __func__, posHeader.ToString());
+    if (memcmp(indexHeader, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+        return error("%s: block index header mismatch at %s", __func__, pos.ToString());
+
+    uint32_t nSize = ReadLE32(indexHeader + CMessageHeader::MESSAGE_START_SIZE);
+    CDataStream ssHeader(SER_DISK, CLIENT_VERSION);
+    ssHeader << pindex->GetBlockHeader();
+    if (nSize <= ssHeader.size() || nSize > MAX_SIZE)
+        return error("%s: invalid block size %u at %s", __func__, nSize, pos.ToString());
+
+    block.resize(nSize);
+    if (!ReadBlockFileBytes(pos, block.data(), nSize))
+        return error("%s: failed to read block at %s", __func__, pos.ToString());
+
+    if (memcmp(block.data(), &ssHeader[0], ssHeader.size()) != 0)
+        return error("%s: block header doesn't match index for %s at %s", __func__, pindex->ToString(), pos.ToString());
+    return true;
+}
+
 bool ReadBlockHeaderFromDisk(CBlock &block, const CDiskBlockPos &pos) {
     CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
@@ -2162,7 +2299,7 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
             nTxFee = nValueIn - tx.GetValueOut();
         } else {
             try {
-                nTxFee = lelantus::ParseLelantusJoinSplit(tx)->getFee();
+                nTxFee = GetPrivacyTxFee(tx);
             }
             catch (CBadTxIn&) {
                 return state.DoS(0, false, REJECT_INVALID, "unable to parse joinsplit");
@@ -2482,7 +2619,7 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             nFees += sigma::GetSigmaSpendInput(tx) - tx.GetValueOut();
         else if (tx.IsLelantusJoinSplit()) {
             try {
-                nFees += lelantus::ParseLelantusJoinSplit(tx)->getFee();
+                nFees += GetPrivacyTxFee(tx);
             }
             catch (const std::exception &) {
                 // do nothing
@@ -2490,7 +2627,7 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
         }
         else if (tx.IsSparkSpend()) {
             try {
-                nFees = spark::ParseSparkSpend(tx).getFee();
+                nFees = GetPrivacyTxFee(tx);
             }
             catch (const std::exception &) {
                 // do nothing
@@ -2638,6 +2775,17 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/** Store the compact filter of a connected block and its header, chained to the previous block's */
+static bool WriteBlockFilterIndex(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    uint256 prevHeader;
+    if (pindex->pprev && !pblocktree->ReadBlockFilterHeader(BlockFilterType::BASIC, pindex->pprev->GetBlockHash(), prevHeader))
+        return error("%s: missing filter header of block %s, rebuild the index with -reindex-chainstate", __func__, pindex->pprev->GetBlockHash().ToString());
+
+    BlockFilter filter(BlockFilterType::BASIC, block, blockundo);
+    return pblocktree->WriteBlockFilter(filter, filter.ComputeHeader(prevHeader));
+}
+
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
                   CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
 {
@@ -2691,8 +2839,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
             view.SetBestBlock(pindex->GetBlockHash());
+            if (fBlockFilterIndex && !WriteBlockFilterIndex(block, CBlockUndo(), pindex))
+                return AbortNode(state, "Failed to write block filter index");
+        }
         return true;
     }
 
@@ -2723,6 +2874,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
+    RecordPerfStat(PerfStat::CONNECTBLOCK_SANITY, nTime1 - nTimeStart);
     LogPrint("bench", "    - Sanity checks: %.2fms [%.2fs]\n", 0.001 * (nTime1 - nTimeStart), nTimeCheck * 0.000001);
 
     bool fEnforceBIP30 = true;
@@ -2767,6 +2919,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
+    RecordPerfStat(PerfStat::CONNECTBLOCK_FORKS, nTime2 - nTime1);
     LogPrint("bench", "    - Fork checks: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeForks * 0.000001);
 
     CBlockUndo blockundo;
@@ -2846,7 +2999,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
             if(tx.IsLelantusJoinSplit()) {
                 try {
-                    nFees += lelantus::ParseLelantusJoinSplit(tx)->getFee();
+                    nFees += GetPrivacyTxFee(tx);
                 }
                 catch (CBadTxIn&) {
                     return state.DoS(0, false, REJECT_INVALID, "unable to parse joinsplit");
@@ -2858,7 +3011,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
             if(tx.IsSparkSpend()) {
                 try {
-                    nFees += spark::ParseSparkSpend(tx).getFee();
+                    nFees += GetPrivacyTxFee(tx);
                 }
                 catch (CBadTxIn&) {
                     return state.DoS(0, false, REJECT_INVALID, "unable to parse spark spend");
@@ -2919,11 +3072,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     block.sparkTxInfo->Complete();
 
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
+    RecordPerfStat(PerfStat::CONNECTBLOCK_CONNECT_TXS, nTime3 - nTime2);
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
 
     if (!control.Wait())
         return state.DoS(100, false);
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
+    RecordPerfStat(PerfStat::CONNECTBLOCK_VERIFY, nTime4 - nTime2);
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime4 - nTime2), nInputs <= 1 ? 0 : 0.001 * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * 0.000001);
 
     //btzc: Add time to check
@@ -3053,6 +3208,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
             return AbortNode(state, "Failed to write timestamp index");
 
+    if (fBlockFilterIndex && !WriteBlockFilterIndex(block, blockundo, pindex))
+        return AbortNode(state, "Failed to write block filter index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -3060,6 +3218,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     batchProofContainer->finalize();
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
+    RecordPerfStat(PerfStat::CONNECTBLOCK_INDEX, nTime5 - nTime4);
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeIndex * 0.000001);
 
     // Watch for changes to the previous coinbase transaction.
@@ -3070,6 +3229,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     evoDb->WriteBestBlock(pindex->GetBlockHash());
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
+    RecordPerfStat(PerfStat::CONNECTBLOCK_CALLBACKS, nTime6 - nTime5);
     LogPrint("bench", "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime6 - nTime5), nTimeCallbacks * 0.000001);
 
     return true;
@@ -3239,6 +3399,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
     }
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
+    // coins still being written in the background are in memory too
+    if (pcoinsflusher)
+        cacheSize += pcoinsflusher->GetPendingUsage();
     cacheSize += evoDb->GetMemoryUsage() * EVO_DB_USAGE_FACTOR * DB_PEAK_USAGE_FACTOR;
     int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
     // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
@@ -3293,6 +3456,12 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
         // Flush the chainstate (which may refer to block index entries).
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
+        // The coins are written in the background, wait for them when the caller relies on
+        // the database itself being up to date or block files are about to be deleted.
+        if (pcoinsflusher && (mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && !pcoinsflusher->Sync())
+            return AbortNode(state, "Failed to write to coin database");
+        // The coins are on disk or, if they are still being written, their head blocks are, so
+        // that ReplayBlocks brings them up to the block EvoDB is committed at after a crash.
         if (!evoDb->CommitRootTransaction()) {
             return AbortNode(state, "Failed to commit EvoDB");
         }
@@ -3684,6 +3853,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     }
 #endif
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
+    RecordPerfStat(PerfStat::CONNECTTIP_TOTAL, nTime6 - nTime1);
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
     return true;
@@ -5077,6 +5247,68 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
     return pindexNew;
 }
 
+CBlockIndex* AddSnapshotBlockIndex(const CDiskBlockIndex& diskindex)
+{
+    AssertLockHeld(cs_main);
+
+    CBlockIndex* pindex = InsertBlockIndex(diskindex.GetBlockHash());
+    // keep what we have the data of (the genesis block) as it is
+    if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+        bool fKnownHeader = pindex->pprev != NULL;
+        LoadDiskBlockIndex(diskindex, pindex);
+        pindex->pprev = InsertBlockIndex(diskindex.hashPrev);
+        pindex->nStatus &= ~(BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO);
+        pindex->nFile = 0;
+        pindex->nDataPos = 0;
+        pindex->nUndoPos = 0;
+        if (pindex->pprev && !fKnownHeader)
+            mapPrevBlockIndex.emplace(pindex->pprev->GetBlockHash(), pindex);
+    }
+
+    pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+    pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
+    pindex->nChainTx = (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
+    if (pindex->pprev)
+        pindex->BuildSkip();
+    setDirtyBlockIndex.insert(pindex);
+    return pindex;
+}
+
+bool ActivateSnapshotChainTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexBase)
+{
+    AssertLockHeld(cs_main);
+    assert(pcoinsTip->GetBestBlock() == pindexBase->GetBlockHash());
+
+    const CBlockIndex* pindexOldTip = chainActive.Tip();
+    chainActive.SetTip(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    PruneBlockIndexCandidates();
+    if (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindexBase))
+        pindexBestHeader = pindexBase;
+    evoDb->WriteBestBlock(pindexBase->GetBlockHash());
+
+    // the privacy states are built from the block index, which now has the snapshot's blocks
+    mempool.clear();
+    sigma::CSigmaState::GetState()->Reset();
+    lelantus::CLelantusState::GetState()->Reset();
+    spark::CSparkState::GetState()->Reset();
+    CSparkNameManager::GetInstance()->Reset();
+    sigma::BuildSigmaStateFromIndex(&chainActive);
+    lelantus::BuildLelantusStateFromIndex(&chainActive);
+    spark::BuildSparkStateFromIndex(&chainActive);
+
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
+        return false;
+
+    LogPrintf("%s: hashBestChain=%s height=%d date=%s\n", __func__,
+        pindexBase->GetBlockHash().ToString(), pindexBase->nHeight,
+        DateTimeStrFormat("%Y-%m-%d %H:%M:%S", pindexBase->GetBlockTime()));
+
+    GetMainSignals().UpdatedBlockTip(pindexBase, pindexOldTip, IsInitialBlockDownload());
+    uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindexBase);
+    return true;
+}
+
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
     LogPrintf("LoadBlockIndexDB\n");
@@ -5181,6 +5413,13 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+    // An address index from before the address balances were kept has them summed up once
+    if (fAddressIndex && !pblocktree->HaveAddressBalances()) {
+        LogPrintf("%s: building address balances...\n", __func__);
+        if (!pblocktree->BuildAddressBalances())
+            return error("%s: failed to build address balances", __func__);
+    }
+
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
@@ -5189,6 +5428,14 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("spentindex", fSpentIndex);
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
 
+    // Check whether we have a block filter index
+    pblocktree->ReadFlag("blockfilterindex", fBlockFilterIndex);
+    LogPrintf("%s: block filter index %s\n", __func__, fBlockFilterIndex ? "enabled" : "disabled");
+
+
+    // Finish a background coins flush that was interrupted part way
+    if (!ReplayBlocks(chainparams, pcoinsTip))
+        return false;
 
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
@@ -5210,6 +5457,73 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     return true;
 }
 
+/** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
+static bool RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, params.GetConsensus())) {
+        return error("ReplayBlock(): ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+    }
+
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsCoinBase() && !tx->HasNoRegularInputs()) {
+            for (const CTxIn &txin : tx->vin) {
+                inputs.SpendCoin(txin.prevout);
+            }
+        }
+        // Pass check = true as every addition may be an overwrite.
+        AddCoins(inputs, *tx, pindex->nHeight, true);
+    }
+    return true;
+}
+
+bool ReplayBlocks(const CChainParams& params, CCoinsView* view)
+{
+    LOCK(cs_main);
+
+    CCoinsViewCache cache(view);
+
+    std::vector<uint256> hashHeads = view->GetHeadBlocks();
+    if (hashHeads.empty()) return true; // We're already in a consistent state.
+    if (hashHeads.size() != 2) return error("ReplayBlocks(): unknown inconsistent state");
+
+    uiInterface.ShowProgress(_("Replaying blocks..."), 0);
+    LogPrintf("Replaying blocks\n");
+
+    const CBlockIndex* pindexOld = nullptr;  // Old tip during the interrupted flush.
+    const CBlockIndex* pindexNew;            // New tip during the interrupted flush.
+
+    if (mapBlockIndex.count(hashHeads[0]) == 0) {
+        return error("ReplayBlocks(): reorganization to unknown block requested");
+    }
+    pindexNew = mapBlockIndex[hashHeads[0]];
+
+    if (!hashHeads[1].IsNull()) { // The old tip is allowed to be 0, indicating it's the first flush.
+        if (mapBlockIndex.count(hashHeads[1]) == 0) {
+            return error("ReplayBlocks(): reorganization from unknown block requested");
+        }
+        pindexOld = mapBlockIndex[hashHeads[1]];
+        // Only forward flushes are written incrementally, there is nothing to roll back.
+        if (pindexNew->GetAncestor(pindexOld->nHeight) != pindexOld) {
+            return error("ReplayBlocks(): %s is not an ancestor of %s", hashHeads[1].ToString(), hashHeads[0].ToString());
+        }
+    }
+
+    // Roll forward from the old tip to the new tip.
+    int nStartHeight = pindexOld ? pindexOld->nHeight + 1 : 1;
+    for (int nHeight = nStartHeight; nHeight <= pindexNew->nHeight; ++nHeight) {
+        const CBlockIndex* pindex = pindexNew->GetAncestor(nHeight);
+        LogPrintf("Rolling forward %s (%i)\n", pindex->GetBlockHash().ToString(), nHeight);
+        uiInterface.ShowProgress(_("Replaying blocks..."), (int)((nHeight - nStartHeight + 1) * 100.0 / (pindexNew->nHeight - nStartHeight + 1)));
+        if (!RollforwardBlock(pindex, cache, params)) return false;
+    }
+
+    cache.SetBestBlock(pindexNew->GetBlockHash());
+    cache.Flush();
+    uiInterface.ShowProgress("", 100);
+    return true;
+}
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -5255,9 +5569,9 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // If pruning or started from a state snapshot, only go back as far as we have data.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (no data)\n", pindex->nHeight);
             break;
         }
         CBlock block;
@@ -5460,10 +5774,16 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    if (fAddressIndex && !pblocktree->BuildAddressBalances())
+        return error("%s: failed to build address balances", __func__);
 
     fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
     pblocktree->WriteFlag("spentindex", fSpentIndex);
 
+    // Use the provided setting for -blockfilterindex in the new database
+    fBlockFilterIndex = GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    pblocktree->WriteFlag("blockfilterindex", fBlockFilterIndex);
+
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
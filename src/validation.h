@@ -24,6 +24,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
 #include <set>
 #include <stdint.h>
@@ -39,6 +40,8 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewFlusher;
+class CDiskBlockIndex;
 class CBloomFilter;
 class CChainParams;
 class CInv;
@@ -145,6 +148,7 @@ static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
 static const bool DEFAULT_TOR_SETUP = false;
 static const bool DEFAULT_ZAP_WALLET = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
@@ -161,6 +165,7 @@ static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
 static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
 
 // Block Height Lyra2Z
 #define LYRA2Z_HEIGHT 20500
@@ -196,6 +201,10 @@ extern std::atomic_bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fTimestampIndex;
+extern bool fBlockFilterIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -294,6 +303,12 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
 bool InitBlockIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex(const CChainParams& chainparams);
+/** Replay blocks that aren't fully applied to the database because a background coins flush was interrupted. */
+bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
+/** Add a block of a state snapshot to the block index, without its data. Returns the entry. */
+CBlockIndex* AddSnapshotBlockIndex(const CDiskBlockIndex& diskindex);
+/** Make the base block of a loaded state snapshot the chain tip, its coins must be in pcoinsTip already. */
+bool ActivateSnapshotChainTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexBase);
 /** Unload database information */
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
@@ -527,16 +542,30 @@ public:
 
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+/** Spent index entries of several outputs, found[i] tells whether keys[i] is spent */
+void GetSpentIndex(const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values, std::vector<bool> &found);
 bool GetAddressIndex(uint160 addressHash, AddressType type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, AddressType type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Visit address index entries or unspent outputs of an address in order, see CBlockTreeDB */
+bool GetAddressIndex(const CAddressIndexIteratorTxKey &from, int end,
+                     const std::function<bool(const CAddressIndexKey &, CAmount)> &visit);
+bool GetAddressUnspent(const CAddressUnspentKey &from,
+                       const std::function<bool(const CAddressUnspentKey &, const CAddressUnspentValue &)> &visit);
+bool GetAddressBalance(uint160 addressHash, AddressType type, CAddressBalance &balance);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/**
+ * Read the block of pindex as it is serialized in the block file, without decoding it.
+ * The stored length and message start are checked and the header is compared with the
+ * one in the index, which avoids recomputing the ProgPoW hash.
+ */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -609,6 +638,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the layer writing flushed coins to the coin database */
+extern CCoinsViewFlusher *pcoinsflusher;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -3589,6 +3589,68 @@ UniValue getsparkaddressbalance(const JSONRPCRequest& request) {
     return results;
 }
 
+UniValue getsparkconsolidationinfo(const JSONRPCRequest& request) {
+    CWallet *const pwallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() > 0) {
+        throw std::runtime_error(
+                "getsparkconsolidationinfo\n"
+                "Returns the settings and the activity of the background consolidation of Spark coins.\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"enabled\": true|false,       (boolean) whether -sparkconsolidate is set\n"
+                "  \"mincoins\": n,               (numeric) coins the wallet may keep before it consolidates\n"
+                "  \"maxinputs\": n,              (numeric) coins merged per transaction at most\n"
+                "  \"interval\": n,               (numeric) seconds the wallet has to be idle before a consolidation\n"
+                "  \"maxfee\": x.xxx,             (numeric) fees consolidation may spend in 24 hours\n"
+                "  \"coins\": n,                  (numeric) spendable Spark coins now\n"
+                "  \"status\": \"...\",           (string) what the last check did or waits for\n"
+                "  \"lastcheck\": ttt,            (numeric) time of the last check\n"
+                "  \"transactions\": n,           (numeric) consolidation transactions sent since startup\n"
+                "  \"coinsmerged\": n,            (numeric) coins merged since startup\n"
+                "  \"fees\": x.xxx,               (numeric) fees paid since startup\n"
+                "  \"recentfees\": x.xxx,         (numeric) fees paid in the last 24 hours\n"
+                "  \"lasttxid\": \"hash\",         (string, optional) the last consolidation transaction\n"
+                "  \"lasttxtime\": ttt,           (numeric, optional) time of the last consolidation transaction\n"
+                "  \"lasterror\": \"...\"         (string, optional) why the last failed consolidation failed\n"
+                "}\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getsparkconsolidationinfo", "")
+                + HelpExampleRpc("getsparkconsolidationinfo", ""));
+    }
+
+    EnsureSparkWalletIsAvailable();
+    assert(pwallet != NULL);
+
+    const CSparkConsolidationConfig& config = pwallet->sparkWallet->GetConsolidationConfig();
+    CSparkConsolidationStats stats = pwallet->sparkWallet->GetConsolidationStats();
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("enabled", config.fEnabled));
+    result.push_back(Pair("mincoins", (int64_t)config.nMinCoins));
+    result.push_back(Pair("maxinputs", (int64_t)config.nMaxInputs));
+    result.push_back(Pair("interval", config.nInterval));
+    result.push_back(Pair("maxfee", ValueFromAmount(config.nMaxFeePerDay)));
+    result.push_back(Pair("coins", (int64_t)pwallet->sparkWallet->GetAvailableSparkCoins().size()));
+    result.push_back(Pair("status", stats.strStatus));
+    result.push_back(Pair("lastcheck", stats.nLastCheckTime));
+    result.push_back(Pair("transactions", (int64_t)stats.nTransactions));
+    result.push_back(Pair("coinsmerged", (int64_t)stats.nCoinsMerged));
+    result.push_back(Pair("fees", ValueFromAmount(stats.nFeesPaid)));
+    result.push_back(Pair("recentfees", ValueFromAmount(stats.nRecentFees)));
+    if (!stats.lastTxHash.IsNull()) {
+        result.push_back(Pair("lasttxid", stats.lastTxHash.GetHex()));
+        result.push_back(Pair("lasttxtime", stats.nLastTxTime));
+    }
+    if (!stats.strLastError.empty())
+        result.push_back(Pair("lasterror", stats.strLastError));
+
+    return result;
+}
+
 UniValue resetsparkmints(const JSONRPCRequest& request) {
     CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
     if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
@@ -3949,6 +4011,162 @@ UniValue spendspark(const JSONRPCRequest& request)
 
     return wtx.GetHash().GetHex();
 }
+static std::string SparkPayoutStatusString(uint8_t status)
+{
+    switch (status) {
+        case SPARK_PAYOUT_QUEUED: return "queued";
+        case SPARK_PAYOUT_SENDING: return "sending";
+        case SPARK_PAYOUT_SENT: return "sent";
+        case SPARK_PAYOUT_FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+static UniValue SparkPayoutToJSON(const CSparkPayout& payout)
+{
+    UniValue entry(UniValue::VOBJ);
+    entry.push_back(Pair("id", payout.id.GetHex()));
+    entry.push_back(Pair("address", payout.address));
+    entry.push_back(Pair("amount", ValueFromAmount(payout.amount)));
+    entry.push_back(Pair("subtractfee", payout.subtractFee));
+    if (!payout.memo.empty())
+        entry.push_back(Pair("memo", payout.memo));
+    entry.push_back(Pair("time", payout.nTime));
+    entry.push_back(Pair("status", SparkPayoutStatusString(payout.status)));
+    if (!payout.txid.IsNull()) {
+        entry.push_back(Pair("txid", payout.txid.GetHex()));
+        entry.push_back(Pair("fee", ValueFromAmount(payout.fee)));
+    }
+    if (!payout.error.empty())
+        entry.push_back(Pair("error", payout.error));
+    return entry;
+}
+
+UniValue queuesparkwithdrawal(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 4)
+        throw std::runtime_error(
+                "queuesparkwithdrawal \"address\" amount ( subtractfee \"memo\" )\n"
+                "\nQueue a payout from the Spark wallet. Queued payouts are collected for -sparkwithdrawalwindow seconds\n"
+                "and sent together, as many per transaction as the consensus limits allow.\n"
+                + HelpRequiringPassphrase(pwallet) + "\n"
+                "\nArguments:\n"
+                "1. \"address\"      (string, required) The Spark or transparent address, or @name for a Spark name\n"
+                "2. amount         (numeric or string, required) The amount in " + CURRENCY_UNIT + " to send\n"
+                "3. subtractfee    (boolean, optional, default=false) Deduct a share of the fee from the amount\n"
+                "4. \"memo\"         (string, optional) A memo, only for Spark addresses\n"
+                "\nResult:\n"
+                "\"id\"              (string) The id of the payout, see getsparkwithdrawal\n"
+                "\nExamples:\n"
+                + HelpExampleCli("queuesparkwithdrawal", "\"TR1FW48J6ozpRu25U8giSDdTrdXXUYau7U\" 0.1")
+                + HelpExampleCli("queuesparkwithdrawal", "\"TR1FW48J6ozpRu25U8giSDdTrdXXUYau7U\" 0.1 true")
+                + HelpExampleRpc("queuesparkwithdrawal", "\"TR1FW48J6ozpRu25U8giSDdTrdXXUYau7U\", 0.1"));
+
+    EnsureSparkWalletIsAvailable();
+
+    if (!spark::IsSparkAllowed()) {
+        throw JSONRPCError(RPC_WALLET_ERROR, "Spark is not activated yet");
+    }
+
+    std::string address = request.params[0].get_str();
+    if (!address.empty() && address[0] == '@') {
+        LOCK(cs_main);
+        CSparkNameManager *sparkNameManager = CSparkNameManager::GetInstance();
+        if (!sparkNameManager->GetSparkAddress(address.substr(1), address))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, std::string("Spark name not found: ") + request.params[0].get_str());
+    }
+
+    CAmount amount = AmountFromValue(request.params[1]);
+    bool subtractFee = request.params.size() > 2 && request.params[2].get_bool();
+    std::string memo = request.params.size() > 3 ? request.params[3].get_str() : "";
+
+    uint256 id;
+    try {
+        id = pwallet->sparkWallet->GetWithdrawalQueue().Add(address, amount, subtractFee, memo);
+    } catch (const std::invalid_argument& e) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, e.what());
+    } catch (const std::exception& e) {
+        throw JSONRPCError(RPC_WALLET_ERROR, e.what());
+    }
+
+    return id.GetHex();
+}
+
+UniValue getsparkwithdrawal(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+                "getsparkwithdrawal \"id\"\n"
+                "\nReturns the status of a payout queued with queuesparkwithdrawal.\n"
+                "\nArguments:\n"
+                "1. \"id\"           (string, required) The id of the payout\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"id\": \"id\",              (string) The id of the payout\n"
+                "  \"address\": \"address\",    (string) The address paid to\n"
+                "  \"amount\": x.xxx,         (numeric) The amount in " + CURRENCY_UNIT + "\n"
+                "  \"subtractfee\": true|false, (boolean) Whether a share of the fee is deducted from the amount\n"
+                "  \"memo\": \"memo\",          (string, optional) The memo\n"
+                "  \"time\": ttt,             (numeric) The time the payout was queued\n"
+                "  \"status\": \"status\",      (string) \"queued\", \"sending\", \"sent\" or \"failed\"\n"
+                "  \"txid\": \"txid\",          (string, optional) The transaction the payout is sent in\n"
+                "  \"fee\": x.xxx,            (numeric, optional) The share of the fee deducted from the amount\n"
+                "  \"error\": \"error\"         (string, optional) Why the payout failed, or why it is still queued\n"
+                "}\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getsparkwithdrawal", "\"id\"")
+                + HelpExampleRpc("getsparkwithdrawal", "\"id\""));
+
+    EnsureSparkWalletIsAvailable();
+
+    CSparkPayout payout;
+    if (!pwallet->sparkWallet->GetWithdrawalQueue().Get(ParseHashV(request.params[0], "id"), payout))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown payout id");
+
+    return SparkPayoutToJSON(payout);
+}
+
+UniValue listsparkwithdrawals(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+                "listsparkwithdrawals ( \"status\" )\n"
+                "\nLists the payouts queued with queuesparkwithdrawal, oldest first. Sent and failed payouts are kept for a week.\n"
+                "\nArguments:\n"
+                "1. \"status\"       (string, optional) Only list payouts with this status: \"queued\", \"sending\", \"sent\" or \"failed\"\n"
+                "\nResult:\n"
+                "[ payout, ... ]   (array) Objects as returned by getsparkwithdrawal\n"
+                "\nExamples:\n"
+                + HelpExampleCli("listsparkwithdrawals", "\"queued\"")
+                + HelpExampleRpc("listsparkwithdrawals", "\"queued\""));
+
+    EnsureSparkWalletIsAvailable();
+
+    std::string status = request.params.size() > 0 ? request.params[0].get_str() : "";
+
+    UniValue result(UniValue::VARR);
+    for (const CSparkPayout& payout : pwallet->sparkWallet->GetWithdrawalQueue().List()) {
+        if (status.empty() || SparkPayoutStatusString(payout.status) == status)
+            result.push_back(SparkPayoutToJSON(payout));
+    }
+    return result;
+}
+
 UniValue getsparknames(const JSONRPCRequest &request)
 {
     if (request.fHelp || request.params.size() > 1) {
@@ -5948,11 +6166,15 @@ static const CRPCCommand commands[] =
     { "wallet",             "getnewsparkaddress",     &getnewsparkaddress,     false },
     { "wallet",             "getsparkbalance",        &getsparkbalance,        false },
     { "wallet",             "getsparkaddressbalance", &getsparkaddressbalance, false },
+    { "wallet",             "getsparkconsolidationinfo", &getsparkconsolidationinfo, true, {} },
     { "wallet",             "resetsparkmints",        &resetsparkmints,        false },
     { "wallet",             "setsparkmintstatus",     &setsparkmintstatus,     false },
     { "wallet",             "mintspark",              &mintspark,              true },
     { "wallet",             "automintspark",          &automintspark,          false },
     { "wallet",             "spendspark",             &spendspark,             false },
+    { "wallet",             "queuesparkwithdrawal",   &queuesparkwithdrawal,   false, {"address", "amount", "subtractfee", "memo"} },
+    { "wallet",             "getsparkwithdrawal",     &getsparkwithdrawal,     true,  {"id"} },
+    { "wallet",             "listsparkwithdrawals",   &listsparkwithdrawals,   true,  {"status"} },
     { "wallet",             "lelantustospark",        &lelantustospark,        false },
     { "wallet",             "identifysparkcoins",     &identifysparkcoins,     false },
     { "wallet",             "getsparkcoinaddr",       &getsparkcoinaddr,       false },
@@ -234,6 +234,181 @@ BOOST_AUTO_TEST_CASE(spend)
     sparkState->Reset();
 }
 
+BOOST_AUTO_TEST_CASE(consolidate)
+{
+    pwalletMain->SetBroadcastTransactions(true);
+    GenerateBlocks(1001);
+
+    spark::MintedCoinData data;
+    data.address = pwalletMain->sparkWallet->getDefaultAddress();
+    data.v = 1 * COIN;
+    data.memo = "";
+    std::vector<spark::MintedCoinData> mintedCoins(5, data);
+
+    std::vector<std::pair<CWalletTx, CAmount>> wtxAndFee;
+    BOOST_CHECK_EQUAL("", pwalletMain->MintAndStoreSpark(mintedCoins, wtxAndFee, false, true));
+
+    std::vector<CMutableTransaction> mints;
+    for (const auto& w : wtxAndFee)
+        mints.emplace_back(*w.first.tx);
+    GenerateBlock(mints, &script);
+    GenerateBlocks(5);
+
+    std::list<CSparkMintMeta> coins = pwalletMain->sparkWallet->GetAvailableSparkCoins();
+    BOOST_CHECK_EQUAL(5, coins.size());
+
+    // a locked coin is left alone
+    COutPoint lockedOutPoint;
+    BOOST_CHECK(pwalletMain->sparkWallet->getMintOutPoint(coins.front(), lockedOutPoint));
+    {
+        LOCK(pwalletMain->cs_wallet);
+        pwalletMain->LockCoin(lockedOutPoint);
+    }
+
+    CSparkConsolidationConfig config;
+    config.fEnabled = true;
+    config.nMinCoins = 2;
+    config.nMaxInputs = 10;
+    config.nInterval = 0;
+    config.nMaxFeePerDay = COIN;
+
+    // four coins are not locked, merging three of them leaves two
+    BOOST_CHECK(pwalletMain->sparkWallet->ConsolidateCoins(config));
+    CSparkConsolidationStats stats = pwalletMain->sparkWallet->GetConsolidationStats();
+    BOOST_CHECK_EQUAL(1, stats.nTransactions);
+    BOOST_CHECK_EQUAL(3, stats.nCoinsMerged);
+    BOOST_CHECK(stats.nFeesPaid > 0);
+    BOOST_CHECK_EQUAL(stats.nFeesPaid, stats.nRecentFees);
+    BOOST_CHECK(::mempool.exists(stats.lastTxHash));
+
+    CTransactionRef tx = ::mempool.get(stats.lastTxHash);
+    std::vector<spark::Coin> outputs;
+    std::vector<GroupElement> tags;
+    ExtractSpend(*tx, outputs, tags);
+    BOOST_CHECK_EQUAL(1, outputs.size());
+    BOOST_CHECK_EQUAL(3, tags.size());
+
+    GenerateBlock({CMutableTransaction(*tx)});
+    GenerateBlocks(5);
+    BOOST_CHECK_EQUAL(2, pwalletMain->sparkWallet->GetAvailableSparkCoins().size());
+    {
+        LOCK(pwalletMain->cs_wallet);
+        pwalletMain->UnlockCoin(lockedOutPoint);
+    }
+    BOOST_CHECK_EQUAL(3, pwalletMain->sparkWallet->GetAvailableSparkCoins().size());
+    BOOST_CHECK_EQUAL(5 * COIN - stats.nFeesPaid, pwalletMain->sparkWallet->getAvailableBalance());
+
+    // nothing more is spent once the fee budget is used up
+    config.nMaxFeePerDay = stats.nFeesPaid;
+    BOOST_CHECK(!pwalletMain->sparkWallet->ConsolidateCoins(config));
+    BOOST_CHECK_EQUAL(1, pwalletMain->sparkWallet->GetConsolidationStats().nTransactions);
+
+    // a transaction the memory pool rejects is neither counted nor charged to the budget
+    config.nMaxFeePerDay = COIN;
+    CAmount maxTxFeeBackup = maxTxFee;
+    maxTxFee = 1;
+    BOOST_CHECK(!pwalletMain->sparkWallet->ConsolidateCoins(config));
+    maxTxFee = maxTxFeeBackup;
+    stats = pwalletMain->sparkWallet->GetConsolidationStats();
+    BOOST_CHECK_EQUAL(1, stats.nTransactions);
+    BOOST_CHECK_EQUAL(stats.nFeesPaid, stats.nRecentFees);
+    BOOST_CHECK_EQUAL("failed", stats.strStatus);
+    BOOST_CHECK(!stats.strLastError.empty());
+
+    auto sparkState = spark::CSparkState::GetState();
+    sparkState->Reset();
+}
+
+BOOST_AUTO_TEST_CASE(withdrawal_queue)
+{
+    pwalletMain->SetBroadcastTransactions(true);
+    GenerateBlocks(1001);
+
+    spark::MintedCoinData data;
+    data.address = pwalletMain->sparkWallet->getDefaultAddress();
+    data.v = 10 * COIN;
+    data.memo = "";
+
+    std::vector<std::pair<CWalletTx, CAmount>> wtxAndFee;
+    BOOST_CHECK_EQUAL("", pwalletMain->MintAndStoreSpark({data, data}, wtxAndFee, false, true));
+    std::vector<CMutableTransaction> mints;
+    for (const auto& w : wtxAndFee)
+        mints.emplace_back(*w.first.tx);
+    GenerateBlock(mints, &script);
+    GenerateBlocks(5);
+
+    CSparkWithdrawalQueue& queue = pwalletMain->sparkWallet->GetWithdrawalQueue();
+    BOOST_CHECK_THROW(queue.Add("invalid", COIN, false, ""), std::invalid_argument);
+    BOOST_CHECK_THROW(queue.Add(CPrivoraAddress(CKeyID(uint160())).ToString(), 0, false, ""), std::invalid_argument);
+
+    std::vector<uint256> ids;
+    std::vector<CScript> scripts;
+    for (int i = 0; i < 5; i++) {
+        CPubKey key;
+        {
+            LOCK(pwalletMain->cs_wallet);
+            key = pwalletMain->GenerateNewKey();
+        }
+        scripts.push_back(GetScriptForDestination(key.GetID()));
+        ids.push_back(queue.Add(CPrivoraAddress(key.GetID()).ToString(), (i + 1) * COIN / 10, i == 0, ""));
+    }
+    spark::Address sparkAddress = pwalletMain->sparkWallet->generateNewAddress();
+    ids.push_back(queue.Add(sparkAddress.encode(spark::GetNetworkType()), COIN, false, "payout"));
+
+    // nothing is sent before the window is over
+    queue.Process();
+    CSparkPayout payout;
+    BOOST_CHECK(queue.Get(ids[0], payout));
+    BOOST_CHECK_EQUAL(SPARK_PAYOUT_QUEUED, payout.status);
+
+    queue.Process(true);
+    BOOST_CHECK(queue.Get(ids[0], payout));
+    BOOST_CHECK_EQUAL(SPARK_PAYOUT_SENT, payout.status);
+    BOOST_CHECK(payout.fee > 0);
+    uint256 txid = payout.txid;
+    BOOST_CHECK(::mempool.exists(txid));
+
+    // all the payouts are in one transaction, only the first one pays the fee
+    for (size_t i = 1; i < ids.size(); i++) {
+        BOOST_CHECK(queue.Get(ids[i], payout));
+        BOOST_CHECK_EQUAL(SPARK_PAYOUT_SENT, payout.status);
+        BOOST_CHECK(payout.txid == txid);
+        BOOST_CHECK_EQUAL(0, payout.fee);
+    }
+    BOOST_CHECK_EQUAL(ids.size(), queue.List().size());
+
+    CTransactionRef tx = ::mempool.get(txid);
+    for (size_t i = 0; i < scripts.size(); i++) {
+        BOOST_CHECK(std::any_of(tx->vout.begin(), tx->vout.end(), [&](const CTxOut& out) {
+            return out.scriptPubKey == scripts[i] && (i == 0 || out.nValue == CAmount(i + 1) * COIN / 10);
+        }));
+    }
+    std::vector<spark::Coin> outputs;
+    std::vector<GroupElement> tags;
+    ExtractSpend(*tx, outputs, tags);
+    // the Spark payout and the change
+    BOOST_CHECK_EQUAL(2, outputs.size());
+
+    GenerateBlock({CMutableTransaction(*tx)});
+    GenerateBlocks(5);
+
+    // a batch the memory pool rejects is not reported as sent and gives its coins back
+    CAmount nBalance = pwalletMain->sparkWallet->getAvailableBalance();
+    uint256 id = queue.Add(CPrivoraAddress(CKeyID(uint160())).ToString(), COIN, false, "");
+    CAmount maxTxFeeBackup = maxTxFee;
+    maxTxFee = 1;
+    queue.Process(true);
+    maxTxFee = maxTxFeeBackup;
+    BOOST_CHECK(queue.Get(id, payout));
+    BOOST_CHECK_EQUAL(SPARK_PAYOUT_FAILED, payout.status);
+    BOOST_CHECK(!payout.error.empty());
+    BOOST_CHECK(payout.txid.IsNull());
+    BOOST_CHECK_EQUAL(nBalance, pwalletMain->sparkWallet->getAvailableBalance());
+
+    auto sparkState = spark::CSparkState::GetState();
+    sparkState->Reset();
+}
+
 BOOST_AUTO_TEST_CASE(mintspark_and_mint_all)
 {
     auto countMintsInBalance = [&](
@@ -497,4 +497,69 @@ BOOST_FIXTURE_TEST_CASE(importwallet_rescan, TestChain100Setup)
     ::pwalletMain = pwalletMainBackup;
 }
 
+BOOST_FIXTURE_TEST_CASE(cached_balance, TestChain100Setup)
+{
+    // one more block makes the first coinbase mature
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+
+    LOCK(cs_main);
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    wallet.ScanForWalletTransactions(chainActive.Genesis());
+
+    CAmount nBalance = wallet.GetBalance();
+    BOOST_CHECK(nBalance > 0);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(true), nBalance);
+    BOOST_CHECK(wallet.GetImmatureBalance() > 0);
+
+    // locking a coin is seen by the cached balances
+    const CTransaction& coinbase = coinbaseTxns[0];
+    unsigned int n = 0;
+    while (n < coinbase.vout.size() && wallet.IsMine(coinbase.vout[n]) != ISMINE_SPENDABLE)
+        n++;
+    BOOST_REQUIRE(n < coinbase.vout.size());
+
+    wallet.LockCoin(COutPoint(coinbase.GetHash(), n));
+    BOOST_CHECK_EQUAL(wallet.GetBalance(true), nBalance - coinbase.vout[n].nValue);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), nBalance);
+    wallet.UnlockCoin(COutPoint(coinbase.GetHash(), n));
+    BOOST_CHECK_EQUAL(wallet.GetBalance(true), nBalance);
+}
+
+BOOST_AUTO_TEST_CASE(mint_balance_tally)
+{
+    CMintBalanceTally tally;
+    tally.Add(0, 1 * COIN);
+    tally.Add(100, 2 * COIN);
+    tally.Add(101, 4 * COIN);
+    tally.Add(101, 8 * COIN);
+
+    // with two confirmations needed only the mint at height 100 is confirmed at height 101
+    std::pair<CAmount, CAmount> balance = {0, 0};
+    size_t confirmed = 0, unconfirmed = 0;
+    tally.Get(101, 2, balance, confirmed, unconfirmed);
+    BOOST_CHECK_EQUAL(balance.first, 2 * COIN);
+    BOOST_CHECK_EQUAL(balance.second, 13 * COIN);
+    BOOST_CHECK_EQUAL(confirmed, 1U);
+    BOOST_CHECK_EQUAL(unconfirmed, 3U);
+
+    // one block later the mint left at height 101 is confirmed too, the unmined one never is
+    tally.Remove(101, 4 * COIN);
+    balance = {0, 0};
+    confirmed = unconfirmed = 0;
+    tally.Get(102, 2, balance, confirmed, unconfirmed);
+    BOOST_CHECK_EQUAL(balance.first, 10 * COIN);
+    BOOST_CHECK_EQUAL(balance.second, 1 * COIN);
+    BOOST_CHECK_EQUAL(confirmed, 2U);
+    BOOST_CHECK_EQUAL(unconfirmed, 1U);
+
+    tally.Clear();
+    balance = {0, 0};
+    confirmed = unconfirmed = 0;
+    tally.Get(102, 2, balance, confirmed, unconfirmed);
+    BOOST_CHECK_EQUAL(balance.first + balance.second, 0);
+    BOOST_CHECK_EQUAL(confirmed + unconfirmed, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
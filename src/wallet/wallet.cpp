@@ -1658,6 +1658,12 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
 }
 
 
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    // depths, and with them maturity and trust, change with every block
+    MarkBalanceDirty();
+}
+
 isminetype CWallet::IsMine(const CTxIn &txin, const CTransaction& tx) const
 {
     LOCK(cs_wallet);
@@ -2730,6 +2736,21 @@ CAmount CWalletTx::GetChange() const
     return nChangeCached;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkBalanceDirty();
+}
+
 bool CWalletTx::InMempool() const
 {
     LOCK(mempool.cs);
@@ -2903,20 +2924,55 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance(bool fExcludeLocked) const
+void CWallet::ConnectMempoolSignals()
+{
+    connMempoolRemoved = mempool.NotifyEntryRemoved.connect(boost::bind(&CWallet::MempoolEntryRemoved, this, _1, _2));
+    connStempoolRemoved = txpools.getStemTxPool().NotifyEntryRemoved.connect(boost::bind(&CWallet::MempoolEntryRemoved, this, _1, _2));
+}
+
+void CWallet::MempoolEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
 {
-    CAmount nTotal = 0;
+    // called with the pool locked, so cs_wallet can't be taken to tell whether the transaction is ours
+    MarkBalanceDirty();
+}
+
+CWalletBalance CWallet::GetWalletBalance() const
+{
+    std::shared_ptr<const CWalletBalance> balance = std::atomic_load(&cachedBalance);
+    if (balance && balance->nGeneration == nBalanceGeneration)
+        return *balance;
+
+    auto newBalance = std::make_shared<CWalletBalance>();
     {
         LOCK2(cs_main, cs_wallet);
+        // taken before going over the transactions: a change made meanwhile makes the result
+        // out of date, so it is computed again next time
+        newBalance->nGeneration = nBalanceGeneration;
         for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
         {
             const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit(true, fExcludeLocked);
+            if (pcoin->IsTrusted()) {
+                newBalance->nAvailable += pcoin->GetAvailableCredit(true, false);
+                newBalance->nAvailableExcludeLocked += pcoin->GetAvailableCredit(true, true);
+                newBalance->nWatchOnly += pcoin->GetAvailableWatchOnlyCredit();
+            } else if (pcoin->GetDepthInMainChain() == 0 &&
+                       (pcoin->InMempool() || pcoin->InStempool()) && !pcoin->IsLockedByLLMQInstantSend()) {
+                newBalance->nUnconfirmed += pcoin->GetAvailableCredit();
+                newBalance->nUnconfirmedWatchOnly += pcoin->GetAvailableWatchOnlyCredit();
+            }
+            newBalance->nImmature += pcoin->GetImmatureCredit();
+            newBalance->nImmatureWatchOnly += pcoin->GetImmatureWatchOnlyCredit();
         }
     }
 
-    return nTotal;
+    std::atomic_store(&cachedBalance, std::shared_ptr<const CWalletBalance>(newBalance));
+    return *newBalance;
+}
+
+CAmount CWallet::GetBalance(bool fExcludeLocked) const
+{
+    CWalletBalance balance = GetWalletBalance();
+    return fExcludeLocked ? balance.nAvailableExcludeLocked : balance.nAvailable;
 }
 
 std::pair<CAmount, CAmount> CWallet::GetPrivateBalance() const
@@ -2937,48 +2993,7 @@ std::pair<CAmount, CAmount> CWallet::GetPrivateBalance(size_t &confirmed, size_t
     if(!zwallet)
         return balance;
 
-    auto lelantusCoins = zwallet->GetTracker().ListLelantusMints(true, false, false);
-    for (auto const &c : lelantusCoins) {
-
-        if (c.isUsed || c.isArchived || !c.isSeedCorrect) {
-            continue;
-        }
-
-        auto conf = c.nHeight > 0
-            ? chainActive.Height() - c.nHeight + 1 : 0;
-
-        if (conf >= ZC_MINT_CONFIRMATIONS) {
-            confirmed++;
-            balance.first += c.amount;
-        } else {
-            unconfirmed++;
-            balance.second += c.amount;
-        }
-    }
-
-    auto sigmaCoins = zwallet->GetTracker().ListMints(true, false, false);
-    for (auto const &c : sigmaCoins) {
-
-        if (c.isUsed || c.isArchived || !c.isSeedCorrect) {
-            continue;
-        }
-
-        CAmount amount;
-        if (!sigma::DenominationToInteger(c.denom, amount)) {
-            throw std::runtime_error("Fail to get denomination value");
-        }
-
-        auto conf = c.nHeight > 0
-            ? chainActive.Height() - c.nHeight + 1 : 0;
-
-        if (conf >= ZC_MINT_CONFIRMATIONS) {
-            confirmed++;
-            balance.first += amount;
-        } else {
-            unconfirmed++;
-            balance.second += amount;
-        }
-    }
+    zwallet->GetTracker().GetBalance(chainActive.Height(), balance, confirmed, unconfirmed);
 
     return balance;
 }
@@ -3700,71 +3715,23 @@ std::vector<unsigned char> CWallet::ProvePrivateTxOwn(const uint256& txid, const
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-                (pcoin->InMempool() || pcoin->InStempool()) && !pcoin->IsLockedByLLMQInstantSend())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetWalletBalance().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetWalletBalance().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetWalletBalance().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-                (pcoin->InMempool() || pcoin->InStempool()) && !pcoin->IsLockedByLLMQInstantSend())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetWalletBalance().nUnconfirmedWatchOnly;
 }
 
-CAmount CWallet::GetImmatureWatchOnlyBalance() const
-{
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+CAmount CWallet::GetImmatureWatchOnlyBalance() const {
+    return GetWalletBalance().nImmatureWatchOnly;
 }
 
 void CWallet::AvailableCoins(std::vector <COutput> &vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, bool fUseInstantSend) const
@@ -4795,8 +4762,10 @@ bool CWallet::EraseFromWallet(uint256 hash) {
         return false;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
             CWalletDB(strWalletFile).EraseTx(hash);
+            MarkBalanceDirty();
+        }
     }
     return true;
 }
@@ -6929,18 +6898,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    MarkBalanceDirty();
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    MarkBalanceDirty();
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    MarkBalanceDirty();
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -7155,6 +7127,14 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
     if (showDebug)
         strUsage += HelpMessageOpt("-sendfreetransactions", strprintf(_("Send transactions as zero-fee transactions if possible (default: %u)"), DEFAULT_SEND_FREE_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-sparkconsolidate", strprintf(_("Merge small Spark coins into larger ones in the background while the wallet is unlocked and idle (default: %u)"), DEFAULT_SPARK_CONSOLIDATE));
+    strUsage += HelpMessageOpt("-sparkconsolidatemincoins=<n>", strprintf(_("Consolidate only while the wallet has more than <n> spendable Spark coins (default: %u)"), DEFAULT_SPARK_CONSOLIDATE_MIN_COINS));
+    strUsage += HelpMessageOpt("-sparkconsolidatemaxinputs=<n>", strprintf(_("Merge at most <n> Spark coins per consolidation transaction (default: %u)"), DEFAULT_SPARK_CONSOLIDATE_MAX_INPUTS));
+    strUsage += HelpMessageOpt("-sparkconsolidateinterval=<n>", strprintf(_("Consolidate only after the Spark wallet created no spend for <n> seconds (default: %u)"), DEFAULT_SPARK_CONSOLIDATE_INTERVAL));
+    strUsage += HelpMessageOpt("-sparkconsolidatemaxfee=<amt>", strprintf(_("Spend at most <amt> (in %s) on consolidation fees in 24 hours (default: %s)"),
+                                                                          CURRENCY_UNIT, FormatMoney(DEFAULT_SPARK_CONSOLIDATE_MAX_FEE)));
+    strUsage += HelpMessageOpt("-sparkwithdrawalwindow=<n>", strprintf(_("Collect queued Spark payouts for <n> seconds before sending them together (default: %u)"), DEFAULT_SPARK_WITHDRAWAL_WINDOW));
+    strUsage += HelpMessageOpt("-sparkwithdrawalmaxpayouts=<n>", strprintf(_("Send at most <n> queued Spark payouts per transaction (default: %u)"), DEFAULT_SPARK_WITHDRAWAL_MAX_PAYOUTS));
     strUsage += HelpMessageOpt("-spendzeroconfchange", strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"), DEFAULT_SPEND_ZEROCONF_CHANGE));
     strUsage += HelpMessageOpt("-txconfirmtarget=<n>", strprintf(_("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)"), DEFAULT_TX_CONFIRM_TARGET));
     strUsage += HelpMessageOpt("-usehd", _("Use hierarchical deterministic key generation (HD) after BIP32. Only has effect during wallet creation/first start") + " " + strprintf(_("(default: %u)"), DEFAULT_USE_HD_WALLET));
@@ -7576,6 +7556,13 @@ bool CWallet::ParameterInteraction()
             return InitError(strprintf(_("Invalid amount for -mininput=<amount>: '%s'"), GetArg("-mininput", "").c_str()));
     }
 
+    if (IsArgSet("-sparkconsolidatemaxfee"))
+    {
+        CAmount nMaxFee = 0;
+        if (!ParseMoney(GetArg("-sparkconsolidatemaxfee", ""), nMaxFee))
+            return InitError(AmountErrMsg("sparkconsolidatemaxfee", GetArg("-sparkconsolidatemaxfee", "")));
+    }
+
     nTxConfirmTarget = GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     bSpendZeroConfChange = GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     fSendFreeTransactions = GetBoolArg("-sendfreetransactions", DEFAULT_SEND_FREE_TRANSACTIONS);
@@ -8110,12 +8097,14 @@ void CWallet::NotifyTransactionLock(const CTransaction &tx)
     // Only notify UI if this transaction is in this wallet
     std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(tx.GetHash());
     if (mi != mapWallet.end()){
+        MarkBalanceDirty();
         NotifyISLockReceived();
     }
 }
 
 void CWallet::NotifyChainLock(const CBlockIndex* pindexChainLock)
 {
+    MarkBalanceDirty();
     NotifyChainLockReceived(pindexChainLock->nHeight);
 }
 
@@ -113,6 +113,7 @@ class CReserveKey;
 class CScript;
 class CTxMemPool;
 class CWalletTx;
+enum class MemPoolRemovalReason;
 namespace bip47 {
 class CPaymentChannel;
 }
@@ -455,18 +456,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -649,6 +639,20 @@ class LelantusJoinSplitBuilder;
 //static boost::signals2::signal<void (CWallet *wallet)> UnlockWallet;
 extern boost::signals2::signal<void (CWallet *wallet)> UnlockWallet;
 
+/** Balances of the transparent outputs of a wallet, computed in one pass over its transactions */
+struct CWalletBalance
+{
+    CAmount nAvailable = 0;
+    CAmount nAvailableExcludeLocked = 0;
+    CAmount nUnconfirmed = 0;
+    CAmount nImmature = 0;
+    CAmount nWatchOnly = 0;
+    CAmount nUnconfirmedWatchOnly = 0;
+    CAmount nImmatureWatchOnly = 0;
+    //! CWallet::nBalanceGeneration the balances were computed at
+    uint64_t nGeneration = 0;
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -679,6 +683,15 @@ private:
     int64_t nLastResend;
     bool fBroadcastTransactions;
 
+    //! Bumped whenever something the transparent balances depend on changes
+    mutable std::atomic<uint64_t> nBalanceGeneration;
+    mutable std::shared_ptr<const CWalletBalance> cachedBalance;
+    //! a transaction leaving the memory pools without being mined changes the unconfirmed balance
+    boost::signals2::scoped_connection connMempoolRemoved;
+    boost::signals2::scoped_connection connStempoolRemoved;
+    void ConnectMempoolSignals();
+    void MempoolEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
+
     mutable bool fAnonymizableTallyCached;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCached;
     mutable bool fAnonymizableTallyCachedNonDenom;
@@ -770,16 +783,20 @@ public:
     CWallet()
     {
         SetNull();
+        ConnectMempoolSignals();
     }
 
     CWallet(const std::string& strWalletFileIn) : strWalletFile(strWalletFileIn)
     {
         SetNull();
         fFileBacked = true;
+        ConnectMempoolSignals();
     }
 
     ~CWallet()
     {
+        connMempoolRemoved.disconnect();
+        connStempoolRemoved.disconnect();
         delete pwalletdbEncryption;
         pwalletdbEncryption = NULL;
     }
@@ -796,6 +813,7 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
+        nBalanceGeneration = 0;
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
@@ -929,12 +947,17 @@ public:
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false, bool fRecoverMnemonic = false);
     CBlockIndex* GetBlockByDate(CBlockIndex* pindexStart, const std::string& dateStr);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    /** Recompute the balances next time they are asked for */
+    void MarkBalanceDirty() const { nBalanceGeneration++; }
+    /** The transparent balances, only recomputed after something they depend on changed */
+    CWalletBalance GetWalletBalance() const;
     CAmount GetBalance(bool fExcludeLocked = false) const;
     std::pair<CAmount, CAmount> GetPrivateBalance() const;
     std::pair<CAmount, CAmount> GetPrivateBalance(size_t &confirmed, size_t &unconfirmed) const;
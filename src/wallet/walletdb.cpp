@@ -1066,6 +1066,7 @@ DBErrors CWalletDB::ZapSelectTx(CWallet* pwallet, std::vector<uint256>& vTxHashI
         }
         else if ((*it) == hash) {
             pwallet->mapWallet.erase(hash);
+            pwallet->MarkBalanceDirty();
             if(!EraseTx(hash)) {
                 LogPrint("db", "Transaction was found for deletion but returned database error: %s\n", hash.GetHex());
                 delerror = true;
@@ -1853,6 +1854,51 @@ bool CWalletDB::EraseSparkSpendEntry(const secp_primitives::GroupElement& lTag)
     return Erase(std::make_pair(std::string("spark_spend"), lTag));
 }
 
+std::list<CSparkPayout> CWalletDB::ListSparkPayouts()
+{
+    std::list<CSparkPayout> listPayouts;
+    Dbc *pcursor = GetCursor();
+    if (!pcursor)
+        throw std::runtime_error(std::string(__func__)+" : cannot create DB cursor");
+    bool setRange = true;
+    while (true) {
+        // Read next record
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (setRange)
+            ssKey << std::make_pair(std::string("sparkPayout"), uint256());
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = ReadAtCursor(pcursor, ssKey, ssValue, setRange);
+        setRange = false;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0) {
+            pcursor->close();
+            throw std::runtime_error(std::string(__func__)+" : error scanning DB");
+        }
+
+        // Unserialize
+        std::string strType;
+        ssKey >> strType;
+        if (strType != "sparkPayout")
+            break;
+
+        CSparkPayout payout;
+        ssValue >> payout;
+        listPayouts.push_back(payout);
+    }
+
+    pcursor->close();
+    return listPayouts;
+}
+
+bool CWalletDB::WriteSparkPayout(const CSparkPayout& payout) {
+    return Write(std::make_pair(std::string("sparkPayout"), payout.id), payout);
+}
+
+bool CWalletDB::EraseSparkPayout(const uint256& id) {
+    return Erase(std::make_pair(std::string("sparkPayout"), id));
+}
+
 /******************************************************************************/
 // BIP47
 /******************************************************************************/
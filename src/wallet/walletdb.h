@@ -316,6 +316,10 @@ public:
     bool HasSparkSpendEntry(const secp_primitives::GroupElement& lTag);
     bool EraseSparkSpendEntry(const secp_primitives::GroupElement& lTag);
 
+    std::list<CSparkPayout> ListSparkPayouts();
+    bool WriteSparkPayout(const CSparkPayout& payout);
+    bool EraseSparkPayout(const uint256& id);
+
     //! write the hdchain model (external chain child index counter)
     bool WriteHDChain(const CHDChain& chain);
     bool WriteMnemonic(const MnemonicContainer& mnContainer);
@@ -20,3 +20,8 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyTransactionEvent(const CTransaction &/*transaction*/, ZMQTxEvent /*event*/, int /*nHeight*/)
+{
+    return true;
+}
@@ -12,6 +12,13 @@ class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+/** Reason a transaction is being notified, carried in the privacy notifications */
+enum class ZMQTxEvent : uint8_t {
+    MEMPOOL = 0,        //!< accepted to the mempool
+    CONNECTED = 1,      //!< included in a connected block
+    DISCONNECTED = 2,   //!< included in a block that was disconnected
+};
+
 class CZMQAbstractNotifier
 {
 public:
@@ -34,6 +41,8 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    /** nHeight is the height of the block the transaction is (dis)connected in, -1 for mempool entry */
+    virtual bool NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight);
 
 protected:
     void *psocket;
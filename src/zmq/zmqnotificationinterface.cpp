@@ -39,6 +39,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubsparkmint"] = CZMQAbstractNotifier::Create<CZMQPublishSparkMintNotifier>;
+    factories["pubsparkspend"] = CZMQAbstractNotifier::Create<CZMQPublishSparkSpendNotifier>;
+    factories["pubsparkname"] = CZMQAbstractNotifier::Create<CZMQPublishSparkNameNotifier>;
+    factories["publelantusspend"] = CZMQAbstractNotifier::Create<CZMQPublishLelantusSpendNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -150,10 +154,26 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
 
 void CZMQNotificationInterface::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int posInBlock)
 {
+    // Blocks being connected pass their index, disconnected blocks pass the index of their parent
+    // and no block position. Without an index the transaction either entered the mempool or was
+    // evicted as a conflict; the latter is not reported to the privacy notifiers.
+    bool fNotifyEvent = true;
+    ZMQTxEvent event = ZMQTxEvent::MEMPOOL;
+    int nHeight = -1;
+    if (pindex && posInBlock != CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK) {
+        event = ZMQTxEvent::CONNECTED;
+        nHeight = pindex->nHeight;
+    } else if (pindex) {
+        event = ZMQTxEvent::DISCONNECTED;
+        nHeight = pindex->nHeight + 1;
+    } else {
+        fNotifyEvent = mempool.exists(tx.GetHash());
+    }
+
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+        if (notifier->NotifyTransaction(tx) && (!fNotifyEvent || notifier->NotifyTransactionEvent(tx, event, nHeight)))
         {
             i++;
         }
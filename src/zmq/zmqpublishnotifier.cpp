@@ -8,6 +8,9 @@
 #include "validation.h"
 #include "util.h"
 #include "rpc/server.h"
+#include "lelantus.h"
+#include "sparkname.h"
+#include "spark/state.h"
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -15,6 +18,10 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_SPARKMINT = "sparkmint";
+static const char *MSG_SPARKSPEND = "sparkspend";
+static const char *MSG_SPARKNAME = "sparkname";
+static const char *MSG_LELANTUSSPEND = "lelantusspend";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -191,3 +198,77 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+/* Privacy notifications share a common layout:
+ *   uint8 event | int32 height | uint256 txid | compact size count | count items
+ * so subscribers can apply and roll back the items without querying the node. */
+template <typename T>
+static bool SendTransactionEventMessage(CZMQAbstractPublishNotifier *notifier, const char *command, const CTransaction &transaction,
+                                        ZMQTxEvent event, int nHeight, const std::vector<T> &items)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << (uint8_t)event << (int32_t)nHeight << transaction.GetHash() << items;
+    return notifier->SendMessage(command, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishSparkMintNotifier::NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight)
+{
+    if (!transaction.IsSparkTransaction())
+        return true;
+
+    std::vector<spark::Coin> coins = spark::GetSparkMintCoins(transaction);
+    if (coins.empty())
+        return true;
+
+    LogPrint("zmq", "zmq: Publish sparkmint %s (%u coins)\n", transaction.GetHash().GetHex(), coins.size());
+    return SendTransactionEventMessage(this, MSG_SPARKMINT, transaction, event, nHeight, coins);
+}
+
+bool CZMQPublishSparkSpendNotifier::NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight)
+{
+    if (!transaction.IsSparkSpend())
+        return true;
+
+    std::vector<GroupElement> lTags = spark::GetSparkUsedTags(transaction);
+    if (lTags.empty())
+        return true;
+
+    LogPrint("zmq", "zmq: Publish sparkspend %s (%u linking tags)\n", transaction.GetHash().GetHex(), lTags.size());
+    return SendTransactionEventMessage(this, MSG_SPARKSPEND, transaction, event, nHeight, lTags);
+}
+
+bool CZMQPublishSparkNameNotifier::NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight)
+{
+    if (!transaction.IsSparkSpend())
+        return true;
+
+    spark::SpendTransaction sparkTx(spark::Params::get_default());
+    CSparkNameTxData sparkNameData;
+    size_t sparkNameDataPos;
+    if (!CSparkNameManager::ParseSparkNameTxData(transaction, sparkTx, sparkNameData, sparkNameDataPos))
+        return true;
+
+    LogPrint("zmq", "zmq: Publish sparkname %s (%s)\n", transaction.GetHash().GetHex(), sparkNameData.name);
+    // a transaction registers at most one name, the count prefix is kept for a uniform layout
+    std::vector<CSparkNameTxData> names;
+    names.push_back(std::move(sparkNameData));
+    return SendTransactionEventMessage(this, MSG_SPARKNAME, transaction, event, nHeight, names);
+}
+
+bool CZMQPublishLelantusSpendNotifier::NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight)
+{
+    if (!transaction.IsLelantusJoinSplit() || transaction.vin.empty())
+        return true;
+
+    std::vector<Scalar> serials;
+    try {
+        serials = lelantus::GetLelantusJoinSplitSerialNumbers(transaction, transaction.vin[0]);
+    } catch (const std::exception &) {
+        return true;
+    }
+    if (serials.empty())
+        return true;
+
+    LogPrint("zmq", "zmq: Publish lelantusspend %s (%u serials)\n", transaction.GetHash().GetHex(), serials.size());
+    return SendTransactionEventMessage(this, MSG_LELANTUSSPEND, transaction, event, nHeight, serials);
+}
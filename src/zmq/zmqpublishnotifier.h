@@ -12,7 +12,7 @@ class CBlockIndex;
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; //!< upcounting per message sequence number
+    uint32_t nSequence {0U}; //!< upcounting per message sequence number
 
 public:
 
@@ -52,4 +52,28 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+class CZMQPublishSparkMintNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight);
+};
+
+class CZMQPublishSparkSpendNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight);
+};
+
+class CZMQPublishSparkNameNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight);
+};
+
+class CZMQPublishLelantusSpendNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionEvent(const CTransaction &transaction, ZMQTxEvent event, int nHeight);
+};
+
 #endif // PRIVORA_ZMQ_ZMQPUBLISHNOTIFIER_H